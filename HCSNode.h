@@ -1,60 +1,266 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <boost/asio.hpp>
 #include "hcs_net/TransportBase.h"          // Endpoint, IMediaTransport
-#include "hcs_net/QuicNgTcp2Transport.h"    // トランスポート実装の例
+#include "hcs_net/IControlTransport.h"      // 制御メッセージのトランスポート
 #include "hcs_control/TopologyManager.h"    // トポロジー管理
 #include "hcs_media/StreamEncoder.h"        // メディア送信
 #include "hcs_media/StreamDecoder.h"        // メディア受信
 #include "hcs_net/TransportAES256.h"        // KeyProvider
+#include "hcs_net/ControlPiggyback.h"       // 制御メッセージの相乗り
+#include "hcs_control/SubscriptionTable.h"  // 中継先の購読テーブル
+#include "hcs_control/RttProbe.h"           // ピアとのRTT計測
+#include "hcs_common/MetricsExporter.h"      // メトリクスの公開
+#include "hcs_net/PacketCapture.h"          // デバッグ用のパケットキャプチャ
+#include "hcs_common/NodeConfig.h"          // ノードの設定と再読み込み
+#include "hcs_common/Metrics.h"
 
 namespace hcs {
 
+/**
+ * @brief ノードおよび各コンポーネントのライフサイクル状態。
+ */
+enum class LifecycleState : uint8_t {
+    kStopped,   ///< 未起動、または停止済み (Start() で再起動できる)
+    kStarting,  ///< 起動中
+    kRunning,   ///< 動作中
+    kDraining,  ///< 停止中 (新規の受け付けを止め、送信キューを送出している)
+    kFailed     ///< 起動に失敗した (起動済みのコンポーネントは閉じられている)
+};
+
+/**
+ * @brief HCSNode が管理するコンポーネント。
+ * 鍵の導出・トポロジー管理・制御トランスポート・診断は互いに独立で並行に起動し、
+ * メディアトランスポートは鍵に、デコーダとエンコーダはメディアトランスポートに依存する。
+ */
+enum class NodeComponent : uint8_t {
+    kKeyProvider,       ///< 鍵の導出 (PBKDF2。起動で最も時間がかかる)
+    kTopology,          ///< トポロジー管理と制御ループ
+    kControlTransport,  ///< 制御トランスポート
+    kDiagnostics,       ///< メトリクスのエクスポータ・設定の再読み込み
+    kMediaTransport,    ///< メディアトランスポート
+    kDecoder,           ///< メディアの受信側
+    kEncoder,           ///< メディアの送信側
+    kCount
+};
+
+/**
+ * @brief ノードのライフサイクルのメトリクス。
+ */
+struct NodeLifecycleMetrics {
+    hcs_common::Gauge& state;             // LifecycleState の値
+    hcs_common::Gauge& start_duration_ms; // 直近の Start() の所要時間
+    hcs_common::Gauge& drain_duration_ms; // 直近の Stop() の開始からソケットを閉じるまでの時間
+    hcs_common::Counter& drain_timeouts;  // 送信キューを送出しきる前にドレインの上限に達した回数
+    hcs_common::Gauge& handoff_duration_ms;    // 直近の停止で子ノードが親を切り替えるまでの時間
+    hcs_common::Counter& handoff_unconfirmed;  // 親の切り替えを確認できないまま停止した子ノードの数
+    hcs_common::Counter& relayed_packets;      // 子ノードへ中継したメディアパケット数 (宛先ごと)
+    hcs_common::Counter& published_packets;    // 送信元として子ノードへ送ったメディアパケット数 (宛先ごと)
+
+    static NodeLifecycleMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static NodeLifecycleMetrics metrics{
+            registry.GetGauge("hcs_node_state", "Node lifecycle state (0=stopped 1=starting 2=running 3=draining 4=failed)"),
+            registry.GetGauge("hcs_node_start_duration_ms", "Duration of the last node start"),
+            registry.GetGauge("hcs_node_drain_duration_ms", "Duration of the last graceful stop"),
+            registry.GetCounter("hcs_node_drain_timeouts_total", "Graceful stops that closed sockets with sends still pending"),
+            registry.GetGauge("hcs_node_handoff_duration_ms", "Time for children to move to a new parent during the last graceful stop"),
+            registry.GetCounter("hcs_node_handoff_unconfirmed_total", "Child subscriptions still present when the handoff timed out"),
+            registry.GetCounter("hcs_node_relayed_packets_total", "Media packets forwarded unchanged to subscribed children"),
+            registry.GetCounter("hcs_node_published_packets_total", "Media packets from the local encoder sent to subscribed children"),
+        };
+        return metrics;
+    }
+};
+
 /**
  * @brief HCS自律分散型ノードのコアロジックを統合するクラス
  * 制御層、データパス層、トランスポート層の全コンポーネントを管理し、
  * ノードの起動・停止、ストリームのライフサイクル制御を行う。
+ *
+ * 送信元のグループ (groups.source) ではエンコーダの出力を一度だけ暗号化して購読中の子ノードへ送り、
+ * 参加中のグループ (groups.join) では選定した親へ JOIN して受信したメディアを自ノードの子ノードへ中継する。
+ *
+ * 各コンポーネントの状態 (LifecycleState) を個別に追跡する。Start() は依存関係のない
+ * コンポーネントを並行に起動し、Stop() は子ノードのハンドオフ → 受け付けの停止 → 送信キューの送出 →
+ * LEAVE の送信 → ソケットのクローズの順に段階的に停止する。停止後は同じインスタンスで再度 Start() できる。
  */
 class HCSNode : public std::enable_shared_from_this<HCSNode> {
 public:
     /**
      * @brief HCSNodeのコンストラクタ
+     * アドレス・ポート・鍵・グループ・タイムアウトは起動時に検証済みの設定から取得する。
      * @param io_context boost::asioのI/Oコンテキスト
-     * @param self_node_id このノードの一意なID
-     * @param local_addr ローカルリスニングアドレス (IPv6を想定)
-     * @param local_port ローカルリスニングポート
+     * @param config ノードの設定 (SIGHUP で調整値を再読み込みする)
      */
     HCSNode(
         boost::asio::io_context& io_context,
-        const std::string& self_node_id,
-        const std::string& local_addr,
-        uint16_t local_port
+        std::shared_ptr<hcs_common::NodeConfigStore> config
     );
     
     ~HCSNode();
 
     /**
      * @brief ノードの全コンポーネントを起動し、トポロジー管理とメディアストリームを開始する
-     * @param key_provider マスターキーを提供するプロバイダ
+     * 鍵の導出 (PBKDF2) はワーカースレッドで行い、その間に制御層と診断を起動する。
+     * io_context を回す前、またはそのスレッドから呼ぶ。
+     * @throw std::logic_error 停止済み (kStopped / kFailed) でない場合
+     * @throw std::exception コンポーネントの起動に失敗した場合 (起動済みのものは閉じて kFailed になる)
+     */
+    void Start();
+
+    /**
+     * @brief ノードを段階的に停止する (io_context のスレッドで非同期に進む)
+     * 子ノードがいる場合は、まず新規の JOIN を止めて子ノードへ停止を予告 (DEPARTING) し、推奨する
+     * 代わりの親を伝える。中継を続けたまま、全ての子ノードが新しい親から受信して LEAVE を返すか
+     * timeouts.handoff に達するまで待つ。その後メディアの送受信を止め、相乗り待ちと制御の送信キューを
+     * 送出し、JOIN を送った親へ LEAVE を送ってから、送信中のパケットが無くなるか
+     * timeouts.drain に達した時点でソケットを閉じる。
+     * @param on_stopped 停止の完了時に io_context のスレッドで呼ばれる (省略可)
+     */
+    void Stop(std::function<void()> on_stopped = nullptr);
+
+    /**
+     * @brief ノード全体の状態
+     */
+    LifecycleState State() const { return state_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief コンポーネントの状態
+     */
+    LifecycleState ComponentState(NodeComponent component) const {
+        return component_states_[static_cast<size_t>(component)].load(std::memory_order_acquire);
+    }
+
+    static const char* StateName(LifecycleState state);
+    static const char* ComponentName(NodeComponent component);
+
+    /**
+     * @brief 設定の threads.io_threads 本のスレッドで io_context を回す (停止するまで戻らない)
+     * コンポーネントは strand で直列化していないため、設定の検証で threads.io_threads は 1 に限っている。
+     * 各スレッドは開始時にパケットプールを pools.packet_buffers 個まで事前確保し、
+     * threads.pin_cpus が有効であれば CPU に固定される。
+     */
+    void Run();
+
+    /**
+     * @brief 子ノードへHEARTBEATを送る。メディア送信中であればRTPパケットに相乗りさせる
+     * @param child 子ノードの制御エンドポイント (相乗り先のメディアパケットとはアドレスで照合する)
+     * @param group_id 子ノードが購読しているグループID
+     */
+    void SendHeartbeat(const hcs_net::Endpoint& child, const std::string& group_id);
+
+    /**
+     * @brief グループに参加し、そのグループのマルチキャストアドレス宛てのADVERTISEを受信する
+     * 起動前に呼んだ場合は Start() で参加し、再起動時にも参加し直す。
+     * @param group_id グループID
+     */
+    void JoinGroup(const std::string& group_id);
+
+    /**
+     * @brief グループから離脱し、そのグループのADVERTISEの受信を停止する
+     * @param group_id グループID
+     */
+    void LeaveGroup(const std::string& group_id);
+
+    /**
+     * @brief 受信したメディアパケットを、そのレイヤーを購読している子ノードへ暗号文のまま中継する
+     * メディアの受信経路 (IMediaTransport の中継ハンドラ) から呼び出される。購読テーブルはロックなしで参照する
+     * @param group_slot SubscriptionTable::RegisterGroup で得たグループのスロット番号
+     * @param layer パケットのレイヤー番号 (SVC/サイマルキャスト)
+     * @param wire 中継する暗号文 (受信したまま。再暗号化しないため、下流の重複排除が IV で同一パケットを識別できる)
+     */
+    void RelayMediaPacket(int group_slot, uint8_t layer, const hcs_common::PacketRef& wire);
+
+    /**
+     * @brief アプリケーションがパケット化した RTP パケットを、送信元のグループの購読者へ送る
+     * エンコーダの出力と同じく一度だけ暗号化する。送信元のグループがない場合とエンコーダの停止後は破棄する。
+     * io_context のスレッドから呼ぶ。
+     * @param packet 平文の RTP パケット (バッファ上でその場で暗号化される)
+     */
+    void PublishMedia(hcs_common::PacketRef packet);
+
+    /**
+     * @brief 受信して解析した RTP パケットの受け取り処理を設定する (Start() の前に呼ぶ)
+     * 復号・RTP 解析の後に io_context のスレッドで呼ばれる (レンダラーやベンチマークの計測用)。
+     * @param handler 復号済みのバッファとペイロードの位置を受け取る処理
+     */
+    void SetMediaHandler(hcs_media::StreamDecoder::PayloadHandler handler);
+
+    /**
+     * @brief 制御メッセージの相乗りの統計 (io_context のスレッドから、または停止後に呼ぶ)
+     */
+    hcs_net::PiggybackStats GetPiggybackStats() const { return control_piggyback_->GetStats(); }
+
+    /**
+     * @brief メトリクスをループバックの HTTP で公開する (Prometheus のスクレイプ対象)
+     * @param port 待ち受けポート
      */
-    void Start(std::shared_ptr<hcs_net::KeyProvider> key_provider);
+    void StartMetricsExporter(uint16_t port);
 
     /**
-     * @brief ノードの全操作を停止し、リソースを解放する
+     * @brief メディアパケットのキャプチャを有効にする (Start() の前に呼ぶ)
+     * 直近のパケットを暗号化の前後でリングに保持し、復号失敗の連続・親の切り替え・SIGUSR2 で
+     * config.directory に pcapng として書き出す。
+     * @param config キャプチャの設定
      */
-    void Stop();
+    void EnableCapture(const hcs_net::CaptureConfig& config);
+
+    /**
+     * @brief トレース (hcs_common/Tracing.h) の記録を有効にする
+     * 直近のイベントは StartMetricsExporter で公開した HTTP の /trace から Chrome trace 形式で取得できる。
+     * 起動手順を記録する場合は Start() の前に呼ぶ。
+     */
+    void EnableTracing();
 
 private:
     boost::asio::io_context& io_context_;
+    std::shared_ptr<hcs_common::NodeConfigStore> config_;
     std::string self_node_id_;
-    hcs_net::Endpoint self_endpoint_;
+
+    // --- ライフサイクル ---
+    std::atomic<LifecycleState> state_{LifecycleState::kStopped};
+    std::array<std::atomic<LifecycleState>, static_cast<size_t>(NodeComponent::kCount)> component_states_{};
+    std::atomic<bool> accepting_{false};        // false の間は JOIN を受け付けない (起動前・ドレイン中)
+    std::chrono::steady_clock::time_point drain_started_;  // Stop() の開始時刻
+    std::chrono::steady_clock::time_point egress_started_; // 送信キューの送出を始めた時刻 (timeouts.drain の起点)
+    boost::asio::steady_timer drain_timer_;     // 送信キューの送出を待つポーリング
+    std::function<void()> on_stopped_;
+    std::set<std::string> joined_groups_;       // 参加中のグループ (再起動時に再参加する)
+    std::map<std::string, std::set<std::string>> joined_parents_; // GroupID -> JOIN を送った親のIP (LEAVE の宛先)
+    std::vector<int> source_slots_;             // 送信元のグループの SubscriptionTable のスロット番号
+    std::shared_ptr<hcs_net::KeyProvider> key_provider_; // 導出済みの鍵 (再起動時に使い回す)
+
+    // --- 計画停止のハンドオフ ---
+    /**
+     * @brief 親の停止予告を受けて新しい親へ JOIN し、受信を確認するまで旧い親への LEAVE を保留している状態。
+     */
+    struct PendingHandoff {
+        hcs_net::Endpoint old_parent;   // 停止する親の制御エンドポイント (LEAVE の宛先)
+        std::string new_parent;         // 新しい親のIP (このIPからのメディアの受信で確認とする)
+        std::chrono::steady_clock::time_point deadline; // 受信を確認できなくても LEAVE を送る時刻
+    };
+    bool handoff_active_ = false;                        // 子ノードの切り替えを待っている (ドレインの第0段)
+    std::chrono::steady_clock::time_point handoff_deadline_;
+    std::chrono::steady_clock::time_point last_departure_sent_;
+    std::map<std::string, PendingHandoff> pending_handoffs_; // GroupID -> 子としての切り替え待ち
+    std::mutex handoff_mutex_;                               // pending_handoffs_ (メディアスレッドからも参照する)
+    std::atomic<bool> handoff_pending_{false};               // pending_handoffs_ が空でないか (受信経路での判定用)
 
     // --- コンポーネント群 ---
     
-    // 1. トランスポート層 (QUIC/Secure UDP)
+    // 1. トランスポート層 (メディアは Secure UDP / QUIC、制御は UDP)。Start() のたびに作り直す
     std::shared_ptr<hcs_net::IMediaTransport> media_transport_;
+    std::shared_ptr<hcs_net::IControlTransport> control_transport_;
     
     // 2. 制御層 (トポロジー管理)
     std::shared_ptr<hcs_control::TopologyManager> topology_manager_;
@@ -62,24 +268,214 @@ private:
     // 3. データパス層 (エンコーダ/デコーダ)
     std::shared_ptr<hcs_media::StreamEncoder> stream_encoder_;
     std::shared_ptr<hcs_media::StreamDecoder> stream_decoder_;
+    hcs_media::StreamDecoder::PayloadHandler media_handler_; // Start() でデコーダへ渡す
+
+    // 4. 制御メッセージのメディアパケットへの相乗り
+    std::shared_ptr<hcs_net::ControlPiggyback> control_piggyback_;
+    std::vector<hcs_net::Endpoint> piggyback_dests_; // 送信元のパケットの宛先一覧 (相乗り待ちがある場合のみ作る。容量を使い回す)
+
+    // 5. 中継先の購読テーブル (JOIN/LEAVEで更新、メディアスレッドから参照)
+    std::shared_ptr<hcs_control::SubscriptionTable> subscription_table_;
+
+    // 6. 制御ループ (ADVERTISEのバッチ適用)
+    boost::asio::steady_timer control_tick_timer_;
+
+    // 7. メトリクスのエクスポータ (StartMetricsExporter で有効化)
+    std::shared_ptr<hcs_common::MetricsHttpExporter> metrics_exporter_;
+
+    // 8. パケットキャプチャ (EnableCapture で有効化。SIGUSR2 で手動出力)
+    std::shared_ptr<hcs_net::PacketCapture> packet_capture_;
+    std::unique_ptr<boost::asio::signal_set> capture_signals_;
+
+    // 9. ピアとのRTT・遅延勾配の計測 (制御ティックごとに PROBE を送る)
+    hcs_control::RttProbe rtt_probe_;
+    uint64_t control_ticks_ = 0;
+    std::chrono::steady_clock::time_point running_since_; // 起動完了時刻 (ADVERTISE の安定性スコアに用いる)
+
+    // 直前にメディアを受信した送信元とそのアドレスの文字列 (生存判定のたびに変換しないため)
+    hcs_net::Endpoint media_activity_sender_;
+    std::string media_activity_ip_;
+
+    /**
+     * @brief 中継の経路 (この親から届いたメディアを、このグループの購読者へ転送する)。
+     */
+    struct RelayRoute {
+        hcs_net::Endpoint parent; // 親のアドレス (照合はアドレスのみで、ポートは見ない)
+        int slot = -1;            // グループの SubscriptionTable のスロット番号
+    };
+    std::vector<RelayRoute> relay_routes_; // 制御ティックごとに親の選定結果から作り直す (I/O スレッドのみで参照)
+
+    // 10. 設定の再読み込み (SIGHUP)
+    std::unique_ptr<boost::asio::signal_set> reload_signals_;
 
     // --- 内部ヘルパー関数 ---
-    
+
     /**
-     * @brief トポロジーマネージャから最適なピアを取得し、エンコーダの送信先を決定する
+     * @brief コンポーネントの状態を更新する (遷移はデバッグログに出す)
      */
-    void SelectAndStartStream();
+    void SetComponentState(NodeComponent component, LifecycleState state);
 
     /**
-     * @brief デコーダをトランスポート層に接続し、受信を開始する
+     * @brief ノード全体の状態を更新する
      */
-    void StartMediaReception();
-    
+    void SetState(LifecycleState state);
+
+    /**
+     * @brief 設定に従って制御トランスポートを作成する
+     */
+    std::shared_ptr<hcs_net::IControlTransport> CreateControlTransport() const;
+
+    /**
+     * @brief 設定の media_backend に従ってメディアトランスポートを作成する (ソケットはここでバインドする)
+     * @param key_provider 導出済みの鍵
+     */
+    std::shared_ptr<hcs_net::IMediaTransport> CreateMediaTransport(std::shared_ptr<hcs_net::KeyProvider> key_provider) const;
+
+    /**
+     * @brief 参加中のグループの親 (プライマリ・セカンダリ・切り替え中の新旧の親) から中継の経路を作り直す
+     */
+    void UpdateRelayRoutes();
+
+    /**
+     * @brief 中継の経路のいずれかに購読中の子ノードがいるかをメディアトランスポートへ伝える
+     * (子ノードがいない間は、受信した暗号文への参照を残さずその場で復号させる)
+     */
+    void UpdateRelayActive();
+
+    /**
+     * @brief スロットの購読者のうち、レイヤーを購読している子ノードへ暗号文を送る
+     * @return 送った宛先の数
+     */
+    size_t SendToSubscribers(int group_slot, uint8_t layer, const hcs_common::PacketRef& wire);
+
+    /**
+     * @brief エンコーダの RTP パケットを一度だけ暗号化し、送信元のグループの購読者へ送る (エンコーダの sink)
+     * 購読者がいなければ暗号化しない。全ての子ノードが同じ暗号文を受け取るため、下流の重複排除が機能する。
+     */
+    void PublishToSubscribers(hcs_common::PacketRef packet);
+
+    /**
+     * @brief 参加中のグループについて、親の選定結果に合わせて JOIN・LEAVE を送る (制御ティックから呼ぶ)
+     * 新たに選定した親へ JOIN し、選定から外れた親へ LEAVE を送る。切り替え中のグループは
+     * HandleParentDeparture と ConfirmHandoffs が扱うため対象外とする。
+     * @param refresh 選定中の全ての親へ JOIN を再送する (UDP の喪失に備えて JOIN_REFRESH_INTERVAL ごと)
+     */
+    void ReconcileParents(bool refresh);
+
+    /**
+     * @brief 親から届いた認証済みのメディアパケットを、そのグループの購読者へ中継する (受信経路から呼ばれる)
+     * メディアパケットはグループを運ばないため、送信元の親が担うグループで中継先を決める。
+     */
+    void RelayFromParent(const hcs_common::PacketRef& wire, const hcs_net::Endpoint& sender);
+
+    /**
+     * @brief 子ノードのいる全グループについて、子ノードへ停止の予告と代わりの親を送る (ドレインの第0段)
+     */
+    void SendDepartures();
+
+    /**
+     * @brief 子ノードの切り替えの完了・期限・予告の再送を確認する (第0段の間、定期的に呼ぶ)
+     */
+    void CheckHandoff();
+
+    /**
+     * @brief 第0段を終え、受け付けの停止以降のドレインに進む
+     */
+    void FinishHandoff();
+
+    /**
+     * @brief メディアの送受信を止め、送信キューの送出と LEAVE の送信を行う (ドレインの第1〜3段)
+     */
+    void DrainEgress();
+
+    /**
+     * @brief 親からの停止予告 (DEPARTING) を処理し、代わりの親へ切り替える
+     */
+    void HandleParentDeparture(const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint);
+
+    /**
+     * @brief 親ノードの制御ポートへ JOIN を送る
+     */
+    void SendJoin(const std::string& parent_ip, const std::string& group_id);
+
+    /**
+     * @brief 親ノードの制御ポートへ LEAVE を送る
+     */
+    void SendLeave(const std::string& parent_ip, const std::string& group_id);
+
+    /**
+     * @brief 切り替え待ちのうち、新しい親からの受信を確認したもの (media_sender が空なら期限切れのもの) について
+     * 旧い親へ LEAVE を送って切り替えを確定する
+     * @param media_sender メディアパケットの送信元IP
+     */
+    void ConfirmHandoffs(const std::string& media_sender);
+
+    /**
+     * @brief JOIN を送った全ての親へ LEAVE を送る (ドレインの第3段)
+     */
+    void SendLeaveToParents();
+
+    /**
+     * @brief 送信中のパケットが無くなるか上限に達するまで待ち、ソケットを閉じる (ドレインの第4段)
+     */
+    void WaitForEgressDrain();
+
+    /**
+     * @brief 全ソケット・タイマー・シグナルの待ち受けを閉じ、全コンポーネントを kStopped にする
+     */
+    void CloseAll();
+
+    /**
+     * @brief 制御メッセージを受信した際の処理
+     */
+    void HandleControlMessage(const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint);
+
+    /**
+     * @brief 制御メッセージを種別ごとに処理する (単独の制御データグラムと相乗りの両方から呼ばれる)
+     */
+    void RouteControlMessage(const std::vector<uint8_t>& message_data, const hcs_net::Endpoint& sender_endpoint);
+
+    /**
+     * @brief SIGUSR2 の待ち受けを予約する。受信するたびにキャプチャを出力する
+     */
+    void WaitCaptureSignal();
+
+    /**
+     * @brief SIGHUP の待ち受けを予約する。受信するたびに設定を再読み込みする
+     */
+    void WaitReloadSignal();
+
+    /**
+     * @brief 再読み込みした調整値を各コンポーネントへ反映する (I/O スレッドで呼ぶ)
+     * @param tunables 新しい調整値
+     */
+    void ApplyTunables(const hcs_common::NodeTunables& tunables);
+
+    /**
+     * @brief 制御ループのティックを予約する。ティックごとに受信済みADVERTISEをまとめて適用する
+     */
+    void ScheduleControlTick();
+
+    /**
+     * @brief 経路を持つグループごとに、そのグループのマルチキャストアドレスへ ADVERTISE を送る
+     * (制御ティックから ADVERTISE_INTERVAL ごとに呼ぶ。停止中は親候補にならないよう送らない)
+     */
+    void SendAdvertise();
+
+    /**
+     * @brief 購読中の全ての子ノードへ HEARTBEAT を送る (制御ティックから HEARTBEAT_INTERVAL ごとに呼ぶ)
+     */
+    void SendHeartbeats();
+
+    /**
+     * @brief メディアの受信を送信元ピアの生存シグナルとして TopologyManager に記録する (メディアスレッドで呼ぶ)
+     */
+    void RecordMediaActivity(const hcs_net::Endpoint& sender);
+
     /**
-     * @brief トランスポート層の初期化を行う
-     * @param key_provider マスターキープロバイダ
+     * @brief ADVERTISE を受信済みの全ピアへ PROBE を送る (RTT は親選定の NodeMetrics::rtt_ms に反映される)
      */
-    void InitTransport(std::shared_ptr<hcs_net::KeyProvider> key_provider);
+    void SendProbes();
 };
 
 } // namespace hcs
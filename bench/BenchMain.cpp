@@ -0,0 +1,17 @@
+// ベンチマーク共通の main。
+// 計測対象の情報ログが出力時間として混入しないよう、ログレベルを Warn に上げてから実行する。
+
+#include <benchmark/benchmark.h>
+#include "hcs_common/Logger.h"
+
+int main(int argc, char** argv) {
+    hcs_common::Logger::SetLevel(hcs_common::LogLevel::kWarn);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    hcs_common::Logger::Instance().Flush();
+    return 0;
+}
@@ -0,0 +1,30 @@
+// PBKDF2KeyProvider の構築 (PBKDF2-HMAC-SHA256、PBKDF2_ITERATIONS 回) のベンチマーク。
+// ノード起動時と鍵の再設定時のみ発生するが、反復回数の変更が起動時間に与える影響を追跡する。
+
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "hcs_net/PBKDF2KeyProvider.h"
+
+namespace {
+
+void BM_PBKDF2KeyProvider_Construct(benchmark::State& state) {
+    const std::vector<uint8_t> salt(hcs_net::PBKDF2_SALT_SIZE, 0x5A);
+    for (auto _ : state) {
+        hcs_net::PBKDF2KeyProvider provider("benchmark-session-password", salt);
+        benchmark::DoNotOptimize(provider.GetEncryptionKey().data());
+    }
+}
+BENCHMARK(BM_PBKDF2KeyProvider_Construct)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief ソルトを指定しない場合 (乱数生成を含む)。
+ */
+void BM_PBKDF2KeyProvider_ConstructRandomSalt(benchmark::State& state) {
+    for (auto _ : state) {
+        hcs_net::PBKDF2KeyProvider provider("benchmark-session-password");
+        benchmark::DoNotOptimize(provider.GetEncryptionKey().data());
+    }
+}
+BENCHMARK(BM_PBKDF2KeyProvider_ConstructRandomSalt)->Unit(benchmark::kMillisecond);
+
+} // namespace
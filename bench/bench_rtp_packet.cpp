@@ -0,0 +1,84 @@
+// RTP パケット化・解析のベンチマーク (制御メッセージの相乗りを含む)。
+
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "hcs_media/RtpPacket.h"
+#include "hcs_net/ControlPiggyback.h"
+
+namespace {
+
+const hcs_net::Endpoint PEER("127.0.0.1", 40000);
+const std::vector<uint8_t> CONTROL_MESSAGE(32, 0x01); // HEARTBEAT 相当の大きさ
+constexpr std::chrono::milliseconds PIGGYBACK_MAX_DELAY(50);
+
+void BM_RtpPacketize(benchmark::State& state) {
+    const size_t frame_size = static_cast<size_t>(state.range(0));
+    uint32_t timestamp = 0;
+    for (auto _ : state) {
+        std::vector<uint8_t> packet = hcs_media::CreateDummyRtpPacket(frame_size, timestamp += 3000);
+        benchmark::DoNotOptimize(packet.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_RtpPacketize)->Arg(200)->Arg(1200);
+
+/**
+ * @brief 保留中の制御メッセージをヘッダー拡張として載せるパケット化 (登録 + 相乗り)。
+ */
+void BM_RtpPacketizeWithPiggyback(benchmark::State& state) {
+    boost::asio::io_context io;
+    auto piggyback = std::make_shared<hcs_net::ControlPiggyback>(
+        io, [](const std::vector<uint8_t>&, const hcs_net::Endpoint&) {});
+    benchmark::IterationCount attached = 0;
+    for (auto _ : state) {
+        piggyback->Submit(CONTROL_MESSAGE, PEER, PIGGYBACK_MAX_DELAY);
+        std::vector<uint8_t> packet = hcs_media::CreateDummyRtpPacket(1200, 0);
+        attached += piggyback->AttachTo(packet, PEER);
+        benchmark::DoNotOptimize(packet.data());
+    }
+    if (attached != state.iterations()) state.SkipWithError("control message was not attached");
+}
+BENCHMARK(BM_RtpPacketizeWithPiggyback);
+
+void BM_RtpParse(benchmark::State& state) {
+    const std::vector<uint8_t> received = hcs_media::CreateDummyRtpPacket(static_cast<size_t>(state.range(0)), 0);
+    for (auto _ : state) {
+        // StreamDecoder と同様に受信バッファから複製してから解析する
+        std::vector<uint8_t> packet(received);
+        size_t payload_offset = 0;
+        const uint8_t* payload = hcs_media::ParseRtpHeader(packet, payload_offset);
+        benchmark::DoNotOptimize(payload);
+        benchmark::DoNotOptimize(hcs_media::RtpTimestamp(packet));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_RtpParse)->Arg(200)->Arg(1200);
+
+/**
+ * @brief 相乗りした制御メッセージの取り出しとヘッダー拡張の除去を含む解析。
+ */
+void BM_RtpParseWithPiggyback(benchmark::State& state) {
+    boost::asio::io_context io;
+    auto piggyback = std::make_shared<hcs_net::ControlPiggyback>(
+        io, [](const std::vector<uint8_t>&, const hcs_net::Endpoint&) {});
+    benchmark::IterationCount extracted = 0;
+    piggyback->SetControlHandler([&extracted](const std::vector<uint8_t>&, const hcs_net::Endpoint&) { ++extracted; });
+
+    std::vector<uint8_t> received = hcs_media::CreateDummyRtpPacket(1200, 0);
+    piggyback->Submit(CONTROL_MESSAGE, PEER, PIGGYBACK_MAX_DELAY);
+    piggyback->AttachTo(received, PEER);
+
+    for (auto _ : state) {
+        std::vector<uint8_t> packet(received);
+        piggyback->ExtractFrom(packet, PEER);
+        size_t payload_offset = 0;
+        benchmark::DoNotOptimize(hcs_media::ParseRtpHeader(packet, payload_offset));
+    }
+    if (extracted != state.iterations()) state.SkipWithError("control message was not extracted");
+}
+BENCHMARK(BM_RtpParseWithPiggyback);
+
+} // namespace
@@ -0,0 +1,80 @@
+// TopologyManager の ADVERTISE 処理のベンチマーク (近隣ピア数 10 / 100 / 1,000 / 10,000)。
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "hcs_control/TopologyManager.h"
+
+namespace {
+
+const std::string GROUP_ID = "group-0";
+const std::string SOURCE_IP = "10.0.0.1";
+const std::string SELF_IP = "10.255.255.254";
+
+void PeerCounts(benchmark::internal::Benchmark* b) {
+    for (int peers : {10, 100, 1000, 10000}) b->Arg(peers);
+}
+
+/**
+ * @brief 送信元の配下にある i 番目のピアの ADVERTISE を生成する (メトリクスと深さはピアごとに変える)。
+ */
+hcs_control::AdvertiseMessage MakeAdvertise(int i) {
+    hcs_control::AdvertiseMessage msg;
+    msg.ip = "10." + std::to_string(1 + (i >> 16)) + "." + std::to_string((i >> 8) & 0xFF) + "." + std::to_string(i & 0xFF);
+    msg.metrics.hop_count = 1 + i % 4;
+    msg.metrics.bandwidth_score = 50 + (i * 37) % 50;
+    msg.metrics.stability_score = 50 + (i * 53) % 50;
+    msg.metrics.rtt_ms = 5 + (i * 17) % 100;
+    msg.groups.insert(GROUP_ID);
+
+    hcs_control::GroupRoute route;
+    route.hops_to_source = msg.metrics.hop_count;
+    route.source_seq = 1;
+    route.path.push_back(SOURCE_IP);
+    for (int hop = 1; hop < route.hops_to_source; ++hop) route.path.push_back("10.0.1." + std::to_string(hop));
+    route.path.push_back(msg.ip);
+    msg.routes[GROUP_ID] = std::move(route);
+    return msg;
+}
+
+std::vector<hcs_control::AdvertiseMessage> MakeAdvertisements(int peers) {
+    std::vector<hcs_control::AdvertiseMessage> messages;
+    messages.reserve(static_cast<size_t>(peers));
+    for (int i = 0; i < peers; ++i) messages.push_back(MakeAdvertise(i));
+    return messages;
+}
+
+/**
+ * @brief 全ピアを学習済みの状態で、既知のピアから定期 ADVERTISE を受信するコスト (1通あたり)。
+ */
+void BM_TopologyManager_HandleAdvertise(benchmark::State& state) {
+    const auto messages = MakeAdvertisements(static_cast<int>(state.range(0)));
+    hcs_control::TopologyManager manager(SELF_IP);
+    for (const auto& msg : messages) manager.HandleAdvertise(msg);
+
+    size_t next = 0;
+    for (auto _ : state) {
+        manager.HandleAdvertise(messages[next]);
+        if (++next == messages.size()) next = 0;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_TopologyManager_HandleAdvertise)->Apply(PeerCounts);
+
+/**
+ * @brief 全ピアの ADVERTISE を1ティック分バッチ適用するコスト (1ティックあたり)。
+ */
+void BM_TopologyManager_FlushAdvertiseBatch(benchmark::State& state) {
+    const auto messages = MakeAdvertisements(static_cast<int>(state.range(0)));
+    hcs_control::TopologyManager manager(SELF_IP);
+    for (const auto& msg : messages) manager.HandleAdvertise(msg);
+
+    for (auto _ : state) {
+        for (const auto& msg : messages) manager.EnqueueAdvertise(msg);
+        benchmark::DoNotOptimize(manager.FlushAdvertiseBatch());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_TopologyManager_FlushAdvertiseBatch)->Apply(PeerCounts)->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,196 @@
+// TransportAES256 の暗号化・復号 (AES-256-GCM) のベンチマーク。
+// ソケットI/Oを除くため、送信データを保持して受信側へ折り返すメモリ上のトランスポートを基底に用いる。
+
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+#include "hcs_media/RtpPacket.h"
+#include "hcs_net/PacketPipeline.h"
+#include "hcs_net/TransportAES256.h"
+
+namespace {
+
+const hcs_net::Endpoint PEER("127.0.0.1", 40000);
+
+/**
+ * @brief 固定鍵を返す KeyProvider (PBKDF2 の導出コストを計測から除く)。
+ */
+class FixedKeyProvider : public hcs_net::KeyProvider {
+public:
+    const std::vector<uint8_t>& GetEncryptionKey() const override { return key_; }
+    const std::vector<uint8_t>& GetSalt() const override { return salt_; }
+
+private:
+    std::vector<uint8_t> key_ = std::vector<uint8_t>(hcs_net::AES256_KEY_SIZE, 0x42);
+    std::vector<uint8_t> salt_ = std::vector<uint8_t>(16, 0x00);
+};
+
+/**
+ * @brief 最後に送信されたデータを保持し、Deliver() で受信コールバックへ渡すトランスポート。
+ */
+class LoopbackTransport : public hcs_net::Transport {
+public:
+    void Start() override {}
+    void Stop() override {}
+    void Send(const std::vector<uint8_t>& data, const hcs_net::Endpoint&) override { last_sent = data; }
+    void SetReceiveCallback(ReceiveCallback callback) override { callback_ = std::move(callback); }
+
+    void Deliver(const std::vector<uint8_t>& data, const hcs_net::Endpoint& sender) { callback_(data, sender); }
+
+    std::vector<uint8_t> last_sent;
+
+private:
+    ReceiveCallback callback_;
+};
+
+/**
+ * @brief 送信されたパケットバッファを保持するトランスポート (バイトベクターへの複製を伴わない経路)。
+ */
+class PacketLoopbackTransport : public LoopbackTransport {
+public:
+    void SendPacket(hcs_common::PacketRef packet, const hcs_net::Endpoint&) override { last_packet = std::move(packet); }
+    void SetPacketCallback(PacketCallback callback) override { packet_callback_ = std::move(callback); }
+
+    void DeliverPacket(hcs_common::PacketRef packet, const hcs_net::Endpoint& sender) {
+        packet_callback_(std::move(packet), sender);
+    }
+
+    hcs_common::PacketRef last_packet;
+
+private:
+    PacketCallback packet_callback_;
+};
+
+/**
+ * @brief 計測するペイロードサイズ (制御メッセージ相当からMTU前後、ジャンボフレームまで)。
+ */
+void PayloadSizes(benchmark::internal::Benchmark* b) {
+    for (int size : {64, 256, 1200, 1400, 8192}) b->Arg(size);
+}
+
+void BM_TransportAES256_Encrypt(benchmark::State& state) {
+    auto loopback = std::make_shared<LoopbackTransport>();
+    hcs_net::TransportAES256 transport(std::make_shared<FixedKeyProvider>(), loopback);
+    const std::vector<uint8_t> payload(static_cast<size_t>(state.range(0)), 0xAA);
+
+    for (auto _ : state) {
+        transport.Send(payload, PEER);
+        benchmark::DoNotOptimize(loopback->last_sent.data());
+    }
+    if (loopback->last_sent.size() != payload.size() + hcs_net::ENCRYPTED_OVERHEAD) {
+        state.SkipWithError("unexpected ciphertext size");
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_TransportAES256_Encrypt)->Apply(PayloadSizes);
+
+/**
+ * @brief パケットバッファの余白に IV とタグを付け、その場で暗号化する経路 (データ経路の送信側)。
+ */
+void BM_TransportAES256_EncryptPacket(benchmark::State& state) {
+    auto loopback = std::make_shared<PacketLoopbackTransport>();
+    hcs_net::TransportAES256 transport(std::make_shared<FixedKeyProvider>(), loopback);
+    const std::vector<uint8_t> payload(static_cast<size_t>(state.range(0)), 0xAA);
+    auto& pool = hcs_common::PacketPool::Local();
+
+    for (auto _ : state) {
+        transport.SendPacket(pool.CopyFrom(payload.data(), payload.size()), PEER);
+        benchmark::DoNotOptimize(loopback->last_packet->Data());
+    }
+    if (loopback->last_packet->Size() != payload.size() + hcs_net::ENCRYPTED_OVERHEAD) {
+        state.SkipWithError("unexpected ciphertext size");
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_TransportAES256_EncryptPacket)->Arg(64)->Arg(256)->Arg(1200)->Arg(1400);
+
+void BM_TransportAES256_Decrypt(benchmark::State& state) {
+    auto key_provider = std::make_shared<FixedKeyProvider>();
+    auto tx_loopback = std::make_shared<LoopbackTransport>();
+    hcs_net::TransportAES256 sender(key_provider, tx_loopback);
+    sender.Send(std::vector<uint8_t>(static_cast<size_t>(state.range(0)), 0xAA), PEER);
+    const std::vector<uint8_t> packet = tx_loopback->last_sent;
+
+    auto rx_loopback = std::make_shared<LoopbackTransport>();
+    hcs_net::TransportAES256 receiver(key_provider, rx_loopback);
+    int64_t delivered = 0;
+    receiver.SetReceiveCallback([&delivered](const std::vector<uint8_t>& plaintext, const hcs_net::Endpoint&) {
+        benchmark::DoNotOptimize(plaintext.data());
+        ++delivered;
+    });
+
+    for (auto _ : state) {
+        rx_loopback->Deliver(packet, PEER);
+    }
+    if (delivered != static_cast<int64_t>(state.iterations())) state.SkipWithError("decryption failed");
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_TransportAES256_Decrypt)->Apply(PayloadSizes);
+
+/**
+ * @brief 受信側の 復号 → RTP 振り分け → 終端 を、コールバックの連鎖で呼ぶ場合と
+ * PacketPipeline で合成した場合の比較。arg 0 はコールバック、1 はパイプライン。
+ */
+void BM_ReceiveChain(benchmark::State& state) {
+    auto key_provider = std::make_shared<FixedKeyProvider>();
+    auto tx_loopback = std::make_shared<PacketLoopbackTransport>();
+    hcs_net::TransportAES256 sender(key_provider, tx_loopback);
+    auto& pool = hcs_common::PacketPool::Local();
+    sender.SendPacket(hcs_media::AcquireDummyRtpPacket(1200, 0), PEER);
+    const hcs_common::PacketRef ciphertext = tx_loopback->last_packet;
+
+    auto rx_loopback = std::make_shared<PacketLoopbackTransport>();
+    hcs_net::TransportAES256 receiver(key_provider, rx_loopback);
+    int64_t delivered = 0;
+    auto sink = [&delivered](hcs_common::PacketRef packet, const hcs_net::Endpoint&) {
+        benchmark::DoNotOptimize(packet->Data());
+        ++delivered;
+    };
+    auto discard = [](hcs_common::PacketRef, const hcs_net::Endpoint&) {};
+    auto demux = hcs_media::MakeRtpDemuxStage(discard);
+    auto pipeline = hcs_net::MakePacketPipeline(hcs_net::DecryptStage(receiver), demux, sink);
+    if (state.range(0) == 0) {
+        // 復号後のコールバックで振り分け、さらに終端のコールバックを呼ぶ (段ごとに間接呼び出し)
+        hcs_net::Transport::PacketCallback sink_callback = sink;
+        receiver.SetPacketCallback([&demux, &sink_callback](hcs_common::PacketRef packet, const hcs_net::Endpoint& ep) {
+            demux(std::move(packet), ep, sink_callback);
+        });
+        for (auto _ : state) {
+            rx_loopback->DeliverPacket(pool.CopyFrom(ciphertext->Data(), ciphertext->Size()), PEER);
+        }
+    } else {
+        hcs_net::BindPacketPipeline(*rx_loopback, pipeline);
+        for (auto _ : state) {
+            rx_loopback->DeliverPacket(pool.CopyFrom(ciphertext->Data(), ciphertext->Size()), PEER);
+        }
+    }
+    if (delivered != static_cast<int64_t>(state.iterations())) state.SkipWithError("packets were dropped");
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReceiveChain)->Arg(0)->Arg(1);
+
+/**
+ * @brief 冗長配信時に後着した重複パケットを復号せずに破棄する経路。
+ */
+void BM_TransportAES256_DuplicateDrop(benchmark::State& state) {
+    auto key_provider = std::make_shared<FixedKeyProvider>();
+    auto tx_loopback = std::make_shared<LoopbackTransport>();
+    hcs_net::TransportAES256 sender(key_provider, tx_loopback);
+    sender.Send(std::vector<uint8_t>(1200, 0xAA), PEER);
+    const std::vector<uint8_t> packet = tx_loopback->last_sent;
+
+    auto rx_loopback = std::make_shared<LoopbackTransport>();
+    hcs_net::TransportAES256 receiver(key_provider, rx_loopback);
+    receiver.EnableDuplicateFilter(true);
+    int64_t delivered = 0;
+    receiver.SetReceiveCallback([&delivered](const std::vector<uint8_t>&, const hcs_net::Endpoint&) { ++delivered; });
+    rx_loopback->Deliver(packet, PEER); // 初回のみ受理される
+
+    for (auto _ : state) {
+        rx_loopback->Deliver(packet, PEER);
+    }
+    if (delivered != 1) state.SkipWithError("duplicate was not dropped");
+}
+BENCHMARK(BM_TransportAES256_DuplicateDrop);
+
+} // namespace
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace hcs_common {
+
+/**
+ * @brief スレッドごとのヒープ確保回数 (データ経路のゼロアロケーションの検証用)。
+ *
+ * 計数は、プログラムが HCS_DEFINE_COUNTING_OPERATOR_NEW() で置き換えた operator new が行う。
+ * 置き換えていないプログラムでは Enabled() が false となり、回数は常に0となる。
+ */
+class AllocationCounter {
+public:
+    /**
+     * @brief 呼び出し元スレッドのこれまでのヒープ確保回数。
+     */
+    static uint64_t ThreadAllocations() { return Count(); }
+
+    /**
+     * @brief operator new が置き換えられ、計数が有効か。
+     */
+    static bool Enabled() { return EnabledFlag(); }
+
+    static void OnAllocate() { ++Count(); }
+    static bool& EnabledFlag() {
+        static bool enabled = false;
+        return enabled;
+    }
+
+private:
+    static uint64_t& Count() {
+        thread_local uint64_t count = 0; // 自明な初期化のため、operator new の中から参照しても安全
+        return count;
+    }
+};
+
+} // namespace hcs_common
+
+// 置き換えた operator delete は malloc 系で確保した領域を free で解放するため、new/delete の対は一致している。
+// GCC はインライン展開後の free を new の結果に対する解放と誤認して -Wmismatched-new-delete を出すため、
+// 置き換えの定義の範囲でのみ抑止する。
+#if defined(__GNUC__) && !defined(__clang__)
+#define HCS_ALLOCATION_COUNTER_DIAGNOSTIC_PUSH \
+    _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wmismatched-new-delete\"")
+#define HCS_ALLOCATION_COUNTER_DIAGNOSTIC_POP _Pragma("GCC diagnostic pop")
+#else
+#define HCS_ALLOCATION_COUNTER_DIAGNOSTIC_PUSH
+#define HCS_ALLOCATION_COUNTER_DIAGNOSTIC_POP
+#endif
+
+/**
+ * @brief グローバルな operator new/delete を、確保回数を数える実装に置き換える。
+ * プログラム全体で1つの翻訳単位 (main のあるファイルなど) にのみ記述すること。
+ */
+#define HCS_DEFINE_COUNTING_OPERATOR_NEW()                                                              \
+    HCS_ALLOCATION_COUNTER_DIAGNOSTIC_PUSH                                                              \
+    void* operator new(std::size_t size) {                                                              \
+        hcs_common::AllocationCounter::OnAllocate();                                                    \
+        if (void* p = std::malloc(size ? size : 1)) return p;                                           \
+        throw std::bad_alloc();                                                                         \
+    }                                                                                                   \
+    void* operator new[](std::size_t size) { return ::operator new(size); }                             \
+    void* operator new(std::size_t size, std::align_val_t align) {                                      \
+        hcs_common::AllocationCounter::OnAllocate();                                                    \
+        const std::size_t a = static_cast<std::size_t>(align);                                          \
+        if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a)) return p;                          \
+        throw std::bad_alloc();                                                                         \
+    }                                                                                                   \
+    void* operator new[](std::size_t size, std::align_val_t align) { return ::operator new(size, align); } \
+    void operator delete(void* p) noexcept { std::free(p); }                                            \
+    void operator delete[](void* p) noexcept { std::free(p); }                                          \
+    void operator delete(void* p, std::size_t) noexcept { std::free(p); }                               \
+    void operator delete[](void* p, std::size_t) noexcept { std::free(p); }                             \
+    void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }                          \
+    void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }                        \
+    void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }             \
+    void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }           \
+    HCS_ALLOCATION_COUNTER_DIAGNOSTIC_POP                                                               \
+    static const bool hcs_allocation_counter_enabled = (hcs_common::AllocationCounter::EnabledFlag() = true)
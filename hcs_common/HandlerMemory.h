@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "Metrics.h"
+
+namespace hcs_common {
+
+constexpr size_t HANDLER_BLOCK_SIZE = 512; ///< 非同期ハンドラ1つ分のブロック長 (Asio の操作オブジェクトとキャプチャを含む)
+
+/**
+ * @brief ハンドラ用メモリのメトリクス。プールが尽きたかブロックに収まらない場合のみヒープから確保する。
+ */
+struct HandlerMemoryMetrics {
+    Counter& heap_fallbacks;
+
+    static HandlerMemoryMetrics& Get() {
+        auto& registry = MetricsRegistry::Instance();
+        static HandlerMemoryMetrics metrics{
+            registry.GetCounter("hcs_handler_memory_heap_fallbacks_total",
+                                "Async handler allocations that fell back to the heap"),
+        };
+        return metrics;
+    }
+};
+
+/**
+ * @brief 非同期ハンドラ用の固定長ブロックのプール。
+ *
+ * Asio は非同期操作ごとにハンドラを格納する領域を確保する。既定の再利用キャッシュはスレッドあたり
+ * 数ブロックのため、送信完了待ちが重なる場合やスレッドをまたいで post する場合はパケットごとに
+ * ヒープ確保が発生する。このプールを HandlerAllocator 経由で関連付けると、事前確保したブロックを使い回す。
+ * フリーリストは (版数, 添字) を1語にまとめた CAS で操作するため、どのスレッドから確保・返却してもよい。
+ */
+class HandlerMemory {
+public:
+    /**
+     * @param blocks 事前確保するブロック数 (同時に保留される非同期操作の上限の目安)
+     */
+    explicit HandlerMemory(size_t blocks)
+        : blocks_(new Block[blocks]), next_(new std::atomic<uint32_t>[blocks]), count_(blocks)
+    {
+        for (size_t i = 0; i < blocks; ++i) {
+            next_[i].store(i + 1 < blocks ? static_cast<uint32_t>(i + 1) : NIL, std::memory_order_relaxed);
+        }
+        head_.store(blocks ? 0 : NIL, std::memory_order_relaxed);
+    }
+
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* Allocate(size_t size) {
+        uint32_t index = 0;
+        if (size <= HANDLER_BLOCK_SIZE && Pop(index)) return &blocks_[index];
+        metrics_.heap_fallbacks.Add();
+        return ::operator new(size);
+    }
+
+    void Deallocate(void* pointer) {
+        Block* block = static_cast<Block*>(pointer);
+        if (block >= blocks_.get() && block < blocks_.get() + count_) {
+            Push(static_cast<uint32_t>(block - blocks_.get()));
+            return;
+        }
+        ::operator delete(pointer);
+    }
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct alignas(std::max_align_t) Block {
+        unsigned char bytes[HANDLER_BLOCK_SIZE];
+    };
+
+    std::unique_ptr<Block[]> blocks_;
+    std::unique_ptr<std::atomic<uint32_t>[]> next_; // ブロックごとのフリーリストのリンク
+    const size_t count_;
+    std::atomic<uint64_t> head_{0};                 // 上位32ビット: 版数 (ABA 対策)、下位32ビット: 先頭の添字
+    HandlerMemoryMetrics& metrics_ = HandlerMemoryMetrics::Get();
+
+    bool Pop(uint32_t& index) {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        for (;;) {
+            const uint32_t top = static_cast<uint32_t>(head);
+            if (top == NIL) return false;
+            const uint64_t next = (((head >> 32) + 1) << 32) | next_[top].load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                index = top;
+                return true;
+            }
+        }
+    }
+
+    void Push(uint32_t index) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            next_[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            const uint64_t next = (((head >> 32) + 1) << 32) | index;
+            if (head_.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed)) return;
+        }
+    }
+};
+
+/**
+ * @brief HandlerMemory から確保する標準アロケータ互換の型 (Asio の関連付けアロケータ)。
+ */
+template <typename T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) noexcept : memory_(&memory) {}
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory_(other.memory_) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(memory_->Allocate(sizeof(T) * n)); }
+    void deallocate(T* pointer, size_t) noexcept { memory_->Deallocate(pointer); }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept { return memory_ == other.memory_; }
+    template <typename U>
+    bool operator!=(const HandlerAllocator<U>& other) const noexcept { return memory_ != other.memory_; }
+
+private:
+    template <typename> friend class HandlerAllocator;
+    HandlerMemory* memory_;
+};
+
+/**
+ * @brief ハンドラに HandlerMemory を関連付けるラッパー。
+ * HandlerMemory はハンドラの完了 (または破棄) まで生存していること。
+ */
+template <typename Handler>
+class PooledHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    PooledHandler(HandlerMemory& memory, Handler handler) : memory_(&memory), handler_(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(*memory_); }
+
+    template <typename... Args>
+    void operator()(Args&&... args) { handler_(std::forward<Args>(args)...); }
+
+private:
+    HandlerMemory* memory_;
+    Handler handler_;
+};
+
+/**
+ * @brief ハンドラの格納領域を memory から確保するよう関連付ける。
+ */
+template <typename Handler>
+PooledHandler<std::decay_t<Handler>> BindHandlerMemory(HandlerMemory& memory, Handler&& handler) {
+    return PooledHandler<std::decay_t<Handler>>(memory, std::forward<Handler>(handler));
+}
+
+} // namespace hcs_common
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <functional> // std::bad_function_call
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hcs_common {
+
+constexpr size_t INPLACE_FUNCTION_CAPACITY = 48; ///< 既定の格納領域 (ポインタ6個分。this と数個の参照を捕捉するラムダが収まる)
+
+template <typename Signature, size_t Capacity = INPLACE_FUNCTION_CAPACITY>
+class InplaceFunction;
+
+/**
+ * @brief ヒープ確保を行わない関数オブジェクトのラッパー (std::function の代替)。
+ *
+ * 呼び出し可能オブジェクトは固定長の内部領域に直接格納し、収まらない場合はコンパイルエラーとする。
+ * パケットごとに呼ばれるコールバックで、設定時・複製時の確保と呼び出し時の余分な間接参照を避ける。
+ * std::function と同様に複製可能で、空の状態で呼び出すと std::bad_function_call を送出する。
+ * 大きな状態を持たせる場合は、状態を別に保持してポインタ (または shared_ptr) を捕捉する。
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+public:
+    InplaceFunction() noexcept = default;
+    InplaceFunction(std::nullptr_t) noexcept {}
+
+    template <typename F,
+              typename Callable = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same<Callable, InplaceFunction>::value &&
+                                          std::is_invocable_r<R, Callable&, Args...>::value>>
+    InplaceFunction(F&& f) {
+        static_assert(sizeof(Callable) <= Capacity,
+                      "Callable does not fit into InplaceFunction; capture less state or raise Capacity.");
+        static_assert(alignof(Callable) <= alignof(Storage), "Callable is over-aligned for InplaceFunction.");
+        static_assert(std::is_copy_constructible<Callable>::value, "InplaceFunction requires a copyable callable.");
+        static_assert(std::is_nothrow_move_constructible<Callable>::value,
+                      "InplaceFunction requires a nothrow-movable callable.");
+        ::new (static_cast<void*>(&storage_)) Callable(std::forward<F>(f));
+        invoke_ = &Invoke<Callable>;
+        manage_ = &Manage<Callable>;
+    }
+
+    InplaceFunction(const InplaceFunction& other) : invoke_(other.invoke_), manage_(other.manage_) {
+        if (manage_) manage_(Operation::kCopy, &storage_, const_cast<Storage*>(&other.storage_));
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept : invoke_(other.invoke_), manage_(other.manage_) {
+        if (manage_) manage_(Operation::kMove, &storage_, &other.storage_);
+        other.Clear();
+    }
+
+    InplaceFunction& operator=(const InplaceFunction& other) {
+        if (this != &other) {
+            InplaceFunction copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            invoke_ = other.invoke_;
+            manage_ = other.manage_;
+            if (manage_) manage_(Operation::kMove, &storage_, &other.storage_);
+            other.Clear();
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept {
+        Reset();
+        return *this;
+    }
+
+    ~InplaceFunction() { Reset(); }
+
+    R operator()(Args... args) const {
+        return invoke_(const_cast<Storage*>(&storage_), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return manage_ != nullptr; }
+
+private:
+    enum class Operation { kCopy, kMove, kDestroy };
+    using Storage = std::aligned_storage_t<Capacity, alignof(std::max_align_t)>;
+    using Invoker = R (*)(Storage*, Args&&...);
+    using Manager = void (*)(Operation, Storage*, Storage*);
+
+    Storage storage_;
+    Invoker invoke_ = &InvokeEmpty;  // 空の場合も分岐なしで呼び出せるよう、送出用の関数を指す
+    Manager manage_ = nullptr;
+
+    template <typename Callable>
+    static R Invoke(Storage* storage, Args&&... args) {
+        return (*std::launder(reinterpret_cast<Callable*>(storage)))(std::forward<Args>(args)...);
+    }
+
+    static R InvokeEmpty(Storage*, Args&&...) { throw std::bad_function_call(); }
+
+    template <typename Callable>
+    static void Manage(Operation operation, Storage* dst, Storage* src) {
+        switch (operation) {
+            case Operation::kCopy:
+                ::new (static_cast<void*>(dst)) Callable(*std::launder(reinterpret_cast<const Callable*>(src)));
+                break;
+            case Operation::kMove: {
+                Callable* from = std::launder(reinterpret_cast<Callable*>(src));
+                ::new (static_cast<void*>(dst)) Callable(std::move(*from));
+                from->~Callable();
+                break;
+            }
+            case Operation::kDestroy:
+                std::launder(reinterpret_cast<Callable*>(dst))->~Callable();
+                break;
+        }
+    }
+
+    void Reset() noexcept {
+        if (manage_) manage_(Operation::kDestroy, &storage_, nullptr);
+        Clear();
+    }
+
+    /**
+     * @brief 内容を破棄せずに空の状態にする (ムーブ元で内容が移動済みの場合)。
+     */
+    void Clear() noexcept {
+        invoke_ = &InvokeEmpty;
+        manage_ = nullptr;
+    }
+};
+
+} // namespace hcs_common
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "MetricShard.h"
+
+namespace hcs_common {
+
+// --- 遅延ヒストグラムの定数 ---
+constexpr int LATENCY_SUB_BUCKET_BITS = 7;  ///< 2の冪区間あたりの分割数 (2^7 = 128、相対誤差 1/64 ≒ 1.6%)
+constexpr int LATENCY_MAX_VALUE_BITS = 40;  ///< 記録できる最大値のビット数 (2^40 ns ≒ 18分、超過分は最大値に丸める)
+constexpr size_t LATENCY_BUCKET_COUNT =
+    (size_t{1} << LATENCY_SUB_BUCKET_BITS) +
+    (LATENCY_MAX_VALUE_BITS - LATENCY_SUB_BUCKET_BITS) * (size_t{1} << (LATENCY_SUB_BUCKET_BITS - 1));
+
+/**
+ * @brief HdrHistogram 方式の対数線形ヒストグラム (ナノ秒単位の遅延用)。
+ *
+ * 値域を2の冪ごとの区間に分け、各区間をさらに線形に分割するため、
+ * 1ns から数分まで一定の相対精度 (約1.6%) で記録できる。バケットは固定長配列で、
+ * Counter と同じく計測スレッドごとのシャードに置くため、記録はバケット番号の計算
+ * (ビット演算のみ) と他スレッドと競合しない加算2回で済む。シャードは各スレッドの
+ * 初回記録時に確保する (約18KB)。分位点 (p50/p99/p99.9) は読み出し時に全シャードを集計して求める。
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() = default;
+    ~LatencyHistogram() {
+        for (auto& shard : shards_) delete shard.load(std::memory_order_relaxed);
+    }
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    /**
+     * @brief 遅延を記録する。
+     * @param nanoseconds 遅延 (ナノ秒、負値は0として扱う)
+     */
+    void Record(int64_t nanoseconds) {
+        const uint64_t value = nanoseconds <= 0 ? 0 : std::min<uint64_t>(static_cast<uint64_t>(nanoseconds), MAX_VALUE);
+        const size_t index = MetricShardAllocator::Current();
+        Shard& shard = LocalShard(index);
+        metric_detail::ShardAdd(shard.counts[BucketIndex(value)], 1, index);
+        metric_detail::ShardAdd(shard.sum, value, index);
+    }
+
+    /**
+     * @brief 記録済みの件数を返す。
+     */
+    uint64_t Count() const {
+        uint64_t total = 0;
+        for (const auto& slot : shards_) {
+            const Shard* shard = slot.load(std::memory_order_acquire);
+            if (!shard) continue;
+            for (const auto& c : shard->counts) total += c.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /**
+     * @brief 記録済みの遅延の合計 (ナノ秒) を返す。
+     */
+    uint64_t Sum() const {
+        uint64_t total = 0;
+        for (const auto& slot : shards_) {
+            if (const Shard* shard = slot.load(std::memory_order_acquire)) total += shard->sum.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /**
+     * @brief 複数の分位点をまとめて求める (バケットの走査は1回)。
+     * @param quantiles 昇順の分位点 (0.0 - 1.0)
+     * @param values 各分位点の値 (ナノ秒、バケット内の中央値で近似) の出力先
+     * @param count 分位点の数
+     * @return 走査時点の件数
+     */
+    uint64_t Quantiles(const double* quantiles, uint64_t* values, size_t count) const {
+        std::array<uint64_t, LATENCY_BUCKET_COUNT> snapshot{};
+        uint64_t total = 0;
+        for (const auto& slot : shards_) {
+            const Shard* shard = slot.load(std::memory_order_acquire);
+            if (!shard) continue;
+            for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+                const uint64_t n = shard->counts[i].load(std::memory_order_relaxed);
+                snapshot[i] += n;
+                total += n;
+            }
+        }
+        std::fill(values, values + count, 0);
+        if (total == 0) return 0;
+
+        size_t q = 0;
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT && q < count; ++i) {
+            cumulative += snapshot[i];
+            while (q < count && cumulative > 0 &&
+                   static_cast<double>(cumulative) >= quantiles[q] * static_cast<double>(total)) {
+                values[q++] = (BucketLowerBound(i) + BucketUpperBound(i)) / 2;
+            }
+        }
+        return total;
+    }
+
+    /**
+     * @brief 単一の分位点を求める。
+     */
+    uint64_t Percentile(double quantile) const {
+        uint64_t value = 0;
+        Quantiles(&quantile, &value, 1);
+        return value;
+    }
+
+    /**
+     * @brief 値が入るバケット番号を返す。
+     */
+    static size_t BucketIndex(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) return static_cast<size_t>(value);
+        const int msb = 63 - __builtin_clzll(value);
+        const int shift = msb - LATENCY_SUB_BUCKET_BITS + 1;
+        const uint64_t top = value >> shift; // [SUB_BUCKET_HALF, SUB_BUCKET_COUNT)
+        return SUB_BUCKET_COUNT + static_cast<size_t>(shift - 1) * SUB_BUCKET_HALF + static_cast<size_t>(top - SUB_BUCKET_HALF);
+    }
+
+    /**
+     * @brief バケットに入る最小値を返す。
+     */
+    static uint64_t BucketLowerBound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) return index;
+        const size_t offset = index - SUB_BUCKET_COUNT;
+        const int shift = static_cast<int>(offset / SUB_BUCKET_HALF) + 1;
+        const uint64_t top = SUB_BUCKET_HALF + offset % SUB_BUCKET_HALF;
+        return top << shift;
+    }
+
+    /**
+     * @brief バケットに入る最大値を返す。
+     */
+    static uint64_t BucketUpperBound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) return index;
+        const size_t offset = index - SUB_BUCKET_COUNT;
+        const int shift = static_cast<int>(offset / SUB_BUCKET_HALF) + 1;
+        return BucketLowerBound(index) + (uint64_t{1} << shift) - 1;
+    }
+
+private:
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << LATENCY_SUB_BUCKET_BITS;
+    static constexpr uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr uint64_t MAX_VALUE = (uint64_t{1} << LATENCY_MAX_VALUE_BITS) - 1;
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> counts{};
+        std::atomic<uint64_t> sum{0};
+    };
+    std::array<std::atomic<Shard*>, METRIC_SHARDS> shards_{};
+
+    /**
+     * @brief シャードを返す (未確保なら確保する。競合するのは共有シャードを使うスレッド同士のみ)。
+     */
+    Shard& LocalShard(size_t index) {
+        Shard* shard = shards_[index].load(std::memory_order_acquire);
+        if (shard) return *shard;
+        Shard* created = new Shard();
+        if (shards_[index].compare_exchange_strong(shard, created, std::memory_order_acq_rel)) return *created;
+        delete created;
+        return *shard;
+    }
+};
+
+} // namespace hcs_common
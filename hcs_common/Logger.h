@@ -0,0 +1,508 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @namespace hcs_common
+ * @brief HCSノードの全層で共有する基盤コンポーネントを格納する名前空間
+ */
+namespace hcs_common {
+
+/**
+ * @brief ログレベル
+ */
+enum class LogLevel : uint8_t { kTrace = 0, kDebug = 1, kInfo = 2, kWarn = 3, kError = 4, kOff = 5 };
+
+} // namespace hcs_common
+
+// コンパイル時の最低ログレベル (LogLevel の数値)。これ未満のログ呼び出しは引数の評価も含めて除去される。
+// 既定はリリースビルドで Info、デバッグビルドで Debug。-DHCS_LOG_MIN_LEVEL=0 で Trace まで有効になる。
+#ifndef HCS_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define HCS_LOG_MIN_LEVEL 2
+#else
+#define HCS_LOG_MIN_LEVEL 1
+#endif
+#endif
+
+namespace hcs_common {
+
+// --- ロガーの定数 ---
+constexpr size_t LOG_RING_CAPACITY = 1024;   ///< スレッドごとのリングバッファのレコード数 (2の冪)
+constexpr size_t LOG_ARG_CAPACITY = 232;     ///< 1レコードに格納できる引数のバイト数 (超過分は切り詰め)
+constexpr auto LOG_DRAIN_INTERVAL = std::chrono::milliseconds(2); ///< バックグラウンドスレッドの排出間隔
+constexpr int64_t LOG_RATE_LIMIT_MS = 1000;  ///< HCS_LOG_*_EVERY の呼び出し箇所ごとの最小出力間隔
+
+static_assert((LOG_RING_CAPACITY & (LOG_RING_CAPACITY - 1)) == 0, "LOG_RING_CAPACITY must be a power of two");
+
+/**
+ * @brief ログ呼び出し箇所ごとの静的情報。レコードにはこのポインタのみを格納する。
+ */
+struct LogSite {
+    LogLevel level;
+    const char* tag;    ///< コンポーネント名 (例: "Encoder")。出力時に [tag] として付与される
+    const char* format; ///< "{}" を引数の位置とする書式文字列 (文字列リテラルであること)
+};
+
+/**
+ * @brief リングバッファ上の1レコード。引数は型タグ付きのバイナリ形式で格納され、
+ * 文字列化はバックグラウンドスレッドで行う。
+ */
+struct LogRecord {
+    int64_t timestamp_ns = 0;      ///< system_clock のエポックからのナノ秒
+    const LogSite* site = nullptr;
+    uint32_t suppressed = 0;       ///< レート制限により抑止された同一箇所のログ件数
+    uint16_t arg_bytes = 0;
+    bool truncated = false;
+    std::array<uint8_t, LOG_ARG_CAPACITY> args;
+};
+
+/**
+ * @brief 1スレッド専用の単一生産者・単一消費者リングバッファ。
+ * 生産者 (ログを書くスレッド) と消費者 (バックグラウンドスレッド) はロックを取らない。
+ */
+class LogRing {
+public:
+    /**
+     * @brief 書き込み先のレコードを確保する。満杯の場合は nullptr を返す (呼び出し元をブロックしない)。
+     */
+    LogRecord* TryClaim() {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= LOG_RING_CAPACITY) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &records_[head & (LOG_RING_CAPACITY - 1)];
+    }
+
+    /**
+     * @brief TryClaim で確保したレコードを消費者に公開する。
+     */
+    void Commit() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /**
+     * @brief 公開済みのレコードを順に処理する (消費者スレッドのみ)。
+     * @return 処理したレコード数
+     */
+    template <typename Fn>
+    size_t Drain(Fn&& fn) {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t count = static_cast<size_t>(head - tail);
+        for (; tail != head; ++tail) {
+            fn(records_[tail & (LOG_RING_CAPACITY - 1)]);
+        }
+        tail_.store(tail, std::memory_order_release);
+        return count;
+    }
+
+    uint64_t TakeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+    void Retire() { retired_.store(true, std::memory_order_release); }
+    bool IsRetired() const { return retired_.load(std::memory_order_acquire); }
+
+private:
+    alignas(64) std::atomic<uint64_t> head_{0}; // 生産者が書き込む
+    alignas(64) std::atomic<uint64_t> tail_{0}; // 消費者が書き込む
+    alignas(64) std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> retired_{false};           // 生産者スレッドが終了した
+    std::array<LogRecord, LOG_RING_CAPACITY> records_;
+};
+
+namespace log_detail {
+
+// 引数の型タグ
+enum ArgType : uint8_t { kInt = 1, kUint, kDouble, kBool, kChar, kString };
+
+/**
+ * @brief ログ引数をレコードへバイナリ形式で書き込むエンコーダ。
+ * 整数・浮動小数点・文字列はコピーのみで済む。その他の型は operator<< で
+ * 呼び出し元スレッド上で文字列化されるため、ホットパスでは使用しないこと。
+ */
+class ArgEncoder {
+public:
+    explicit ArgEncoder(LogRecord& record) : record_(record) {}
+
+    template <typename T>
+    void Put(const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            PutScalar(kBool, static_cast<uint8_t>(value));
+        } else if constexpr (std::is_same_v<T, char>) {
+            PutScalar(kChar, value);
+        } else if constexpr (std::is_enum_v<T>) {
+            Put(static_cast<std::underlying_type_t<T>>(value));
+        } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            PutScalar(kInt, static_cast<int64_t>(value));
+        } else if constexpr (std::is_integral_v<T>) {
+            PutScalar(kUint, static_cast<uint64_t>(value));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            PutScalar(kDouble, static_cast<double>(value));
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            PutString(std::string_view(value));
+        } else {
+            std::ostringstream oss;
+            oss << value;
+            PutString(oss.str());
+        }
+    }
+
+private:
+    LogRecord& record_;
+
+    template <typename V>
+    void PutScalar(ArgType type, V value) {
+        if (record_.arg_bytes + 1 + sizeof(V) > LOG_ARG_CAPACITY) {
+            record_.truncated = true;
+            return;
+        }
+        uint8_t* out = record_.args.data() + record_.arg_bytes;
+        out[0] = type;
+        std::memcpy(out + 1, &value, sizeof(V));
+        record_.arg_bytes = static_cast<uint16_t>(record_.arg_bytes + 1 + sizeof(V));
+    }
+
+    void PutString(std::string_view value) {
+        const size_t header = 1 + sizeof(uint16_t);
+        if (record_.arg_bytes + header > LOG_ARG_CAPACITY) {
+            record_.truncated = true;
+            return;
+        }
+        size_t len = std::min(value.size(), LOG_ARG_CAPACITY - record_.arg_bytes - header);
+        if (len < value.size()) record_.truncated = true;
+        uint8_t* out = record_.args.data() + record_.arg_bytes;
+        out[0] = kString;
+        const uint16_t len16 = static_cast<uint16_t>(len);
+        std::memcpy(out + 1, &len16, sizeof(len16));
+        std::memcpy(out + header, value.data(), len);
+        record_.arg_bytes = static_cast<uint16_t>(record_.arg_bytes + header + len);
+    }
+};
+
+/**
+ * @brief レコードの先頭から引数を1つずつ取り出し、文字列に追記する。
+ * @return 取り出せた場合はtrue
+ */
+inline bool AppendNextArg(const LogRecord& record, size_t& offset, std::string& out) {
+    if (offset >= record.arg_bytes) return false;
+    const uint8_t* in = record.args.data() + offset;
+    char buf[32];
+    switch (in[0]) {
+        case kInt: { int64_t v; std::memcpy(&v, in + 1, sizeof(v)); out.append(buf, std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v))); offset += 1 + sizeof(v); break; }
+        case kUint: { uint64_t v; std::memcpy(&v, in + 1, sizeof(v)); out.append(buf, std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v))); offset += 1 + sizeof(v); break; }
+        case kDouble: { double v; std::memcpy(&v, in + 1, sizeof(v)); out.append(buf, std::snprintf(buf, sizeof(buf), "%g", v)); offset += 1 + sizeof(v); break; }
+        case kBool: out.append(in[1] ? "true" : "false"); offset += 2; break;
+        case kChar: out.push_back(static_cast<char>(in[1])); offset += 2; break;
+        case kString: {
+            uint16_t len;
+            std::memcpy(&len, in + 1, sizeof(len));
+            out.append(reinterpret_cast<const char*>(in + 1 + sizeof(len)), len);
+            offset += 1 + sizeof(len) + len;
+            break;
+        }
+        default: return false;
+    }
+    return true;
+}
+
+} // namespace log_detail
+
+/**
+ * @brief 非同期ロガー。
+ *
+ * ログを書くスレッドは自スレッド専用のリングバッファにレコード (呼び出し箇所のポインタと
+ * バイナリ化した引数) を書き込むだけで、書式化・出力はバックグラウンドスレッドが行う。
+ * 生産者側はロックもメモリ確保も行わず、リングが満杯の場合はレコードを破棄して件数のみ数える。
+ * ログは HCS_LOG_* マクロ経由で出力し、直接 Write を呼ばないこと。
+ */
+class Logger {
+public:
+    /**
+     * @brief プロセス共通のロガーを返す。初回呼び出し時にバックグラウンドスレッドを起動する。
+     */
+    static Logger& Instance() {
+        static Logger instance;
+        return instance;
+    }
+
+    /**
+     * @brief 実行時のログレベルを設定する。コンパイル時に除去されたレベルは有効化できない。
+     */
+    static void SetLevel(LogLevel level) { RuntimeLevel().store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+
+    /**
+     * @brief 指定レベルのログが実行時に有効か。
+     */
+    static bool Enabled(LogLevel level) {
+        return static_cast<uint8_t>(level) >= RuntimeLevel().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 出力先を設定する。既定は Info 以下が stdout、Warn 以上が stderr。
+     * @param out 全レベルの出力先 (nullptr で既定に戻す)
+     */
+    void SetOutput(std::FILE* out) {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        output_ = out;
+    }
+
+    /**
+     * @brief レコードを自スレッドのリングバッファへ書き込む (HCS_LOG_* マクロから呼び出される)。
+     * @param site 呼び出し箇所の静的情報
+     * @param suppressed レート制限により直前に抑止された件数
+     * @param args 書式文字列の "{}" に対応する引数
+     */
+    template <typename... Args>
+    void Write(const LogSite& site, uint32_t suppressed, const Args&... args) {
+        LogRing& ring = LocalRing();
+        LogRecord* record = ring.TryClaim();
+        if (!record) return;
+        record->timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        record->site = &site;
+        record->suppressed = suppressed;
+        record->arg_bytes = 0;
+        record->truncated = false;
+        log_detail::ArgEncoder encoder(*record);
+        (encoder.Put(args), ...);
+        ring.Commit();
+    }
+
+    /**
+     * @brief 全スレッドのリングバッファに溜まったレコードを呼び出し元スレッドで出力する。
+     * 停止処理や致命的エラーの直前に呼び出し、ログの欠落を防ぐ。
+     */
+    void Flush() {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        DrainAll();
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+private:
+    std::mutex registry_mutex_;                   // rings_ の登録・削除のみを保護する
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    std::mutex drain_mutex_;                      // 排出処理 (バックグラウンド / Flush) を直列化する
+    std::FILE* output_ = nullptr;
+    std::string line_;                            // 書式化用の再利用バッファ
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread worker_;
+
+    Logger() : worker_([this]() { Run(); }) {}
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        worker_.join();
+        Flush();
+    }
+
+    static std::atomic<uint8_t>& RuntimeLevel() {
+        static std::atomic<uint8_t> level{static_cast<uint8_t>(LogLevel::kTrace)};
+        return level;
+    }
+
+    /**
+     * @brief 自スレッドのリングバッファを返す。初回のみレジストリへ登録する。
+     * スレッド終了時にリングは retired となり、残りのレコードを排出した後に破棄される。
+     */
+    LogRing& LocalRing() {
+        struct Holder {
+            std::shared_ptr<LogRing> ring;
+            ~Holder() { if (ring) ring->Retire(); }
+        };
+        thread_local Holder holder;
+        if (!holder.ring) {
+            holder.ring = std::make_shared<LogRing>();
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            rings_.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        while (!stopping_) {
+            wake_.wait_for(lock, LOG_DRAIN_INTERVAL);
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+                DrainAll();
+            }
+            lock.lock();
+        }
+    }
+
+    /**
+     * @brief 全リングを排出する (drain_mutex_ 保持中に呼び出すこと)。
+     */
+    void DrainAll() {
+        std::vector<std::shared_ptr<LogRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            rings = rings_;
+        }
+
+        bool wrote = false;
+        for (const auto& ring : rings) {
+            const bool retired = ring->IsRetired(); // 排出前に読むことで、終了直前のレコードも取りこぼさない
+            wrote |= ring->Drain([this](const LogRecord& record) { Emit(record); }) > 0;
+            if (uint64_t dropped = ring->TakeDropped()) {
+                std::fprintf(output_ ? output_ : stderr,
+                             "[Logger] Dropped %llu log records (ring buffer full).\n",
+                             static_cast<unsigned long long>(dropped));
+                wrote = true;
+            }
+            if (retired) {
+                std::lock_guard<std::mutex> lock(registry_mutex_);
+                rings_.erase(std::remove(rings_.begin(), rings_.end(), ring), rings_.end());
+            }
+        }
+        if (wrote) {
+            std::fflush(output_ ? output_ : stdout);
+            if (!output_) std::fflush(stderr);
+        }
+    }
+
+    void Emit(const LogRecord& record) {
+        static constexpr const char* LEVEL_NAMES[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+        const LogSite& site = *record.site;
+
+        line_.clear();
+        AppendTimestamp(record.timestamp_ns);
+        line_.push_back(' ');
+        line_.append(LEVEL_NAMES[static_cast<size_t>(site.level)]);
+        line_.append(" [");
+        line_.append(site.tag);
+        line_.append("] ");
+
+        size_t offset = 0;
+        for (const char* p = site.format; *p; ++p) {
+            if (p[0] == '{' && p[1] == '}') {
+                if (!log_detail::AppendNextArg(record, offset, line_)) line_.append("{}");
+                ++p;
+            } else {
+                line_.push_back(*p);
+            }
+        }
+        if (record.truncated) line_.append(" [truncated]");
+        if (record.suppressed > 0) {
+            line_.append(" [suppressed ");
+            line_.append(std::to_string(record.suppressed));
+            line_.append(" similar]");
+        }
+        line_.push_back('\n');
+
+        std::FILE* out = output_ ? output_ : (site.level >= LogLevel::kWarn ? stderr : stdout);
+        std::fwrite(line_.data(), 1, line_.size(), out);
+    }
+
+    void AppendTimestamp(int64_t timestamp_ns) {
+        const std::time_t sec = static_cast<std::time_t>(timestamp_ns / 1000000000);
+        std::tm tm{};
+        localtime_r(&sec, &tm);
+        char buf[40];
+        size_t len = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+        len += std::snprintf(buf + len, sizeof(buf) - len, ".%06lld",
+                             static_cast<long long>((timestamp_ns % 1000000000) / 1000));
+        line_.append(buf, len);
+    }
+};
+
+/**
+ * @brief 呼び出し箇所ごとのレート制限。指定間隔内の2件目以降を抑止し、抑止件数を次の出力に付与する。
+ */
+class LogRateLimiter {
+public:
+    explicit constexpr LogRateLimiter(int64_t interval_ms) : interval_ns_(interval_ms * 1000000) {}
+
+    /**
+     * @brief 出力してよいかを判定する。
+     * @param suppressed 出力する場合、直前までに抑止された件数 (出力)
+     * @return 出力する場合はtrue
+     */
+    bool Allow(uint32_t& suppressed) {
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t next = next_allowed_ns_.load(std::memory_order_relaxed);
+        if (now < next || !next_allowed_ns_.compare_exchange_strong(next, now + interval_ns_, std::memory_order_relaxed)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    const int64_t interval_ns_;
+    std::atomic<int64_t> next_allowed_ns_{0};
+    std::atomic<uint32_t> suppressed_{0};
+};
+
+} // namespace hcs_common
+
+/**
+ * @brief ログ出力マクロ。
+ * HCS_LOG_MIN_LEVEL 未満のレベルは if constexpr で除去され、引数も評価されない。
+ * 書式文字列の "{}" が引数に順に置換される (書式化はバックグラウンドスレッドで行う)。
+ * 例: HCS_LOG_INFO("Encoder", "Sent {} bytes to {}", bytes, dest);
+ */
+#define HCS_LOG(level, tag, format, ...)                                                              \
+    do {                                                                                              \
+        if constexpr (static_cast<int>(level) >= HCS_LOG_MIN_LEVEL) {                                 \
+            if (::hcs_common::Logger::Enabled(level)) {                                               \
+                static constexpr ::hcs_common::LogSite hcs_log_site_{level, tag, format};            \
+                ::hcs_common::Logger::Instance().Write(hcs_log_site_, 0, ##__VA_ARGS__);              \
+            }                                                                                         \
+        }                                                                                             \
+    } while (0)
+
+/**
+ * @brief レート制限付きログ出力マクロ。呼び出し箇所ごとに interval_ms に1件まで出力し、
+ * 抑止した件数を次の出力に付与する。パケットごとに発生しうるエラー経路で使用する。
+ */
+#define HCS_LOG_RATE_LIMITED(level, interval_ms, tag, format, ...)                                    \
+    do {                                                                                              \
+        if constexpr (static_cast<int>(level) >= HCS_LOG_MIN_LEVEL) {                                 \
+            if (::hcs_common::Logger::Enabled(level)) {                                               \
+                static constexpr ::hcs_common::LogSite hcs_log_site_{level, tag, format};            \
+                static ::hcs_common::LogRateLimiter hcs_log_limiter_(interval_ms);                    \
+                uint32_t hcs_log_suppressed_ = 0;                                                     \
+                if (hcs_log_limiter_.Allow(hcs_log_suppressed_)) {                                    \
+                    ::hcs_common::Logger::Instance().Write(hcs_log_site_, hcs_log_suppressed_, ##__VA_ARGS__); \
+                }                                                                                     \
+            }                                                                                         \
+        }                                                                                             \
+    } while (0)
+
+#define HCS_LOG_TRACE(tag, format, ...) HCS_LOG(::hcs_common::LogLevel::kTrace, tag, format, ##__VA_ARGS__)
+#define HCS_LOG_DEBUG(tag, format, ...) HCS_LOG(::hcs_common::LogLevel::kDebug, tag, format, ##__VA_ARGS__)
+#define HCS_LOG_INFO(tag, format, ...) HCS_LOG(::hcs_common::LogLevel::kInfo, tag, format, ##__VA_ARGS__)
+#define HCS_LOG_WARN(tag, format, ...) HCS_LOG(::hcs_common::LogLevel::kWarn, tag, format, ##__VA_ARGS__)
+#define HCS_LOG_ERROR(tag, format, ...) HCS_LOG(::hcs_common::LogLevel::kError, tag, format, ##__VA_ARGS__)
+
+// パケット単位で発生しうる警告・エラー向け (呼び出し箇所ごとに LOG_RATE_LIMIT_MS に1件)
+#define HCS_LOG_WARN_EVERY(tag, format, ...) \
+    HCS_LOG_RATE_LIMITED(::hcs_common::LogLevel::kWarn, ::hcs_common::LOG_RATE_LIMIT_MS, tag, format, ##__VA_ARGS__)
+#define HCS_LOG_ERROR_EVERY(tag, format, ...) \
+    HCS_LOG_RATE_LIMITED(::hcs_common::LogLevel::kError, ::hcs_common::LOG_RATE_LIMIT_MS, tag, format, ##__VA_ARGS__)
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace hcs_common {
+
+// --- メトリクスの定数 ---
+constexpr size_t METRIC_SHARDS = 64; ///< メトリクスごとのシャード数 (同時に計測するスレッド数の想定上限)
+constexpr size_t METRIC_SHARED_SHARD = METRIC_SHARDS - 1; ///< 専有シャードを割り当てられなかったスレッドが共有するシャード
+
+/**
+ * @brief 計測スレッドごとのシャード番号を管理する。
+ * スレッドは初回計測時に専有シャードを1つ割り当てられ、終了時に返却する。
+ * 専有シャードへの加算は他スレッドと競合しないため、アトミックな読み書き (RMW なし) で済む。
+ */
+class MetricShardAllocator {
+public:
+    /**
+     * @brief 呼び出し元スレッドのシャード番号を返す。
+     */
+    static size_t Current() {
+        thread_local Slot slot;
+        return slot.index;
+    }
+
+    /**
+     * @brief シャードが呼び出し元スレッドの専有か (共有シャードは RMW で加算する必要がある)。
+     */
+    static bool IsExclusive(size_t shard) { return shard != METRIC_SHARED_SHARD; }
+
+private:
+    struct Slot {
+        size_t index;
+        Slot() : index(Acquire()) {}
+        ~Slot() { Release(index); }
+    };
+
+    static std::mutex& Mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<size_t>& FreeList() {
+        static std::vector<size_t> free_list = [] {
+            std::vector<size_t> list;
+            for (size_t i = METRIC_SHARED_SHARD; i-- > 0;) list.push_back(i);
+            return list;
+        }();
+        return free_list;
+    }
+
+    static size_t Acquire() {
+        std::lock_guard<std::mutex> lock(Mutex());
+        auto& free_list = FreeList();
+        if (free_list.empty()) return METRIC_SHARED_SHARD;
+        size_t index = free_list.back();
+        free_list.pop_back();
+        return index;
+    }
+
+    static void Release(size_t index) {
+        if (!IsExclusive(index)) return;
+        // シャードの値はそのまま残り、次に割り当てられたスレッドが加算を続ける
+        std::lock_guard<std::mutex> lock(Mutex());
+        FreeList().push_back(index);
+    }
+};
+
+namespace metric_detail {
+
+/**
+ * @brief シャード上の値に加算する。専有シャードは load/store、共有シャードは fetch_add を用いる。
+ */
+inline void ShardAdd(std::atomic<uint64_t>& cell, uint64_t n, size_t shard) {
+    if (MetricShardAllocator::IsExclusive(shard)) {
+        cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    } else {
+        cell.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+} // namespace metric_detail
+
+} // namespace hcs_common
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "MetricShard.h"
+
+namespace hcs_common {
+
+/**
+ * @brief 単調増加カウンタ (パケット数、バイト数、エラー数など)。
+ * 加算はスレッドごとのシャードに対して行い、集計はスクレイプ時のみ行う。
+ */
+class Counter {
+public:
+    /**
+     * @brief カウンタに加算する。
+     */
+    void Add(uint64_t n = 1) {
+        const size_t shard = MetricShardAllocator::Current();
+        metric_detail::ShardAdd(shards_[shard].value, n, shard);
+    }
+
+    /**
+     * @brief 全シャードの合計を返す (スクレイプ時に使用)。
+     */
+    uint64_t Value() const {
+        uint64_t total = 0;
+        for (const auto& s : shards_) total += s.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+/**
+ * @brief 現在値を表すゲージ (キュー長、ピア数など)。
+ * 最後に設定された値が意味を持つためシャード化せず、単一のアトミック変数で保持する。
+ */
+class Gauge {
+public:
+    void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void Add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    alignas(64) std::atomic<int64_t> value_{0};
+};
+
+/**
+ * @brief 固定バケットのヒストグラム (パケットサイズ、処理時間など)。
+ * バケットの上限値は登録時に固定し、観測はシャード上のバケットへの加算のみで済む。
+ */
+class Histogram {
+public:
+    /**
+     * @param bounds バケットの上限値 (昇順)。上限を超える観測値は +Inf バケットに入る
+     */
+    explicit Histogram(std::vector<uint64_t> bounds) : bounds_(std::move(bounds)) {
+        std::sort(bounds_.begin(), bounds_.end());
+        for (auto& s : shards_) s.buckets = std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1);
+    }
+
+    /**
+     * @brief 観測値を記録する。
+     */
+    void Observe(uint64_t value) {
+        const size_t shard = MetricShardAllocator::Current();
+        Shard& s = shards_[shard];
+        size_t bucket = 0;
+        while (bucket < bounds_.size() && value > bounds_[bucket]) ++bucket;
+        metric_detail::ShardAdd(s.buckets[bucket], 1, shard);
+        metric_detail::ShardAdd(s.sum, value, shard);
+    }
+
+    const std::vector<uint64_t>& Bounds() const { return bounds_; }
+
+    /**
+     * @brief 全シャードを集計したバケットごとの件数 (非累積、末尾は +Inf) と合計を返す。
+     */
+    std::vector<uint64_t> Snapshot(uint64_t& sum) const {
+        std::vector<uint64_t> counts(bounds_.size() + 1, 0);
+        sum = 0;
+        for (const auto& s : shards_) {
+            for (size_t i = 0; i < counts.size(); ++i) counts[i] += s.buckets[i].load(std::memory_order_relaxed);
+            sum += s.sum.load(std::memory_order_relaxed);
+        }
+        return counts;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> sum{0};
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+    };
+    std::vector<uint64_t> bounds_;
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+/**
+ * @brief プロセス共通のメトリクスレジストリ。
+ *
+ * メトリクスは (名前, ラベル) ごとに一度だけ生成され、返した参照はプロセス終了まで有効。
+ * 計測側は生成時に参照を保持しておき、計測ごとにレジストリを引かないこと。
+ * 登録・スクレイプはミューテックスで保護されるが、計測 (Add/Set/Observe) はロックを取らない。
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry& Instance() {
+        static MetricsRegistry instance;
+        return instance;
+    }
+
+    /**
+     * @brief カウンタを取得する (未登録なら生成する)。
+     * @param name メトリクス名 (例: "hcs_udp_packets_sent_total")
+     * @param help 説明文
+     * @param labels ラベル (例: "transport=\"media\""、なしの場合は空文字列)
+     */
+    Counter& GetCounter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family& family = GetFamily(name, help, "counter");
+        auto& entry = family.series[labels];
+        if (!entry.counter) entry.counter = &counters_.emplace_back();
+        return *entry.counter;
+    }
+
+    /**
+     * @brief ゲージを取得する (未登録なら生成する)。
+     */
+    Gauge& GetGauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family& family = GetFamily(name, help, "gauge");
+        auto& entry = family.series[labels];
+        if (!entry.gauge) entry.gauge = &gauges_.emplace_back();
+        return *entry.gauge;
+    }
+
+    /**
+     * @brief ヒストグラムを取得する (未登録なら生成する)。登録済みの場合 bounds は無視される。
+     */
+    Histogram& GetHistogram(const std::string& name, const std::string& help,
+                            std::vector<uint64_t> bounds, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family& family = GetFamily(name, help, "histogram");
+        auto& entry = family.series[labels];
+        if (!entry.histogram) entry.histogram = &histograms_.emplace_back(std::move(bounds));
+        return *entry.histogram;
+    }
+
+    /**
+     * @brief 遅延分布を取得する (未登録なら生成する)。
+     * 記録はナノ秒単位で行い、出力時に秒単位の summary (p50/p99/p99.9、合計、件数) に変換する。
+     */
+    LatencyHistogram& GetLatencySummary(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family& family = GetFamily(name, help, "summary");
+        auto& entry = family.series[labels];
+        if (!entry.latency) entry.latency = &latencies_.emplace_back();
+        return *entry.latency;
+    }
+
+    /**
+     * @brief 全メトリクスを集計し、Prometheus のテキスト形式 (version 0.0.4) で返す。
+     */
+    std::string RenderText() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string out;
+        char buf[32];
+        for (const auto& [name, family] : families_) {
+            out += "# HELP " + name + " " + family.help + "\n";
+            out += "# TYPE " + name + " " + family.type + "\n";
+            for (const auto& [labels, entry] : family.series) {
+                if (entry.counter) {
+                    AppendSample(out, name, labels, "", std::to_string(entry.counter->Value()));
+                } else if (entry.gauge) {
+                    AppendSample(out, name, labels, "", std::to_string(entry.gauge->Value()));
+                } else if (entry.histogram) {
+                    uint64_t sum = 0;
+                    std::vector<uint64_t> counts = entry.histogram->Snapshot(sum);
+                    const auto& bounds = entry.histogram->Bounds();
+                    uint64_t cumulative = 0;
+                    for (size_t i = 0; i < counts.size(); ++i) {
+                        cumulative += counts[i];
+                        std::string le = i < bounds.size() ? std::to_string(bounds[i]) : "+Inf";
+                        std::snprintf(buf, sizeof(buf), "le=\"%s\"", le.c_str());
+                        AppendSample(out, name + "_bucket", labels, buf, std::to_string(cumulative));
+                    }
+                    AppendSample(out, name + "_sum", labels, "", std::to_string(sum));
+                    AppendSample(out, name + "_count", labels, "", std::to_string(cumulative));
+                } else if (entry.latency) {
+                    static constexpr double QUANTILES[] = {0.5, 0.99, 0.999};
+                    static constexpr const char* QUANTILE_LABELS[] = {"quantile=\"0.5\"", "quantile=\"0.99\"", "quantile=\"0.999\""};
+                    uint64_t values[3];
+                    const uint64_t count = entry.latency->Quantiles(QUANTILES, values, 3);
+                    for (size_t i = 0; i < 3; ++i) {
+                        AppendSample(out, name, labels, QUANTILE_LABELS[i], FormatSeconds(values[i], buf, sizeof(buf)));
+                    }
+                    AppendSample(out, name + "_sum", labels, "", FormatSeconds(entry.latency->Sum(), buf, sizeof(buf)));
+                    AppendSample(out, name + "_count", labels, "", std::to_string(count));
+                }
+            }
+        }
+        return out;
+    }
+
+    /**
+     * @brief テキスト形式のメトリクスをファイルへ書き出す (node_exporter の textfile collector 向け)。
+     * 書き込み途中のファイルを読まれないよう、一時ファイルに書いてから置き換える。
+     * @return 成功した場合はtrue
+     */
+    bool WriteTextFile(const std::string& path) const {
+        const std::string text = RenderText();
+        const std::string tmp_path = path + ".tmp";
+        std::FILE* f = std::fopen(tmp_path.c_str(), "w");
+        if (!f) return false;
+        const bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+        if (std::fclose(f) != 0 || !ok) return false;
+        return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    }
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+private:
+    struct Series {
+        Counter* counter = nullptr;
+        Gauge* gauge = nullptr;
+        Histogram* histogram = nullptr;
+        LatencyHistogram* latency = nullptr;
+    };
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, Series> series; // ラベル -> 系列
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_; // 名前順に出力する
+    // deque は要素のアドレスを変えずに拡張できるため、返した参照が無効にならない
+    std::deque<Counter> counters_;
+    std::deque<Gauge> gauges_;
+    std::deque<Histogram> histograms_;
+    std::deque<LatencyHistogram> latencies_;
+
+    MetricsRegistry() = default;
+
+    Family& GetFamily(const std::string& name, const std::string& help, const char* type) {
+        auto [it, inserted] = families_.try_emplace(name);
+        if (inserted) {
+            it->second.help = help;
+            it->second.type = type;
+        } else if (it->second.type != type) {
+            throw std::logic_error("Metric " + name + " is already registered as " + it->second.type);
+        }
+        return it->second;
+    }
+
+    static const char* FormatSeconds(uint64_t nanoseconds, char* buf, size_t size) {
+        std::snprintf(buf, size, "%.9g", static_cast<double>(nanoseconds) / 1e9);
+        return buf;
+    }
+
+    static void AppendSample(std::string& out, const std::string& name, const std::string& labels,
+                             const char* extra_label, const std::string& value) {
+        out += name;
+        if (!labels.empty() || *extra_label) {
+            out += '{';
+            out += labels;
+            if (!labels.empty() && *extra_label) out += ',';
+            out += extra_label;
+            out += '}';
+        }
+        out += ' ';
+        out += value;
+        out += '\n';
+    }
+};
+
+} // namespace hcs_common
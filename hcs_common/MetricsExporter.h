@@ -0,0 +1,112 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include "Logger.h"
+#include "Metrics.h"
+#include "Tracing.h"
+
+namespace hcs_common {
+
+constexpr size_t METRICS_MAX_REQUEST_SIZE = 8192; ///< スクレイプ要求ヘッダーの最大サイズ
+
+/**
+ * @brief メトリクスを HTTP でローカルに公開するエクスポータ (Prometheus のスクレイプ対象)。
+ * /trace への要求には Tracer の直近のイベントを Chrome trace event 形式の JSON で返し、
+ * それ以外のパスには常に MetricsRegistry の全メトリクスをテキスト形式で返す (メソッドは区別しない)。
+ * 集計はスクレイプ時のみ行われるため、計測側のコストには影響しない。
+ */
+class MetricsHttpExporter : public std::enable_shared_from_this<MetricsHttpExporter> {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param io I/Oコンテキスト
+     * @param port 待ち受けポート
+     * @param bind_address 待ち受けアドレス (既定はループバックのみ)
+     */
+    MetricsHttpExporter(boost::asio::io_context& io, uint16_t port, const std::string& bind_address = "127.0.0.1")
+        : io_(io), acceptor_(io), endpoint_(boost::asio::ip::make_address(bind_address), port) {}
+
+    /**
+     * @brief 待ち受けを開始する。
+     */
+    void Start() {
+        boost::system::error_code ec;
+        acceptor_.open(endpoint_.protocol(), ec);
+        if (!ec) acceptor_.set_option(boost::asio::socket_base::reuse_address(true), ec);
+        if (!ec) acceptor_.bind(endpoint_, ec);
+        if (!ec) acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
+        if (ec) {
+            HCS_LOG_ERROR("Metrics", "Failed to listen on {}: {}", endpoint_, ec.message());
+            return;
+        }
+        HCS_LOG_INFO("Metrics", "Serving metrics on http://{}/metrics", endpoint_);
+        AsyncAccept();
+    }
+
+    /**
+     * @brief 待ち受けを停止する。
+     */
+    void Stop() {
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+    }
+
+private:
+    boost::asio::io_context& io_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    boost::asio::ip::tcp::endpoint endpoint_;
+
+    struct Session {
+        explicit Session(boost::asio::io_context& io) : socket(io), request(METRICS_MAX_REQUEST_SIZE) {}
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::streambuf request;
+        std::string response;
+    };
+
+    void AsyncAccept() {
+        auto session = std::make_shared<Session>(io_);
+        acceptor_.async_accept(session->socket,
+            [self = shared_from_this(), session](const boost::system::error_code& ec) {
+                if (ec == boost::asio::error::operation_aborted) return;
+                if (!ec) self->ServeSession(session);
+                self->AsyncAccept();
+            });
+    }
+
+    void ServeSession(const std::shared_ptr<Session>& session) {
+        boost::asio::async_read_until(session->socket, session->request, "\r\n\r\n",
+            [session](const boost::system::error_code& ec, std::size_t) {
+                if (ec) return; // 切断または要求ヘッダーが大きすぎる
+                const bool trace = RequestPath(session->request).rfind("/trace", 0) == 0;
+                const std::string body = trace ? Tracer::Instance().RenderChromeTrace()
+                                               : MetricsRegistry::Instance().RenderText();
+                session->response =
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: " + std::string(trace ? "application/json" : "text/plain; version=0.0.4") + "\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                    "Connection: close\r\n\r\n" + body;
+                boost::asio::async_write(session->socket, boost::asio::buffer(session->response),
+                    [session](const boost::system::error_code&, std::size_t) {
+                        boost::system::error_code ignored;
+                        session->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+                    });
+            });
+    }
+
+    /**
+     * @brief 要求行 ("GET /path HTTP/1.1") からパスを取り出す。
+     */
+    static std::string RequestPath(const boost::asio::streambuf& request) {
+        const char* data = static_cast<const char*>(request.data().data());
+        const std::string line(data, std::find(data, data + request.size(), '\r'));
+        const size_t begin = line.find(' ');
+        if (begin == std::string::npos) return {};
+        const size_t end = line.find(' ', begin + 1);
+        return line.substr(begin + 1, end == std::string::npos ? std::string::npos : end - begin - 1);
+    }
+};
+
+} // namespace hcs_common
@@ -0,0 +1,676 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include "Logger.h"
+
+namespace hcs_common {
+
+constexpr size_t CONFIG_MAX_ERRORS = 32; ///< 1回の読み込みで報告する検証エラーの上限
+
+// --- 起動時に確定し、実行中は変更しない設定 ---
+
+/**
+ * @brief トランスポートの設定。
+ */
+struct TransportSettings {
+    std::string address = "::";              // メディアの待ち受けアドレス
+    uint16_t media_port = 5004;
+    uint16_t control_port = 5005;
+    std::string media_backend = "udp";       // メディアのトランスポート (udp: AES-256-GCM の UDP / quic: ngtcp2 でビルドした場合のみ)
+    std::string timestamps = "software";     // カーネルのタイムスタンプ: off / software / hardware
+    std::string multicast_scope = "link";    // ディスカバリのスコープ: link / site / organization
+    int multicast_hop_limit = 1;
+    std::string multicast_interface;         // 空の場合はカーネルの既定
+};
+
+/**
+ * @brief スレッド構成。
+ */
+struct ThreadSettings {
+    size_t io_threads = 1;  // io_context を回すスレッド数 (コンポーネントが strand 化されるまでは 1 のみ)
+    bool pin_cpus = false;  // I/O スレッドを CPU に固定する
+};
+
+/**
+ * @brief 暗号スイートと鍵の設定。
+ */
+struct CryptoSettings {
+    std::string suite = "aes-256-gcm";
+    std::string passphrase_file;   // 鍵導出のパスフレーズを記したファイル (末尾の改行は除く)
+    std::string passphrase;        // 読み込んだパスフレーズ (設定ファイルには書かない)
+    std::vector<uint8_t> salt;     // 16 バイトのソルト (16進数。全ノードで同じ値とする)
+};
+
+/**
+ * @brief 事前確保するプールの大きさ。
+ */
+struct PoolSettings {
+    size_t packet_buffers = 0;          // 起動時に I/O スレッドのパケットプールへ確保するバッファ数
+    size_t capture_ring_packets = 4096; // パケットキャプチャのリング容量
+};
+
+/**
+ * @brief 周期とタイムアウト。
+ */
+struct TimeoutSettings {
+    std::chrono::milliseconds frame_interval{33};     // エンコーダのフレーム間隔 (約 30 FPS)
+    std::chrono::seconds bootstrap_failover{5};       // 到着間隔の学習前に親を障害とみなすまでの時間
+    std::chrono::milliseconds control_tick{100};      // 制御ループの周期 (ADVERTISE のバッチ適用)
+    std::chrono::milliseconds handoff{2000};          // 停止時に子ノードの親の切り替えを待つ上限 (0 で予告しない)
+    std::chrono::milliseconds drain{500};             // 停止時に送信キューの送出を待つ上限
+};
+
+/**
+ * @brief 参加・配信するグループ。
+ */
+struct GroupSettings {
+    std::vector<std::string> join;    // 起動時に参加するグループ
+    std::vector<std::string> source;  // 自ノードが送信元となるグループ
+};
+
+/**
+ * @brief 診断用のエンドポイント。
+ */
+struct DiagnosticsSettings {
+    uint16_t metrics_port = 0;  // 0 の場合はメトリクスを公開しない
+    std::string capture_dir;    // 空の場合はパケットキャプチャを無効にする
+};
+
+// --- 実行中に再読み込みできる設定 ---
+
+/**
+ * @brief 実行中に安全に変更できる調整値。
+ * 再読み込み時は新しい値の組を丸ごと公開し、読み手はロックなしで現在の組を参照する。
+ */
+struct NodeTunables {
+    LogLevel log_level = LogLevel::kInfo;
+    bool tracing = false;
+    bool redundant = false;                                // 冗長配信モード (セカンダリ親)
+    int max_tree_depth = 8;
+    double suspect_phi = 3.0;
+    double failed_phi = 8.0;
+    std::chrono::milliseconds heartbeat_piggyback{100};    // HEARTBEAT をメディアに相乗りさせる最大待ち時間
+    std::chrono::milliseconds probe_interval{1000};        // RTT プローブの周期
+    std::chrono::microseconds control_coalescing{0};       // 制御メッセージの送信をまとめる待ち時間
+};
+
+/**
+ * @brief ノードの全設定。NodeConfigLoader が検証済みの値のみを格納する。
+ */
+struct NodeConfig {
+    std::string node_id;
+    std::string node_address; // 経路のパスベクトルで自ノードを識別するアドレス (空なら transport.address)
+    TransportSettings transport;
+    ThreadSettings threads;
+    CryptoSettings crypto;
+    PoolSettings pools;
+    TimeoutSettings timeouts;
+    GroupSettings groups;
+    DiagnosticsSettings diagnostics;
+    NodeTunables tunables; // 起動時の値 (以降は NodeConfigStore::Tunables() を参照する)
+};
+
+/**
+ * @brief 設定ファイルと上書き指定を読み込み、NodeConfig に変換して検証する。
+ *
+ * 書式は INI 形式で、"[section]" の後の "key = value" を "section.key" として扱う。
+ * 行頭が '#' または ';' の行は注釈。時間は単位 (us / ms / s) 付きで、リストはカンマ区切りで書く。
+ * 上書き指定は "section.key=value" の形でファイルの後に適用する (コマンドライン用)。
+ * 未知のキー・型や範囲の誤りは、すべてを集めて1つの例外で報告する (起動を1回で直せるように)。
+ *
+ * 例:
+ *   [node]
+ *   id = relay-1
+ *   [transport]
+ *   media_port = 5004
+ *   [timeouts]
+ *   frame_interval = 33ms
+ */
+class NodeConfigLoader {
+public:
+    /**
+     * @brief 設定ファイルを読み込む
+     * @param path 設定ファイルのパス (空の場合は既定値に上書き指定のみを適用する)
+     * @param overrides "section.key=value" の上書き指定
+     * @return 検証済みの設定
+     * @throw std::invalid_argument 読み込みまたは検証に失敗した場合 (全エラーを含む)
+     */
+    static NodeConfig Load(const std::string& path, const std::vector<std::string>& overrides = {}) {
+        std::string text;
+        if (!path.empty()) {
+            std::ifstream in(path);
+            if (!in) throw std::invalid_argument("Failed to open config file: " + path);
+            std::ostringstream buffer;
+            buffer << in.rdbuf();
+            text = buffer.str();
+        }
+        return Parse(text, path.empty() ? "<defaults>" : path, overrides);
+    }
+
+    /**
+     * @brief 設定の文字列を解析する
+     * @param text 設定ファイルの内容
+     * @param source エラーメッセージに含める読み込み元の名前
+     * @param overrides "section.key=value" の上書き指定
+     * @throw std::invalid_argument 解析または検証に失敗した場合
+     */
+    static NodeConfig Parse(const std::string& text, const std::string& source,
+                            const std::vector<std::string>& overrides = {}) {
+        NodeConfig config;
+        std::vector<std::string> errors;
+        std::vector<std::string> seen;
+
+        std::istringstream lines(text);
+        std::string line;
+        std::string section;
+        for (size_t number = 1; std::getline(lines, line); ++number) {
+            const std::string where = source + ":" + std::to_string(number);
+            line = Trim(line);
+            if (line.empty() || line[0] == '#' || line[0] == ';') continue;
+            if (line.front() == '[') {
+                if (line.back() != ']') {
+                    errors.push_back(where + ": unterminated section header");
+                    continue;
+                }
+                section = Trim(line.substr(1, line.size() - 2));
+                continue;
+            }
+            const size_t eq = line.find('=');
+            if (eq == std::string::npos) {
+                errors.push_back(where + ": expected key = value");
+                continue;
+            }
+            const std::string key = (section.empty() ? "" : section + ".") + Trim(line.substr(0, eq));
+            if (std::find(seen.begin(), seen.end(), key) != seen.end()) {
+                errors.push_back(where + ": duplicate key " + key);
+                continue;
+            }
+            seen.push_back(key);
+            Apply(config, key, Trim(line.substr(eq + 1)), where, errors);
+        }
+
+        for (const auto& override_text : overrides) {
+            const size_t eq = override_text.find('=');
+            if (eq == std::string::npos) {
+                errors.push_back("override '" + override_text + "': expected section.key=value");
+                continue;
+            }
+            Apply(config, Trim(override_text.substr(0, eq)), Trim(override_text.substr(eq + 1)), "override", errors);
+        }
+
+        // 型の誤りがなければ値どうしの整合性を検証し、パスフレーズを読み込む
+        if (errors.empty()) Validate(config, errors);
+        if (errors.empty() && !config.crypto.passphrase_file.empty()) LoadPassphrase(config.crypto, errors);
+
+        if (!errors.empty()) {
+            std::string message = "Invalid node configuration (" + std::to_string(errors.size()) + " error(s)):";
+            for (size_t i = 0; i < errors.size() && i < CONFIG_MAX_ERRORS; ++i) message += "\n  " + errors[i];
+            throw std::invalid_argument(message);
+        }
+        return config;
+    }
+
+    /**
+     * @brief 設定を正規化した INI 形式で書き出す (起動時のログや設定の確認用。パスフレーズは含めない)
+     */
+    static std::string Render(const NodeConfig& config) {
+        std::string out;
+        std::string section;
+        for (const auto& key : Keys()) {
+            const std::string name = key.name;
+            const size_t dot = name.find('.');
+            const std::string key_section = name.substr(0, dot);
+            if (key_section != section) {
+                if (!section.empty()) out += "\n";
+                out += "[" + key_section + "]\n";
+                section = key_section;
+            }
+            if (key.tunable) out += "# reloadable\n";
+            out += name.substr(dot + 1) + " = " + key.render(config) + "\n";
+        }
+        return out;
+    }
+
+    /**
+     * @brief 2つの設定で値が異なる、再起動が必要なキーを返す (再読み込み時の警告用)
+     */
+    static std::vector<std::string> RestartRequiredChanges(const NodeConfig& current, const NodeConfig& next) {
+        std::vector<std::string> changed;
+        for (const auto& key : Keys()) {
+            if (!key.tunable && key.render(current) != key.render(next)) changed.push_back(key.name);
+        }
+        if (current.crypto.passphrase != next.crypto.passphrase) changed.push_back("crypto.passphrase_file (contents)");
+        return changed;
+    }
+
+private:
+    /**
+     * @brief 設定キーの定義 (解析・書き出し・再読み込み可否)。
+     */
+    struct ConfigKey {
+        const char* name;
+        bool tunable;
+        std::function<bool(NodeConfig&, const std::string&, std::string&)> parse; // 失敗時はエラー文を返す
+        std::function<std::string(const NodeConfig&)> render;
+    };
+
+    template <typename Field>
+    static ConfigKey MakeKey(const char* name, bool tunable, Field field, std::vector<std::string> choices = {}) {
+        return ConfigKey{
+            name, tunable,
+            [field, choices](NodeConfig& config, const std::string& text, std::string& error) {
+                auto& value = field(config);
+                if (!choices.empty() && std::find(choices.begin(), choices.end(), text) == choices.end()) {
+                    error = "must be one of " + Join(choices);
+                    return false;
+                }
+                return ParseValue(text, value, error);
+            },
+            [field](const NodeConfig& config) { return RenderValue(field(const_cast<NodeConfig&>(config))); },
+        };
+    }
+
+    /**
+     * @brief 全設定キー。書き出しの順序もこの順とする。
+     */
+    static const std::vector<ConfigKey>& Keys() {
+        static const std::vector<ConfigKey> keys = {
+            MakeKey("node.id", false, [](NodeConfig& c) -> auto& { return c.node_id; }),
+            MakeKey("node.address", false, [](NodeConfig& c) -> auto& { return c.node_address; }),
+            MakeKey("node.log_level", true, [](NodeConfig& c) -> auto& { return c.tunables.log_level; }),
+            MakeKey("transport.address", false, [](NodeConfig& c) -> auto& { return c.transport.address; }),
+            MakeKey("transport.media_port", false, [](NodeConfig& c) -> auto& { return c.transport.media_port; }),
+            MakeKey("transport.control_port", false, [](NodeConfig& c) -> auto& { return c.transport.control_port; }),
+            MakeKey("transport.media_backend", false, [](NodeConfig& c) -> auto& { return c.transport.media_backend; },
+                    {"udp", "quic"}),
+            MakeKey("transport.timestamps", false, [](NodeConfig& c) -> auto& { return c.transport.timestamps; },
+                    {"off", "software", "hardware"}),
+            MakeKey("transport.multicast_scope", false, [](NodeConfig& c) -> auto& { return c.transport.multicast_scope; },
+                    {"link", "site", "organization"}),
+            MakeKey("transport.multicast_hop_limit", false, [](NodeConfig& c) -> auto& { return c.transport.multicast_hop_limit; }),
+            MakeKey("transport.multicast_interface", false, [](NodeConfig& c) -> auto& { return c.transport.multicast_interface; }),
+            MakeKey("transport.control_coalescing", true, [](NodeConfig& c) -> auto& { return c.tunables.control_coalescing; }),
+            MakeKey("threads.io_threads", false, [](NodeConfig& c) -> auto& { return c.threads.io_threads; }),
+            MakeKey("threads.pin_cpus", false, [](NodeConfig& c) -> auto& { return c.threads.pin_cpus; }),
+            MakeKey("crypto.suite", false, [](NodeConfig& c) -> auto& { return c.crypto.suite; }, {"aes-256-gcm"}),
+            MakeKey("crypto.passphrase_file", false, [](NodeConfig& c) -> auto& { return c.crypto.passphrase_file; }),
+            MakeKey("crypto.salt", false, [](NodeConfig& c) -> auto& { return c.crypto.salt; }),
+            MakeKey("pools.packet_buffers", false, [](NodeConfig& c) -> auto& { return c.pools.packet_buffers; }),
+            MakeKey("pools.capture_ring_packets", false, [](NodeConfig& c) -> auto& { return c.pools.capture_ring_packets; }),
+            MakeKey("timeouts.frame_interval", false, [](NodeConfig& c) -> auto& { return c.timeouts.frame_interval; }),
+            MakeKey("timeouts.bootstrap_failover", false, [](NodeConfig& c) -> auto& { return c.timeouts.bootstrap_failover; }),
+            MakeKey("timeouts.control_tick", false, [](NodeConfig& c) -> auto& { return c.timeouts.control_tick; }),
+            MakeKey("timeouts.handoff", false, [](NodeConfig& c) -> auto& { return c.timeouts.handoff; }),
+            MakeKey("timeouts.drain", false, [](NodeConfig& c) -> auto& { return c.timeouts.drain; }),
+            MakeKey("timeouts.heartbeat_piggyback", true, [](NodeConfig& c) -> auto& { return c.tunables.heartbeat_piggyback; }),
+            MakeKey("timeouts.probe_interval", true, [](NodeConfig& c) -> auto& { return c.tunables.probe_interval; }),
+            MakeKey("topology.redundant", true, [](NodeConfig& c) -> auto& { return c.tunables.redundant; }),
+            MakeKey("topology.max_tree_depth", true, [](NodeConfig& c) -> auto& { return c.tunables.max_tree_depth; }),
+            MakeKey("topology.suspect_phi", true, [](NodeConfig& c) -> auto& { return c.tunables.suspect_phi; }),
+            MakeKey("topology.failed_phi", true, [](NodeConfig& c) -> auto& { return c.tunables.failed_phi; }),
+            MakeKey("groups.join", false, [](NodeConfig& c) -> auto& { return c.groups.join; }),
+            MakeKey("groups.source", false, [](NodeConfig& c) -> auto& { return c.groups.source; }),
+            MakeKey("diagnostics.metrics_port", false, [](NodeConfig& c) -> auto& { return c.diagnostics.metrics_port; }),
+            MakeKey("diagnostics.capture_dir", false, [](NodeConfig& c) -> auto& { return c.diagnostics.capture_dir; }),
+            MakeKey("diagnostics.tracing", true, [](NodeConfig& c) -> auto& { return c.tunables.tracing; }),
+        };
+        return keys;
+    }
+
+    static void Apply(NodeConfig& config, const std::string& key, const std::string& value, const std::string& where,
+                      std::vector<std::string>& errors) {
+        for (const auto& entry : Keys()) {
+            if (key != entry.name) continue;
+            std::string error;
+            if (!entry.parse(config, value, error)) errors.push_back(where + ": " + key + " = '" + value + "': " + error);
+            return;
+        }
+        errors.push_back(where + ": unknown key " + key);
+    }
+
+    /**
+     * @brief 値の範囲と値どうしの整合性を検証する
+     */
+    static void Validate(const NodeConfig& c, std::vector<std::string>& errors) {
+        auto check = [&errors](bool ok, const std::string& message) {
+            if (!ok) errors.push_back(message);
+        };
+        using std::chrono::milliseconds;
+        if (!c.node_address.empty()) {
+            check(IsUnicastAddress(c.node_address), "node.address must be a unicast IP address");
+        } else {
+            check(IsUnicastAddress(c.transport.address),
+                  "node.address is required when transport.address is not a unicast IP address");
+        }
+        check(c.transport.media_port != 0, "transport.media_port must not be 0");
+        check(c.transport.control_port != 0, "transport.control_port must not be 0");
+        check(c.transport.media_port != c.transport.control_port, "transport.media_port and control_port must differ");
+        check(c.transport.multicast_hop_limit >= 1 && c.transport.multicast_hop_limit <= 255,
+              "transport.multicast_hop_limit must be 1-255");
+        check(c.transport.multicast_scope != "link" || c.transport.multicast_hop_limit == 1,
+              "transport.multicast_hop_limit must be 1 for link scope");
+#if !HCS_HAVE_NGTCP2
+        check(c.transport.media_backend != "quic", "transport.media_backend=quic requires a build with ngtcp2 (HCS_WITH_NGTCP2)");
+#endif
+        // 制御・メディアの各コンポーネントは単一スレッドの io_context を前提にしており、strand で
+        // 直列化していない。複数スレッドで回すと状態が競合するため、strand 化するまでは 1 に限る。
+        check(c.threads.io_threads == 1, "threads.io_threads must be 1 (node components are not strand-wrapped)");
+        check(!c.crypto.passphrase_file.empty(), "crypto.passphrase_file is required");
+        check(c.crypto.salt.size() == 16, "crypto.salt must be 16 bytes (32 hex digits)");
+        check(c.pools.capture_ring_packets >= 1, "pools.capture_ring_packets must be at least 1");
+        check(c.timeouts.frame_interval >= milliseconds(1) && c.timeouts.frame_interval <= milliseconds(1000),
+              "timeouts.frame_interval must be 1ms-1s");
+        check(c.timeouts.bootstrap_failover >= std::chrono::seconds(1), "timeouts.bootstrap_failover must be at least 1s");
+        check(c.timeouts.control_tick >= milliseconds(10) && c.timeouts.control_tick <= milliseconds(1000),
+              "timeouts.control_tick must be 10ms-1s");
+        check(c.timeouts.handoff <= std::chrono::seconds(30), "timeouts.handoff must be at most 30s");
+        check(c.timeouts.drain <= std::chrono::seconds(10), "timeouts.drain must be at most 10s");
+        check(c.tunables.heartbeat_piggyback <= milliseconds(1000), "timeouts.heartbeat_piggyback must be at most 1s");
+        check(c.tunables.probe_interval >= c.timeouts.control_tick,
+              "timeouts.probe_interval must not be shorter than timeouts.control_tick");
+        check(c.tunables.control_coalescing <= std::chrono::microseconds(10000),
+              "transport.control_coalescing must be at most 10ms");
+        check(c.tunables.max_tree_depth >= 1 && c.tunables.max_tree_depth <= 64, "topology.max_tree_depth must be 1-64");
+        check(c.tunables.suspect_phi > 0.0, "topology.suspect_phi must be positive");
+        check(c.tunables.failed_phi > c.tunables.suspect_phi, "topology.failed_phi must be greater than suspect_phi");
+        for (const auto& gid : c.groups.join) check(!gid.empty(), "groups.join contains an empty group id");
+        for (const auto& gid : c.groups.source) check(!gid.empty(), "groups.source contains an empty group id");
+    }
+
+    /**
+     * @brief 特定のホストを指す IP アドレス (ワイルドカードでない) か。IPv6 のスコープ (%eth0) は除いて判定する
+     */
+    static bool IsUnicastAddress(const std::string& text) {
+        in_addr v4{};
+        if (inet_pton(AF_INET, text.c_str(), &v4) == 1) {
+            return v4.s_addr != htonl(INADDR_ANY) && !IN_MULTICAST(ntohl(v4.s_addr));
+        }
+        in6_addr v6{};
+        if (inet_pton(AF_INET6, text.substr(0, text.find('%')).c_str(), &v6) != 1) return false;
+        return !IN6_IS_ADDR_UNSPECIFIED(&v6) && !IN6_IS_ADDR_MULTICAST(&v6);
+    }
+
+    static void LoadPassphrase(CryptoSettings& crypto, std::vector<std::string>& errors) {
+        std::ifstream in(crypto.passphrase_file);
+        if (!in) {
+            errors.push_back("crypto.passphrase_file: cannot read " + crypto.passphrase_file);
+            return;
+        }
+        std::getline(in, crypto.passphrase);
+        if (!crypto.passphrase.empty() && crypto.passphrase.back() == '\r') crypto.passphrase.pop_back();
+        if (crypto.passphrase.empty()) errors.push_back("crypto.passphrase_file: " + crypto.passphrase_file + " is empty");
+    }
+
+    // --- 値の解析と書き出し ---
+
+    static std::string Trim(const std::string& s) {
+        const size_t begin = s.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos) return "";
+        const size_t end = s.find_last_not_of(" \t\r\n");
+        return s.substr(begin, end - begin + 1);
+    }
+
+    static std::string Join(const std::vector<std::string>& items) {
+        std::string out;
+        for (const auto& item : items) out += (out.empty() ? "" : ", ") + item;
+        return out;
+    }
+
+    static bool ParseValue(const std::string& text, std::string& value, std::string&) {
+        value = text;
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, bool& value, std::string& error) {
+        if (text == "true" || text == "yes" || text == "on" || text == "1") value = true;
+        else if (text == "false" || text == "no" || text == "off" || text == "0") value = false;
+        else {
+            error = "expected a boolean (true/false)";
+            return false;
+        }
+        return true;
+    }
+
+    static bool ParseSigned(const std::string& text, long long& value, std::string& error) {
+        char* end = nullptr;
+        errno = 0;
+        value = std::strtoll(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || errno == ERANGE) {
+            error = "expected an integer";
+            return false;
+        }
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, int& value, std::string& error) {
+        long long v = 0;
+        if (!ParseSigned(text, v, error)) return false;
+        value = static_cast<int>(v);
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, uint16_t& value, std::string& error) {
+        long long v = 0;
+        if (!ParseSigned(text, v, error)) return false;
+        if (v < 0 || v > 65535) {
+            error = "expected a port number 0-65535";
+            return false;
+        }
+        value = static_cast<uint16_t>(v);
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, size_t& value, std::string& error) {
+        long long v = 0;
+        if (!ParseSigned(text, v, error)) return false;
+        if (v < 0) {
+            error = "expected a non-negative integer";
+            return false;
+        }
+        value = static_cast<size_t>(v);
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, double& value, std::string& error) {
+        char* end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        if (text.empty() || *end != '\0') {
+            error = "expected a number";
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Rep, typename Period>
+    static bool ParseValue(const std::string& text, std::chrono::duration<Rep, Period>& value, std::string& error) {
+        // 単位の省略は誤りとする (ms と s の取り違えを防ぐ)
+        size_t digits = 0;
+        while (digits < text.size() && (std::isdigit(static_cast<unsigned char>(text[digits])) || text[digits] == '.')) ++digits;
+        const std::string unit = text.substr(digits);
+        double scale_us = 0;
+        if (unit == "us") scale_us = 1;
+        else if (unit == "ms") scale_us = 1e3;
+        else if (unit == "s") scale_us = 1e6;
+        if (digits == 0 || scale_us == 0) {
+            error = "expected a duration with a unit (us, ms, s)";
+            return false;
+        }
+        const double us = std::strtod(text.substr(0, digits).c_str(), nullptr) * scale_us;
+        value = std::chrono::duration_cast<std::chrono::duration<Rep, Period>>(
+            std::chrono::duration<double, std::micro>(us));
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, std::vector<std::string>& value, std::string&) {
+        value.clear();
+        std::istringstream items(text);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            item = Trim(item);
+            if (!item.empty()) value.push_back(item);
+        }
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, std::vector<uint8_t>& value, std::string& error) {
+        if (text.size() % 2 != 0 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            error = "expected an even number of hex digits";
+            return false;
+        }
+        value.clear();
+        for (size_t i = 0; i < text.size(); i += 2) {
+            value.push_back(static_cast<uint8_t>(std::stoul(text.substr(i, 2), nullptr, 16)));
+        }
+        return true;
+    }
+
+    static bool ParseValue(const std::string& text, LogLevel& value, std::string& error) {
+        static const char* names[] = {"trace", "debug", "info", "warn", "error", "off"};
+        for (size_t i = 0; i < 6; ++i) {
+            if (text == names[i]) {
+                value = static_cast<LogLevel>(i);
+                return true;
+            }
+        }
+        error = "must be one of trace, debug, info, warn, error, off";
+        return false;
+    }
+
+    static std::string RenderValue(const std::string& value) { return value; }
+    static std::string RenderValue(bool value) { return value ? "true" : "false"; }
+    static std::string RenderValue(int value) { return std::to_string(value); }
+    static std::string RenderValue(uint16_t value) { return std::to_string(value); }
+    static std::string RenderValue(size_t value) { return std::to_string(value); }
+
+    static std::string RenderValue(double value) {
+        std::ostringstream os;
+        os << value;
+        return os.str();
+    }
+
+    template <typename Rep, typename Period>
+    static std::string RenderValue(const std::chrono::duration<Rep, Period>& value) {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+        if (us % 1000000 == 0 && us != 0) return std::to_string(us / 1000000) + "s";
+        if (us % 1000 == 0) return std::to_string(us / 1000) + "ms";
+        return std::to_string(us) + "us";
+    }
+
+    static std::string RenderValue(const std::vector<std::string>& value) { return Join(value); }
+
+    static std::string RenderValue(const std::vector<uint8_t>& value) {
+        static const char* digits = "0123456789abcdef";
+        std::string out;
+        for (uint8_t b : value) {
+            out += digits[b >> 4];
+            out += digits[b & 0x0F];
+        }
+        return out;
+    }
+
+    static std::string RenderValue(LogLevel value) {
+        static const char* names[] = {"trace", "debug", "info", "warn", "error", "off"};
+        return names[static_cast<size_t>(value)];
+    }
+};
+
+/**
+ * @brief 起動時に読み込んだ設定と、再読み込みで差し替わる調整値を保持する。
+ *
+ * Config() は起動時に検証した値で以降変わらないため、どのスレッドからもロックなしで参照できる。
+ * Tunables() は現在の調整値の組を返す。再読み込みは新しい組を作って1回のポインタの公開で差し替え、
+ * 古い組は破棄しない (読み手が参照中でも安全で、再読み込みの回数だけしか増えない)。
+ * 再起動が必要なキーの変更は適用せず、警告として報告する。
+ */
+class NodeConfigStore {
+public:
+    /// 調整値の差し替え後に呼ばれるハンドラ (再読み込みを行ったスレッドで呼ばれる)
+    using ReloadHandler = std::function<void(const NodeTunables&)>;
+
+    /**
+     * @brief 設定を読み込む
+     * @param path 設定ファイルのパス (Reload でも同じファイルを読む)
+     * @param overrides 上書き指定 (Reload でも同じものを適用する)
+     * @throw std::invalid_argument 読み込みまたは検証に失敗した場合
+     */
+    NodeConfigStore(std::string path, std::vector<std::string> overrides = {})
+        : path_(std::move(path)), overrides_(std::move(overrides)), config_(NodeConfigLoader::Load(path_, overrides_)) {
+        history_.push_back(std::make_unique<NodeTunables>(config_.tunables));
+        current_.store(history_.back().get(), std::memory_order_release);
+    }
+
+    /**
+     * @brief 起動時に確定した設定 (変更されない)
+     */
+    const NodeConfig& Config() const { return config_; }
+
+    /**
+     * @brief 現在の調整値 (ロックなし。返した参照はプロセス終了まで有効)
+     */
+    const NodeTunables& Tunables() const { return *current_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 調整値が差し替えられた回数
+     */
+    uint64_t Generation() const { return generation_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 調整値の差し替え時に呼ばれるハンドラを追加する (ロガーのレベルなど、コンポーネントへの反映用)
+     */
+    void OnReload(ReloadHandler handler) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handlers_.push_back(std::move(handler));
+    }
+
+    /**
+     * @brief 設定ファイルを読み直し、調整値を差し替える
+     * 読み込みや検証に失敗した場合は現在の値を維持する。
+     * @return 調整値を差し替えた場合はtrue
+     */
+    bool Reload() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        NodeConfig next;
+        try {
+            next = NodeConfigLoader::Load(path_, overrides_);
+        } catch (const std::exception& e) {
+            HCS_LOG_ERROR("NodeConfig", "Reload of {} failed; keeping the current configuration. {}", path_, e.what());
+            return false;
+        }
+        for (const auto& key : NodeConfigLoader::RestartRequiredChanges(config_, next)) {
+            HCS_LOG_WARN("NodeConfig", "{} changed in {} but requires a restart; the new value is ignored.", key, path_);
+        }
+        history_.push_back(std::make_unique<NodeTunables>(next.tunables));
+        current_.store(history_.back().get(), std::memory_order_release);
+        generation_.fetch_add(1, std::memory_order_relaxed);
+        for (const auto& handler : handlers_) handler(*history_.back());
+        HCS_LOG_INFO("NodeConfig", "Reloaded tunables from {} (generation {}).", path_, Generation());
+        return true;
+    }
+
+private:
+    const std::string path_;
+    const std::vector<std::string> overrides_;
+    const NodeConfig config_;
+    std::mutex mutex_; // 再読み込みとハンドラ登録を直列化する (読み手は取らない)
+    std::vector<std::unique_ptr<NodeTunables>> history_;
+    std::atomic<const NodeTunables*> current_{nullptr};
+    std::atomic<uint64_t> generation_{0};
+    std::vector<ReloadHandler> handlers_;
+};
+
+} // namespace hcs_common
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Metrics.h"
+
+namespace hcs_common {
+
+// --- パケットバッファの定数 ---
+constexpr size_t PACKET_BUFFER_SIZE = 2048;   ///< バッファ1つの容量 (MTU + 暗号化・ヘッダー拡張の余白)
+constexpr size_t PACKET_HEADROOM = 64;        ///< 先頭の余白 (IV やヘッダーを複製なしで前置するため)
+constexpr size_t PACKET_POOL_CHUNK = 256;     ///< プールが一度にヒープから確保するバッファ数
+
+/**
+ * @brief パケットバッファプールのメトリクス。ヒープ確保はプールの拡張時のみ行われるため、
+ * 定常状態で heap_allocations が増えないことがデータ経路のゼロアロケーションの指標となる。
+ */
+struct PacketPoolMetrics {
+    Counter& heap_allocations;
+    Gauge& buffers;
+
+    static PacketPoolMetrics& Get() {
+        auto& registry = MetricsRegistry::Instance();
+        static PacketPoolMetrics metrics{
+            registry.GetCounter("hcs_packet_pool_heap_allocations_total",
+                                "Heap allocations made by packet buffer pools (flat once warmed up)"),
+            registry.GetGauge("hcs_packet_pool_buffers", "Packet buffers owned by all pools"),
+        };
+        return metrics;
+    }
+};
+
+class PacketPool;
+
+/**
+ * @brief 固定長のパケットバッファ。先頭と末尾に余白を持ち、データ領域を複製せずに
+ * ヘッダーの前置 (Prepend) や末尾の追加 (Append)、先頭・末尾の除去 (Consume/Trim) ができる。
+ * 参照カウントは PacketRef が管理し、0 になると取得元のプールへ戻る。
+ */
+class PacketBuffer {
+public:
+    PacketBuffer() = default;
+    PacketBuffer(const PacketBuffer&) = delete;
+    PacketBuffer& operator=(const PacketBuffer&) = delete;
+
+    uint8_t* Data() { return storage_ + offset_; }
+    const uint8_t* Data() const { return storage_ + offset_; }
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+
+    /**
+     * @brief 先頭の余白 (Prepend できるバイト数)。
+     */
+    size_t Headroom() const { return offset_; }
+
+    /**
+     * @brief 末尾の余白 (Append できるバイト数)。
+     */
+    size_t Tailroom() const { return PACKET_BUFFER_SIZE - offset_ - size_; }
+
+    /**
+     * @brief 現在の先頭位置から書き込める最大サイズ (受信バッファとして使う場合)。
+     */
+    size_t Capacity() const { return PACKET_BUFFER_SIZE - offset_; }
+
+    /**
+     * @brief 先頭の余白を n バイト使ってデータ領域を前に広げる。
+     * @return 新しい先頭へのポインタ
+     * @throw std::length_error 余白が足りない場合
+     */
+    uint8_t* Prepend(size_t n) {
+        if (n > Headroom()) throw std::length_error("Packet headroom exhausted.");
+        offset_ -= static_cast<uint32_t>(n);
+        size_ += static_cast<uint32_t>(n);
+        return Data();
+    }
+
+    /**
+     * @brief 末尾の余白を n バイト使ってデータ領域を後ろに広げる。
+     * @return 追加した領域の先頭へのポインタ
+     * @throw std::length_error 余白が足りない場合
+     */
+    uint8_t* Append(size_t n) {
+        if (n > Tailroom()) throw std::length_error("Packet tailroom exhausted.");
+        uint8_t* tail = Data() + size_;
+        size_ += static_cast<uint32_t>(n);
+        return tail;
+    }
+
+    /**
+     * @brief 先頭から n バイトを取り除く (ヘッダーの除去)。
+     */
+    void Consume(size_t n) {
+        if (n > size_) throw std::length_error("Consume beyond packet size.");
+        offset_ += static_cast<uint32_t>(n);
+        size_ -= static_cast<uint32_t>(n);
+    }
+
+    /**
+     * @brief 末尾から n バイトを取り除く (トレーラーの除去)。
+     */
+    void Trim(size_t n) {
+        if (n > size_) throw std::length_error("Trim beyond packet size.");
+        size_ -= static_cast<uint32_t>(n);
+    }
+
+    /**
+     * @brief データサイズを設定する (受信後に受信バイト数を反映する場合など)。
+     * @throw std::length_error 容量を超える場合
+     */
+    void Resize(size_t n) {
+        if (n > Capacity()) throw std::length_error("Packet size exceeds buffer capacity.");
+        size_ = static_cast<uint32_t>(n);
+    }
+
+    /**
+     * @brief 他に参照がなく、データを書き換えてよいか。
+     */
+    bool Unique() const { return refs_.load(std::memory_order_acquire) == 1; }
+
+    /**
+     * @brief カーネルがこのデータグラムを受信した時刻 (単調時計のナノ秒、不明な場合は0)。
+     * SO_TIMESTAMPING が有効なトランスポートが受信時に設定し、バッファが再利用されるまで保持される。
+     */
+    int64_t ReceiveTimestamp() const { return rx_timestamp_ns_; }
+    void SetReceiveTimestamp(int64_t ns) { rx_timestamp_ns_ = ns; }
+
+private:
+    friend class PacketRef;
+    friend class PacketPool;
+
+    std::atomic<uint32_t> refs_{0};
+    PacketPool* owner_ = nullptr;   // 取得元のプール (プールはプロセス終了まで破棄されない)
+    PacketBuffer* next_ = nullptr;  // フリーリストのリンク
+    uint32_t offset_ = PACKET_HEADROOM;
+    uint32_t size_ = 0;
+    int64_t rx_timestamp_ns_ = 0;   // カーネルの受信時刻 (単調時計)
+    alignas(64) uint8_t storage_[PACKET_BUFFER_SIZE];
+};
+
+/**
+ * @brief PacketBuffer への参照カウント付きポインタ。複製は参照カウントの加算のみで、
+ * 最後の参照が破棄されるとバッファは取得元のプールへ戻る (どのスレッドで破棄してもよい)。
+ */
+class PacketRef {
+public:
+    PacketRef() = default;
+    PacketRef(const PacketRef& other) : buffer_(other.buffer_) {
+        if (buffer_) buffer_->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    PacketRef(PacketRef&& other) noexcept : buffer_(other.buffer_) { other.buffer_ = nullptr; }
+    PacketRef& operator=(PacketRef other) noexcept {
+        std::swap(buffer_, other.buffer_);
+        return *this;
+    }
+    ~PacketRef() { Reset(); }
+
+    PacketBuffer* operator->() const { return buffer_; }
+    PacketBuffer& operator*() const { return *buffer_; }
+    PacketBuffer* Get() const { return buffer_; }
+    explicit operator bool() const { return buffer_ != nullptr; }
+
+    /**
+     * @brief 参照を手放す。
+     */
+    inline void Reset();
+
+private:
+    friend class PacketPool;
+    explicit PacketRef(PacketBuffer* buffer) : buffer_(buffer) {}
+
+    PacketBuffer* buffer_ = nullptr;
+};
+
+/**
+ * @brief スレッドごとのパケットバッファプール。
+ *
+ * 取得と所有スレッドでの返却はスレッドローカルのフリーリストのみで完結し、
+ * 他スレッドからの返却はロックフリーのスタックに積まれて、所有スレッドが次に不足した際にまとめて回収する。
+ * バッファは所有スレッドが最初に書き込むため、NUMA 環境ではそのスレッドのノードのメモリに配置される。
+ * スレッド終了後もプールは破棄せず、未返却のバッファを保持したまま新しいスレッドに引き継ぐ。
+ */
+class PacketPool {
+public:
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    /**
+     * @brief 呼び出し元スレッドのプールを返す。
+     */
+    static PacketPool& Local() {
+        thread_local LocalHolder holder;
+        return *holder.pool;
+    }
+
+    /**
+     * @brief 空のバッファを取得する。
+     * @param headroom 先頭に確保する余白
+     */
+    PacketRef Acquire(size_t headroom = PACKET_HEADROOM) {
+        if (headroom > PACKET_BUFFER_SIZE) throw std::length_error("Packet headroom exceeds buffer size.");
+        PacketBuffer* buffer = free_;
+        if (!buffer) {
+            // 他スレッドが返却したバッファを回収し、それもなければヒープから拡張する
+            free_ = remote_free_.exchange(nullptr, std::memory_order_acquire);
+            if (!free_) Grow();
+            buffer = free_;
+        }
+        free_ = buffer->next_;
+        buffer->next_ = nullptr;
+        buffer->offset_ = static_cast<uint32_t>(headroom);
+        buffer->size_ = 0;
+        buffer->rx_timestamp_ns_ = 0;
+        buffer->refs_.store(1, std::memory_order_relaxed);
+        return PacketRef(buffer);
+    }
+
+    /**
+     * @brief 空きバッファが少なくとも n 個になるまでプールを拡張する (起動時の事前確保)。
+     * 呼び出し元スレッドのプールに確保するため、バッファを使う I/O スレッド上で呼ぶこと。
+     */
+    void Reserve(size_t n) {
+        size_t available = 0;
+        for (PacketBuffer* b = free_; b && available < n; b = b->next_) ++available;
+        for (; available < n; available += PACKET_POOL_CHUNK) Grow();
+    }
+
+    /**
+     * @brief データを複製したバッファを取得する。
+     * @throw std::length_error データが容量を超える場合
+     */
+    PacketRef CopyFrom(const uint8_t* data, size_t size, size_t headroom = PACKET_HEADROOM) {
+        PacketRef packet = Acquire(headroom);
+        std::memcpy(packet->Append(size), data, size);
+        return packet;
+    }
+
+private:
+    friend class PacketRef;
+
+    PacketBuffer* free_ = nullptr;                     // 所有スレッドのみが操作する
+    alignas(64) std::atomic<PacketBuffer*> remote_free_{nullptr}; // 他スレッドからの返却
+    std::vector<std::unique_ptr<PacketBuffer[]>> chunks_;
+    PacketPoolMetrics& metrics_ = PacketPoolMetrics::Get();
+
+    PacketPool() = default;
+
+    /**
+     * @brief スレッドとプールの対応。スレッド終了時にプールを再利用待ちへ戻す。
+     */
+    struct LocalHolder {
+        PacketPool* pool;
+        LocalHolder() : pool(Adopt()) { Owner() = pool; }
+        ~LocalHolder() {
+            Owner() = nullptr;
+            std::lock_guard<std::mutex> lock(RetiredMutex());
+            Retired().push_back(pool);
+        }
+    };
+
+    static PacketPool*& Owner() {
+        thread_local PacketPool* owner = nullptr;
+        return owner;
+    }
+
+    static std::mutex& RetiredMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<PacketPool*>& Retired() {
+        static auto* retired = new std::vector<PacketPool*>(); // 終了処理の順序に依存しないよう破棄しない
+        return *retired;
+    }
+
+    /**
+     * @brief 終了したスレッドのプールを引き継ぐか、新しいプールを作る (プールは破棄しない)。
+     */
+    static PacketPool* Adopt() {
+        {
+            std::lock_guard<std::mutex> lock(RetiredMutex());
+            if (!Retired().empty()) {
+                PacketPool* pool = Retired().back();
+                Retired().pop_back();
+                return pool;
+            }
+        }
+        return new PacketPool();
+    }
+
+    void Grow() {
+        std::unique_ptr<PacketBuffer[]> chunk(new PacketBuffer[PACKET_POOL_CHUNK]);
+        for (size_t i = 0; i < PACKET_POOL_CHUNK; ++i) {
+            chunk[i].owner_ = this;
+            chunk[i].next_ = (i + 1 < PACKET_POOL_CHUNK) ? &chunk[i + 1] : free_;
+        }
+        free_ = &chunk[0];
+        chunks_.push_back(std::move(chunk));
+        metrics_.heap_allocations.Add();
+        metrics_.buffers.Add(static_cast<int64_t>(PACKET_POOL_CHUNK));
+    }
+
+    void Release(PacketBuffer* buffer) {
+        if (Owner() == this) {
+            buffer->next_ = free_;
+            free_ = buffer;
+            return;
+        }
+        // 他スレッドからの返却: 所有スレッドは exchange で一括回収するため ABA は起きない
+        PacketBuffer* head = remote_free_.load(std::memory_order_relaxed);
+        do {
+            buffer->next_ = head;
+        } while (!remote_free_.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+    }
+};
+
+inline void PacketRef::Reset() {
+    if (!buffer_) return;
+    if (buffer_->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) buffer_->owner_->Release(buffer_);
+    buffer_ = nullptr;
+}
+
+} // namespace hcs_common
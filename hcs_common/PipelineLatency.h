@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include "Metrics.h"
+
+namespace hcs_common {
+
+/**
+ * @brief メディアパイプラインの段 (各段の遅延は直前の段の完了からの経過時間)。
+ *
+ * 送信側: キャプチャ → kEncode → kPacketize → kEncrypt → kSocketSend
+ * 受信側: 受信 (カーネル) → kSocketReceive → kDecrypt → kJitterBuffer → kFrameComplete
+ * kNetwork は送信側のキャプチャ時刻 (RTP タイムスタンプ) から受信までの時間で、
+ * ノード間の時計が同期している (NTP/PTP) ことを前提とする。
+ * カーネルのタイムスタンプ (SO_TIMESTAMPING) が得られる場合、kSocketSend は NIC への受け渡しまで、
+ * 受信側の起点はカーネルの受信時刻となり、リアクタの待ち時間は kSocketReceive に分離される。
+ */
+enum class PipelineStage : uint8_t {
+    kEncode,        ///< キャプチャ → エンコード完了
+    kPacketize,     ///< エンコード完了 → RTP パケット化 (制御メッセージの相乗りを含む)
+    kEncrypt,       ///< パケット化 → 暗号化完了
+    kSocketSend,    ///< 暗号化完了 → ソケット送信完了 (カーネルの送信時刻が得られる場合はその時刻)
+    kNetwork,       ///< キャプチャ (送信ノード) → ソケット受信 (受信ノード)
+    kSocketReceive, ///< カーネルの受信時刻 → 受信ハンドラの開始 (リアクタの待ち時間。カーネルの時刻がない場合は記録しない)
+    kDecrypt,       ///< 受信ハンドラの開始 → 復号・認証完了
+    kJitterBuffer,  ///< 復号完了 → ジッタバッファからの払い出し
+    kFrameComplete, ///< ジッタバッファ → フレーム完成 (デコーダへの投入)
+    kCount
+};
+
+constexpr size_t PIPELINE_STAGE_COUNT = static_cast<size_t>(PipelineStage::kCount);
+constexpr uint32_t MEDIA_CLOCK_RATE = 90000;                ///< 映像 RTP タイムスタンプのクロック (90kHz)
+constexpr int64_t NETWORK_LATENCY_LIMIT_NS = 10'000'000'000; ///< これを超える kNetwork は時計のずれとみなして記録しない
+
+/**
+ * @brief パイプライン各段の遅延分布 (プロセス共通)。
+ * 段ごとに MetricsRegistry の summary "hcs_pipeline_stage_latency_seconds{stage=...}" を持つ。
+ */
+class PipelineLatency {
+public:
+    /**
+     * @brief 段の遅延を記録する。
+     */
+    static void Record(PipelineStage stage, int64_t nanoseconds) {
+        Histograms()[static_cast<size_t>(stage)]->Record(nanoseconds);
+    }
+
+    /**
+     * @brief 段の遅延分布を返す。
+     */
+    static LatencyHistogram& Stage(PipelineStage stage) {
+        return *Histograms()[static_cast<size_t>(stage)];
+    }
+
+    static const char* StageName(PipelineStage stage) {
+        switch (stage) {
+            case PipelineStage::kEncode:        return "encode";
+            case PipelineStage::kPacketize:     return "packetize";
+            case PipelineStage::kEncrypt:       return "encrypt";
+            case PipelineStage::kSocketSend:    return "socket_send";
+            case PipelineStage::kNetwork:       return "network";
+            case PipelineStage::kSocketReceive: return "socket_receive";
+            case PipelineStage::kDecrypt:       return "decrypt";
+            case PipelineStage::kJitterBuffer:  return "jitter_buffer";
+            case PipelineStage::kFrameComplete: return "frame_complete";
+            default:                            return "unknown";
+        }
+    }
+
+    /**
+     * @brief 単調時計の現在時刻 (ナノ秒)。段の遅延計測に用いる。
+     */
+    static int64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief 実時刻を 90kHz の RTP タイムスタンプに変換した値 (ノード間で比較するため壁時計を用いる)。
+     */
+    static uint32_t MediaClockNow() {
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+        return static_cast<uint32_t>(static_cast<uint64_t>(us) * MEDIA_CLOCK_RATE / 1'000'000);
+    }
+
+    /**
+     * @brief 受信した RTP タイムスタンプ (送信側のキャプチャ時刻) から kNetwork を記録する。
+     * 時計が同期していない (負値や上限超過) と判断した場合は記録しない。
+     * @param capture_rtp_timestamp 送信側のキャプチャ時刻
+     * @param received_ns カーネルの受信時刻 (単調時計)。0 の場合は現在時刻を受信時刻とする
+     */
+    static void RecordNetwork(uint32_t capture_rtp_timestamp, int64_t received_ns = 0) {
+        uint32_t received = MediaClockNow();
+        if (received_ns != 0) {
+            // 受信からの経過時間だけ遡る (リアクタの待ち時間を kNetwork に含めない)
+            const int64_t waited_ns = std::max<int64_t>(0, NowNs() - received_ns);
+            received -= static_cast<uint32_t>(waited_ns * MEDIA_CLOCK_RATE / 1'000'000'000);
+        }
+        const int32_t ticks = static_cast<int32_t>(received - capture_rtp_timestamp);
+        const int64_t ns = static_cast<int64_t>(ticks) * 1'000'000'000 / MEDIA_CLOCK_RATE;
+        if (ns < 0 || ns > NETWORK_LATENCY_LIMIT_NS) return;
+        Record(PipelineStage::kNetwork, ns);
+    }
+
+private:
+    static std::array<LatencyHistogram*, PIPELINE_STAGE_COUNT>& Histograms() {
+        static std::array<LatencyHistogram*, PIPELINE_STAGE_COUNT> histograms = [] {
+            std::array<LatencyHistogram*, PIPELINE_STAGE_COUNT> h{};
+            auto& registry = MetricsRegistry::Instance();
+            for (size_t i = 0; i < PIPELINE_STAGE_COUNT; ++i) {
+                h[i] = &registry.GetLatencySummary(
+                    "hcs_pipeline_stage_latency_seconds", "Latency of each media pipeline stage",
+                    std::string("stage=\"") + StageName(static_cast<PipelineStage>(i)) + "\"");
+            }
+            return h;
+        }();
+        return histograms;
+    }
+};
+
+/**
+ * @brief パケットに付随する段ごとのタイムスタンプ。
+ * パケットと一緒に受け渡し、各段の完了時に Mark() を呼ぶと直前の段からの経過時間が記録される。
+ */
+struct PacketTiming {
+    std::array<int64_t, PIPELINE_STAGE_COUNT> marked_at{}; // 段ごとの完了時刻 (未通過は0)
+    int64_t last_ns = 0;                                   // 直前の段の完了時刻 (単調時計)
+    int64_t received_ns = 0;                               // ソケットでの受信時刻 (カーネルの時刻があればその時刻)
+
+    /**
+     * @brief 計測を開始する (キャプチャ時またはソケット受信時)。
+     */
+    void Begin() { last_ns = PipelineLatency::NowNs(); }
+
+    /**
+     * @brief ソケット受信時に計測を開始する。
+     * カーネルの受信時刻があればそこを起点とし、受信ハンドラまでの待ち時間を kSocketReceive に記録する。
+     * @param kernel_ns カーネルの受信時刻 (単調時計、不明な場合は0)
+     */
+    void BeginReceive(int64_t kernel_ns) {
+        if (kernel_ns == 0) {
+            Begin();
+            received_ns = last_ns;
+            return;
+        }
+        last_ns = kernel_ns;
+        received_ns = kernel_ns;
+        Mark(PipelineStage::kSocketReceive);
+    }
+
+    bool Started() const { return last_ns != 0; }
+
+    /**
+     * @brief 段の完了を記録する。Begin() 前の呼び出しは無視する。
+     */
+    void Mark(PipelineStage stage) {
+        if (!Started()) return;
+        const int64_t now = PipelineLatency::NowNs();
+        PipelineLatency::Record(stage, now - last_ns);
+        marked_at[static_cast<size_t>(stage)] = now;
+        last_ns = now;
+    }
+};
+
+/**
+ * @brief 同期呼び出しの間、処理中パケットのタイミングを下位層へ受け渡す。
+ *
+ * 受信時刻のようにパケットより長く参照する値は PacketBuffer (ReceiveTimestamp) に持たせ、
+ * 段ごとの時刻はエンコーダ → 暗号化、復号 → デコーダの同期呼び出しの間だけ
+ * スレッドローカルに公開する。SealPacket/OpenPacket がバッファを複製する経路や、
+ * バイト列を受け取る制御トランスポートのハンドラからも同じ方法で参照できる。
+ * 非同期の完了ハンドラへ持ち越す場合は、PacketTiming をコピーしてキャプチャすること。
+ */
+class ScopedPacketTiming {
+public:
+    explicit ScopedPacketTiming(PacketTiming& timing) : previous_(Slot()) { Slot() = &timing; }
+    ~ScopedPacketTiming() { Slot() = previous_; }
+
+    ScopedPacketTiming(const ScopedPacketTiming&) = delete;
+    ScopedPacketTiming& operator=(const ScopedPacketTiming&) = delete;
+
+    /**
+     * @brief 呼び出し元スレッドで処理中のパケットのタイミングを返す (なければ nullptr)。
+     */
+    static PacketTiming* Current() { return Slot(); }
+
+private:
+    PacketTiming* previous_;
+
+    static PacketTiming*& Slot() {
+        thread_local PacketTiming* current = nullptr;
+        return current;
+    }
+};
+
+} // namespace hcs_common
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// トレースの埋め込みをコンパイル時に有効にするか。0 の場合 HCS_TRACE_* マクロは何も生成しない。
+#ifndef HCS_TRACING
+#define HCS_TRACING 1
+#endif
+
+namespace hcs_common {
+
+// --- トレースの定数 ---
+constexpr size_t TRACE_RING_CAPACITY = 8192;   ///< スレッドごとに保持する直近のイベント数 (2の冪)
+constexpr size_t TRACE_MAX_RETIRED_RINGS = 32; ///< 終了したスレッドのリングを出力用に残す数
+
+static_assert((TRACE_RING_CAPACITY & (TRACE_RING_CAPACITY - 1)) == 0, "TRACE_RING_CAPACITY must be a power of two");
+
+/**
+ * @brief トレースイベントの種類 (Chrome trace event format の ph)。
+ */
+enum class TracePhase : uint8_t {
+    kComplete = 'X', ///< 開始時刻と所要時間を持つ区間
+    kInstant = 'i',  ///< 時点のみのイベント
+};
+
+/**
+ * @brief 出力用に複製したトレースイベント。
+ * name と category は文字列リテラル (プロセスの終了まで有効なポインタ) であること。
+ */
+struct TraceEvent {
+    int64_t begin_ns = 0;     ///< steady_clock の開始時刻
+    int64_t duration_ns = 0;  ///< kComplete の所要時間
+    const char* name = nullptr;
+    const char* category = nullptr;
+    uint64_t id = 0;          ///< パケット・フレームなどの識別子 (0 は無し)
+    TracePhase phase = TracePhase::kComplete;
+};
+
+/**
+ * @brief 1スレッド専用の上書き型リングバッファ (フライトレコーダー)。
+ *
+ * 書き込み側 (トレースするスレッド) はロックを取らず、満杯時は最古のイベントを上書きする。
+ * 各スロットの値はアトミック変数 (relaxed) に格納するため、出力スレッドは書き込み中でも読み出せる。
+ * 読み出し中に上書きされた可能性のあるイベントは、読み出し後に書き込み位置を再確認して捨てる。
+ */
+class TraceRing {
+public:
+    explicit TraceRing(uint32_t thread_id) : thread_id_(thread_id) {}
+
+    void Push(const TraceEvent& event) {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[head & (TRACE_RING_CAPACITY - 1)];
+        slot.begin_ns.store(event.begin_ns, std::memory_order_relaxed);
+        slot.duration_ns.store(event.duration_ns, std::memory_order_relaxed);
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.category.store(event.category, std::memory_order_relaxed);
+        slot.id.store(event.id, std::memory_order_relaxed);
+        slot.phase.store(static_cast<uint8_t>(event.phase), std::memory_order_relaxed);
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief 保持しているイベントを古い順に複製する (任意のスレッドから呼べる)。
+     */
+    void Snapshot(std::vector<TraceEvent>& out) const {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        const uint64_t first = head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+        const size_t base = out.size();
+        for (uint64_t i = first; i < head; ++i) {
+            const Slot& slot = slots_[i & (TRACE_RING_CAPACITY - 1)];
+            TraceEvent event;
+            event.begin_ns = slot.begin_ns.load(std::memory_order_relaxed);
+            event.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.category = slot.category.load(std::memory_order_relaxed);
+            event.id = slot.id.load(std::memory_order_relaxed);
+            event.phase = static_cast<TracePhase>(slot.phase.load(std::memory_order_relaxed));
+            out.push_back(event);
+        }
+        // 読み出し中に書き込み側が追い越したスロットは内容が混在しうるため捨てる
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t head_after = head_.load(std::memory_order_relaxed);
+        const uint64_t valid_from = head_after > TRACE_RING_CAPACITY ? head_after - TRACE_RING_CAPACITY : 0;
+        if (valid_from > first) {
+            const size_t overwritten = static_cast<size_t>(std::min<uint64_t>(valid_from - first, head - first));
+            out.erase(out.begin() + static_cast<std::ptrdiff_t>(base),
+                      out.begin() + static_cast<std::ptrdiff_t>(base + overwritten));
+        }
+    }
+
+    uint32_t ThreadId() const { return thread_id_; }
+
+    void SetThreadName(std::string name) {
+        std::lock_guard<std::mutex> lock(name_mutex_);
+        thread_name_ = std::move(name);
+    }
+
+    std::string ThreadName() const {
+        std::lock_guard<std::mutex> lock(name_mutex_);
+        return thread_name_;
+    }
+
+    void Retire() { retired_.store(true, std::memory_order_release); }
+    bool IsRetired() const { return retired_.load(std::memory_order_acquire); }
+
+private:
+    struct Slot {
+        std::atomic<int64_t> begin_ns{0};
+        std::atomic<int64_t> duration_ns{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<const char*> category{nullptr};
+        std::atomic<uint64_t> id{0};
+        std::atomic<uint8_t> phase{0};
+    };
+
+    alignas(64) std::atomic<uint64_t> head_{0};
+    const uint32_t thread_id_;
+    std::atomic<bool> retired_{false};
+    mutable std::mutex name_mutex_;  // スレッド名の設定・出力時のみ
+    std::string thread_name_;
+    std::vector<Slot> slots_ = std::vector<Slot>(TRACE_RING_CAPACITY);
+};
+
+/**
+ * @brief プロセス共通のトレーサー。
+ *
+ * 区間 (HCS_TRACE_SPAN) と時点 (HCS_TRACE_INSTANT) のイベントをスレッドごとのリングに記録し、
+ * Chrome trace event format の JSON (chrome://tracing / Perfetto で表示) として出力する。
+ * 既定では無効で、無効時のイベント記録のコストはアトミック変数の読み出し1回。
+ * リングは直近のイベントのみを保持するため、有効にしたまま常時運用し、必要な時に出力できる。
+ */
+class Tracer {
+public:
+    static Tracer& Instance() {
+        static Tracer instance;
+        return instance;
+    }
+
+    /**
+     * @brief 記録の有効/無効を切り替える。
+     */
+    static void SetEnabled(bool enabled) { EnabledFlag().store(enabled, std::memory_order_relaxed); }
+
+    static bool Enabled() { return EnabledFlag().load(std::memory_order_relaxed); }
+
+    static int64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief 呼び出し元スレッドのリングにイベントを記録する (Enabled() の確認は呼び出し元で行う)。
+     */
+    void Record(const TraceEvent& event) { LocalRing().Push(event); }
+
+    /**
+     * @brief 呼び出し元スレッドの表示名を設定する (タイムライン上の行の名前)。
+     */
+    void SetThreadName(const std::string& name) { LocalRing().SetThreadName(name); }
+
+    /**
+     * @brief 全スレッドの直近のイベントを Chrome trace event format の JSON で書き出す。
+     * 記録中でも呼び出せる (出力中に上書きされたイベントは含まれない)。
+     */
+    void WriteChromeTrace(std::ostream& out) {
+        std::vector<std::shared_ptr<TraceRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            rings = rings_;
+        }
+
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        auto separator = [&]() {
+            if (!first) out << ",\n";
+            first = false;
+        };
+        std::vector<TraceEvent> events;
+        char buf[64];
+        for (const auto& ring : rings) {
+            const uint32_t tid = ring->ThreadId();
+            const std::string thread_name = ring->ThreadName();
+            separator();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"";
+            AppendEscaped(out, thread_name.empty() ? "thread-" + std::to_string(tid) : thread_name);
+            out << "\"}}";
+
+            events.clear();
+            ring->Snapshot(events);
+            for (const auto& event : events) {
+                if (!event.name) continue;
+                separator();
+                out << "{\"ph\":\"" << static_cast<char>(event.phase) << "\",\"name\":\"";
+                AppendEscaped(out, event.name);
+                out << "\",\"cat\":\"";
+                AppendEscaped(out, event.category ? event.category : "");
+                // ts/dur はマイクロ秒 (小数点以下でナノ秒を表す)
+                std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(event.begin_ns) / 1e3);
+                out << "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << buf;
+                if (event.phase == TracePhase::kComplete) {
+                    std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(event.duration_ns) / 1e3);
+                    out << ",\"dur\":" << buf;
+                } else {
+                    out << ",\"s\":\"t\"";
+                }
+                if (event.id != 0) out << ",\"args\":{\"id\":" << event.id << "}";
+                out << "}";
+            }
+        }
+        out << "]}\n";
+    }
+
+    /**
+     * @brief WriteChromeTrace の結果を文字列で返す (HTTP での公開用)。
+     */
+    std::string RenderChromeTrace() {
+        std::ostringstream out;
+        WriteChromeTrace(out);
+        return out.str();
+    }
+
+    /**
+     * @brief WriteChromeTrace の結果をファイルに書き出す。
+     * @return 書き込みに成功した場合はtrue
+     */
+    bool WriteChromeTraceFile(const std::string& path) {
+        std::ofstream file(path, std::ios::out | std::ios::trunc);
+        if (!file) return false;
+        WriteChromeTrace(file);
+        return static_cast<bool>(file.flush());
+    }
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+private:
+    std::mutex registry_mutex_;
+    std::vector<std::shared_ptr<TraceRing>> rings_;
+    uint32_t next_thread_id_ = 1;
+
+    Tracer() = default;
+
+    static std::atomic<bool>& EnabledFlag() {
+        static std::atomic<bool> enabled{false};
+        return enabled;
+    }
+
+    /**
+     * @brief 自スレッドのリングを返す。初回のみレジストリへ登録する。
+     * 終了したスレッドのリングは TRACE_MAX_RETIRED_RINGS 個まで出力用に残す。
+     */
+    TraceRing& LocalRing() {
+        struct Holder {
+            std::shared_ptr<TraceRing> ring;
+            ~Holder() { if (ring) ring->Retire(); }
+        };
+        thread_local Holder holder;
+        if (!holder.ring) {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            holder.ring = std::make_shared<TraceRing>(next_thread_id_++);
+            size_t retired = static_cast<size_t>(std::count_if(rings_.begin(), rings_.end(),
+                [](const std::shared_ptr<TraceRing>& ring) { return ring->IsRetired(); }));
+            for (auto it = rings_.begin(); retired > TRACE_MAX_RETIRED_RINGS && it != rings_.end();) {
+                if ((*it)->IsRetired()) {
+                    it = rings_.erase(it);
+                    --retired;
+                } else {
+                    ++it;
+                }
+            }
+            rings_.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    static void AppendEscaped(std::ostream& out, const std::string& text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+            else out << c;
+        }
+    }
+};
+
+/**
+ * @brief スコープの開始から終了までを1つの区間として記録する (HCS_TRACE_SPAN から使う)。
+ * 無効時は開始時刻も取得しない。
+ */
+class ScopedTraceSpan {
+public:
+    ScopedTraceSpan(const char* category, const char* name, uint64_t id = 0) {
+        if (!Tracer::Enabled()) return;
+        event_.category = category;
+        event_.name = name;
+        event_.id = id;
+        event_.begin_ns = Tracer::NowNs();
+    }
+
+    ~ScopedTraceSpan() {
+        if (!event_.name) return;
+        event_.duration_ns = Tracer::NowNs() - event_.begin_ns;
+        Tracer::Instance().Record(event_);
+    }
+
+    /**
+     * @brief 区間の識別子を後から設定する (復号後に判明するシーケンス番号など)。
+     */
+    void SetId(uint64_t id) { event_.id = id; }
+
+    ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+    ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+private:
+    TraceEvent event_;
+};
+
+/**
+ * @brief 時点のイベントを記録する (HCS_TRACE_INSTANT から使う)。
+ */
+inline void TraceInstant(const char* category, const char* name, uint64_t id = 0) {
+    if (!Tracer::Enabled()) return;
+    TraceEvent event;
+    event.begin_ns = Tracer::NowNs();
+    event.name = name;
+    event.category = category;
+    event.id = id;
+    event.phase = TracePhase::kInstant;
+    Tracer::Instance().Record(event);
+}
+
+} // namespace hcs_common
+
+#define HCS_TRACE_CONCAT_INNER(a, b) a##b
+#define HCS_TRACE_CONCAT(a, b) HCS_TRACE_CONCAT_INNER(a, b)
+
+#if HCS_TRACING
+/**
+ * @brief 現在のスコープを区間として記録する。
+ * @code
+ * HCS_TRACE_SPAN("net", "udp.send", seq);
+ * @endcode
+ * category と name は文字列リテラルであること。id (省略可) はパケット・フレームの識別子。
+ */
+#define HCS_TRACE_SPAN(category, name, ...) \
+    ::hcs_common::ScopedTraceSpan HCS_TRACE_CONCAT(hcs_trace_span_, __LINE__)(category, name, ##__VA_ARGS__)
+/**
+ * @brief 名前付きの区間 (SetId で識別子を後から設定する場合)。
+ */
+#define HCS_TRACE_SPAN_NAMED(var, category, name, ...) \
+    ::hcs_common::ScopedTraceSpan var(category, name, ##__VA_ARGS__)
+#define HCS_TRACE_SET_ID(var, id) (var).SetId(id)
+#define HCS_TRACE_INSTANT(category, name, ...) ::hcs_common::TraceInstant(category, name, ##__VA_ARGS__)
+#else
+#define HCS_TRACE_SPAN(category, name, ...) do {} while (0)
+#define HCS_TRACE_SPAN_NAMED(var, category, name, ...) do {} while (0)
+#define HCS_TRACE_SET_ID(var, id) do {} while (0)
+#define HCS_TRACE_INSTANT(category, name, ...) do {} while (0)
+#endif
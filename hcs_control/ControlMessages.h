@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TopologyManager.h"
+
+// 制御メッセージタイプ定義 (先頭1バイト)。多バイト整数はビッグエンディアンで格納する
+// ADVERTISE: [type][hop_count:u8][bandwidth:u16][stability:u16][group_count:u8] の後にグループごとに
+//   [group_len:u8][group_id][hops:u8] と、経路があれば [seq:u32][path_count:u8]([ip_len:u8][ip])* を続ける
+#define MSG_TYPE_ADVERTISE 1
+#define MSG_TYPE_HEARTBEAT 2   // [type][group_id...] (親から子へ。メディアに相乗りする)
+#define MSG_TYPE_JOIN 3        // [type][media_port:u16][layer_mask:u32][group_id...]
+#define MSG_TYPE_LEAVE 4       // [type][media_port:u16][group_id...]
+#define MSG_TYPE_PROBE 5       // [type][seq:u32][t1:i64] (RttProbe)
+#define MSG_TYPE_PROBE_REPLY 6 // [type][seq:u32][t1:i64][t2:i64][t3:i64]
+#define MSG_TYPE_DEPARTING 7   // [type][group_len:u8][group_id][count:u8]([ip_len:u8][ip])* (停止の予告と代わりの親)
+
+namespace hcs_control {
+
+constexpr uint8_t ADVERTISE_NO_ROUTE = 0xFF; ///< hops の値: 送信元への経路を持たない (seq・path を続けない)
+constexpr size_t JOIN_HEADER_SIZE = 7;       ///< JOIN のグループIDより前の長さ [type][media_port][layer_mask]
+constexpr size_t LEAVE_HEADER_SIZE = 3;      ///< LEAVE のグループIDより前の長さ [type][media_port]
+
+namespace detail {
+
+inline void PutU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void PutU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(value >> shift));
+}
+
+/**
+ * @brief [len:u8][bytes] の文字列を書き込む。
+ * @return 255 バイトを超える場合は書き込まずにfalse
+ */
+inline bool PutString(std::vector<uint8_t>& out, const std::string& text) {
+    if (text.size() > UINT8_MAX) return false;
+    out.push_back(static_cast<uint8_t>(text.size()));
+    out.insert(out.end(), text.begin(), text.end());
+    return true;
+}
+
+inline uint8_t ClampU8(int value) {
+    return static_cast<uint8_t>(std::clamp(value, 0, static_cast<int>(UINT8_MAX)));
+}
+
+inline uint16_t ClampU16(int value) {
+    return static_cast<uint16_t>(std::clamp(value, 0, static_cast<int>(UINT16_MAX)));
+}
+
+/**
+ * @brief 境界を確認しながらメッセージを先頭から読み出す。
+ */
+class Reader {
+public:
+    Reader(const std::vector<uint8_t>& message, size_t pos) : message_(message), pos_(pos) {}
+
+    bool U8(uint8_t& out) {
+        if (pos_ + 1 > message_.size()) return false;
+        out = message_[pos_++];
+        return true;
+    }
+
+    bool U16(uint16_t& out) {
+        if (pos_ + 2 > message_.size()) return false;
+        out = static_cast<uint16_t>((message_[pos_] << 8) | message_[pos_ + 1]);
+        pos_ += 2;
+        return true;
+    }
+
+    bool U32(uint32_t& out) {
+        if (pos_ + 4 > message_.size()) return false;
+        out = 0;
+        for (size_t i = 0; i < 4; ++i) out = (out << 8) | message_[pos_ + i];
+        pos_ += 4;
+        return true;
+    }
+
+    bool String(std::string& out) {
+        uint8_t len = 0;
+        if (!U8(len) || pos_ + len > message_.size()) return false;
+        out.assign(message_.begin() + pos_, message_.begin() + pos_ + len);
+        pos_ += len;
+        return true;
+    }
+
+    bool AtEnd() const { return pos_ == message_.size(); }
+
+private:
+    const std::vector<uint8_t>& message_;
+    size_t pos_;
+};
+
+} // namespace detail
+
+/**
+ * @brief ADVERTISE を組み立てる。
+ * 送信元IPと RTT は受信側が決める (送信元アドレスと自ノードの計測値) ため含めない。
+ * 255 バイトを超えるグループID・アドレスを含むグループは通知しない。
+ * @param msg TopologyManager::BuildAdvertise の結果
+ */
+inline std::vector<uint8_t> EncodeAdvertise(const AdvertiseMessage& msg) {
+    std::vector<uint8_t> out{MSG_TYPE_ADVERTISE, detail::ClampU8(msg.metrics.hop_count)};
+    detail::PutU16(out, detail::ClampU16(msg.metrics.bandwidth_score));
+    detail::PutU16(out, detail::ClampU16(msg.metrics.stability_score));
+    const size_t count_pos = out.size();
+    out.push_back(0);
+
+    for (const auto& gid : msg.groups) {
+        if (out[count_pos] == UINT8_MAX) break;
+        const size_t group_start = out.size();
+        bool ok = detail::PutString(out, gid);
+        auto route = msg.routes.find(gid);
+        if (ok && (route == msg.routes.end() || route->second.hops_to_source < 0 ||
+                   route->second.hops_to_source >= ADVERTISE_NO_ROUTE || route->second.path.empty() ||
+                   route->second.path.size() > UINT8_MAX)) {
+            out.push_back(ADVERTISE_NO_ROUTE);
+        } else if (ok) {
+            out.push_back(static_cast<uint8_t>(route->second.hops_to_source));
+            detail::PutU32(out, route->second.source_seq);
+            out.push_back(static_cast<uint8_t>(route->second.path.size()));
+            for (const auto& ip : route->second.path) ok = ok && detail::PutString(out, ip);
+        }
+        if (!ok) {
+            out.resize(group_start);
+            continue;
+        }
+        ++out[count_pos];
+    }
+    return out;
+}
+
+/**
+ * @brief ADVERTISE を解析する。送信元IP (msg.ip) と RTT は呼び出し側で設定する。
+ * @return 形式が正しければtrue
+ */
+inline bool DecodeAdvertise(const std::vector<uint8_t>& message, AdvertiseMessage& msg) {
+    if (message.empty() || message[0] != MSG_TYPE_ADVERTISE) return false;
+    detail::Reader reader(message, 1);
+    uint8_t hop_count = 0, group_count = 0;
+    uint16_t bandwidth = 0, stability = 0;
+    if (!reader.U8(hop_count) || !reader.U16(bandwidth) || !reader.U16(stability) || !reader.U8(group_count)) {
+        return false;
+    }
+    msg.metrics.hop_count = hop_count;
+    msg.metrics.bandwidth_score = bandwidth;
+    msg.metrics.stability_score = stability;
+
+    for (uint8_t g = 0; g < group_count; ++g) {
+        std::string gid;
+        uint8_t hops = 0;
+        if (!reader.String(gid) || gid.empty() || !reader.U8(hops)) return false;
+        msg.groups.insert(gid);
+        if (hops == ADVERTISE_NO_ROUTE) continue;
+
+        GroupRoute route;
+        route.hops_to_source = hops;
+        uint8_t path_count = 0;
+        if (!reader.U32(route.source_seq) || !reader.U8(path_count) || path_count == 0) return false;
+        route.path.resize(path_count);
+        for (auto& ip : route.path) {
+            if (!reader.String(ip)) return false;
+        }
+        msg.routes[gid] = std::move(route);
+    }
+    return reader.AtEnd();
+}
+
+/**
+ * @brief JOIN (子ノードの購読登録) を組み立てる。
+ * @param media_port 子ノードがメディアを受信するポート
+ * @param layer_mask 受信するレイヤーのビットマスク
+ * @param group_id グループID
+ */
+inline std::vector<uint8_t> EncodeJoin(uint16_t media_port, uint32_t layer_mask, const std::string& group_id) {
+    std::vector<uint8_t> join;
+    join.reserve(JOIN_HEADER_SIZE + group_id.size());
+    join.push_back(MSG_TYPE_JOIN);
+    detail::PutU16(join, media_port);
+    detail::PutU32(join, layer_mask);
+    join.insert(join.end(), group_id.begin(), group_id.end());
+    return join;
+}
+
+/**
+ * @brief JOIN を解析する。
+ * @return 形式が正しく、グループIDが空でなければtrue
+ */
+inline bool DecodeJoin(const std::vector<uint8_t>& message, uint16_t& media_port, uint32_t& layer_mask,
+                       std::string& group_id) {
+    if (message.size() <= JOIN_HEADER_SIZE || message[0] != MSG_TYPE_JOIN) return false;
+    detail::Reader reader(message, 1);
+    reader.U16(media_port);
+    reader.U32(layer_mask);
+    group_id.assign(message.begin() + JOIN_HEADER_SIZE, message.end());
+    return true;
+}
+
+/**
+ * @brief LEAVE (子ノードの購読解除) を組み立てる。
+ * @param media_port JOIN で通知したメディア受信ポート (親は送信元アドレスとこのポートで購読を特定する)
+ * @param group_id グループID
+ */
+inline std::vector<uint8_t> EncodeLeave(uint16_t media_port, const std::string& group_id) {
+    std::vector<uint8_t> leave;
+    leave.reserve(LEAVE_HEADER_SIZE + group_id.size());
+    leave.push_back(MSG_TYPE_LEAVE);
+    detail::PutU16(leave, media_port);
+    leave.insert(leave.end(), group_id.begin(), group_id.end());
+    return leave;
+}
+
+/**
+ * @brief LEAVE を解析する。
+ * @return 形式が正しく、グループIDが空でなければtrue
+ */
+inline bool DecodeLeave(const std::vector<uint8_t>& message, uint16_t& media_port, std::string& group_id) {
+    if (message.size() <= LEAVE_HEADER_SIZE || message[0] != MSG_TYPE_LEAVE) return false;
+    detail::Reader reader(message, 1);
+    reader.U16(media_port);
+    group_id.assign(message.begin() + LEAVE_HEADER_SIZE, message.end());
+    return true;
+}
+
+/**
+ * @brief DEPARTING を組み立てる (255 バイトを超えるグループID・アドレスは含めない)。
+ * @param group_id 停止するノードが中継しているグループID
+ * @param recommended 代わりの親の候補 (先頭ほど推奨度が高い)
+ */
+inline std::vector<uint8_t> EncodeDeparting(const std::string& group_id, const std::vector<std::string>& recommended) {
+    std::vector<uint8_t> message{MSG_TYPE_DEPARTING};
+    detail::PutString(message, group_id);
+    const size_t count_pos = message.size();
+    message.push_back(0);
+    for (const auto& ip : recommended) {
+        if (message[count_pos] == UINT8_MAX || !detail::PutString(message, ip)) continue;
+        ++message[count_pos];
+    }
+    return message;
+}
+
+/**
+ * @brief DEPARTING を解析する。
+ * @return 形式が正しければtrue
+ */
+inline bool DecodeDeparting(const std::vector<uint8_t>& message, std::string& group_id,
+                            std::vector<std::string>& recommended) {
+    if (message.empty() || message[0] != MSG_TYPE_DEPARTING) return false;
+    detail::Reader reader(message, 1);
+    uint8_t count = 0;
+    if (!reader.String(group_id) || group_id.empty() || !reader.U8(count)) return false;
+    recommended.resize(count);
+    for (auto& ip : recommended) {
+        if (!reader.String(ip)) return false;
+    }
+    return reader.AtEnd();
+}
+
+} // namespace hcs_control
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace hcs_control {
+
+/**
+ * @brief 障害検出器が返すピアの疑い度合い。
+ */
+enum class Suspicion {
+    kAlive,   // 正常 (phi < suspect_phi)
+    kSuspect, // 疑わしい (suspect_phi <= phi < failed_phi)
+    kFailed   // ダウンと判定 (phi >= failed_phi)
+};
+
+/**
+ * @brief phi-accrual 障害検出器の調整パラメータ。
+ */
+struct PhiAccrualConfig {
+    double suspect_phi = 3.0;      // この値以上で kSuspect (誤検知率 約 10^-3)
+    double failed_phi = 8.0;       // この値以上で kFailed (誤検知率 約 10^-8)
+    size_t window_size = 100;      // 学習に用いる到着間隔のサンプル数
+    size_t min_samples = 3;        // phi を計算するのに必要な最小サンプル数
+    std::chrono::milliseconds min_std_deviation{20}; // 標準偏差の下限 (規則的すぎるリンクでの過敏化を防ぐ)
+    std::chrono::milliseconds acceptable_pause{0};   // 許容する追加の停止時間 (GC 等)
+};
+
+/**
+ * @brief phi-accrual 方式の適応型障害検出器。
+ * 生存シグナルの到着間隔の分布 (平均・分散) を学習し、最終到着からの経過時間が
+ * その分布上どれだけ起こりにくいかを phi = -log10(P(遅延 >= 経過時間)) として返す。
+ * 固定タイムアウトと異なり、周期の短いリンクでは短時間で、ジッタの大きいリンクでは
+ * 慎重に障害を判定する。
+ */
+class PhiAccrualDetector {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 生存シグナル (HEARTBEAT / ADVERTISE / メディアパケット) の到着を記録する。
+     * @param now 到着時刻
+     * @param window_size 保持する到着間隔サンプルの最大数
+     */
+    void Heartbeat(Clock::time_point now, size_t window_size) {
+        if (has_last_) {
+            double interval_ms = std::chrono::duration<double, std::milli>(now - last_arrival_).count();
+            AddInterval(interval_ms, window_size);
+        }
+        last_arrival_ = now;
+        has_last_ = true;
+    }
+
+    /**
+     * @brief 現在時刻における phi 値を計算する。
+     * @param now 評価時刻
+     * @param config 検出パラメータ
+     * @return phi 値 (サンプル不足の場合は 0.0)
+     */
+    double Phi(Clock::time_point now, const PhiAccrualConfig& config) const {
+        if (!HasEnoughSamples(config)) return 0.0;
+
+        const double n = static_cast<double>(intervals_ms_.size());
+        const double mean = sum_ms_ / n
+                          + static_cast<double>(config.acceptable_pause.count());
+        const double variance = std::max(0.0, sum_sq_ms_ / n - (sum_ms_ / n) * (sum_ms_ / n));
+        const double std_dev = std::max(std::sqrt(variance),
+                                        static_cast<double>(config.min_std_deviation.count()));
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(now - last_arrival_).count();
+
+        // 正規分布の累積分布関数をロジスティック近似で評価する
+        const double y = (elapsed_ms - mean) / std_dev;
+        const double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+        if (elapsed_ms > mean) {
+            return -std::log10(e / (1.0 + e));
+        }
+        return -std::log10(1.0 - 1.0 / (1.0 + e));
+    }
+
+    /**
+     * @brief phi を計算できるだけのサンプルが揃っているか。
+     */
+    bool HasEnoughSamples(const PhiAccrualConfig& config) const {
+        return has_last_ && intervals_ms_.size() >= std::max<size_t>(config.min_samples, 1);
+    }
+
+    /**
+     * @brief 学習済みの分布と最終到着時刻を破棄する。
+     */
+    void Reset() {
+        intervals_ms_.clear();
+        next_ = 0;
+        sum_ms_ = 0.0;
+        sum_sq_ms_ = 0.0;
+        has_last_ = false;
+    }
+
+private:
+    std::vector<double> intervals_ms_; // 到着間隔のリングバッファ (ms)
+    size_t next_ = 0;                  // 次に上書きするリングバッファ位置
+    double sum_ms_ = 0.0;              // 到着間隔の総和
+    double sum_sq_ms_ = 0.0;           // 到着間隔の二乗和
+    Clock::time_point last_arrival_;
+    bool has_last_ = false;
+
+    /**
+     * @brief 到着間隔サンプルを追加し、ウィンドウ外の古いサンプルを除外する。
+     */
+    void AddInterval(double interval_ms, size_t window_size) {
+        if (window_size == 0) window_size = 1;
+        if (intervals_ms_.size() < window_size) {
+            intervals_ms_.push_back(interval_ms);
+        } else {
+            if (next_ >= intervals_ms_.size()) next_ = 0;
+            double old = intervals_ms_[next_];
+            sum_ms_ -= old;
+            sum_sq_ms_ -= old * old;
+            intervals_ms_[next_] = interval_ms;
+            next_ = (next_ + 1) % intervals_ms_.size();
+        }
+        sum_ms_ += interval_ms;
+        sum_sq_ms_ += interval_ms * interval_ms;
+    }
+};
+
+} // namespace hcs_control
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "hcs_common/Metrics.h"
+
+namespace hcs_control {
+
+constexpr size_t RTT_PROBE_SIZE = 12;       ///< PROBE の本体 [seq:u32][t1:i64] (ビッグエンディアン)
+constexpr size_t RTT_PROBE_REPLY_SIZE = 28; ///< PROBE_REPLY の本体 [seq:u32][t1:i64][t2:i64][t3:i64]
+constexpr int64_t RTT_MAX_SAMPLE_NS = 10'000'000'000; ///< これを超える RTT は時計の異常とみなして捨てる
+
+/**
+ * @brief ピアごとの RTT と片方向遅延の変化の推定値。
+ */
+struct RttEstimate {
+    int64_t srtt_ns = 0;          // 平滑化した RTT (RFC 6298 の SRTT)
+    int64_t rttvar_ns = 0;        // RTT の変動 (RFC 6298 の RTTVAR)
+    int64_t last_rtt_ns = 0;      // 直近のサンプル
+    double delay_gradient = 0.0;  // 往路の片方向遅延の変化率 (遅延の増分 / 経過時間、正なら経路上のキューが伸びている)
+    uint64_t samples = 0;
+};
+
+/**
+ * @brief RTT プローブのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct RttProbeMetrics {
+    hcs_common::Counter& probes_sent;
+    hcs_common::Counter& replies_received;
+    hcs_common::Counter& replies_discarded;
+    hcs_common::LatencyHistogram& rtt;
+
+    static RttProbeMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static RttProbeMetrics metrics{
+            registry.GetCounter("hcs_probe_sent_total", "RTT probes sent"),
+            registry.GetCounter("hcs_probe_replies_total", "RTT probe replies accepted"),
+            registry.GetCounter("hcs_probe_replies_discarded_total", "RTT probe replies discarded (stale, malformed or implausible)"),
+            registry.GetLatencySummary("hcs_probe_rtt_seconds", "Round-trip time measured by probes (kernel timestamps when available)"),
+        };
+        return metrics;
+    }
+};
+
+/**
+ * @brief PROBE / PROBE_REPLY による RTT と遅延勾配の計測。
+ *
+ * NTP と同じ4つの時刻から RTT = (t4 - t1) - (t3 - t2) を求める。
+ * t1 = PROBE の送信時刻、t2 = 応答側の PROBE の受信時刻、t3 = PROBE_REPLY の送信時刻、t4 = PROBE_REPLY の受信時刻。
+ * 受信時刻 (t2, t4) にカーネルのタイムスタンプを用いると、応答側・計測側の双方でリアクタの待ち時間が
+ * RTT から除かれ、CPU 負荷が高いノードでも親選定に使う RTT が膨らまない。
+ * t1/t4 と t2/t3 はそれぞれのノードの単調時計で、差のみを用いるため時計の同期は不要。
+ * 送信時刻 (t1, t3) はどちらもメッセージの末尾8バイトに置き、IControlTransport::SendTimestamped が
+ * 送信の直前に書き込む (まとめ送りのキューでの待ち時間を RTT に含めない)。
+ * 往路の片方向遅延 (t2 - t1) は時計のずれを含むが、連続するプローブ間の変化量ではずれが打ち消されるため、
+ * その変化率を遅延勾配 (輻輳の兆候) として用いる。
+ * 全メソッドは io_context のスレッドから呼び出すことを前提とする。
+ */
+class RttProbe {
+public:
+    /**
+     * @brief ピアへ送る PROBE の本体を追記する
+     * @param peer ピアのIPアドレス
+     * @param now_ns 送信時刻 (単調時計。SendTimestamped で送る場合は送信直前の時刻で上書きされる)
+     * @param out 追記先 (メッセージタイプの直後)
+     */
+    void WriteProbe(const std::string& peer, int64_t now_ns, std::vector<uint8_t>& out) {
+        PeerProbe& state = peers_[peer];
+        PutU32(out, ++state.next_seq);
+        PutI64(out, now_ns);
+        metrics_.probes_sent.Add();
+    }
+
+    /**
+     * @brief 受信した PROBE に対する PROBE_REPLY の本体を追記する
+     * @param probe PROBE の本体
+     * @param size 本体の長さ
+     * @param received_ns PROBE の受信時刻 (カーネルのタイムスタンプがあればその時刻)
+     * @param now_ns 応答の送信時刻 (SendTimestamped で送る場合は送信直前の時刻で上書きされる)
+     * @param out 追記先 (メッセージタイプの直後)
+     * @return 応答を作成した場合はtrue (本体が短い場合はfalse)
+     */
+    static bool WriteReply(const uint8_t* probe, size_t size, int64_t received_ns, int64_t now_ns, std::vector<uint8_t>& out) {
+        if (size < RTT_PROBE_SIZE) return false;
+        out.insert(out.end(), probe, probe + RTT_PROBE_SIZE); // seq と t1 はそのまま返す
+        PutI64(out, received_ns);
+        PutI64(out, now_ns);
+        return true;
+    }
+
+    /**
+     * @brief PROBE_REPLY を処理し、RTT と遅延勾配を更新する
+     * @param peer 応答したピアのIPアドレス
+     * @param reply PROBE_REPLY の本体
+     * @param size 本体の長さ
+     * @param received_ns PROBE_REPLY の受信時刻 (カーネルのタイムスタンプがあればその時刻)
+     * @return 推定値を更新した場合はtrue
+     */
+    bool HandleReply(const std::string& peer, const uint8_t* reply, size_t size, int64_t received_ns) {
+        auto it = peers_.find(peer);
+        if (size < RTT_PROBE_REPLY_SIZE || it == peers_.end()) {
+            metrics_.replies_discarded.Add();
+            return false;
+        }
+        PeerProbe& state = it->second;
+        const uint32_t seq = GetU32(reply);
+        const int64_t t1 = GetI64(reply + 4);
+        const int64_t t2 = GetI64(reply + 12);
+        const int64_t t3 = GetI64(reply + 20);
+        const int64_t rtt = (received_ns - t1) - (t3 - t2);
+        // 追い越された古い応答、重複、時計の異常によるサンプルは捨てる
+        if (static_cast<int32_t>(seq - state.last_reply_seq) <= 0 || static_cast<int32_t>(state.next_seq - seq) < 0 ||
+            rtt < 0 || rtt > RTT_MAX_SAMPLE_NS) {
+            metrics_.replies_discarded.Add();
+            return false;
+        }
+        state.last_reply_seq = seq;
+
+        RttEstimate& est = state.estimate;
+        est.last_rtt_ns = rtt;
+        if (est.samples == 0) {
+            est.srtt_ns = rtt;
+            est.rttvar_ns = rtt / 2;
+        } else {
+            const int64_t err = rtt - est.srtt_ns;
+            est.rttvar_ns += ((err < 0 ? -err : err) - est.rttvar_ns) / 4;
+            est.srtt_ns += err / 8;
+        }
+
+        // 往路の片方向遅延の変化率 (時計のずれは差分で打ち消される)
+        const int64_t forward_delay = t2 - t1;
+        if (est.samples > 0 && t1 > state.last_t1) {
+            const double gradient = static_cast<double>(forward_delay - state.last_forward_delay) /
+                                    static_cast<double>(t1 - state.last_t1);
+            est.delay_gradient += (gradient - est.delay_gradient) / 8.0;
+        }
+        state.last_forward_delay = forward_delay;
+        state.last_t1 = t1;
+        ++est.samples;
+
+        metrics_.replies_received.Add();
+        metrics_.rtt.Record(rtt);
+        return true;
+    }
+
+    /**
+     * @brief ピアの平滑化した RTT (ms) を返す
+     * @return 計測済みの場合はRTT、未計測の場合は -1
+     */
+    long long RttMs(const std::string& peer) const {
+        const RttEstimate* est = Estimate(peer);
+        if (!est || est->samples == 0) return -1;
+        return (est->srtt_ns + 500'000) / 1'000'000;
+    }
+
+    /**
+     * @brief ピアの推定値を返す (未計測の場合は nullptr)
+     */
+    const RttEstimate* Estimate(const std::string& peer) const {
+        auto it = peers_.find(peer);
+        return it == peers_.end() ? nullptr : &it->second.estimate;
+    }
+
+    /**
+     * @brief ピアの計測状態を破棄する (ピアの離脱時)
+     */
+    void Forget(const std::string& peer) {
+        peers_.erase(peer);
+    }
+
+private:
+    struct PeerProbe {
+        uint32_t next_seq = 0;        // 最後に送った PROBE の番号
+        uint32_t last_reply_seq = 0;  // 最後に受理した応答の番号
+        int64_t last_t1 = 0;
+        int64_t last_forward_delay = 0;
+        RttEstimate estimate;
+    };
+
+    std::map<std::string, PeerProbe> peers_;
+    RttProbeMetrics& metrics_ = RttProbeMetrics::Get();
+
+    static void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(v >> shift));
+    }
+
+    static void PutI64(std::vector<uint8_t>& out, int64_t value) {
+        const uint64_t v = static_cast<uint64_t>(value);
+        for (int shift = 56; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(v >> shift));
+    }
+
+    static uint32_t GetU32(const uint8_t* p) {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    static int64_t GetI64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+        return static_cast<int64_t>(v);
+    }
+};
+
+} // namespace hcs_control
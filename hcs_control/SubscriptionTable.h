@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "hcs_net/common.h" // Endpoint
+
+namespace hcs_control {
+
+constexpr uint32_t ALL_LAYERS = 0xFFFFFFFFu; ///< 全レイヤーを購読する場合のレイヤーマスク
+/// 差し替えたスナップショットを解放するまでの猶予。読み手が1回のパケット処理で参照を保持する時間より十分に長くする
+constexpr std::chrono::milliseconds SUBSCRIPTION_RECLAIM_GRACE{1000};
+
+/**
+ * @brief グループを購読している子ノード1件分のエントリ。
+ * 送信先はバイナリ形式の Endpoint で、ファンアウト時に文字列の解析は発生しない。
+ */
+struct Subscriber {
+    hcs_net::Endpoint endpoint;       // トランスポートに渡す送信先 (比較・検索のキーを兼ねる)
+    uint32_t layer_mask = ALL_LAYERS; // 購読するレイヤー (SVC/サイマルキャスト) のビットマスク
+    uint16_t control_port = 0;        // JOIN の送信元ポート (制御メッセージの宛先。アドレスは endpoint と同じ)
+
+    /**
+     * @brief 子ノードの制御メッセージの宛先 (JOIN の送信元) を返す。
+     */
+    hcs_net::Endpoint ControlEndpoint() const { return endpoint.WithPort(control_port); }
+
+    /**
+     * @brief 指定レイヤーを購読しているか。
+     */
+    bool WantsLayer(uint8_t layer) const {
+        return layer < 32 && (layer_mask & (1u << layer)) != 0;
+    }
+};
+
+/**
+ * @brief 1グループ分の購読者一覧 (不変のスナップショット)。
+ * 送信先で整列した連続配列で、ファンアウトは単純な走査で済む。
+ */
+struct GroupSubscribers {
+    std::vector<Subscriber> children;
+};
+
+/**
+ * @brief 中継ノードのグループ別購読テーブル (GroupID -> 子ノードと購読レイヤー)。
+ *
+ * JOIN/LEAVE を処理する制御スレッドが更新し、メディアスレッドがファンアウト時に参照する。
+ * グループは登録時に固定長配列のスロット番号を割り当てられ、各スロットは不変スナップショットへの
+ * ポインタを std::atomic で保持する。更新はスナップショットを複製して差し替える (copy-on-write) ため、
+ * メディアスレッドはロックも参照カウントの操作もなく、atomic の読み出しのみで一覧を得られる。
+ * 差し替えた古いスナップショットは退避し、SUBSCRIPTION_RECLAIM_GRACE を過ぎてから解放する (遅延解放)。
+ * このため読み手は、得たポインタを1回のパケット処理の間だけ使い、保持し続けてはならない。
+ * 更新側は内部のミューテックスで直列化される。
+ */
+class SubscriptionTable {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param max_groups 登録できるグループ数の上限 (スロット配列は再確保しない)
+     */
+    explicit SubscriptionTable(size_t max_groups = 4096)
+        : max_groups_(max_groups),
+          slots_(std::make_unique<std::atomic<const GroupSubscribers*>[]>(max_groups)) {
+        for (size_t i = 0; i < max_groups_; ++i) slots_[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~SubscriptionTable() {
+        for (size_t i = 0; i < max_groups_; ++i) delete slots_[i].load(std::memory_order_relaxed);
+    }
+
+    SubscriptionTable(const SubscriptionTable&) = delete;
+    SubscriptionTable& operator=(const SubscriptionTable&) = delete;
+
+    /**
+     * @brief グループを登録し、スロット番号を返す。登録済みの場合は既存の番号を返す。
+     * メディアスレッドは設定時にスロット番号を取得しておき、以降は番号で参照する。
+     * @param group_id グループID
+     * @return スロット番号 (上限に達した場合は -1)
+     */
+    int RegisterGroup(const std::string& group_id) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return RegisterGroupLocked(group_id);
+    }
+
+    /**
+     * @brief グループのスロット番号を返す。
+     * @return スロット番号 (未登録の場合は -1)
+     */
+    int FindGroup(const std::string& group_id) const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto it = group_slots_.find(group_id);
+        return it == group_slots_.end() ? -1 : it->second;
+    }
+
+    /**
+     * @brief 子ノードの購読を追加する (JOIN)。既に購読中の場合はレイヤーマスクと制御ポートを更新する。
+     * @param group_id グループID (未登録なら登録する)
+     * @param child 子ノードのメディア送信先
+     * @param layer_mask 購読するレイヤーのビットマスク
+     * @param control_port JOIN の送信元ポート (子ノードへの制御メッセージの宛先)
+     * @return 追加・更新した場合はtrue (グループ数の上限を超える場合はfalse)
+     */
+    bool Join(const std::string& group_id, const hcs_net::Endpoint& child, uint32_t layer_mask = ALL_LAYERS,
+              uint16_t control_port = 0) {
+        Subscriber sub{child, layer_mask, control_port};
+
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        int slot = RegisterGroupLocked(group_id);
+        if (slot < 0) return false;
+
+        auto next = CopySlot(slot);
+        auto& children = next->children;
+        auto it = std::lower_bound(children.begin(), children.end(), sub.endpoint, ByEndpoint());
+        if (it != children.end() && it->endpoint == sub.endpoint) {
+            if (it->layer_mask == layer_mask && it->control_port == control_port) return true; // 変化なし (複製を破棄)
+            it->layer_mask = layer_mask;
+            it->control_port = control_port;
+        } else {
+            children.insert(it, std::move(sub));
+        }
+        Publish(slot, std::move(next));
+        return true;
+    }
+
+    /**
+     * @brief 子ノードの購読を削除する (LEAVE)。
+     * @return 削除した場合はtrue
+     */
+    bool Leave(const std::string& group_id, const hcs_net::Endpoint& child) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto slot_it = group_slots_.find(group_id);
+        if (slot_it == group_slots_.end()) return false;
+        return RemoveLocked(slot_it->second, child);
+    }
+
+    /**
+     * @brief 子ノードの購読を全グループから削除する (子ノードの離脱・障害時)。
+     * @return 削除したグループ数
+     */
+    size_t RemoveChild(const hcs_net::Endpoint& child) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        size_t removed = 0;
+        for (const auto& [gid, slot] : group_slots_) {
+            if (RemoveLocked(slot, child)) ++removed;
+        }
+        return removed;
+    }
+
+    /**
+     * @brief グループの購読者一覧を返す (メディアスレッドから呼び出し可能、ロックなし)。
+     * 返したスナップショットは後続の更新の影響を受けず、SUBSCRIPTION_RECLAIM_GRACE の間は有効。
+     * @param slot RegisterGroup/FindGroup で得たスロット番号
+     * @return 購読者一覧 (未登録・購読者なしの場合は nullptr)
+     */
+    const GroupSubscribers* Subscribers(int slot) const {
+        if (slot < 0 || static_cast<size_t>(slot) >= max_groups_) return nullptr;
+        return slots_[slot].load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 購読者のいるグループと、その購読者一覧の複製を返す (制御ループ・停止時のハンドオフ用)。
+     * 複製を返すため、走査中に購読を更新してよい。
+     */
+    std::vector<std::pair<std::string, std::vector<Subscriber>>> ActiveGroups() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        std::vector<std::pair<std::string, std::vector<Subscriber>>> result;
+        for (const auto& [gid, slot] : group_slots_) {
+            if (const auto* subscribers = slots_[slot].load(std::memory_order_acquire)) {
+                result.emplace_back(gid, subscribers->children);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief 猶予を過ぎた古いスナップショットを解放する (更新時にも行うが、更新が途絶えた場合のために制御ループから呼ぶ)。
+     */
+    void ReclaimRetired() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        ReclaimLocked(std::chrono::steady_clock::now());
+    }
+
+    /**
+     * @brief 解放を待っている古いスナップショットの数を返す。
+     */
+    size_t RetiredCount() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return retired_.size();
+    }
+
+    /**
+     * @brief 登録済みのグループ数を返す。
+     */
+    size_t GroupCount() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return group_slots_.size();
+    }
+
+private:
+    struct ByEndpoint {
+        bool operator()(const Subscriber& a, const hcs_net::Endpoint& b) const {
+            return a.endpoint < b;
+        }
+    };
+
+    struct Retired {
+        std::unique_ptr<const GroupSubscribers> snapshot;
+        std::chrono::steady_clock::time_point retired_at;
+    };
+
+    const size_t max_groups_;
+    std::unique_ptr<std::atomic<const GroupSubscribers*>[]> slots_; // スロット -> 購読者スナップショット (所有する)
+    std::unordered_map<std::string, int> group_slots_;              // GroupID -> スロット番号 (更新側のみ)
+    std::deque<Retired> retired_;                                   // 差し替えた古いスナップショット (差し替え順)
+    mutable std::mutex write_mutex_;
+
+    int RegisterGroupLocked(const std::string& group_id) {
+        auto it = group_slots_.find(group_id);
+        if (it != group_slots_.end()) return it->second;
+        if (group_slots_.size() >= max_groups_) return -1;
+        int slot = static_cast<int>(group_slots_.size());
+        group_slots_.emplace(group_id, slot);
+        return slot;
+    }
+
+    /**
+     * @brief スロットの現在のスナップショットを複製する (更新用)。
+     */
+    std::unique_ptr<GroupSubscribers> CopySlot(int slot) const {
+        const auto* current = slots_[slot].load(std::memory_order_acquire);
+        return current ? std::make_unique<GroupSubscribers>(*current) : std::make_unique<GroupSubscribers>();
+    }
+
+    /**
+     * @brief 新しいスナップショットを公開し、古いものを退避する (読み手がまだ参照している可能性があるため即座には解放しない)。
+     */
+    void Publish(int slot, std::unique_ptr<GroupSubscribers> next) {
+        const GroupSubscribers* published = next->children.empty() ? nullptr : next.release();
+        const GroupSubscribers* previous = slots_[slot].exchange(published, std::memory_order_acq_rel);
+        const auto now = std::chrono::steady_clock::now();
+        if (previous) retired_.push_back(Retired{std::unique_ptr<const GroupSubscribers>(previous), now});
+        ReclaimLocked(now);
+    }
+
+    void ReclaimLocked(std::chrono::steady_clock::time_point now) {
+        while (!retired_.empty() && now - retired_.front().retired_at >= SUBSCRIPTION_RECLAIM_GRACE) {
+            retired_.pop_front();
+        }
+    }
+
+    bool RemoveLocked(int slot, const hcs_net::Endpoint& target) {
+        const auto* current = slots_[slot].load(std::memory_order_acquire);
+        if (!current) return false;
+        const auto& children = current->children;
+        auto it = std::lower_bound(children.begin(), children.end(), target, ByEndpoint());
+        if (it == children.end() || it->endpoint != target) return false;
+
+        auto next = std::make_unique<GroupSubscribers>();
+        next->children.reserve(children.size() - 1);
+        next->children.insert(next->children.end(), children.begin(), it);
+        next->children.insert(next->children.end(), it + 1, children.end());
+        Publish(slot, std::move(next));
+        return true;
+    }
+};
+
+} // namespace hcs_control
@@ -1,12 +1,19 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
 #include <set>
+#include <cstdint>
+#include <algorithm>
 #include <string>
 #include <chrono>
 #include <vector>
 #include <memory>
-#include <iostream>
+#include <functional>
+#include "PhiAccrualDetector.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/Tracing.h"
 
 namespace hcs_control {
 
@@ -14,31 +21,99 @@ namespace hcs_control {
  * @brief ノードの品質と経路を評価するためのメトリクス構造体。
  */
 struct NodeMetrics {
-    int hop_count = 0;        // 親ノードまでのホップ数 (少ない方が良い)
-    int bandwidth_score = 0;  // 帯域幅の品質スコア (高い方が良い)
-    int stability_score = 0;  // 安定性/稼働時間のスコア (高い方が良い)
-    long long rtt_ms = 9999;  // ラウンドトリップタイム (ms) (低い方が良い)
+    int hop_count = 0;        // 親ノードまでのホップ数 (少ない方が良い)
+    int bandwidth_score = 0;  // 帯域幅の品質スコア (高い方が良い)
+    int stability_score = 0;  // 安定性/稼働時間のスコア (高い方が良い)
+    long long rtt_ms = 9999;  // ラウンドトリップタイム (ms) (低い方が良い)
+};
+
+/**
+ * @brief グループごとの配信ツリー上の経路情報。ADVERTISEでグループごとに伝播される。
+ * パスベクトルによりループを、送信元シーケンス番号により失効した経路の再利用を防ぐ。
+ */
+struct GroupRoute {
+    int hops_to_source = -1;       // 送信元までのホップ数 (0 = 自身が送信元, -1 = 経路なし)
+    uint32_t source_seq = 0;       // 送信元が ADVERTISE ごとに増加させる経路シーケンス番号
+    std::vector<std::string> path; // 送信元からこのノード自身までの経路 (パスベクトル)
 };
 
 /**
  * @brief 近隣ノードの現在の状態を保持する構造体。
  */
 struct PeerState {
-    NodeMetrics metrics;
-    std::string ip_address;
-    std::chrono::steady_clock::time_point last_advertise_time; // 最終受信時刻
-    double score = -1.0;                                     // 計算されたノードスコア
-    bool is_parent = false;                                  // 現在の親ノードであるか
-    std::set<std::string> groups;                             // 所属グループID
+    NodeMetrics metrics;
+    std::string ip_address;
+    std::chrono::steady_clock::time_point last_advertise_time; // 最終受信時刻
+    double score = -1.0;                                     // 計算されたノードスコア
+    bool is_parent = false;                                  // 現在の親ノードであるか
+    std::set<std::string> groups;                             // 所属グループID
+    std::map<std::string, GroupRoute> routes;                 // GroupID -> このピアの送信元までの経路
+    std::map<std::string, uint32_t> seq_stalls;               // GroupID -> 送信元シーケンス番号が進まなかった連続ADVERTISE数
+    PhiAccrualDetector control_detector;                      // HEARTBEAT/ADVERTISE の到着間隔を学習
+    PhiAccrualDetector media_detector;                        // メディアパケットの到着間隔を学習
+    bool media_active = false;                                // メディア受信を生存判定に用いるか
 };
 
 /**
  * @brief ピアディスカバリおよびステータス交換のためのADVERTISEメッセージ構造体。
  */
 struct AdvertiseMessage {
-    std::string ip;
-    NodeMetrics metrics;
-    std::set<std::string> groups;
+    std::string ip;
+    NodeMetrics metrics;
+    std::set<std::string> groups;
+    std::map<std::string, GroupRoute> routes; // GroupID -> 送信元ノードの経路 (未接続のグループは含まない)
+};
+
+/**
+ * @brief グループごとの現在の親選定結果 (スナップショット出力用)。
+ */
+struct ParentSelection {
+    std::string group_id;
+    std::string primary_ip;   // プライマリ親IP (未選定なら空)
+    std::string secondary_ip; // セカンダリ親IP (冗長モード無効または未選定なら空)
+    int depth = -1;           // 自ノードの送信元からの深さ (自ノードが送信元なら0、経路なしなら-1)
+};
+
+/**
+ * @brief ADVERTISEバッチ適用 (FlushAdvertiseBatch) の結果。
+ */
+struct AdvertiseBatchStats {
+    size_t received = 0; // バッチ期間中に受信したメッセージ数
+    size_t senders = 0;  // 重複排除後の送信元数 (適用したメッセージ数)
+    size_t groups = 0;   // ランキングを更新したグループ数
+};
+
+/**
+ * @brief 親の計画停止の予告 (HandleParentDeparture) に対する切り替え結果。
+ */
+struct ParentHandoff {
+    std::string new_parent; // 切り替え後のプライマリ親IP (代わりの候補がなければ空)
+    bool receiving = false; // 新しい親から既に受信している (冗長モードのセカンダリの昇格・切り替え済み)
+};
+
+/**
+ * @brief トポロジー管理のメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct TopologyMetrics {
+    hcs_common::Counter& advertise_received;
+    hcs_common::Counter& advertise_applied;
+    hcs_common::Counter& heartbeats;
+    hcs_common::Counter& parent_switches;
+    hcs_common::Counter& parent_failures;
+    hcs_common::Counter& parent_handoffs;
+
+    static TopologyMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static TopologyMetrics metrics{
+            registry.GetCounter("hcs_topology_advertise_received_total", "ADVERTISE messages received"),
+            registry.GetCounter("hcs_topology_advertise_applied_total", "ADVERTISE messages applied to peer state (after batch dedup)"),
+            registry.GetCounter("hcs_topology_heartbeats_total", "HEARTBEAT messages received from known peers"),
+            registry.GetCounter("hcs_topology_parent_switches_total", "Primary parent changes across all groups"),
+            registry.GetCounter("hcs_topology_parent_failures_total", "Primary parents declared failed by the phi-accrual detector"),
+            registry.GetCounter("hcs_topology_parent_handoffs_total", "Parent changes made ahead of a planned parent departure"),
+        };
+        return metrics;
+    }
 };
 
 /**
@@ -47,121 +122,845 @@ struct AdvertiseMessage {
  */
 class TopologyManager {
 public:
-    TopologyManager() = default;
+    TopologyManager() = default;
+
+    /**
+     * @brief 自ノードのIPアドレスを指定して初期化する。
+     * 自ノードIPは、受信した経路のパスベクトルに自身が含まれるか (ループ) の判定に用いる。
+     * @param self_ip 自ノードのIPアドレス
+     */
+    explicit TopologyManager(const std::string& self_ip) : self_ip_(self_ip) {}
+
+    /**
+     * @brief 現在時刻を返す関数の型。シミュレータでは仮想時計を注入する。
+     */
+    using NowFunction = std::function<std::chrono::steady_clock::time_point()>;
 
-    /**
+    /**
+     * @brief 時刻の取得元を差し替える (既定は std::chrono::steady_clock::now)。
+     * 離散イベントシミュレータから仮想時計を与え、実時間より高速に検証するために用いる。
+     * @param now 現在時刻を返す関数 (nullptr の場合は既定に戻す)
+     */
+    void SetClock(NowFunction now) {
+        now_ = std::move(now);
+    }
+
+    /**
+     * @brief プライマリ親の変更を通知する関数の型 (グループID, 旧親IP, 新親IP)。旧親・新親は空の場合がある。
+     */
+    using ParentChangeHandler = std::function<void(const std::string&, const std::string&, const std::string&)>;
+
+    /**
+     * @brief プライマリ親が変わるたびに呼ばれるハンドラを設定する (パケットキャプチャのトリガーなど)。
+     * ハンドラは TopologyManager の更新中に呼ばれるため、その中から TopologyManager を変更しないこと。
+     */
+    void SetParentChangeHandler(ParentChangeHandler handler) {
+        parent_change_handler_ = std::move(handler);
+    }
+
+    /**
      * @brief マネージャを起動し、定期的な処理（タイマー）を開始する。
      */
-    void Start() {
-        // TODO: 定期的なADVERTISE送信やHEARTBEATチェックタイマーを設定
-        std::cout << "[TopologyManager] Started. Failover timeout set to " 
-                << failover_timeout_sec_ << "s.\n";
-    }
+    void Start() {
+        HCS_LOG_INFO("TopologyManager", "Started. Failure detector phi thresholds: suspect={}, failed={} (bootstrap timeout {}s).",
+                     detector_config_.suspect_phi, detector_config_.failed_phi, failover_timeout_sec_);
+    }
+
+    /**
+     * @brief 冗長配信モードを切り替える。
+     * 有効時はグループごとにプライマリ親に加え、経路の重ならないセカンダリ親を選定する。
+     * ノードは両方の親からストリームを受信し、受信側で先着パケットのみを採用する。
+     * @param enabled trueで冗長配信モードを有効化
+     */
+    void SetRedundantMode(bool enabled) {
+        redundant_mode_ = enabled;
+        if (!enabled) {
+            for (auto& [gid, best] : best_scores_) {
+                best.secondary_score = -1.0;
+                best.secondary_ip.clear();
+            }
+        }
+    }
 
-    /**
+    /**
+     * @brief phi-accrual 障害検出器のパラメータを設定する。
+     * @param config 疑い閾値・学習ウィンドウなどの検出パラメータ
+     */
+    void SetFailureDetectorConfig(const PhiAccrualConfig& config) {
+        detector_config_ = config;
+    }
+
+    /**
+     * @brief 到着間隔の学習前に用いる HEARTBEAT タイムアウトを設定する。
+     * @param seconds 最後の HEARTBEAT からこの秒数を超えた親を障害とみなす
+     */
+    void SetBootstrapTimeout(int seconds) {
+        failover_timeout_sec_ = seconds;
+    }
+
+    /**
+     * @brief 配信ツリーの最大深さ (送信元からのホップ数) を設定する。
+     * ツリーの深さはエンドツーエンド遅延に直結するため、これを超える経路の親は選定しない。
+     * @param max_depth 自ノードが到達してよい最大ホップ数
+     */
+    void SetMaxTreeDepth(int max_depth) {
+        max_tree_depth_ = max_depth;
+    }
+
+    /**
+     * @brief 自ノードを指定グループの送信元 (ツリーのルート) として登録する。
+     * @param group_id 自ノードが配信するグループID
+     */
+    void AddSourceGroup(const std::string& group_id) {
+        source_groups_[group_id];
+    }
+
+    /**
+     * @brief 自ノードが送信するADVERTISEメッセージを構築する。
+     * 送信元グループではシーケンス番号を進めてルート経路を、それ以外では現在の親の経路に
+     * 自ノードを連結した経路を通知する。親のいないグループの経路は通知しない。
+     * @param metrics 自ノードの最新メトリクス
+     * @return 送信すべきADVERTISEメッセージ
+     */
+    AdvertiseMessage BuildAdvertise(const NodeMetrics& metrics) {
+        AdvertiseMessage msg;
+        msg.ip = self_ip_;
+        msg.metrics = metrics;
+
+        for (auto& [gid, seq] : source_groups_) {
+            GroupRoute route;
+            route.hops_to_source = 0;
+            route.source_seq = ++seq;
+            route.path = {self_ip_};
+            msg.groups.insert(gid);
+            msg.routes[gid] = std::move(route);
+        }
+
+        for (const auto& [gid, best] : best_scores_) {
+            if (source_groups_.count(gid) || best.parent_ip.empty()) continue;
+            const GroupRoute* parent_route = RouteOf(best.parent_ip, gid);
+            if (!parent_route) continue;
+
+            GroupRoute route = *parent_route;
+            route.hops_to_source += 1;
+            route.path.push_back(self_ip_);
+            msg.groups.insert(gid);
+            msg.routes[gid] = std::move(route);
+        }
+        return msg;
+    }
+
+    /**
      * @brief ADVERTISEメッセージを受信し、近隣ノードの状態を更新する。
+     * 受信のたびにランキングを更新する。高レートで受信する場合は EnqueueAdvertise を用いる。
      * @param msg 受信したADVERTISEメッセージ
      */
-    void HandleAdvertise(const AdvertiseMessage& msg) {
-        auto now = std::chrono::steady_clock::now();
-        auto& peer = neighbor_nodes_[msg.ip];
-        peer.ip_address = msg.ip;
-        peer.metrics = msg.metrics;
-        peer.last_advertise_time = now;
-        peer.groups = msg.groups;
-
-        // グループごとにスコア計算し、最良ノードを更新
-        for (const auto& gid : msg.groups) {
-            double score = ComputeNodeScore(msg.metrics);
-            
-            // スコアが更新された場合のみ記録
-            if (score > best_scores_[gid].score) {
-                best_scores_[gid].score = score;
-                best_scores_[gid].parent_ip = msg.ip;
-            }
-        }
-    }
-
-    /**
+    void HandleAdvertise(const AdvertiseMessage& msg) {
+        HCS_TRACE_SPAN("topology", "topology.advertise");
+        metrics_.advertise_received.Add();
+        ApplyAdvertise(msg, Now());
+        if (IsDeparting(msg.ip)) return; // 停止を予告したピアは親候補にしない
+        for (const auto& gid : msg.groups) {
+            double score = 0.0;
+            if (ScoreCandidate(msg, gid, score)) OfferCandidate(gid, msg.ip, score);
+        }
+    }
+
+    /**
+     * @brief ADVERTISEメッセージをバッチに追加する。ランキングの更新は FlushAdvertiseBatch まで遅延する。
+     * 同一送信元から複数のメッセージが届いた場合は、最新のもののみを保持する。
+     * @param msg 受信したADVERTISEメッセージ
+     */
+    void EnqueueAdvertise(AdvertiseMessage msg) {
+        auto& pending = pending_advertise_[msg.ip];
+        pending.arrival = Now();
+        pending.msg = std::move(msg);
+        ++pending_received_;
+        metrics_.advertise_received.Add();
+    }
+
+    /**
+     * @brief バッチ中のADVERTISEをまとめて適用する。制御ループのティックごとに呼び出す。
+     * 全送信元のピア状態と送信元シーケンス番号を先に更新してから、
+     * グループごとに候補をスコア順に並べ、ランキングを1回だけ更新する。
+     * @return 適用結果の統計
+     */
+    AdvertiseBatchStats FlushAdvertiseBatch() {
+        HCS_TRACE_SPAN_NAMED(span, "topology", "topology.advertise_batch");
+        AdvertiseBatchStats stats;
+        stats.received = pending_received_;
+        stats.senders = pending_advertise_.size();
+        pending_received_ = 0;
+        if (pending_advertise_.empty()) return stats;
+        HCS_TRACE_SET_ID(span, stats.senders);
+
+        for (const auto& [ip, pending] : pending_advertise_) {
+            ApplyAdvertise(pending.msg, pending.arrival);
+        }
+
+        // 候補を (グループ, スコア降順) に並べ、グループごとに1回だけランキングを更新する。
+        // バッファはティック間で再利用し、高レート受信時の再確保を避ける。
+        offer_buffer_.clear();
+        for (const auto& [ip, pending] : pending_advertise_) {
+            if (IsDeparting(ip)) continue; // 停止を予告したピアは親候補にしない
+            for (const auto& gid : pending.msg.groups) {
+                double score = 0.0;
+                if (ScoreCandidate(pending.msg, gid, score)) offer_buffer_.push_back({&gid, &ip, score});
+            }
+        }
+        std::sort(offer_buffer_.begin(), offer_buffer_.end(), [](const CandidateOffer& a, const CandidateOffer& b) {
+            if (*a.group_id != *b.group_id) return *a.group_id < *b.group_id;
+            if (a.score != b.score) return a.score > b.score;
+            return *a.ip < *b.ip;
+        });
+        // 現在の親のスコアを先に更新し、他の候補を最新のスコアと比べる
+        for (auto& offer : offer_buffer_) {
+            if (!IsSelectedParent(*offer.group_id, *offer.ip)) continue;
+            OfferCandidate(*offer.group_id, *offer.ip, offer.score);
+            offer.applied = true;
+        }
+        for (size_t i = 0; i < offer_buffer_.size(); ++i) {
+            const CandidateOffer& offer = offer_buffer_[i];
+            bool group_head = (i == 0 || *offer_buffer_[i - 1].group_id != *offer.group_id);
+            if (group_head) {
+                ++stats.groups;
+            } else if (!redundant_mode_) {
+                continue; // 非冗長モードでは最高スコアの候補のみが選定に影響する
+            }
+            if (!offer.applied) OfferCandidate(*offer.group_id, *offer.ip, offer.score);
+        }
+        offer_buffer_.clear();
+        pending_advertise_.clear();
+        return stats;
+    }
+
+    /**
+     * @brief バッチ中の (未適用の) 送信元数を返す。
+     */
+    size_t PendingAdvertiseCount() const { return pending_advertise_.size(); }
+
+    /**
      * @brief HEARTBEAT（生存確認）メッセージを受信し、最終受信時刻を更新する。
      * @param ip 送信元IPアドレス
      * @param group_id グループID (現在はIPで管理)
      */
-    void HandleHeartbeat(const std::string& ip, const std::string& group_id) {
-        auto it = neighbor_nodes_.find(ip);
-        if (it != neighbor_nodes_.end()) {
-            it->second.last_advertise_time = std::chrono::steady_clock::now();
-        }
-    }
+    void HandleHeartbeat(const std::string& ip, const std::string& group_id) {
+        auto it = neighbor_nodes_.find(ip);
+        if (it != neighbor_nodes_.end()) {
+            metrics_.heartbeats.Add();
+            auto now = Now();
+            it->second.last_advertise_time = now;
+            it->second.control_detector.Heartbeat(now, detector_config_.window_size);
+        }
+    }
+
+    /**
+     * @brief ピアからメディアパケットを受信したことを生存シグナルとして記録する。
+     * メディアは HEARTBEAT よりはるかに高頻度で届くため、学習される到着間隔が短く、
+     * 親ノードの停止を数百ミリ秒で検出できる。
+     * @param ip メディアパケットの送信元IPアドレス
+     */
+    void HandleMediaActivity(const std::string& ip) {
+        auto it = neighbor_nodes_.find(ip);
+        if (it != neighbor_nodes_.end()) {
+            auto now = Now();
+            it->second.last_advertise_time = now;
+            it->second.media_detector.Heartbeat(now, detector_config_.window_size);
+            it->second.media_active = true;
+        }
+    }
+
+    /**
+     * @brief ピアからのメディア受信が意図的に停止したことを通知し、メディアによる生存判定を解除する。
+     * ストリーム終了や購読解除の際に呼び出さないと、メディア途絶が障害と誤判定される。
+     * @param ip 対象ピアのIPアドレス
+     */
+    void ResetMediaLiveness(const std::string& ip) {
+        auto it = neighbor_nodes_.find(ip);
+        if (it != neighbor_nodes_.end()) {
+            it->second.media_detector.Reset();
+            it->second.media_active = false;
+        }
+    }
+
+    /**
+     * @brief ピアの現在の phi 値を返す。
+     * 制御メッセージとメディアの両検出器のうち、より強く障害を示す方を採用する。
+     * @param ip 対象ピアのIPアドレス
+     * @return phi 値 (未知のピアまたはサンプル不足の場合は 0.0)
+     */
+    double GetPhi(const std::string& ip) const {
+        auto it = neighbor_nodes_.find(ip);
+        if (it == neighbor_nodes_.end()) return 0.0;
+        auto now = Now();
+        double phi = it->second.control_detector.Phi(now, detector_config_);
+        if (it->second.media_active) {
+            phi = std::max(phi, it->second.media_detector.Phi(now, detector_config_));
+        }
+        return phi;
+    }
+
+    /**
+     * @brief ピアの疑い度合いを判定する。
+     * 到着間隔の学習が済んでいない間は、従来の固定タイムアウトで判定する。
+     * @param ip 対象ピアのIPアドレス
+     * @return 疑い度合い (未知のピアは kFailed)
+     */
+    Suspicion GetSuspicion(const std::string& ip) const {
+        auto it = neighbor_nodes_.find(ip);
+        if (it == neighbor_nodes_.end()) return Suspicion::kFailed;
+        const PeerState& peer = it->second;
+
+        bool learned = peer.control_detector.HasEnoughSamples(detector_config_) ||
+                       (peer.media_active && peer.media_detector.HasEnoughSamples(detector_config_));
+        if (!learned) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                Now() - peer.last_advertise_time).count();
+            return elapsed > failover_timeout_sec_ ? Suspicion::kFailed : Suspicion::kAlive;
+        }
+
+        double phi = GetPhi(ip);
+        if (phi >= detector_config_.failed_phi) return Suspicion::kFailed;
+        if (phi >= detector_config_.suspect_phi) return Suspicion::kSuspect;
+        return Suspicion::kAlive;
+    }
 
-    /**
+    /**
      * @brief 指定されたグループIDの現在の最良親ノードのIPアドレスを返す。
      * @param group_id グループID
      * @return 最良親ノードのIPアドレス、見つからない場合は空文字列
      */
-    std::string SelectBestParent(const std::string& group_id) {
-        auto it = best_scores_.find(group_id);
-        if (it != best_scores_.end()) return it->second.parent_ip;
-        return "";
-    }
+    std::string SelectBestParent(const std::string& group_id) {
+        auto it = best_scores_.find(group_id);
+        if (it != best_scores_.end()) return it->second.parent_ip;
+        return "";
+    }
 
-    /**
-     * @brief 現在の親ノードの生存状態をチェックし、タイムアウトした場合は選定をリセットする。
+    /**
+     * @brief 指定されたグループIDのセカンダリ親ノード (冗長配信用) のIPアドレスを返す。
+     * @param group_id グループID
+     * @return セカンダリ親ノードのIPアドレス、冗長モード無効または候補なしの場合は空文字列
+     */
+    std::string SelectSecondaryParent(const std::string& group_id) {
+        auto it = best_scores_.find(group_id);
+        if (it != best_scores_.end()) return it->second.secondary_ip;
+        return "";
+    }
+
+    /**
+     * @brief 現在の親ノードの生存状態を phi-accrual 検出器で評価し、障害時は選定をリセットする。
+     * サブ秒での検出を活かすため、数百ミリ秒以下の周期で呼び出すことを想定する。
      * @param group_id チェック対象のグループID
      */
-    void CheckParentHealth(const std::string& group_id) {
-        auto parent_ip = SelectBestParent(group_id);
-        if (parent_ip.empty()) return;
-
-        auto it = neighbor_nodes_.find(parent_ip);
-        if (it == neighbor_nodes_.end()) return;
-
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            now - it->second.last_advertise_time).count();
-
-        if (elapsed > failover_timeout_sec_) {
-            std::cout << "[TopologyManager] Parent " << parent_ip
-                      << " for group " << group_id << " is considered down (Timeout: "
-                      << elapsed << "s).\n";
-            // 親フラグのリセットとスコアの削除
-            it->second.is_parent = false;
-            best_scores_.erase(group_id);
-            
-            // TODO: HCSNodeに対して親変更の必要性を通知するコールバックを呼び出す
-        }
-    }
+    void CheckParentHealth(const std::string& group_id) {
+        HCS_TRACE_SPAN("topology", "topology.check_parent_health");
+        auto best_it = best_scores_.find(group_id);
+        if (best_it == best_scores_.end()) return;
+        auto& best = best_it->second;
+
+        // セカンダリ親が先にダウンした場合は、冗長経路のみを解除する
+        if (!best.secondary_ip.empty() && GetSuspicion(best.secondary_ip) == Suspicion::kFailed) {
+            HCS_LOG_INFO("TopologyManager", "Secondary parent {} for group {} is considered down.",
+                         best.secondary_ip, group_id);
+            best.secondary_score = -1.0;
+            best.secondary_ip.clear();
+        }
+
+        const std::string parent_ip = best.parent_ip;
+        if (parent_ip.empty()) return;
+
+        auto it = neighbor_nodes_.find(parent_ip);
+        if (it == neighbor_nodes_.end()) return;
+
+        Suspicion suspicion = GetSuspicion(parent_ip);
+        if (suspicion == Suspicion::kSuspect && !best.secondary_ip.empty() &&
+            GetSuspicion(best.secondary_ip) == Suspicion::kAlive) {
+            // 冗長モード: 疑わしい段階で健全なセカンダリと役割を入れ替える (旧プライマリは予備として保持)
+            HCS_LOG_INFO("TopologyManager", "Parent {} for group {} is suspected (phi={}). Swapping with secondary {}.",
+                         parent_ip, group_id, GetPhi(parent_ip), best.secondary_ip);
+            it->second.is_parent = false;
+            std::swap(best.score, best.secondary_score);
+            std::swap(best.parent_ip, best.secondary_ip);
+            NotifyParentSwitch(group_id, parent_ip, best.parent_ip);
+            return;
+        }
+
+        if (suspicion == Suspicion::kFailed) {
+            HCS_LOG_INFO("TopologyManager", "Parent {} for group {} is considered down (phi={}).",
+                         parent_ip, group_id, GetPhi(parent_ip));
+            // 親フラグのリセット
+            it->second.is_parent = false;
+            metrics_.parent_failures.Add();
+
+            if (!best.secondary_ip.empty()) {
+                // 冗長モード: セカンダリ親から既に受信中のため、即座にプライマリへ昇格する
+                HCS_LOG_INFO("TopologyManager", "Promoting secondary parent {} for group {}.",
+                             best.secondary_ip, group_id);
+                NotifyParentSwitch(group_id, parent_ip, best.secondary_ip);
+                best.score = best.secondary_score;
+                best.parent_ip = best.secondary_ip;
+                best.secondary_score = -1.0;
+                best.secondary_ip.clear();
+            } else {
+                // スコアの削除による再選定の強制。後継が未定のため新しい親は空で通知する
+                best_scores_.erase(best_it);
+                NotifyParentSwitch(group_id, parent_ip, "");
+            }
+        }
+    }
+
+    /**
+     * @brief 親が計画停止を予告した際に、障害検出を待たずに代わりの親へ切り替える。
+     * 予告したピアは DEPARTURE_HOLD_SEC の間、親候補から外す (停止までに届く ADVERTISE で再選定しないように)。
+     * セカンダリ親があれば昇格し、なければ推奨された候補、次に既知の全ピアの順に、
+     * 経路が有効で最もスコアの高いピアを選ぶ。推奨された候補のうち、ADVERTISE を未受信のピアは評価できないため除く。
+     * @param parent_ip 停止を予告したピアのIP
+     * @param group_id グループID
+     * @param recommended 停止するピアが推奨した代わりの親 (RecommendReplacements の結果)
+     * @return 切り替え結果。予告したピアが既に親でない場合 (予告の再送) は現在の親を receiving として返す
+     */
+    ParentHandoff HandleParentDeparture(const std::string& parent_ip, const std::string& group_id,
+                                        const std::vector<std::string>& recommended) {
+        const auto now = Now();
+        for (auto it = departing_.begin(); it != departing_.end();) {
+            it = it->second <= now ? departing_.erase(it) : std::next(it);
+        }
+        departing_[parent_ip] = now + std::chrono::seconds(DEPARTURE_HOLD_SEC);
+
+        ParentHandoff result;
+        auto best_it = best_scores_.find(group_id);
+        if (best_it != best_scores_.end() &&
+            (best_it->second.parent_ip == parent_ip || best_it->second.secondary_ip == parent_ip)) {
+            DropCandidate(group_id, parent_ip);
+            best_it = best_scores_.find(group_id);
+        } else {
+            // 切り替え済み、または親ではない
+            if (best_it != best_scores_.end()) result.new_parent = best_it->second.parent_ip;
+            result.receiving = !result.new_parent.empty();
+            return result;
+        }
+        if (best_it != best_scores_.end() && !best_it->second.parent_ip.empty()) {
+            // セカンダリの昇格、または予告したピアがセカンダリだった場合は、プライマリから受信中
+            metrics_.parent_handoffs.Add();
+            result.new_parent = best_it->second.parent_ip;
+            result.receiving = true;
+            return result;
+        }
+
+        std::string chosen;
+        double chosen_score = -1.0;
+        auto consider = [&](const std::string& ip) {
+            if (ip == parent_ip || ip == self_ip_ || IsDeparting(ip)) return;
+            // 推奨された候補には ADVERTISE を未受信 (経路なし) のピアも含まれる
+            const GroupRoute* route = RouteOf(ip, group_id);
+            auto peer_it = neighbor_nodes_.find(ip);
+            if (!route || peer_it == neighbor_nodes_.end() || !IsEligibleParent(peer_it->second, *route, group_id)) return;
+            const double score = ComputeGroupScore(peer_it->second.metrics, *route);
+            if (chosen.empty() || score > chosen_score) {
+                chosen = ip;
+                chosen_score = score;
+            }
+        };
+        for (const auto& ip : recommended) consider(ip);
+        if (chosen.empty()) {
+            for (const auto& [ip, peer] : neighbor_nodes_) consider(ip);
+        }
+        if (chosen.empty()) {
+            HCS_LOG_WARN("TopologyManager", "Parent {} for group {} is departing and no replacement is known.",
+                         parent_ip, group_id);
+            return result;
+        }
+
+        auto& best = best_scores_[group_id];
+        NotifyParentSwitch(group_id, parent_ip, chosen);
+        best.score = chosen_score;
+        best.parent_ip = chosen;
+        metrics_.parent_handoffs.Add();
+        HCS_LOG_INFO("TopologyManager", "Parent {} for group {} is departing. Switching to {}.",
+                     parent_ip, group_id, chosen);
+        result.new_parent = chosen;
+        return result;
+    }
+
+    /**
+     * @brief 自ノードが停止する際に、子ノードへ推奨する代わりの親を返す。
+     * 自ノードの親 (プライマリ・セカンダリ) を先頭に、そのグループの経路を持つピアをスコア順に並べる。
+     * 自ノードが送信元のグループでは代わりがないため空を返す。
+     * @param group_id グループID
+     * @param max_count 返す候補の最大数
+     */
+    std::vector<std::string> RecommendReplacements(const std::string& group_id, size_t max_count) const {
+        std::vector<std::string> result;
+        if (source_groups_.count(group_id)) return result;
+
+        auto add = [&](const std::string& ip) {
+            if (ip.empty() || result.size() >= max_count || IsDeparting(ip)) return;
+            if (std::find(result.begin(), result.end(), ip) == result.end()) result.push_back(ip);
+        };
+        auto best_it = best_scores_.find(group_id);
+        if (best_it != best_scores_.end()) {
+            add(best_it->second.parent_ip);
+            add(best_it->second.secondary_ip);
+        }
+
+        std::vector<std::pair<double, const std::string*>> others;
+        for (const auto& [ip, peer] : neighbor_nodes_) {
+            const GroupRoute* route = RouteOf(ip, group_id);
+            if (route && IsEligibleParent(peer, *route, group_id)) {
+                others.emplace_back(ComputeGroupScore(peer.metrics, *route), &ip);
+            }
+        }
+        std::sort(others.begin(), others.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (const auto& [score, ip] : others) add(*ip);
+        return result;
+    }
+
+    /**
+     * @brief 自ノードのIPアドレスを返す。
+     */
+    const std::string& GetSelfIp() const { return self_ip_; }
+
+    /**
+     * @brief 近隣ノードの状態一覧を返す (読み取り専用)。
+     */
+    const std::map<std::string, PeerState>& GetPeers() const { return neighbor_nodes_; }
+
+    /**
+     * @brief 全グループの現在の親選定結果を返す。自ノードが送信元のグループも深さ0として含む。
+     */
+    std::vector<ParentSelection> GetParentSelections() const {
+        std::vector<ParentSelection> result;
+        for (const auto& [gid, seq] : source_groups_) {
+            result.push_back(ParentSelection{gid, "", "", 0});
+        }
+        for (const auto& [gid, best] : best_scores_) {
+            if (source_groups_.count(gid)) continue;
+            const GroupRoute* route = RouteOf(best.parent_ip, gid);
+            result.push_back(ParentSelection{gid, best.parent_ip, best.secondary_ip,
+                                             route ? route->hops_to_source + 1 : -1});
+        }
+        return result;
+    }
 
 private:
-    /**
+    /**
      * @brief グループごとの最良ノードを追跡するための構造体。
      */
-    struct BestScore {
-        double score = -1.0;
-        std::string parent_ip;
-    };
+    struct BestScore {
+        double score = -1.0;
+        std::string parent_ip;
+        double secondary_score = -1.0; // 冗長モード時のセカンダリ親スコア
+        std::string secondary_ip;      // 冗長モード時のセカンダリ親IP
+    };
+
+    /**
+     * @brief バッチ適用待ちのADVERTISE。
+     */
+    struct PendingAdvertise {
+        AdvertiseMessage msg;
+        std::chrono::steady_clock::time_point arrival; // 受信時刻 (生存判定の学習に用いる)
+    };
+
+    /**
+     * @brief バッチ適用時の親候補 (pending_advertise_ 内の文字列を参照する)。
+     */
+    struct CandidateOffer {
+        const std::string* group_id;
+        const std::string* ip;
+        double score;
+        bool applied = false; // 現在の親のスコア更新として先に反映済み
+    };
+
+    std::map<std::string, PeerState> neighbor_nodes_; // IPアドレス -> PeerState
+    std::map<std::string, BestScore> best_scores_;    // GroupID -> BestScore
+
+    static constexpr int DEPARTURE_HOLD_SEC = 10; // 停止を予告したピアを親候補から外す時間 (秒)
+    // 親候補のスコアは深さを優先して比較する (深さ1段の差は品質スコアの取り得る幅を常に上回る)
+    static constexpr int DEPTH_SCORE_LEVELS = 65;          // 深さの段数 (設定できる最大深さ 64 + 1)
+    static constexpr double DEPTH_SCORE_STEP = 10000.0;    // 深さ1段あたりのスコア差
+    static constexpr double PARENT_SWITCH_MARGIN = 50.0;   // 同じ深さの候補へ切り替えるのに必要なスコア差
+
+    int failover_timeout_sec_ = 5; // 到着間隔の学習前に用いる HEARTBEAT タイムアウト時間 (秒)
+    PhiAccrualConfig detector_config_; // phi-accrual 障害検出器のパラメータ
+
+    NowFunction now_;                                    // 時刻の取得元 (未設定なら steady_clock)
+    ParentChangeHandler parent_change_handler_;          // プライマリ親の変更の通知先
+    std::string self_ip_;                                // 自ノードIP (ループ検出用)
+    std::map<std::string, uint32_t> source_groups_;      // 自ノードが送信元のグループ -> 発行済み経路シーケンス番号
+    std::map<std::string, std::chrono::steady_clock::time_point> departing_; // 停止を予告したピアIP -> 親候補に戻す時刻
+    int max_tree_depth_ = 8;                             // 配信ツリーの最大深さ (ホップ数)
+    uint32_t max_seq_lag_ = 3;                           // 送信元シーケンス番号が進まないまま許容するピアのADVERTISE数
+    bool redundant_mode_ = false;  // プライマリ/セカンダリの二重親配信を行うか
+    std::unordered_map<std::string, PendingAdvertise> pending_advertise_; // 送信元IP -> 最新の未適用ADVERTISE
+    std::vector<CandidateOffer> offer_buffer_;                           // バッチ適用時の作業領域
+    size_t pending_received_ = 0;                              // 前回の適用以降に受信したADVERTISE数
+    TopologyMetrics& metrics_ = TopologyMetrics::Get();
+
+    /**
+     * @brief 現在時刻を返す (仮想時計が設定されていればそれを用いる)。
+     */
+    std::chrono::steady_clock::time_point Now() const {
+        return now_ ? now_() : std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief ピアが停止を予告してから DEPARTURE_HOLD_SEC 以内か。
+     */
+    bool IsDeparting(const std::string& ip) const {
+        auto it = departing_.find(ip);
+        return it != departing_.end() && Now() < it->second;
+    }
 
-    std::map<std::string, PeerState> neighbor_nodes_; // IPアドレス -> PeerState
-    std::map<std::string, BestScore> best_scores_;    // GroupID -> BestScore
+    /**
+     * @brief 2つの親候補の経路が重ならない (一方の障害が他方に波及しない) かを判定する。
+     * 両者のパスベクトルが送信元以外のノードを共有しない場合に分離しているとみなす。
+     * 経路情報が未通知の場合は、別ノードであれば分離しているものとして扱う。
+     * @param a 候補ノードIP
+     * @param b 候補ノードIP
+     * @param group_id 判定対象のグループID
+     * @return 経路が分離していればtrue
+     */
+    bool IsDisjoint(const std::string& a, const std::string& b, const std::string& group_id) const {
+        if (a.empty() || b.empty()) return true;
+        if (a == b) return false;
+        const GroupRoute* route_a = RouteOf(a, group_id);
+        const GroupRoute* route_b = RouteOf(b, group_id);
+        if (!route_a || !route_b) return true;
+
+        // path[0] は共通の送信元のため比較対象から除く
+        for (size_t i = 1; i < route_a->path.size(); ++i) {
+            const auto& node = route_a->path[i];
+            if (std::find(route_b->path.begin() + 1, route_b->path.end(), node) != route_b->path.end()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief ピアが通知した、指定グループにおける送信元までの経路を返す。
+     * @return 経路 (未知のピア・未通知のグループ・経路なしの場合は nullptr)
+     */
+    const GroupRoute* RouteOf(const std::string& ip, const std::string& group_id) const {
+        auto it = neighbor_nodes_.find(ip);
+        if (it == neighbor_nodes_.end()) return nullptr;
+        auto route = it->second.routes.find(group_id);
+        if (route == it->second.routes.end() || route->second.hops_to_source < 0) return nullptr;
+        return &route->second;
+    }
 
-    int failover_timeout_sec_ = 5; // HEARTBEAT タイムアウト時間 (秒)
+    /**
+     * @brief ピアの経路が、自ノードの親として配信ツリーを構成できるかを判定する。
+     * 1. パスベクトルに自ノードが含まれる場合はループとなるため不可。
+     * 2. 自ノードの深さ (経路のホップ数 + 1) が最大深さを超える場合は不可。
+     * 3. ピアの通知する送信元シーケンス番号が max_seq_lag_ 回続けて進んでいない場合は、
+     *    送信元への経路を失ったピアが古い経路を通知し続けているとみなし不可。
+     *    比較はピア自身の直前の通知に対して行うため、送信元から遠いピアの伝播遅延は影響しない。
+     * @param peer 経路を通知したピア
+     * @param route ピアが通知した経路
+     * @param group_id 対象グループID
+     * @return 親候補として有効であればtrue
+     */
+    bool IsEligibleParent(const PeerState& peer, const GroupRoute& route, const std::string& group_id) const {
+        if (route.hops_to_source < 0 || route.path.empty()) return false;
+        if (!self_ip_.empty() &&
+            std::find(route.path.begin(), route.path.end(), self_ip_) != route.path.end()) {
+            return false;
+        }
+        if (route.hops_to_source + 1 > max_tree_depth_) return false;
+
+        auto stalls = peer.seq_stalls.find(group_id);
+        return stalls == peer.seq_stalls.end() || stalls->second < max_seq_lag_;
+    }
+
+    /**
+     * @brief 親候補として無効になったピアを、指定グループのプライマリ/セカンダリから外す。
+     * プライマリを外す場合、セカンダリがあれば昇格させる。
+     */
+    void DropCandidate(const std::string& group_id, const std::string& ip) {
+        auto it = best_scores_.find(group_id);
+        if (it == best_scores_.end()) return;
+        auto& best = it->second;
+
+        if (best.secondary_ip == ip) {
+            best.secondary_score = -1.0;
+            best.secondary_ip.clear();
+        }
+        if (best.parent_ip == ip) {
+            auto peer = neighbor_nodes_.find(ip);
+            if (peer != neighbor_nodes_.end()) peer->second.is_parent = false;
+
+            if (!best.secondary_ip.empty()) {
+                NotifyParentSwitch(group_id, ip, best.secondary_ip);
+                best.score = best.secondary_score;
+                best.parent_ip = best.secondary_ip;
+                best.secondary_score = -1.0;
+                best.secondary_ip.clear();
+            } else {
+                best_scores_.erase(it);
+            }
+        }
+    }
+
+    /**
+     * @brief ADVERTISEの内容をピア状態に反映し、グループごとに送信元シーケンス番号の停滞を数える。
+     * @param msg ADVERTISEメッセージ
+     * @param arrival 受信時刻
+     */
+    void ApplyAdvertise(const AdvertiseMessage& msg, std::chrono::steady_clock::time_point arrival) {
+        metrics_.advertise_applied.Add();
+        auto& peer = neighbor_nodes_[msg.ip];
+        peer.ip_address = msg.ip;
+        peer.metrics = msg.metrics;
+        peer.score = ComputeNodeScore(msg.metrics);
+        peer.last_advertise_time = arrival;
+        peer.control_detector.Heartbeat(arrival, detector_config_.window_size);
+        peer.groups = msg.groups;
+
+        // 前回の通知から進んでいなければ停滞として数える (初めて通知された経路は停滞なし)
+        std::map<std::string, uint32_t> stalls;
+        for (const auto& [gid, route] : msg.routes) {
+            if (route.hops_to_source < 0 || !msg.groups.count(gid)) continue;
+            auto previous = peer.routes.find(gid);
+            if (previous == peer.routes.end() || previous->second.hops_to_source < 0 ||
+                static_cast<int32_t>(route.source_seq - previous->second.source_seq) > 0) {
+                stalls[gid] = 0;
+            } else {
+                auto count = peer.seq_stalls.find(gid);
+                stalls[gid] = (count != peer.seq_stalls.end() ? count->second : 0) + 1;
+            }
+        }
+        peer.seq_stalls = std::move(stalls);
+        peer.routes = msg.routes;
+    }
+
+    /**
+     * @brief 送信元を指定グループの親候補として評価する。
+     * ループ・深さ超過・失効した経路を持つピアは、現在の親であっても外す。
+     * @param msg 送信元のADVERTISEメッセージ
+     * @param group_id 対象グループID
+     * @param score 親候補としてのスコア (出力)
+     * @return 親候補として有効であればtrue
+     */
+    bool ScoreCandidate(const AdvertiseMessage& msg, const std::string& group_id, double& score) {
+        if (source_groups_.count(group_id)) return false; // 自ノードがルートのグループでは親を持たない
+
+        auto route_it = msg.routes.find(group_id);
+        if (route_it == msg.routes.end() ||
+            !IsEligibleParent(neighbor_nodes_.at(msg.ip), route_it->second, group_id)) {
+            DropCandidate(group_id, msg.ip);
+            return false;
+        }
+        score = ComputeGroupScore(msg.metrics, route_it->second);
+        return true;
+    }
+
+    /**
+     * @brief プライマリ親の変更を記録し、ハンドラへ通知する。選定結果を更新する前に呼び出す。
+     * 新しい親から受信していなければ、以前に親だった時のメディアの学習を捨てる
+     * (残しておくと、選び直した直後にメディア途絶として障害と判定される)。
+     */
+    void NotifyParentSwitch(const std::string& group_id, const std::string& old_parent, const std::string& new_parent) {
+        if (!new_parent.empty() && !IsReceivingFrom(new_parent)) ResetMediaLiveness(new_parent);
+        metrics_.parent_switches.Add();
+        HCS_TRACE_INSTANT("topology", "topology.parent_switch");
+        if (parent_change_handler_) parent_change_handler_(group_id, old_parent, new_parent);
+    }
+
+    /**
+     * @brief 親候補のスコアを指定グループのプライマリ/セカンダリ選定に反映する。
+     * 現在のプライマリ/セカンダリからの通知はスコアを更新するだけとし、古いスコアのまま
+     * 他の候補を退け続けないようにする。同じ深さの候補への切り替えには PARENT_SWITCH_MARGIN の差を要する。
+     * @param group_id 対象グループID
+     * @param ip 候補ノードIP
+     * @param score 候補のスコア
+     */
+    void OfferCandidate(const std::string& group_id, const std::string& ip, double score) {
+        auto& best = best_scores_[group_id];
+
+        if (!best.parent_ip.empty() && ip == best.parent_ip) {
+            best.score = score;
+        } else if (!best.secondary_ip.empty() && ip == best.secondary_ip) {
+            best.secondary_score = score;
+        } else if (best.parent_ip.empty() || score > best.score + PARENT_SWITCH_MARGIN) {
+            if (redundant_mode_ && best.parent_ip != ip) {
+                // 旧プライマリは新プライマリと経路が分離していればセカンダリへ降格
+                if (!best.parent_ip.empty() && IsDisjoint(best.parent_ip, ip, group_id)) {
+                    best.secondary_score = best.score;
+                    best.secondary_ip = best.parent_ip;
+                } else if (!best.secondary_ip.empty() && !IsDisjoint(best.secondary_ip, ip, group_id)) {
+                    best.secondary_score = -1.0;
+                    best.secondary_ip.clear();
+                }
+            }
+            NotifyParentSwitch(group_id, best.parent_ip, ip);
+            best.score = score;
+            best.parent_ip = ip;
+            return;
+        } else {
+            if (redundant_mode_ && score > best.secondary_score && IsDisjoint(best.parent_ip, ip, group_id)) {
+                if (!IsReceivingFrom(ip)) ResetMediaLiveness(ip);
+                best.secondary_score = score;
+                best.secondary_ip = ip;
+            }
+            return;
+        }
+
+        // 更新後のスコアでセカンダリがプライマリを上回った場合は入れ替える
+        if (redundant_mode_ && !best.secondary_ip.empty() && best.secondary_score > best.score + PARENT_SWITCH_MARGIN) {
+            NotifyParentSwitch(group_id, best.parent_ip, best.secondary_ip);
+            std::swap(best.score, best.secondary_score);
+            std::swap(best.parent_ip, best.secondary_ip);
+        }
+    }
+
+    /**
+     * @brief 指定ピアをいずれかのグループでプライマリまたはセカンダリ親としているか (メディアを受信中か)。
+     */
+    bool IsReceivingFrom(const std::string& ip) const {
+        for (const auto& [gid, best] : best_scores_) {
+            if (best.parent_ip == ip || best.secondary_ip == ip) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 指定ピアが指定グループの現在のプライマリまたはセカンダリ親か。
+     */
+    bool IsSelectedParent(const std::string& group_id, const std::string& ip) const {
+        auto it = best_scores_.find(group_id);
+        return it != best_scores_.end() && (it->second.parent_ip == ip || it->second.secondary_ip == ip);
+    }
+
+    /**
+     * @brief グループ経路の深さを優先したノードスコアを計算する。
+     * そのピアを親とした場合の自ノードの深さで段を決め、同じ深さの候補どうしは品質 (ComputeNodeScore) で比べる。
+     * 品質は段の幅に収めるため、浅い候補は品質に関わらず深い候補より高いスコアとなる。
+     */
+    double ComputeGroupScore(const NodeMetrics& metrics, const GroupRoute& route) const {
+        NodeMetrics effective = metrics;
+        effective.hop_count = 0; // 深さは段で評価する
+        const int depth = std::min(route.hops_to_source + 1, DEPTH_SCORE_LEVELS);
+        const double quality = std::clamp(ComputeNodeScore(effective), 0.0, DEPTH_SCORE_STEP - 1.0);
+        return (DEPTH_SCORE_LEVELS - depth) * DEPTH_SCORE_STEP + quality;
+    }
 
-    /**
+    /**
      * @brief 複数のメトリクスに基づき、ノードの総合評価スコアを計算する。
      * @param metrics 評価対象のノードメトリクス
      * @return 計算されたスコア (高いほど優秀)
      */
-    double ComputeNodeScore(const NodeMetrics& metrics) const {
-        // スコア計算式 (調整可能):
-        // (低くあるべき) hop_count は減点、rtt_ms も減点
-        // (高くあるべき) bandwidth_score, stability_score は加点
-        double score = 1000.0 // ベーススコア
-                       - metrics.hop_count * 10.0
-                       + metrics.bandwidth_score * 5.0
-                       + metrics.stability_score * 2.0
-                       - metrics.rtt_ms * 0.1;
-        return score;
-    }
+    double ComputeNodeScore(const NodeMetrics& metrics) const {
+        // スコア計算式 (調整可能):
+        // (低くあるべき) hop_count は減点、rtt_ms も減点
+        // (高くあるべき) bandwidth_score, stability_score は加点
+        double score = 1000.0 // ベーススコア
+                       - metrics.hop_count * 10.0
+                       + metrics.bandwidth_score * 5.0
+                       + metrics.stability_score * 2.0
+                       - metrics.rtt_ms * 0.1;
+        return score;
+    }
 };
 
 } // namespace hcs_control
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include "TopologyManager.h"
+
+namespace hcs_control {
+
+/**
+ * @brief TopologyManager の状態を改行区切りJSON (NDJSON) として逐次出力するライタ。
+ *
+ * 1行が1スナップショットに対応し、ダッシュボード ("Interactive Network Topology Visualizer.html")
+ * で読み込んで再生できる。出力量を抑えるため、keyframe_interval 回に1回だけ全ピアを出力し
+ * ("full":true)、それ以外は前回出力から変化したピアと消えたピアのみを出力する。
+ * 親選定結果 ("parents") は小さいため毎回出力する。
+ *
+ * 行フォーマット:
+ * {"t":<UNIX時刻ms>,"node":"<自ノードIP>","full":<bool>,
+ *  "peers":[{"ip":..,"score":..,"hop":..,"bw":..,"stab":..,"rtt":..,"phi":..,"groups":[..]}],
+ *  "gone":["<ip>",..],
+ *  "parents":[{"g":"<GroupID>","p":"<primary>","s":"<secondary>","d":<depth>}]}
+ */
+class TopologySnapshotWriter {
+public:
+    /**
+     * @brief 出力ファイルを開いてライタを作成する (追記モード)。
+     * 名前付きパイプ (FIFO) を指定すれば、ダッシュボード側のプロセスへ直接ストリーミングできる。
+     * @param path 出力先ファイルパス
+     * @param keyframe_interval 全ピアを出力する間隔 (スナップショット数)
+     */
+    explicit TopologySnapshotWriter(const std::string& path, size_t keyframe_interval = 50)
+        : file_(std::make_unique<std::ofstream>(path, std::ios::out | std::ios::app)),
+          out_(file_.get()),
+          keyframe_interval_(keyframe_interval == 0 ? 1 : keyframe_interval)
+    {
+        if (!*file_) {
+            throw std::runtime_error("[SnapshotWriter] Failed to open snapshot file: " + path);
+        }
+    }
+
+    /**
+     * @brief 既存のストリームへ出力するライタを作成する。
+     * シミュレータなどで複数ノードのスナップショットを1本のストリームにまとめる場合に用いる。
+     * @param out 出力先ストリーム (ライタより長く生存すること)
+     * @param keyframe_interval 全ピアを出力する間隔 (スナップショット数)
+     */
+    explicit TopologySnapshotWriter(std::ostream& out, size_t keyframe_interval = 50)
+        : out_(&out),
+          keyframe_interval_(keyframe_interval == 0 ? 1 : keyframe_interval) {}
+
+    /**
+     * @brief 現在のトポロジー状態を1行出力する。
+     * @param topology 出力対象のトポロジーマネージャ
+     * @param now_ms スナップショット時刻 (UNIX時刻ms、負値の場合は現在時刻)
+     */
+    void Write(const TopologyManager& topology, long long now_ms = -1) {
+        if (now_ms < 0) {
+            now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        const bool full = (snapshot_count_++ % keyframe_interval_) == 0;
+
+        std::string line;
+        line.reserve(256);
+        line += "{\"t\":" + std::to_string(now_ms);
+        line += ",\"node\":";
+        AppendString(line, topology.GetSelfIp());
+        line += full ? ",\"full\":true" : ",\"full\":false";
+
+        // --- ピア (キーフレームでは全件、それ以外は変化分のみ) ---
+        line += ",\"peers\":[";
+        bool first = true;
+        std::map<std::string, Signature> current;
+        for (const auto& [ip, peer] : topology.GetPeers()) {
+            const double phi = topology.GetPhi(ip);
+            Signature sig = MakeSignature(peer, phi);
+            auto prev = last_written_.find(ip);
+            if (full || prev == last_written_.end() || !(prev->second == sig)) {
+                if (!first) line += ',';
+                first = false;
+                AppendPeer(line, peer, phi);
+            }
+            current.emplace(ip, std::move(sig));
+        }
+        line += ']';
+
+        // --- 前回から消えたピア ---
+        line += ",\"gone\":[";
+        first = true;
+        for (const auto& [ip, sig] : last_written_) {
+            if (current.count(ip)) continue;
+            if (!first) line += ',';
+            first = false;
+            AppendString(line, ip);
+        }
+        line += ']';
+        last_written_ = std::move(current);
+
+        // --- グループごとの親選定 ---
+        line += ",\"parents\":[";
+        first = true;
+        for (const auto& sel : topology.GetParentSelections()) {
+            if (!first) line += ',';
+            first = false;
+            line += "{\"g\":";
+            AppendString(line, sel.group_id);
+            line += ",\"p\":";
+            AppendString(line, sel.primary_ip);
+            line += ",\"s\":";
+            AppendString(line, sel.secondary_ip);
+            line += ",\"d\":" + std::to_string(sel.depth) + '}';
+        }
+        line += "]}\n";
+
+        out_->write(line.data(), static_cast<std::streamsize>(line.size()));
+        out_->flush();
+    }
+
+private:
+    /**
+     * @brief 差分判定用のピア状態の要約。phi は連続的に変化するため整数に量子化する。
+     */
+    struct Signature {
+        double score = 0.0;
+        NodeMetrics metrics;
+        int phi_level = 0;
+        std::set<std::string> groups;
+
+        bool operator==(const Signature& o) const {
+            return score == o.score && metrics.hop_count == o.metrics.hop_count &&
+                   metrics.bandwidth_score == o.metrics.bandwidth_score &&
+                   metrics.stability_score == o.metrics.stability_score &&
+                   metrics.rtt_ms == o.metrics.rtt_ms && phi_level == o.phi_level &&
+                   groups == o.groups;
+        }
+    };
+
+    std::unique_ptr<std::ofstream> file_; // パス指定時のみ所有する出力ファイル
+    std::ostream* out_;
+    size_t keyframe_interval_;
+    size_t snapshot_count_ = 0;
+    std::map<std::string, Signature> last_written_; // IP -> 最後に出力したピア状態
+
+    static Signature MakeSignature(const PeerState& peer, double phi) {
+        Signature sig;
+        sig.score = peer.score;
+        sig.metrics = peer.metrics;
+        sig.phi_level = static_cast<int>(std::min(phi, 99.0));
+        sig.groups = peer.groups;
+        return sig;
+    }
+
+    static void AppendPeer(std::string& line, const PeerState& peer, double phi) {
+        char num[64];
+        line += "{\"ip\":";
+        AppendString(line, peer.ip_address);
+        std::snprintf(num, sizeof(num), ",\"score\":%.1f", peer.score);
+        line += num;
+        line += ",\"hop\":" + std::to_string(peer.metrics.hop_count);
+        line += ",\"bw\":" + std::to_string(peer.metrics.bandwidth_score);
+        line += ",\"stab\":" + std::to_string(peer.metrics.stability_score);
+        line += ",\"rtt\":" + std::to_string(peer.metrics.rtt_ms);
+        std::snprintf(num, sizeof(num), ",\"phi\":%.1f", std::isfinite(phi) ? std::min(phi, 99.0) : 99.0);
+        line += num;
+        line += ",\"groups\":[";
+        bool first = true;
+        for (const auto& gid : peer.groups) {
+            if (!first) line += ',';
+            first = false;
+            AppendString(line, gid);
+        }
+        line += "]}";
+    }
+
+    /**
+     * @brief JSON文字列としてエスケープして追加する。
+     */
+    static void AppendString(std::string& line, const std::string& value) {
+        line += '"';
+        for (char c : value) {
+            switch (c) {
+                case '"':  line += "\\\""; break;
+                case '\\': line += "\\\\"; break;
+                case '\n': line += "\\n"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char esc[8];
+                        std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                        line += esc;
+                    } else {
+                        line += c;
+                    }
+            }
+        }
+        line += '"';
+    }
+};
+
+} // namespace hcs_control
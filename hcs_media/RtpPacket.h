@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hcs_common/Logger.h"
+#include "hcs_common/PacketBuffer.h"
+
+namespace hcs_media {
+
+constexpr size_t RTP_HEADER_SIZE = 12;        ///< RTP 固定ヘッダー長 (CSRC・拡張なし)
+constexpr uint8_t RTP_PAYLOAD_TYPE_VIDEO = 96; ///< 映像ストリームの動的ペイロードタイプ
+
+/**
+ * @brief 疑似RTPパケットを書き込む
+ * (実際はFFmpegのAVPacketをRTPパケットに変換するロジックが入る)
+ * @param packet 出力先 (RTP_HEADER_SIZE + frame_size バイト)
+ * @param frame_size ペイロードサイズ
+ * @param rtp_timestamp キャプチャ時刻 (90kHz、受信側で kNetwork の計測に用いる)
+ */
+inline void WriteDummyRtpPacket(uint8_t* packet, size_t frame_size, uint32_t rtp_timestamp) {
+    // 最小限のRTPヘッダー (12バイト) + ダミーペイロード
+    // V=2, P=0, X=0, CC=0, M=0, PT=96 (Dynamic), SeqNum, Timestamp, SSRC
+
+    // 0: V=2, P=0, X=0, CC=0
+    packet[0] = 0x80;
+    // 1: PT=96 (ペイロードタイプ)
+    packet[1] = RTP_PAYLOAD_TYPE_VIDEO;
+    // 2-3: シーケンス番号 (ここではダミー値を設定)
+    packet[2] = 0x00;
+    packet[3] = 0x01;
+    // 4-7: タイムスタンプ
+    packet[4] = static_cast<uint8_t>(rtp_timestamp >> 24);
+    packet[5] = static_cast<uint8_t>(rtp_timestamp >> 16);
+    packet[6] = static_cast<uint8_t>(rtp_timestamp >> 8);
+    packet[7] = static_cast<uint8_t>(rtp_timestamp);
+    // 8-11: SSRC
+    packet[8] = 0xDE;
+    packet[9] = 0xAD;
+    packet[10] = 0xBE;
+    packet[11] = 0xEF;
+
+    // ダミーペイロードの充填
+    // (実際はFFmpegエンコーダからのH.265/VP9 NALUが入る)
+    std::fill(packet + RTP_HEADER_SIZE, packet + RTP_HEADER_SIZE + frame_size, 0xAA);
+}
+
+/**
+ * @brief 疑似RTPパケットを生成する
+ * @param frame_size ペイロードサイズ
+ * @param rtp_timestamp キャプチャ時刻 (90kHz)
+ * @return RTPヘッダーとダミーペイロードを連結したパケット
+ */
+inline std::vector<uint8_t> CreateDummyRtpPacket(size_t frame_size, uint32_t rtp_timestamp) {
+    std::vector<uint8_t> packet(RTP_HEADER_SIZE + frame_size);
+    WriteDummyRtpPacket(packet.data(), frame_size, rtp_timestamp);
+    return packet;
+}
+
+/**
+ * @brief 疑似RTPパケットを呼び出し元スレッドのプールのバッファに生成する (ヒープ確保なし)
+ * @param frame_size ペイロードサイズ
+ * @param rtp_timestamp キャプチャ時刻 (90kHz)
+ * @throw std::length_error バッファに収まらない場合
+ */
+inline hcs_common::PacketRef AcquireDummyRtpPacket(size_t frame_size, uint32_t rtp_timestamp) {
+    hcs_common::PacketRef packet = hcs_common::PacketPool::Local().Acquire();
+    WriteDummyRtpPacket(packet->Append(RTP_HEADER_SIZE + frame_size), frame_size, rtp_timestamp);
+    return packet;
+}
+
+/**
+ * @brief RTPパケットからペイロードとヘッダー情報を抽出する (疑似)
+ * @param rtp_packet 受信したRTPパケットデータ
+ * @param size パケットのサイズ
+ * @param payload_offset RTPヘッダーサイズ（ここでは固定12バイトとする）
+ * @return RTPペイロードへのポインタ
+ */
+inline const uint8_t* ParseRtpHeader(const uint8_t* rtp_packet, size_t size, size_t& payload_offset) {
+    if (size < RTP_HEADER_SIZE) {
+        // パケットがRTPヘッダーの最小長に満たない
+        return nullptr;
+    }
+
+    // 実際のロジックでは、V, P, X, CC, M, PT, SeqNum, Timestamp, SSRCなどを解析する
+    uint8_t version = (rtp_packet[0] >> 6) & 0x03; // バージョン (期待値: 2)
+    uint8_t payload_type = rtp_packet[1] & 0x7F; // ペイロードタイプ (例: 96)
+
+    // ここでは簡易的にRTPヘッダーを12バイトとして固定
+    payload_offset = RTP_HEADER_SIZE;
+
+    HCS_LOG_TRACE("Decoder", "RTP Packet received. Version: {}, PT: {}", version, payload_type);
+
+    return rtp_packet + payload_offset;
+}
+
+inline const uint8_t* ParseRtpHeader(const std::vector<uint8_t>& rtp_packet, size_t& payload_offset) {
+    return ParseRtpHeader(rtp_packet.data(), rtp_packet.size(), payload_offset);
+}
+
+/**
+ * @brief RTPタイムスタンプ (送信側のキャプチャ時刻) を読み出す。
+ * @param rtp_packet RTPヘッダー長以上のパケット
+ */
+inline uint32_t RtpTimestamp(const uint8_t* rtp_packet) {
+    return (uint32_t(rtp_packet[4]) << 24) | (uint32_t(rtp_packet[5]) << 16) |
+           (uint32_t(rtp_packet[6]) << 8) | uint32_t(rtp_packet[7]);
+}
+
+inline uint32_t RtpTimestamp(const std::vector<uint8_t>& rtp_packet) {
+    return RtpTimestamp(rtp_packet.data());
+}
+
+/**
+ * @brief SSRC (ストリームの識別子) を読み出す。
+ * @param rtp_packet RTPヘッダー長以上のパケット
+ */
+inline uint32_t RtpSsrc(const uint8_t* rtp_packet) {
+    return (uint32_t(rtp_packet[8]) << 24) | (uint32_t(rtp_packet[9]) << 16) |
+           (uint32_t(rtp_packet[10]) << 8) | uint32_t(rtp_packet[11]);
+}
+
+/**
+ * @brief SSRC を書き換える。
+ * @param rtp_packet RTPヘッダー長以上のパケット
+ */
+inline void SetRtpSsrc(uint8_t* rtp_packet, uint32_t ssrc) {
+    rtp_packet[8] = static_cast<uint8_t>(ssrc >> 24);
+    rtp_packet[9] = static_cast<uint8_t>(ssrc >> 16);
+    rtp_packet[10] = static_cast<uint8_t>(ssrc >> 8);
+    rtp_packet[11] = static_cast<uint8_t>(ssrc);
+}
+
+/**
+ * @brief PacketPipeline (hcs_net/PacketPipeline.h) の振り分け段。
+ * RTPヘッダーに満たないパケットとバージョンが2でないパケットを破棄し、
+ * ペイロードタイプが映像のものは次段へ、それ以外 (RTCP など) は other へ渡す。
+ * @tparam Other 映像以外のパケットの処理 (PacketRef と送信元を受け取る呼び出し可能オブジェクト)
+ */
+template <typename Other>
+class RtpDemuxStage {
+public:
+    explicit RtpDemuxStage(Other other, uint8_t media_payload_type = RTP_PAYLOAD_TYPE_VIDEO)
+        : other_(std::move(other)), media_payload_type_(media_payload_type) {}
+
+    template <typename Endpoint, typename Next>
+    void operator()(hcs_common::PacketRef packet, const Endpoint& sender, Next& next) {
+        const uint8_t* data = packet->Data();
+        if (packet->Size() < RTP_HEADER_SIZE || (data[0] >> 6) != 2) {
+            ++dropped_;
+            return;
+        }
+        if ((data[1] & 0x7F) == media_payload_type_) {
+            next(std::move(packet), sender);
+        } else {
+            other_(std::move(packet), sender);
+        }
+    }
+
+    /**
+     * @brief RTPとして解釈できずに破棄したパケット数
+     */
+    uint64_t Dropped() const { return dropped_; }
+
+private:
+    Other other_;
+    uint8_t media_payload_type_;
+    uint64_t dropped_ = 0;
+};
+
+/**
+ * @brief RtpDemuxStage を作る (Other の型を推論させるため)
+ */
+template <typename Other>
+RtpDemuxStage<std::decay_t<Other>> MakeRtpDemuxStage(Other&& other, uint8_t media_payload_type = RTP_PAYLOAD_TYPE_VIDEO) {
+    return RtpDemuxStage<std::decay_t<Other>>(std::forward<Other>(other), media_payload_type);
+}
+
+} // namespace hcs_media
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "hcs_common/InplaceFunction.h"
+#include "hcs_common/PacketBuffer.h"
+#include "hcs_common/PipelineLatency.h"
+#include "hcs_net/TransportBase.h" // IMediaTransport, Endpoint
+
+namespace hcs_media {
+
+/**
+ * @brief メディアの受信側 (トランスポートで復号済みの RTP → 解析 → デコーダへの投入)。
+ * IMediaTransport の受信ハンドラとして登録され、受信した RTP パケットを処理する。
+ * 全メソッドは io_context のスレッドから呼び出すことを前提とする。
+ */
+class StreamDecoder : public std::enable_shared_from_this<StreamDecoder> {
+public:
+    /// 相乗りした制御メッセージを RTP パケットから取り出す処理 (ControlPiggyback::ExtractFrom)。パケットごとに呼ばれる
+    using ControlExtractor = hcs_common::InplaceFunction<void(hcs_common::PacketBuffer&, const hcs_net::Endpoint&)>;
+    /// 解析済みの RTP パケット (復号済みのバッファとペイロードの位置) の受け取り。パケットごとに呼ばれる
+    using PayloadHandler = hcs_common::InplaceFunction<void(const hcs_common::PacketBuffer&, size_t)>;
+
+    /**
+     * @brief コンストラクタ
+     * @param group_id 受信するグループID (ログ出力用)
+     */
+    explicit StreamDecoder(const std::string& group_id = "");
+    ~StreamDecoder();
+
+    /**
+     * @brief トランスポートの受信ハンドラとして登録し、受信を開始する
+     * @param transport 受信に用いるトランスポート (ソケットはここで受信を開始する)
+     */
+    void StartDecoding(std::shared_ptr<hcs_net::IMediaTransport> transport);
+
+    /**
+     * @brief 受信したパケットの処理を停止する (以降に届いたパケットは破棄する)
+     */
+    void Stop();
+
+    /**
+     * @brief 相乗りした制御メッセージの取り出し処理を設定する
+     */
+    void SetControlExtractor(ControlExtractor extractor);
+
+    /**
+     * @brief 解析済みの RTP パケットの受け取り処理を設定する (デコーダへの投入と並べて呼ぶ)
+     */
+    void SetPayloadHandler(PayloadHandler handler);
+
+private:
+    std::shared_ptr<hcs_net::IMediaTransport> transport_;
+    std::string group_id_;
+    ControlExtractor control_extractor_;
+    PayloadHandler payload_handler_;
+    bool decoding_ = false;
+
+    void HandlePacket(hcs_common::PacketRef packet, const hcs_net::Endpoint& sender);
+    void ProcessReceivedPacket(hcs_common::PacketBuffer& packet, const hcs_net::Endpoint& sender,
+                               hcs_common::PacketTiming& timing);
+};
+
+} // namespace hcs_media
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <boost/asio.hpp>
+#include "hcs_common/InplaceFunction.h"
+#include "hcs_common/PacketBuffer.h"
+#include "hcs_net/TransportBase.h" // IMediaTransport, Endpoint
+
+namespace hcs_net {
+class ControlPiggyback;
+}
+
+namespace hcs_media {
+
+/**
+ * @brief メディアの送信側 (エンコード → RTP パケット化 → トランスポートへの送信)。
+ * フレーム間隔ごとにフレームを処理し、RTP パケットを IMediaTransport に渡して暗号化・送信させる。
+ * 全メソッドは io_context のスレッドから呼び出すことを前提とする。
+ */
+class StreamEncoder : public std::enable_shared_from_this<StreamEncoder> {
+public:
+    /// 平文の RTP パケットを受け取る送信先 (暗号化と宛先の選択は呼び出し側が行う)
+    using PacketSink = hcs_common::InplaceFunction<void(hcs_common::PacketRef)>;
+
+    /**
+     * @brief コンストラクタ
+     * @param io_context フレームのタイマーを駆動する I/O コンテキスト
+     */
+    explicit StreamEncoder(boost::asio::io_context& io_context);
+    ~StreamEncoder();
+
+    /**
+     * @brief 送信に用いるトランスポートを設定する (StartPublishing の前に呼ぶ)
+     */
+    void SetTransport(std::shared_ptr<hcs_net::IMediaTransport> transport);
+
+    /**
+     * @brief 送信先を設定する
+     */
+    void SetDestination(const hcs_net::Endpoint& dest);
+
+    /**
+     * @brief RTP パケットをトランスポートではなく sink に渡す (StartPublishing の前に呼ぶ)。
+     * HCSNode が購読中の子ノードへ配る場合に使う。宛先が1つに決まらないため制御メッセージは相乗りさせない。
+     */
+    void SetPacketSink(PacketSink sink);
+
+    /**
+     * @brief 送信する RTP パケットに、同じ宛先への保留中の制御メッセージを相乗りさせる
+     */
+    void SetControlPiggyback(std::shared_ptr<hcs_net::ControlPiggyback> piggyback);
+
+    /**
+     * @brief フレーム間隔を設定する (次にスケジュールするフレームから反映される)
+     */
+    void SetFrameInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief フレーム処理のループを開始する (トランスポートと送信先、または sink が設定済みであること)
+     */
+    void StartPublishing();
+
+    /**
+     * @brief フレーム処理を停止する (送信済みのパケットの完了は待たない)
+     */
+    void Stop();
+
+    /**
+     * @brief フレーム処理のループが動作中か
+     */
+    bool Publishing() const { return publishing_; }
+
+private:
+    boost::asio::io_context& io_context_;
+    std::shared_ptr<hcs_net::IMediaTransport> transport_;
+    hcs_net::Endpoint dest_endpoint_;
+    std::shared_ptr<hcs_net::ControlPiggyback> piggyback_;
+    PacketSink sink_;
+    boost::asio::steady_timer encoding_timer_;
+    std::chrono::milliseconds frame_interval_{33}; // 約 30 FPS
+    bool publishing_ = false;
+
+    void HandleEncodingTimer(const boost::system::error_code& ec);
+    void ProcessNextFrame();
+    void SendRtpPacket(hcs_common::PacketRef rtp_packet);
+};
+
+} // namespace hcs_media
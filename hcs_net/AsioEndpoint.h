@@ -0,0 +1,48 @@
+#pragma once
+
+#include <boost/asio/ip/udp.hpp>
+#include "common.h"
+
+/**
+ * @namespace hcs_net
+ * @brief HCSノードのネットワーク関連コンポーネントを格納する名前空間
+ */
+namespace hcs_net {
+
+/**
+ * @brief Endpoint を Boost.Asio の UDP エンドポイントに変換する (バイト列の複製のみで、文字列を経由しない)。
+ * IPv4 (射影アドレス) は IPv4 のエンドポイントに戻す (IPv4 ソケットから送信するため)。
+ */
+inline boost::asio::ip::udp::endpoint ToUdpEndpoint(const Endpoint& ep) {
+    if (ep.IsV4()) {
+        boost::asio::ip::address_v4::bytes_type bytes;
+        std::memcpy(bytes.data(), ep.V4Bytes(), bytes.size());
+        return boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(bytes), ep.port);
+    }
+    boost::asio::ip::address_v6::bytes_type bytes;
+    std::memcpy(bytes.data(), ep.address.data(), bytes.size());
+    return boost::asio::ip::udp::endpoint(boost::asio::ip::address_v6(bytes, ep.scope_id), ep.port);
+}
+
+/**
+ * @brief Endpoint をデュアルスタック (IPv6) ソケット用の UDP エンドポイントに変換する。
+ * IPv4 は IPv4 射影アドレスのまま IPv6 として扱う。
+ */
+inline boost::asio::ip::udp::endpoint ToUdpEndpointV6(const Endpoint& ep) {
+    boost::asio::ip::address_v6::bytes_type bytes;
+    std::memcpy(bytes.data(), ep.address.data(), bytes.size());
+    return boost::asio::ip::udp::endpoint(boost::asio::ip::address_v6(bytes, ep.scope_id), ep.port);
+}
+
+/**
+ * @brief Boost.Asio の UDP エンドポイントを Endpoint に変換する (受信時の送信元)。
+ * IPv4 と、デュアルスタックソケットで受信した IPv4 射影アドレスは同じ Endpoint になる。
+ */
+inline Endpoint FromUdpEndpoint(const boost::asio::ip::udp::endpoint& ep) {
+    const boost::asio::ip::address address = ep.address();
+    if (address.is_v4()) return Endpoint::FromV4Bytes(address.to_v4().to_bytes().data(), ep.port());
+    const boost::asio::ip::address_v6 v6 = address.to_v6();
+    return Endpoint::FromV6Bytes(v6.to_bytes().data(), ep.port(), v6.scope_id());
+}
+
+} // namespace hcs_net
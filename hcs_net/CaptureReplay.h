@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "PacketCapture.h"
+
+/**
+ * @namespace hcs_net
+ * @brief HCSノードのネットワーク関連コンポーネントを格納する名前空間
+ */
+namespace hcs_net {
+
+/**
+ * @brief PacketCapture が書き出した pcapng ファイルを読み込む。
+ *
+ * 生の IPv4/IPv6 (リンク種別 101) の UDP パケットを含む拡張パケットブロックのみを扱い、
+ * 送信元・宛先を合成ヘッダーから復元する。他のブロックと UDP 以外のパケットは読み飛ばす。
+ * バイト順はセクションヘッダーのマジックで判定する (他の環境で書き出したファイルも読める)。
+ */
+class PcapngReader {
+public:
+    /**
+     * @brief ファイルを開き、セクションヘッダーを検証する
+     * @param path pcapng ファイルのパス
+     * @throw std::runtime_error 開けない、または pcapng でない場合
+     */
+    explicit PcapngReader(const std::string& path) : in_(path, std::ios::binary) {
+        if (!in_) throw std::runtime_error("Failed to open capture file: " + path);
+        uint32_t type = 0;
+        if (!in_.read(reinterpret_cast<char*>(&type), sizeof(type)) || type != 0x0A0D0D0A) {
+            throw std::runtime_error("Not a pcapng file: " + path);
+        }
+        in_.seekg(0);
+    }
+
+    /**
+     * @brief 次の UDP パケットを読む
+     * @param packet 読み込んだパケットの出力先
+     * @return 読み込んだ場合はtrue、ファイルの終端ではfalse
+     * @throw std::runtime_error ブロックが壊れている場合
+     */
+    bool Next(CapturedPacket& packet) {
+        std::vector<uint8_t> body;
+        for (;;) {
+            uint32_t header[2];
+            if (!in_.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+            uint32_t type = header[0];
+            if (type == 0x0A0D0D0A) {
+                // セクションヘッダー: 長さの前にバイト順マジックを読み、以降のバイト順を決める
+                uint32_t magic = 0;
+                if (!in_.read(reinterpret_cast<char*>(&magic), sizeof(magic))) return false;
+                if (magic == 0x1A2B3C4D) swap_ = false;
+                else if (magic == 0x4D3C2B1A) swap_ = true;
+                else throw std::runtime_error("Invalid pcapng byte-order magic.");
+                in_.seekg(-4, std::ios::cur);
+            } else {
+                type = Get32(header[0]);
+            }
+            const uint32_t total = Get32(header[1]);
+            if (total < 12 || total % 4 != 0) throw std::runtime_error("Corrupt pcapng block length.");
+            body.resize(total - 12);
+            uint32_t trailer = 0;
+            if (!in_.read(reinterpret_cast<char*>(body.data()), static_cast<std::streamsize>(body.size())) ||
+                !in_.read(reinterpret_cast<char*>(&trailer), sizeof(trailer))) {
+                throw std::runtime_error("Truncated pcapng block.");
+            }
+            if (type == 0x00000006 && ParseEnhancedPacket(body, packet)) return true;
+        }
+    }
+
+    /**
+     * @brief 全パケットを読み込む
+     */
+    std::vector<CapturedPacket> ReadAll() {
+        std::vector<CapturedPacket> packets;
+        CapturedPacket packet;
+        while (Next(packet)) packets.push_back(packet);
+        return packets;
+    }
+
+private:
+    std::ifstream in_;
+    bool swap_ = false;
+
+    uint32_t Get32(uint32_t v) const { return swap_ ? __builtin_bswap32(v) : v; }
+    uint16_t Get16(uint16_t v) const { return swap_ ? __builtin_bswap16(v) : v; }
+
+    uint32_t Read32(const uint8_t* p) const {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return Get32(v);
+    }
+
+    uint16_t Read16(const uint8_t* p) const {
+        uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return Get16(v);
+    }
+
+    static uint16_t ReadBE16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+
+    bool ParseEnhancedPacket(const std::vector<uint8_t>& body, CapturedPacket& packet) const {
+        if (body.size() < 20) return false;
+        const uint32_t interface_id = Read32(body.data());
+        const uint64_t ts = (static_cast<uint64_t>(Read32(body.data() + 4)) << 32) | Read32(body.data() + 8);
+        const uint32_t captured = Read32(body.data() + 12);
+        const uint32_t original = Read32(body.data() + 16);
+        const size_t padded = (static_cast<size_t>(captured) + 3) & ~size_t{3};
+        if (20 + padded > body.size()) return false;
+        const uint8_t* ip = body.data() + 20;
+
+        size_t header = 0;
+        if (captured >= CAPTURE_IPV4_UDP_HEADER && (ip[0] >> 4) == 4 && ip[9] == 17) {
+            header = static_cast<size_t>(ip[0] & 0x0F) * 4 + 8;
+            if (captured < header) return false;
+            packet.source = Endpoint::FromV4Bytes(ip + 12, ReadBE16(ip + header - 8));
+            packet.destination = Endpoint::FromV4Bytes(ip + 16, ReadBE16(ip + header - 6));
+        } else if (captured >= CAPTURE_IPV6_UDP_HEADER && (ip[0] >> 4) == 6 && ip[6] == 17) {
+            header = CAPTURE_IPV6_UDP_HEADER;
+            packet.source = Endpoint::FromV6Bytes(ip + 8, ReadBE16(ip + 40));
+            packet.destination = Endpoint::FromV6Bytes(ip + 24, ReadBE16(ip + 42));
+        } else {
+            return false;
+        }
+
+        packet.point = interface_id == 1 ? CapturePoint::kPlaintext : CapturePoint::kWire;
+        packet.timestamp_ns = static_cast<int64_t>(ts);  // PacketCapture の出力はナノ秒分解能
+        packet.original_length = original >= header ? static_cast<uint32_t>(original - header) : 0;
+        packet.payload.assign(ip + header, ip + captured);
+
+        // オプションから epb_flags (向き) を探す。無い場合は受信として扱う
+        packet.direction = CaptureDirection::kInbound;
+        size_t offset = 20 + padded;
+        while (offset + 4 <= body.size()) {
+            const uint16_t code = Read16(body.data() + offset);
+            const uint16_t length = Read16(body.data() + offset + 2);
+            if (code == 0) break;
+            if (code == 2 && length == 4 && offset + 8 <= body.size()) {
+                const uint32_t flags = Read32(body.data() + offset + 4);
+                if ((flags & 0x3) == static_cast<uint32_t>(CaptureDirection::kOutbound)) {
+                    packet.direction = CaptureDirection::kOutbound;
+                }
+            }
+            offset += 4 + ((static_cast<size_t>(length) + 3) & ~size_t{3});
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief キャプチャしたパケットを受信パケットとして再生するトランスポート。
+ *
+ * TransportAES256 の基底トランスポートとして使うと、記録した暗号文 (kWire) を実際の復号処理と
+ * 受信処理の連鎖に通して、障害時の受信側の挙動をオフラインで再現できる。
+ * 平文 (kPlaintext) を再生する場合は受信処理へ直接接続する。送信は記録のみで、どこにも送らない。
+ */
+class CaptureReplayTransport : public Transport {
+public:
+    explicit CaptureReplayTransport(std::vector<CapturedPacket> packets) : packets_(std::move(packets)) {}
+
+    void Start() override {}
+    void Stop() override {}
+
+    void Send(const std::vector<uint8_t>& data, const Endpoint& destination) override {
+        (void)data;
+        (void)destination;
+        ++sent_;
+    }
+
+    void SendPacket(hcs_common::PacketRef packet, const Endpoint& destination) override {
+        (void)packet;
+        (void)destination;
+        ++sent_;
+    }
+
+    void SetReceiveCallback(ReceiveCallback callback) override { receive_callback_ = std::move(callback); }
+
+    void SetPacketCallback(PacketCallback callback) override { packet_callback_ = std::move(callback); }
+
+    /**
+     * @brief 指定した位置で受信したパケットを記録順に受信コールバックへ渡す
+     * @param point 再生するキャプチャ位置
+     * @param local 受信ノードのエンドポイントで絞り込む場合に指定する (ポート0の場合は全て再生する)
+     * @return 再生したパケット数
+     */
+    size_t Replay(CapturePoint point, const Endpoint& local = Endpoint()) {
+        size_t replayed = 0;
+        for (const auto& packet : packets_) {
+            if (packet.point != point || packet.direction != CaptureDirection::kInbound) continue;
+            if (local.port != 0 && packet.destination != local) continue;
+            if (packet_callback_ && packet.payload.size() <= hcs_common::PACKET_BUFFER_SIZE - hcs_common::PACKET_HEADROOM) {
+                packet_callback_(hcs_common::PacketPool::Local().CopyFrom(packet.payload.data(), packet.payload.size()),
+                                 packet.source);
+            } else if (receive_callback_) {
+                receive_callback_(packet.payload, packet.source);
+            }
+            ++replayed;
+        }
+        return replayed;
+    }
+
+    const std::vector<CapturedPacket>& Packets() const { return packets_; }
+    size_t SentCount() const { return sent_; }
+
+private:
+    std::vector<CapturedPacket> packets_;
+    ReceiveCallback receive_callback_;
+    PacketCallback packet_callback_;
+    size_t sent_ = 0;
+};
+
+} // namespace hcs_net
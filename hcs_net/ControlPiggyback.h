@@ -0,0 +1,451 @@
+#pragma once
+
+#include "common.h"
+#include "hcs_common/Logger.h"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace hcs_net {
+
+// --- RTPヘッダー拡張による制御メッセージの相乗り (ピギーバック) ---
+constexpr uint8_t PIGGYBACK_EXTENSION_ID = 10;     ///< HCS制御メッセージを運ぶ拡張要素のID (RFC 8285 two-byte header)
+constexpr uint8_t PIGGYBACK_ORIGIN_EXTENSION_ID = 11; ///< 制御メッセージを載せたノードのアドレス (16バイト) を運ぶ拡張要素のID
+constexpr size_t PIGGYBACK_ORIGIN_SIZE = 2 + 16;    ///< 送信元の拡張要素 (要素ヘッダーとアドレス) の長さ
+constexpr uint16_t RTP_TWO_BYTE_EXT_PROFILE = 0x1000; ///< RFC 8285 two-byte header 形式の拡張プロファイル
+constexpr size_t MAX_PIGGYBACK_BYTES = 256;        ///< 1つのメディアパケットに載せる制御データの上限 (MTU超過を防ぐ)
+/// 相乗りできるメッセージの最大長。拡張ヘッダー (4)、送信元の要素、要素ヘッダー (2) を加えても MAX_PIGGYBACK_BYTES に
+/// 収まる長さとし、単独では載らないメッセージがキューの先頭を塞がないようにする (拡張要素の長さの上限 255 より小さい)
+constexpr size_t MAX_PIGGYBACK_MESSAGE_SIZE = MAX_PIGGYBACK_BYTES - 4 - PIGGYBACK_ORIGIN_SIZE - 2;
+constexpr size_t RTP_FIXED_HEADER_SIZE = 12;
+
+/**
+ * @brief ピギーバックの統計。
+ */
+struct PiggybackStats {
+    uint64_t piggybacked = 0; // メディアパケットに相乗りさせた制御メッセージ数
+    uint64_t fallback = 0;    // 期限内にメディア送信がなく、制御トランスポートで送った数
+    uint64_t extracted = 0;   // 受信メディアパケットから取り出した制御メッセージ数
+    uint64_t relayed = 0;     // extracted のうち、上流のノードが載せて中継されてきたため処理せずに破棄した数
+};
+
+/**
+ * @brief 小さな制御メッセージ (HEARTBEAT、RTCP相当のフィードバック、メトリクス差分) を
+ * 同じ宛先へ送られるメディアパケットに相乗りさせるキュー。
+ *
+ * 制御メッセージは RTP ヘッダー拡張 (RFC 8285 two-byte header, ID = PIGGYBACK_EXTENSION_ID) に格納される。
+ * RTPパケットは TransportAES256 でヘッダーごと暗号化されるため、拡張部も暗号化・認証される。
+ * 期限までに宛先へのメディアパケットが送信されなければ、フォールバック (通常は ControlUdpTransport) で送る。
+ * 親子間でメディアが流れている間は、単独の制御データグラムがほぼ不要になる。
+ *
+ * 中継ノードは暗号文をそのまま子ノードへ転送するため、上流のノードが載せた制御メッセージも孫ノードに届く。
+ * SetOrigin で自ノードのアドレスを設定すると拡張部に送信元の要素 (ID = PIGGYBACK_ORIGIN_EXTENSION_ID) を加え、
+ * 受信側は送信元の要素が直前のホップのアドレスと異なるメッセージを処理せずに破棄する。
+ * 全メソッドは io_context のスレッドから呼び出すことを前提とする。
+ */
+class ControlPiggyback : public std::enable_shared_from_this<ControlPiggyback> {
+public:
+    /// 期限切れの制御メッセージを単独で送る関数
+    using FallbackSender = std::function<void(const std::vector<uint8_t>&, const Endpoint&)>;
+    /// 受信メディアパケットから取り出した制御メッセージを処理する関数
+    using ControlHandler = std::function<void(const std::vector<uint8_t>&, const Endpoint&)>;
+
+    /**
+     * @brief コンストラクタ
+     * @param io Boost.Asio I/Oコンテキスト (期限タイマー用)
+     * @param fallback 期限切れの制御メッセージを送る関数
+     */
+    ControlPiggyback(boost::asio::io_context& io, FallbackSender fallback)
+        : fallback_(std::move(fallback)), timer_(io) {}
+
+    /**
+     * @brief 受信側で取り出した制御メッセージのハンドラを設定する。
+     */
+    void SetControlHandler(ControlHandler handler) {
+        control_handler_ = std::move(handler);
+    }
+
+    /**
+     * @brief 相乗りさせる制御メッセージに添える自ノードのアドレスを設定する (ポートは用いない)。
+     */
+    void SetOrigin(const Endpoint& self) {
+        origin_ = self;
+        has_origin_ = true;
+    }
+
+    /**
+     * @brief 相乗り待ちの制御メッセージがあるか (送信経路で宛先の一覧を作るかの判定用)。
+     */
+    bool HasPending() const { return !pending_.empty(); }
+
+    /**
+     * @brief 制御メッセージを、宛先へのメディアパケットに相乗りさせるよう登録する。
+     * 相乗りできない大きさのメッセージは直ちにフォールバックで送る。
+     * メディアと制御はポートが異なるため、相乗り先はIPアドレスで照合する。
+     * @param message 制御メッセージ
+     * @param dest 宛先の制御エンドポイント (フォールバック時の送信先)
+     * @param max_delay 相乗りを待つ最大時間
+     */
+    void Submit(const std::vector<uint8_t>& message, const Endpoint& dest, std::chrono::milliseconds max_delay) {
+        if (message.empty() || message.size() > MAX_PIGGYBACK_MESSAGE_SIZE || max_delay.count() <= 0) {
+            SendFallback(message, dest);
+            return;
+        }
+        auto deadline = std::chrono::steady_clock::now() + max_delay;
+        pending_[dest.WithPort(0)].push_back(PendingControl{message, deadline, dest});
+        ArmTimer(deadline);
+    }
+
+    /**
+     * @brief 送信直前のRTPパケットに、宛先向けの保留中の制御メッセージを拡張ヘッダーとして追加する。
+     * 既に他のヘッダー拡張を持つパケットには追加しない。
+     * @param packet 送信するRTPパケット (暗号化前、末尾の余白を使ってその場で書き換える)
+     * @param dest 宛先のメディアエンドポイント
+     * @return 相乗りさせた制御メッセージ数
+     */
+    size_t AttachTo(hcs_common::PacketBuffer& packet, const Endpoint& dest) {
+        if (!SelectQueues(&dest, 1)) return 0;
+        size_t size = packet.Size();
+        const size_t attached = AttachInPlace(packet.Data(), size, packet.Capacity());
+        packet.Resize(size);
+        return attached;
+    }
+
+    /**
+     * @brief 同じRTPパケットを複数の宛先へ送る場合に、全ての宛先へ向けて保留中の制御メッセージを追加する。
+     * グループの全購読者へ送る HEARTBEAT のように、全ての宛先のキューに同じ内容で登録されたメッセージだけを載せ、
+     * 各キューから取り除く。一部の宛先向けのメッセージはキューに残り、その宛先へのパケットか期限切れを待つ。
+     * @param packet 送信するRTPパケット (暗号化前、末尾の余白を使ってその場で書き換える)
+     * @param dests 宛先のメディアエンドポイント (同じホストが複数含まれてもよい)
+     * @return 相乗りさせた制御メッセージ数
+     */
+    size_t AttachToAll(hcs_common::PacketBuffer& packet, const std::vector<Endpoint>& dests) {
+        if (!SelectQueues(dests.data(), dests.size())) return 0;
+        size_t size = packet.Size();
+        const size_t attached = AttachInPlace(packet.Data(), size, packet.Capacity());
+        packet.Resize(size);
+        return attached;
+    }
+
+    /**
+     * @brief AttachTo のバイト列版 (ベンチマーク・テスト用)。
+     */
+    size_t AttachTo(std::vector<uint8_t>& rtp_packet, const Endpoint& dest) {
+        if (!SelectQueues(&dest, 1)) return 0;
+        size_t size = rtp_packet.size();
+        rtp_packet.resize(size + MAX_PIGGYBACK_BYTES);
+        const size_t attached = AttachInPlace(rtp_packet.data(), size, rtp_packet.size());
+        rtp_packet.resize(size);
+        return attached;
+    }
+
+    /**
+     * @brief 受信したRTPパケット (復号後) から相乗りした制御メッセージを取り出してハンドラに渡し、
+     * 該当する拡張要素を取り除く。他の拡張要素がなければ拡張ヘッダー自体を削除し、X ビットを落とす。
+     * 送信元の要素が sender と異なるホストを示すメッセージ (中継されたもの) はハンドラに渡さない。
+     * @param packet 受信したRTPパケット (その場で書き換える)
+     * @param sender 送信元エンドポイント
+     * @return 制御メッセージを取り出した場合はtrue
+     */
+    bool ExtractFrom(hcs_common::PacketBuffer& packet, const Endpoint& sender) {
+        size_t size = packet.Size();
+        std::vector<std::vector<uint8_t>> messages;
+        if (!ExtractInPlace(packet.Data(), size, sender, messages)) return false;
+        // 拡張部を書き換えてから制御メッセージを処理する (ハンドラ内でパケットを参照しても整合するように)
+        packet.Resize(size);
+        Dispatch(messages, sender);
+        return true;
+    }
+
+    /**
+     * @brief ExtractFrom のバイト列版 (ベンチマーク・テスト用)。
+     */
+    bool ExtractFrom(std::vector<uint8_t>& rtp_packet, const Endpoint& sender) {
+        size_t size = rtp_packet.size();
+        std::vector<std::vector<uint8_t>> messages;
+        if (!ExtractInPlace(rtp_packet.data(), size, sender, messages)) return false;
+        rtp_packet.resize(size);
+        Dispatch(messages, sender);
+        return true;
+    }
+
+    /**
+     * @brief 保留中の制御メッセージを全てフォールバックで送る (停止時などに呼び出す)。
+     */
+    void FlushAll() {
+        timer_.cancel();
+        armed_ = false;
+        auto pending = std::move(pending_);
+        pending_.clear();
+        for (auto& [host, queue] : pending) {
+            for (auto& entry : queue) SendFallback(entry.message, entry.dest);
+        }
+    }
+
+    /**
+     * @brief ピギーバックの統計を返す。
+     */
+    const PiggybackStats& GetStats() const { return stats_; }
+
+private:
+    struct PendingControl {
+        std::vector<uint8_t> message;
+        std::chrono::steady_clock::time_point deadline;
+        Endpoint dest; // フォールバック時の送信先 (制御エンドポイント)
+    };
+
+    using PendingMap = std::map<Endpoint, std::deque<PendingControl>>;
+
+    FallbackSender fallback_;
+    ControlHandler control_handler_;
+    PendingMap pending_; // 宛先ホスト (ポート0) -> 相乗り待ちの制御メッセージ (登録順)
+    std::vector<PendingMap::iterator> selected_; // AttachInPlace の対象とする宛先のキュー (重複なし)
+    Endpoint origin_;          // 相乗りさせたメッセージに添える自ノードのアドレス
+    bool has_origin_ = false;
+    boost::asio::steady_timer timer_;
+    std::chrono::steady_clock::time_point armed_deadline_;
+    bool armed_ = false;
+    PiggybackStats stats_;
+
+    /**
+     * @brief data[begin, end) を取り除き、後続のデータを前に詰める。
+     */
+    static void EraseRange(uint8_t* data, size_t& size, size_t begin, size_t end) {
+        std::memmove(data + begin, data + end, size - end);
+        size -= end - begin;
+    }
+
+    /**
+     * @brief 宛先ごとのキューを selected_ に集める (同じホストは1つにまとめる)。
+     * @return 全ての宛先に保留中のメッセージがある場合はtrue (1つでもなければ共通のメッセージもない)
+     */
+    bool SelectQueues(const Endpoint* dests, size_t count) {
+        selected_.clear();
+        if (pending_.empty() || count == 0) return false;
+        for (size_t i = 0; i < count; ++i) {
+            auto it = pending_.find(dests[i].WithPort(0));
+            if (it == pending_.end()) return false;
+            if (std::find(selected_.begin(), selected_.end(), it) == selected_.end()) selected_.push_back(it);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 先頭の宛先のキューの entry と同じ内容のメッセージを、他の全ての宛先のキューから探す。
+     * @param matches 各キューで一致したエントリ (selected_ と同じ順。先頭は entry 自身)
+     * @return 全てのキューにあればtrue
+     */
+    bool FindCommon(std::deque<PendingControl>::iterator entry,
+                    std::vector<std::deque<PendingControl>::iterator>& matches) const {
+        matches.clear();
+        matches.push_back(entry);
+        for (size_t i = 1; i < selected_.size(); ++i) {
+            auto& queue = selected_[i]->second;
+            auto found = std::find_if(queue.begin(), queue.end(),
+                                      [&](const PendingControl& other) { return other.message == entry->message; });
+            if (found == queue.end()) return false;
+            matches.push_back(found);
+        }
+        return true;
+    }
+
+    /**
+     * @brief selected_ の全ての宛先に共通する保留中のメッセージで拡張ヘッダーを組み立て、
+     * ヘッダーの直後に挿入する (capacity まで書き込める領域の上で行う)。
+     */
+    size_t AttachInPlace(uint8_t* data, size_t& size, size_t capacity) {
+        if (selected_.empty() || size < RTP_FIXED_HEADER_SIZE) return 0;
+        if ((data[0] >> 6) != 2 || (data[0] & 0x10)) return 0; // RTP v2 以外、または拡張あり
+        // 載せられないパケットではキューから取り出さない (取り出したメッセージが失われないように)
+        const size_t header_len = RTP_FIXED_HEADER_SIZE + 4 * (data[0] & 0x0F);
+        if (header_len > size) return 0;
+        // パディング (最大3バイト) の分を除いた、末尾の余白に収まる予算
+        const size_t room = capacity - size;
+        if (room < 4 + 3) return 0;
+        const size_t budget = std::min(MAX_PIGGYBACK_BYTES, room - 3);
+
+        std::array<uint8_t, MAX_PIGGYBACK_BYTES + 3> ext;
+        ext[0] = static_cast<uint8_t>(RTP_TWO_BYTE_EXT_PROFILE >> 8);
+        ext[1] = static_cast<uint8_t>(RTP_TWO_BYTE_EXT_PROFILE & 0xFF);
+        size_t ext_size = 4;
+        if (has_origin_) {
+            if (ext_size + PIGGYBACK_ORIGIN_SIZE > budget) return 0;
+            ext[ext_size++] = PIGGYBACK_ORIGIN_EXTENSION_ID;
+            ext[ext_size++] = static_cast<uint8_t>(origin_.address.size());
+            std::memcpy(ext.data() + ext_size, origin_.address.data(), origin_.address.size());
+            ext_size += origin_.address.size();
+        }
+
+        // 予算内に収まる分だけ、古い順に拡張要素へ詰める (複数の宛先では全てに共通するものだけ)
+        auto& queue = selected_.front()->second;
+        std::vector<std::deque<PendingControl>::iterator> matches;
+        size_t attached = 0;
+        for (auto entry = queue.begin(); entry != queue.end();) {
+            const auto& message = entry->message;
+            if (ext_size + 2 + message.size() > budget) break;
+            if (selected_.size() > 1 && !FindCommon(entry, matches)) {
+                ++entry;
+                continue;
+            }
+            ext[ext_size++] = PIGGYBACK_EXTENSION_ID;
+            ext[ext_size++] = static_cast<uint8_t>(message.size());
+            std::memcpy(ext.data() + ext_size, message.data(), message.size());
+            ext_size += message.size();
+            for (size_t i = 1; i < selected_.size(); ++i) selected_[i]->second.erase(matches[i]);
+            entry = queue.erase(entry);
+            ++attached;
+        }
+        for (auto it : selected_) {
+            if (it->second.empty()) pending_.erase(it);
+        }
+        selected_.clear();
+        if (attached == 0) return 0;
+
+        while (ext_size % 4 != 0) ext[ext_size++] = 0; // 32ビット境界までパディング
+        size_t words = (ext_size - 4) / 4;
+        ext[2] = static_cast<uint8_t>(words >> 8);
+        ext[3] = static_cast<uint8_t>(words & 0xFF);
+
+        std::memmove(data + header_len + ext_size, data + header_len, size - header_len);
+        std::memcpy(data + header_len, ext.data(), ext_size);
+        size += ext_size;
+        data[0] |= 0x10; // X ビット
+        stats_.piggybacked += attached;
+        return attached;
+    }
+
+    /**
+     * @brief 相乗りした制御メッセージを messages へ取り出し、拡張部をその場で書き換える。
+     * 拡張ヘッダーが不正な場合はパケットを変更しない。
+     */
+    bool ExtractInPlace(uint8_t* data, size_t& size, const Endpoint& sender,
+                        std::vector<std::vector<uint8_t>>& messages) {
+        if (size < RTP_FIXED_HEADER_SIZE || !(data[0] & 0x10)) return false;
+        size_t ext_offset = RTP_FIXED_HEADER_SIZE + 4 * (data[0] & 0x0F);
+        if (ext_offset + 4 > size) return false;
+
+        uint16_t profile = static_cast<uint16_t>((data[ext_offset] << 8) | data[ext_offset + 1]);
+        size_t ext_len = 4 * static_cast<size_t>((data[ext_offset + 2] << 8) | data[ext_offset + 3]);
+        size_t data_begin = ext_offset + 4;
+        size_t data_end = data_begin + ext_len;
+        if ((profile & 0xFFF0) != RTP_TWO_BYTE_EXT_PROFILE || data_end > size) return false;
+
+        // 1回目の走査: 要素の検証と制御メッセージの取り出し (パケットはまだ書き換えない)
+        std::array<uint8_t, 16> origin{};
+        bool has_origin = false;
+        size_t pos = data_begin;
+        while (pos < data_end) {
+            uint8_t id = data[pos];
+            if (id == 0) { ++pos; continue; } // パディング
+            if (pos + 2 > data_end) break;
+            size_t len = data[pos + 1];
+            if (pos + 2 + len > data_end) {
+                HCS_LOG_WARN_EVERY("Piggyback", "Malformed RTP header extension from {}", sender);
+                return false;
+            }
+            if (id == PIGGYBACK_EXTENSION_ID) {
+                messages.emplace_back(data + pos + 2, data + pos + 2 + len);
+            } else if (id == PIGGYBACK_ORIGIN_EXTENSION_ID && len == sender.address.size()) {
+                std::memcpy(origin.data(), data + pos + 2, origin.size());
+                has_origin = true;
+            }
+            pos += 2 + len;
+        }
+        if (messages.empty()) return false;
+
+        // 2回目の走査: HCS制御以外の拡張要素を前に詰める (書き込み位置は常に読み出し位置以下)
+        size_t out = data_begin;
+        pos = data_begin;
+        while (pos < data_end) {
+            uint8_t id = data[pos];
+            if (id == 0) { ++pos; continue; }
+            if (pos + 2 > data_end) break;
+            size_t len = data[pos + 1];
+            if (id != PIGGYBACK_EXTENSION_ID && id != PIGGYBACK_ORIGIN_EXTENSION_ID) {
+                std::memmove(data + out, data + pos, 2 + len);
+                out += 2 + len;
+            }
+            pos += 2 + len;
+        }
+
+        if (out == data_begin) {
+            EraseRange(data, size, ext_offset, data_end);
+            data[0] &= static_cast<uint8_t>(~0x10);
+        } else {
+            while ((out - data_begin) % 4 != 0) data[out++] = 0;
+            size_t words = (out - data_begin) / 4;
+            data[ext_offset + 2] = static_cast<uint8_t>(words >> 8);
+            data[ext_offset + 3] = static_cast<uint8_t>(words & 0xFF);
+            EraseRange(data, size, out, data_end);
+        }
+        stats_.extracted += messages.size();
+        // 中継ノードは暗号文を転送するだけで拡張部を書き換えないため、直前のホップ以外が載せたものは処理しない
+        if (has_origin && origin != sender.address) {
+            stats_.relayed += messages.size();
+            messages.clear();
+        }
+        return true;
+    }
+
+    void Dispatch(const std::vector<std::vector<uint8_t>>& messages, const Endpoint& sender) {
+        if (!control_handler_) return;
+        for (const auto& message : messages) control_handler_(message, sender);
+    }
+
+    void SendFallback(const std::vector<uint8_t>& message, const Endpoint& dest) {
+        ++stats_.fallback;
+        if (fallback_) fallback_(message, dest);
+    }
+
+    /**
+     * @brief 最も早い期限でタイマーを設定する (既により早い期限で設定済みなら何もしない)。
+     */
+    void ArmTimer(std::chrono::steady_clock::time_point deadline) {
+        if (armed_ && armed_deadline_ <= deadline) return;
+        armed_ = true;
+        armed_deadline_ = deadline;
+        timer_.expires_at(deadline);
+        timer_.async_wait([weak = weak_from_this()](const boost::system::error_code& ec) {
+            if (ec) return; // 再設定またはキャンセル
+            if (auto self = weak.lock()) self->OnDeadline();
+        });
+    }
+
+    /**
+     * @brief 期限を過ぎた制御メッセージをフォールバックで送り、次の期限でタイマーを再設定する。
+     */
+    void OnDeadline() {
+        armed_ = false;
+        auto now = std::chrono::steady_clock::now();
+        auto next = std::chrono::steady_clock::time_point::max();
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            // 登録ごとに待ち時間が異なりうるため、キュー全体から期限切れのものを順序を保って取り除く
+            auto& queue = it->second;
+            std::deque<PendingControl> kept;
+            for (auto& entry : queue) {
+                if (entry.deadline <= now) {
+                    SendFallback(entry.message, entry.dest);
+                } else {
+                    next = std::min(next, entry.deadline);
+                    kept.push_back(std::move(entry));
+                }
+            }
+            if (kept.empty()) {
+                it = pending_.erase(it);
+            } else {
+                queue = std::move(kept);
+                ++it;
+            }
+        }
+        if (next != std::chrono::steady_clock::time_point::max()) ArmTimer(next);
+    }
+};
+
+} // namespace hcs_net
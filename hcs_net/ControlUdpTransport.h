@@ -0,0 +1,650 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "IControlTransport.h" // IControlTransport
+#include "AsioEndpoint.h" // Endpoint と Asio のエンドポイントの変換
+#include "SocketTimestamping.h" // カーネルの受信時刻
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PipelineLatency.h"
+
+#if defined(__linux__)
+#include <sys/socket.h> // sendmmsg
+#endif
+
+#if defined(__linux__) && !defined(IPV6_MULTICAST_ALL)
+#define IPV6_MULTICAST_ALL 29 // linux/in6.h で定義 (glibc の netinet/in.h には含まれない)
+#endif
+
+namespace hcs_net {
+
+/// 複数の制御メッセージを1データグラムにまとめたバンドルを示す先頭バイト (MSG_TYPE_* と衝突しない値)
+constexpr uint8_t CONTROL_BUNDLE_TYPE = 0xFF;
+/// バンドルするデータグラムの最大サイズ (IPv6最小MTU 1280 から IPv6/UDPヘッダを引いた値以下)
+constexpr size_t MAX_CONTROL_DATAGRAM_SIZE = 1200;
+/// 1回の sendmmsg で送信する最大データグラム数
+constexpr size_t MAX_SEND_BATCH = 64;
+
+/**
+ * @brief 送信キューの統計 (バッチ化の効果確認用)。
+ */
+struct ControlSendStats {
+    uint64_t messages = 0;  // AsyncSendTo/AsyncSendToGroup で受け付けたメッセージ数
+    uint64_t datagrams = 0; // 送信したデータグラム数 (バンドル後)
+    uint64_t syscalls = 0;  // 送信に要したシステムコール数
+};
+
+/**
+ * @brief 制御トランスポートのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct ControlTransportMetrics {
+    hcs_common::Counter& messages_sent;
+    hcs_common::Counter& datagrams_sent;
+    hcs_common::Counter& send_syscalls;
+    hcs_common::Counter& send_errors;
+    hcs_common::Counter& datagrams_received;
+    hcs_common::Counter& messages_received;
+    hcs_common::Counter& malformed;
+    hcs_common::Gauge& send_queue_depth;
+
+    static ControlTransportMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static ControlTransportMetrics metrics{
+            registry.GetCounter("hcs_control_messages_sent_total", "Control messages accepted for sending"),
+            registry.GetCounter("hcs_control_datagrams_sent_total", "Control datagrams sent (after bundling)"),
+            registry.GetCounter("hcs_control_send_syscalls_total", "System calls spent sending control datagrams"),
+            registry.GetCounter("hcs_control_send_errors_total", "Control datagram send failures"),
+            registry.GetCounter("hcs_control_datagrams_received_total", "Control datagrams received"),
+            registry.GetCounter("hcs_control_messages_received_total", "Control messages received (after unbundling)"),
+            registry.GetCounter("hcs_control_malformed_total", "Truncated or malformed control bundles"),
+            registry.GetGauge("hcs_control_send_queue_depth", "Control datagrams waiting for a writable socket"),
+        };
+        return metrics;
+    }
+};
+
+/**
+ * @brief ADVERTISE などのマルチキャスト制御メッセージが届く範囲 (IPv6マルチキャストスコープ)。
+ */
+enum class MulticastScope : uint8_t {
+    kLinkLocal = 0x2,          // ff12:: 同一リンク内のみ (ルーターを越えない)
+    kSiteLocal = 0x5,          // ff15:: サイト内 (hop limit の範囲で転送される)
+    kOrganizationLocal = 0x8   // ff18:: 組織内
+};
+
+/**
+ * @brief 制御メッセージのためのシンプルなUDPトランスポートの実装。
+ * IControlTransportインターフェースを実装し、Boost.Asioを使ってUDP通信を行う。
+ *
+ * IPv6/IPv4デュアルスタックで待ち受け、ピアディスカバリにはグループごとのIPv6マルチキャスト
+ * アドレスを用いる。ノードは参加中のグループのアドレスにのみ join するため、
+ * 関係のないグループのADVERTISEはNICのマルチキャストフィルタで破棄され、CPUに届かない。
+ *
+ * 送信はティック単位でまとめて行う。同じ宛先への複数のメッセージは1つのデータグラムに
+ * バンドルし (先頭バイト CONTROL_BUNDLE_TYPE、以降 [長さ u16][メッセージ] の繰り返し)、
+ * 宛先の異なるデータグラムは Linux では sendmmsg でまとめて送出する。
+ * 全メソッドは io_context のスレッドから呼び出すことを前提とする。
+ */
+class ControlUdpTransport : public IControlTransport,
+                            public std::enable_shared_from_this<ControlUdpTransport> {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param io Boost.Asio I/Oコンテキスト
+     * @param port リッスンするポート番号 (マルチキャストの宛先ポートも兼ねる)
+     */
+    ControlUdpTransport(boost::asio::io_context& io, uint16_t port)
+        : io_(io), socket_(io), port_(port), flush_timer_(io) {}
+
+    /**
+     * @brief グループIDに対応するマルチキャストアドレスを返す。
+     * 形式は ff1S::4843:5300:HHHH:HHHH (S = スコープ、HHHHHHHH = グループIDの FNV-1a ハッシュ)。
+     * NICのマルチキャストMACフィルタ (33:33 + 下位32ビット) がグループごとに異なる値になるよう、
+     * ハッシュを下位32ビットに置く。ハッシュ値 0 は全HCSノード向けのディスカバリ用に予約する。
+     * @param group_id グループID (空文字列の場合はディスカバリ用アドレス)
+     * @param scope マルチキャストスコープ
+     * @param scope_id リンクローカルスコープで用いるインターフェースインデックス
+     * @return IPv6マルチキャストアドレス
+     */
+    static boost::asio::ip::address_v6 GroupAddress(const std::string& group_id,
+                                                    MulticastScope scope = MulticastScope::kLinkLocal,
+                                                    unsigned int scope_id = 0) {
+        uint32_t hash = 0;
+        if (!group_id.empty()) {
+            hash = 2166136261u;
+            for (unsigned char c : group_id) {
+                hash ^= c;
+                hash *= 16777619u;
+            }
+            if (hash == 0) hash = 1;
+        }
+
+        boost::asio::ip::address_v6::bytes_type bytes{};
+        bytes[0] = 0xff;
+        bytes[1] = static_cast<uint8_t>(0x10 | static_cast<uint8_t>(scope)); // T フラグ (一時割り当て) + スコープ
+        bytes[8] = 0x48;  // 'H'
+        bytes[9] = 0x43;  // 'C'
+        bytes[10] = 0x53; // 'S'
+        bytes[12] = static_cast<uint8_t>(hash >> 24);
+        bytes[13] = static_cast<uint8_t>(hash >> 16);
+        bytes[14] = static_cast<uint8_t>(hash >> 8);
+        bytes[15] = static_cast<uint8_t>(hash);
+        return boost::asio::ip::address_v6(bytes, scope == MulticastScope::kLinkLocal ? scope_id : 0);
+    }
+
+    /**
+     * @brief マルチキャストの送受信に用いるインターフェースを指定する (StartReceive より前に呼び出す)。
+     * リンクローカルスコープでは送信インターフェースを特定する必要がある。
+     * @param if_index インターフェースインデックス (0 の場合はカーネルの既定)
+     */
+    void SetMulticastInterface(unsigned int if_index) {
+        if_index_ = if_index;
+    }
+
+    /**
+     * @brief マルチキャストのスコープと hop limit を設定する (StartReceive より前に呼び出す)。
+     * リンクローカルスコープでは hop limit は常に 1 として扱う。
+     * @param scope マルチキャストスコープ
+     * @param hop_limit 送信するマルチキャストパケットの hop limit (1 - 255)
+     */
+    void SetMulticastScope(MulticastScope scope, int hop_limit = 1) {
+        scope_ = scope;
+        hop_limit_ = scope == MulticastScope::kLinkLocal ? 1 : std::max(1, std::min(hop_limit, 255));
+    }
+
+    /**
+     * @brief 送信をまとめる待ち時間を設定する。
+     * 0 (既定) の場合は、現在のハンドラ内で発行された送信を直後にまとめて送出する。
+     * 正の値の場合は、最初の送信からこの時間だけ待ってから送出する (遅延と引き換えにバンドル率が上がる)。
+     * @param delay 待ち時間
+     */
+    void SetCoalescingDelay(std::chrono::microseconds delay) override {
+        coalescing_delay_ = delay;
+    }
+
+    /**
+     * @brief カーネルによる受信タイムスタンプの取得方法を設定する (StartReceive より前に呼び出す。既定は kSoftware)。
+     * 有効時、ハンドラの呼び出し中は hcs_common::ScopedPacketTiming::Current()->received_ns に
+     * カーネルの受信時刻が入る (RTT プローブの計測にリアクタの待ち時間を含めないため)。
+     */
+    void SetTimestampMode(SocketTimestampMode mode) {
+        timestamp_mode_ = mode;
+    }
+
+    /**
+     * @brief 送信キューの統計を返す。
+     */
+    const ControlSendStats& GetSendStats() const { return send_stats_; }
+
+    /**
+     * @brief 受信を開始し、ハンドラを登録する。
+     * ディスカバリ用アドレスと、事前に JoinGroup されたグループのアドレスに参加する。
+     * ポートは共有しない (SO_REUSEADDR を設定しない) ため、同じポートで動作中のノードがあれば失敗する。
+     * @throw std::runtime_error ソケットを開けない、または bind できない場合
+     */
+    void StartReceive(RecvHandler handler) override {
+        handler_ = std::move(handler);
+        boost::asio::ip::udp::endpoint ep(boost::asio::ip::udp::v6(), port_);
+        boost::system::error_code ec;
+        socket_.open(ep.protocol(), ec);
+        if (!ec) socket_.set_option(boost::asio::ip::v6_only(false), ec); // IPv4ピアからのユニキャストも受信する
+        if (!ec) socket_.bind(ep, ec);
+        if (ec) {
+            boost::system::error_code ignored;
+            socket_.close(ignored);
+            throw std::runtime_error("Control transport bind error on port " + std::to_string(port_) + ": " + ec.message());
+        }
+        ConfigureMulticast();
+        // 送信タイムスタンプは読み出さないため、受信のみ有効にする
+        kernel_timestamps_ = SocketTimestamping::Enable(socket_.native_handle(), timestamp_mode_, false);
+        if (kernel_timestamps_) socket_.non_blocking(true);
+
+        HCS_LOG_INFO("ControlTransport", "Listening on port {} (multicast scope ff1{}::, hop limit {}).",
+                     port_, static_cast<int>(scope_), hop_limit_);
+        AsyncReceive();
+    }
+
+    /**
+     * @brief グループのマルチキャストアドレスに参加し、そのグループのADVERTISEを受信する。
+     * 受信開始前に呼び出した場合は、StartReceive 時に参加する。
+     * @param group_id グループID
+     */
+    void JoinGroup(const std::string& group_id) override {
+        if (!joined_groups_.insert(group_id).second) return;
+        if (socket_.is_open()) ApplyMembership(group_id, true);
+    }
+
+    /**
+     * @brief グループのマルチキャストアドレスから離脱する。
+     * @param group_id グループID
+     */
+    void LeaveGroup(const std::string& group_id) override {
+        if (joined_groups_.erase(group_id) == 0) return;
+        if (socket_.is_open()) ApplyMembership(group_id, false);
+    }
+
+    /**
+     * @brief 制御メッセージを非同期的に送信する。
+     * メッセージは送信キューに積まれ、ティックの終わりに同じ宛先のものとまとめて送出される。
+     */
+    void AsyncSendTo(const std::vector<uint8_t>& message,
+                     const Endpoint& dest,
+                     SendCallback on_sent = nullptr) override {
+        // Endpoint は IPv4 を射影アドレスで保持するため、そのままデュアルスタックソケットの宛先になる
+        Enqueue(message, ToUdpEndpointV6(dest), std::move(on_sent));
+    }
+
+    /**
+     * @brief 制御メッセージをグループのマルチキャストアドレスへ非同期的に送信する。
+     * 送信ノード自身はそのグループに参加していなくてもよい。
+     * @param message 送信データ
+     * @param group_id 宛先グループID (空文字列の場合はディスカバリ用アドレス)
+     * @param on_sent 送信完了コールバック
+     */
+    void AsyncSendToGroup(const std::vector<uint8_t>& message,
+                          const std::string& group_id,
+                          SendCallback on_sent = nullptr) override {
+        Enqueue(message, boost::asio::ip::udp::endpoint(GroupAddress(group_id, scope_, if_index_), port_),
+                std::move(on_sent));
+    }
+
+    /**
+     * @brief 送信時刻を末尾8バイトに書き込み、バンドル・送信キューを経由せず直ちに送信する。
+     */
+    void SendTimestamped(std::vector<uint8_t> message, const Endpoint& dest) override {
+        ++send_stats_.messages;
+        metrics_.messages_sent.Add();
+        if (!socket_.is_open()) return;
+        socket_.non_blocking(true);
+        if (message.size() >= SEND_TIME_SIZE) {
+            const uint64_t now = static_cast<uint64_t>(hcs_common::PipelineLatency::NowNs());
+            for (size_t i = 0; i < SEND_TIME_SIZE; ++i) {
+                message[message.size() - SEND_TIME_SIZE + i] = static_cast<uint8_t>(now >> (56 - 8 * i));
+            }
+        }
+        boost::system::error_code ec;
+        socket_.send_to(boost::asio::buffer(message), ToUdpEndpointV6(dest), 0, ec);
+        ++send_stats_.syscalls;
+        metrics_.send_syscalls.Add();
+        if (ec) {
+            metrics_.send_errors.Add();
+            HCS_LOG_WARN_EVERY("ControlTransport", "Timestamped send to {} failed: {}", dest, ec.message());
+            return;
+        }
+        ++send_stats_.datagrams;
+        metrics_.datagrams_sent.Add();
+    }
+
+    /**
+     * @brief 送信キューに溜まっているメッセージを直ちに送出する。
+     */
+    void Flush() override {
+        flush_timer_.cancel();
+        FlushSendQueue();
+    }
+
+    /**
+     * @brief バンドル中と送出待ちのデータグラム数 (送信バッファが空くのを待っている分を含む)。
+     */
+    size_t PendingSends() const override {
+        return filling_.size() + send_queue_.size();
+    }
+
+    /**
+     * @brief トランスポート層を停止する。
+     */
+    void Stop() override {
+        // 未送信のメッセージを送出してから閉じる
+        Flush();
+        boost::system::error_code ec;
+        socket_.close(ec);
+    }
+
+private:
+    boost::asio::io_context& io_;
+    boost::asio::ip::udp::socket socket_;
+    uint16_t port_;
+    RecvHandler handler_;
+    std::vector<uint8_t> recv_buffer_ = std::vector<uint8_t>(4096); // {4096} だと要素1個のベクタになる
+    boost::asio::ip::udp::endpoint sender_endpoint_;
+    SocketTimestampMode timestamp_mode_ = SocketTimestampMode::kSoftware;
+    bool kernel_timestamps_ = false;
+
+    MulticastScope scope_ = MulticastScope::kLinkLocal;
+    static constexpr size_t SEND_TIME_SIZE = 8; // SendTimestamped が書き込む送信時刻の長さ
+    int hop_limit_ = 1;               // 送信マルチキャストの hop limit
+    unsigned int if_index_ = 0;       // マルチキャストに用いるインターフェース (0 = 既定)
+    std::set<std::string> joined_groups_; // 参加中のグループID
+
+    /**
+     * @brief 送信待ちのデータグラム (1宛先分、複数メッセージをバンドルしうる)。
+     */
+    struct OutgoingDatagram {
+        boost::asio::ip::udp::endpoint dest;
+        std::vector<uint8_t> payload;
+        std::vector<SendCallback> callbacks; // バンドルした各メッセージの完了コールバック
+        size_t message_count = 0;
+        size_t first_message_size = 0;       // バンドル化前の先頭メッセージ長
+    };
+
+    std::vector<OutgoingDatagram> filling_;                      // 現在のティックでバンドル中のデータグラム
+    std::map<boost::asio::ip::udp::endpoint, size_t> filling_index_; // 宛先 -> filling_ 内の位置
+    std::deque<OutgoingDatagram> send_queue_;                    // 送出待ちのデータグラム
+    boost::asio::steady_timer flush_timer_;
+    std::chrono::microseconds coalescing_delay_{0};
+    bool flush_scheduled_ = false;
+    bool waiting_writable_ = false; // 送信バッファが空くのを待機中
+    bool sending_ = false;          // SendQueued 実行中 (完了コールバックからの再入を防ぐ)
+    ControlSendStats send_stats_;
+    ControlTransportMetrics& metrics_ = ControlTransportMetrics::Get();
+
+    /**
+     * @brief メッセージを宛先ごとのデータグラムにバンドルし、ティック終了時の送出を予約する。
+     */
+    void Enqueue(const std::vector<uint8_t>& message, const boost::asio::ip::udp::endpoint& dest,
+                 SendCallback on_sent) {
+        ++send_stats_.messages;
+        metrics_.messages_sent.Add();
+        auto it = filling_index_.find(dest);
+        if (it != filling_index_.end() && AppendToBundle(filling_[it->second], message)) {
+            filling_[it->second].callbacks.push_back(std::move(on_sent));
+        } else {
+            OutgoingDatagram datagram;
+            datagram.dest = dest;
+            datagram.payload = message;
+            datagram.callbacks.push_back(std::move(on_sent));
+            datagram.message_count = 1;
+            datagram.first_message_size = message.size();
+            filling_index_[dest] = filling_.size();
+            filling_.push_back(std::move(datagram));
+        }
+        ScheduleFlush();
+    }
+
+    /**
+     * @brief データグラムにメッセージを追加する。最大サイズを超える場合は追加せず false を返す。
+     * 2つ目のメッセージを追加する時点で、先頭メッセージをバンドル形式に変換する。
+     */
+    static bool AppendToBundle(OutgoingDatagram& datagram, const std::vector<uint8_t>& message) {
+        if (message.size() > 0xFFFF) return false;
+        size_t bundled_size = datagram.message_count == 1
+            ? 1 + 2 + datagram.first_message_size
+            : datagram.payload.size();
+        if (bundled_size + 2 + message.size() > MAX_CONTROL_DATAGRAM_SIZE) return false;
+
+        if (datagram.message_count == 1) {
+            std::vector<uint8_t> bundle;
+            bundle.reserve(MAX_CONTROL_DATAGRAM_SIZE);
+            bundle.push_back(CONTROL_BUNDLE_TYPE);
+            AppendFramed(bundle, datagram.payload);
+            datagram.payload = std::move(bundle);
+        }
+        AppendFramed(datagram.payload, message);
+        ++datagram.message_count;
+        return true;
+    }
+
+    static void AppendFramed(std::vector<uint8_t>& out, const std::vector<uint8_t>& message) {
+        out.push_back(static_cast<uint8_t>(message.size() >> 8));
+        out.push_back(static_cast<uint8_t>(message.size() & 0xFF));
+        out.insert(out.end(), message.begin(), message.end());
+    }
+
+    void ScheduleFlush() {
+        if (flush_scheduled_) return;
+        flush_scheduled_ = true;
+        auto self = shared_from_this();
+        if (coalescing_delay_.count() > 0) {
+            flush_timer_.expires_after(coalescing_delay_);
+            flush_timer_.async_wait([self](const boost::system::error_code& ec) {
+                if (!ec) self->FlushSendQueue();
+            });
+        } else {
+            io_.post([self]() { self->FlushSendQueue(); });
+        }
+    }
+
+    /**
+     * @brief バンドル中のデータグラムを確定し、送出キューへ移して送信する。
+     */
+    void FlushSendQueue() {
+        flush_scheduled_ = false;
+        filling_index_.clear();
+        for (auto& datagram : filling_) send_queue_.push_back(std::move(datagram));
+        filling_.clear();
+        SendQueued();
+    }
+
+    /**
+     * @brief 送出キューのデータグラムを送信する。Linux では sendmmsg で最大 MAX_SEND_BATCH 件を1回で送る。
+     * 送信バッファが満杯の場合は書き込み可能になるまで待機して再開する。
+     */
+    void SendQueued() {
+        if (waiting_writable_ || sending_) return; // 実行中の送信ループが追加分も送出する
+        sending_ = true;
+        SendQueuedImpl();
+        sending_ = false;
+        metrics_.send_queue_depth.Set(static_cast<int64_t>(send_queue_.size()));
+    }
+
+    void SendQueuedImpl() {
+        if (!socket_.is_open()) {
+            while (!send_queue_.empty()) CompleteFront(boost::asio::error::not_connected);
+            return;
+        }
+#if defined(__linux__)
+        socket_.non_blocking(true);
+        while (!send_queue_.empty()) {
+            mmsghdr msgs[MAX_SEND_BATCH];
+            iovec iovs[MAX_SEND_BATCH];
+            size_t count = std::min(send_queue_.size(), MAX_SEND_BATCH);
+            for (size_t i = 0; i < count; ++i) {
+                auto& datagram = send_queue_[i];
+                iovs[i].iov_base = datagram.payload.data();
+                iovs[i].iov_len = datagram.payload.size();
+                msgs[i] = mmsghdr{};
+                msgs[i].msg_hdr.msg_name = datagram.dest.data();
+                msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(datagram.dest.size());
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int sent = ::sendmmsg(socket_.native_handle(), msgs, static_cast<unsigned int>(count), 0);
+            ++send_stats_.syscalls;
+            metrics_.send_syscalls.Add();
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    WaitWritable();
+                    return;
+                }
+                // 先頭のデータグラムのみ失敗として扱い、残りは送信を続ける
+                boost::system::error_code ec(errno, boost::asio::error::get_system_category());
+                HCS_LOG_WARN_EVERY("ControlTransport", "Send error to {}: {}", send_queue_.front().dest, ec.message());
+                CompleteFront(ec);
+                continue;
+            }
+            for (int i = 0; i < sent; ++i) CompleteFront(boost::system::error_code{});
+        }
+#else
+        while (!send_queue_.empty()) {
+            boost::system::error_code ec;
+            socket_.send_to(boost::asio::buffer(send_queue_.front().payload), send_queue_.front().dest, 0, ec);
+            ++send_stats_.syscalls;
+            metrics_.send_syscalls.Add();
+            if (ec == boost::asio::error::would_block) {
+                WaitWritable();
+                return;
+            }
+            if (ec) {
+                HCS_LOG_WARN_EVERY("ControlTransport", "Send error to {}: {}", send_queue_.front().dest, ec.message());
+            }
+            CompleteFront(ec);
+        }
+#endif
+    }
+
+    void WaitWritable() {
+        waiting_writable_ = true;
+        socket_.async_wait(boost::asio::ip::udp::socket::wait_write,
+            [self = shared_from_this()](const boost::system::error_code& ec) {
+                self->waiting_writable_ = false;
+                if (ec) {
+                    while (!self->send_queue_.empty()) self->CompleteFront(ec);
+                    return;
+                }
+                self->SendQueued();
+            });
+    }
+
+    /**
+     * @brief 送出キュー先頭のデータグラムを完了させ、バンドルした全メッセージのコールバックを呼び出す。
+     */
+    void CompleteFront(const boost::system::error_code& ec) {
+        OutgoingDatagram datagram = std::move(send_queue_.front());
+        send_queue_.pop_front();
+        if (!ec) {
+            ++send_stats_.datagrams;
+            metrics_.datagrams_sent.Add();
+        } else {
+            metrics_.send_errors.Add();
+        }
+        for (auto& cb : datagram.callbacks) {
+            if (cb) cb(ec, ec ? 0 : datagram.payload.size());
+        }
+    }
+
+    /**
+     * @brief マルチキャスト関連のソケットオプションを設定し、ディスカバリ用と参加済みグループに join する。
+     */
+    void ConfigureMulticast() {
+        boost::system::error_code ec;
+        socket_.set_option(boost::asio::ip::multicast::hops(hop_limit_), ec);
+        // 同一ホスト上の他ノードにもADVERTISEを届けるため、マルチキャストのループバックは有効のままとする
+        // (自ノードが送信したものの折り返しは、受信側で送信元アドレスにより除く)
+        socket_.set_option(boost::asio::ip::multicast::enable_loopback(true), ec);
+        if (if_index_ != 0) {
+            socket_.set_option(boost::asio::ip::multicast::outbound_interface(if_index_), ec);
+        }
+#ifdef IPV6_MULTICAST_ALL
+        // Linux の既定では、同一ホストの他ソケットが join したグループ宛ても受信してしまうため無効化する
+        int multicast_all = 0;
+        ::setsockopt(socket_.native_handle(), IPPROTO_IPV6, IPV6_MULTICAST_ALL,
+                     &multicast_all, sizeof(multicast_all));
+#endif
+        ApplyMembership("", true);
+        for (const auto& group_id : joined_groups_) ApplyMembership(group_id, true);
+    }
+
+    /**
+     * @brief グループのマルチキャストアドレスへの参加/離脱をソケットに反映する。
+     */
+    void ApplyMembership(const std::string& group_id, bool join) {
+        boost::system::error_code ec;
+        auto group = GroupAddress(group_id, scope_, if_index_);
+        if (join) {
+            socket_.set_option(boost::asio::ip::multicast::join_group(group, if_index_), ec);
+        } else {
+            socket_.set_option(boost::asio::ip::multicast::leave_group(group, if_index_), ec);
+        }
+        if (ec) {
+            HCS_LOG_ERROR("ControlTransport", "Failed to {} {} for group '{}': {}",
+                          join ? "join" : "leave", group.to_string(), group_id, ec.message());
+        }
+    }
+
+    /**
+     * @brief 非同期受信ループ
+     */
+    void AsyncReceive() {
+        if (kernel_timestamps_) {
+            // 補助データ (受信時刻) を受け取るため、受信可能になるのを待って recvmsg で読み出す
+            socket_.async_wait(boost::asio::ip::udp::socket::wait_read,
+                [self = shared_from_this()](const boost::system::error_code& ec) {
+                    if (ec) return;
+                    self->ReceiveReady();
+                    self->AsyncReceive();
+                });
+            return;
+        }
+        socket_.async_receive_from(
+            boost::asio::buffer(recv_buffer_),
+            sender_endpoint_,
+            [self = shared_from_this()](const boost::system::error_code& ec, std::size_t bytes_recvd) {
+                if (!ec && bytes_recvd > 0) {
+                    // 受信データをハンドラに渡す
+                    if (self->handler_) {
+                        // デュアルスタックで受信したIPv4ピア (射影アドレス) も IPv4 と同じ Endpoint になる
+                        self->DispatchReceived(bytes_recvd, FromUdpEndpoint(self->sender_endpoint_));
+                    }
+                }
+                if (!ec) self->AsyncReceive();
+            });
+    }
+
+    /**
+     * @brief 溜まっているデータグラムを受信時刻とともに読み出し、ハンドラに渡す。
+     */
+    void ReceiveReady() {
+        for (;;) {
+            sockaddr_storage from{};
+            iovec iov{recv_buffer_.data(), recv_buffer_.size()};
+            alignas(cmsghdr) uint8_t control[TIMESTAMP_CONTROL_SIZE];
+            msghdr msg{};
+            msg.msg_name = &from;
+            msg.msg_namelen = sizeof(from);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            const ssize_t received = ::recvmsg(socket_.native_handle(), &msg, MSG_DONTWAIT);
+            if (received <= 0) return;
+            if (handler_) {
+                DispatchReceived(static_cast<size_t>(received), SocketTimestamping::ToEndpoint(from),
+                                 SocketTimestamping::Parse(msg).steady_ns);
+            }
+        }
+    }
+
+    /**
+     * @brief 受信したデータグラムをハンドラに渡す。バンドルの場合は個々のメッセージに分解する。
+     * ハンドラの呼び出し中は受信時刻を ScopedPacketTiming で公開する。
+     * @param kernel_ns カーネルの受信時刻 (単調時計、不明な場合は0)
+     */
+    void DispatchReceived(size_t bytes_recvd, const Endpoint& sender_ep, int64_t kernel_ns = 0) {
+        // 制御メッセージはメディアの段に含めないため、受信時刻のみを設定する
+        hcs_common::PacketTiming timing;
+        timing.received_ns = kernel_ns != 0 ? kernel_ns : hcs_common::PipelineLatency::NowNs();
+        hcs_common::ScopedPacketTiming timing_scope(timing);
+        const uint8_t* data = recv_buffer_.data();
+        metrics_.datagrams_received.Add();
+        if (data[0] != CONTROL_BUNDLE_TYPE) {
+            metrics_.messages_received.Add();
+            handler_(std::vector<uint8_t>(data, data + bytes_recvd), sender_ep);
+            return;
+        }
+        size_t offset = 1;
+        while (offset + 2 <= bytes_recvd) {
+            size_t len = (static_cast<size_t>(data[offset]) << 8) | data[offset + 1];
+            offset += 2;
+            if (offset + len > bytes_recvd) {
+                metrics_.malformed.Add();
+                HCS_LOG_WARN_EVERY("ControlTransport", "Truncated control bundle from {}", sender_ep);
+                return;
+            }
+            metrics_.messages_received.Add();
+            handler_(std::vector<uint8_t>(data + offset, data + offset + len), sender_ep);
+            offset += len;
+        }
+    }
+};
+
+} // namespace hcs_net
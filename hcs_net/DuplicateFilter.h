@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * @namespace hcs_net
+ * @brief HCSノードのネットワーク関連コンポーネントを格納する名前空間
+ */
+namespace hcs_net {
+
+// --- 重複排除ウィンドウの定数 ---
+constexpr size_t DEDUP_WINDOW_BITS = 1024; ///< ストリームごとに追跡するシーケンス番号の幅
+constexpr size_t DEDUP_WINDOW_WORDS = DEDUP_WINDOW_BITS / 64;
+
+/**
+ * @brief (ストリームID, シーケンス番号) 単位で先着パケットのみを通す重複排除フィルタ
+ *
+ * 冗長配信モードでは同一パケットがプライマリ親とセカンダリ親の両方から届くため、
+ * 復号前にビットマップを1回参照するだけで後着分を破棄し、復号コストの倍増を防ぐ。
+ * IPsecのアンチリプレイウィンドウと同様に、判定 (IsDuplicate) は復号前、
+ * 記録 (Mark) は認証成功後に行うことで、偽造パケットによる正規パケットの抑止を防ぐ。
+ */
+class DuplicateFilter {
+public:
+    /**
+     * @brief 指定パケットが既に受理済み、またはウィンドウより古いかを判定する
+     * @param stream_id 送信元ストリームID (SSRC相当)
+     * @param seq ストリーム内のシーケンス番号
+     * @return 破棄すべき場合はtrue
+     */
+    [[nodiscard]] bool IsDuplicate(uint32_t stream_id, uint64_t seq) const {
+        auto it = windows_.find(stream_id);
+        if (it == windows_.end()) return false;
+        const Window& w = it->second;
+        if (seq > w.highest) return false;
+        if (w.highest - seq >= DEDUP_WINDOW_BITS) return true; // ウィンドウ外の遅着パケット
+        const size_t bit = seq % DEDUP_WINDOW_BITS;
+        return (w.bits[bit / 64] >> (bit % 64)) & 1u;
+    }
+
+    /**
+     * @brief 認証に成功したパケットを受理済みとして記録する
+     * @param stream_id 送信元ストリームID (SSRC相当)
+     * @param seq ストリーム内のシーケンス番号
+     */
+    void Mark(uint32_t stream_id, uint64_t seq) {
+        auto [it, inserted] = windows_.try_emplace(stream_id);
+        Window& w = it->second;
+        if (inserted) {
+            w.highest = seq;
+        } else if (seq > w.highest) {
+            // ウィンドウを前進させ、再利用されるビットをクリアする
+            const uint64_t advance = seq - w.highest;
+            if (advance >= DEDUP_WINDOW_BITS) {
+                w.bits.fill(0);
+            } else {
+                for (uint64_t s = w.highest + 1; s <= seq; ++s) {
+                    const size_t bit = s % DEDUP_WINDOW_BITS;
+                    w.bits[bit / 64] &= ~(uint64_t{1} << (bit % 64));
+                }
+            }
+            w.highest = seq;
+        } else if (w.highest - seq >= DEDUP_WINDOW_BITS) {
+            return;
+        }
+        const size_t bit = seq % DEDUP_WINDOW_BITS;
+        w.bits[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+
+    /**
+     * @brief 全ストリームの追跡状態を破棄する
+     */
+    void Reset() { windows_.clear(); }
+
+private:
+    /**
+     * @brief ストリームごとのスライディングウィンドウ
+     */
+    struct Window {
+        uint64_t highest = 0;                          ///< 受理済みの最大シーケンス番号
+        std::array<uint64_t, DEDUP_WINDOW_WORDS> bits{}; ///< seq % DEDUP_WINDOW_BITS の受理ビット
+    };
+
+    std::unordered_map<uint32_t, Window> windows_; ///< ストリームID -> ウィンドウ
+};
+
+} // namespace hcs_net
@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <boost/system/error_code.hpp>
+#include "common.h" // Endpoint
+
+namespace hcs_net {
+
+/**
+ * @brief 制御メッセージのためのトランスポート抽象インターフェース。
+ * メディアデータとは異なり、セキュリティ機能は簡略化されるか、よりシンプルな実装に依存する可能性がある。
+ */
+class IControlTransport {
+public:
+    /// 受信ハンドラ (受信したメッセージ、送信元)
+    using RecvHandler = std::function<void(const std::vector<uint8_t>&, const Endpoint&)>;
+    /// 送信完了コールバック (エラー、送信したバイト数)
+    using SendCallback = std::function<void(const boost::system::error_code&, std::size_t)>;
+
+    virtual ~IControlTransport() = default;
+
+    /**
+     * @brief 受信を開始し、メッセージハンドラを登録する。
+     * @throw std::runtime_error 受信を開始できない場合 (ポートが使用中など)
+     */
+    virtual void StartReceive(RecvHandler handler) = 0;
+
+    /**
+     * @brief 制御メッセージを非同期的に送信する。
+     */
+    virtual void AsyncSendTo(const std::vector<uint8_t>& message,
+                            const Endpoint& dest,
+                            SendCallback on_sent = nullptr) = 0;
+
+    /**
+     * @brief 送信時刻をメッセージ末尾の8バイト (単調時計の ns、ビッグエンディアン) に書き込み、まとめ送りを待たずに送信する。
+     * 時刻の書き込みは送信のシステムコールの直前に行い、送信キューでの待ち時間を含めない (RTT プローブの t1/t3 用)。
+     * 送信バッファが満杯で直ちに送れない場合は、遅れた時刻で計測しないよう破棄する。
+     * @param message 送信データ (末尾8バイトは上書きされる)
+     * @param dest 宛先
+     */
+    virtual void SendTimestamped(std::vector<uint8_t> message, const Endpoint& dest) = 0;
+
+    /**
+     * @brief グループのマルチキャストアドレスに参加し、そのグループ宛ての制御メッセージを受信する。
+     */
+    virtual void JoinGroup(const std::string& group_id) = 0;
+
+    /**
+     * @brief グループのマルチキャストアドレスから離脱する。
+     */
+    virtual void LeaveGroup(const std::string& group_id) = 0;
+
+    /**
+     * @brief 制御メッセージをグループのマルチキャストアドレスへ非同期的に送信する。
+     */
+    virtual void AsyncSendToGroup(const std::vector<uint8_t>& message,
+                                  const std::string& group_id,
+                                  SendCallback on_sent = nullptr) = 0;
+
+    /**
+     * @brief 送信を依頼済みで、まだ送出していないメッセージ数 (停止時のドレインの判定に用いる)。
+     */
+    virtual size_t PendingSends() const { return 0; }
+
+    /**
+     * @brief まとめ送りの待ち時間を設定する (まとめ送りをしない実装では何もしない)。
+     */
+    virtual void SetCoalescingDelay(std::chrono::microseconds /*delay*/) {}
+
+    /**
+     * @brief まとめ送りを待っているメッセージを直ちに送出する (停止の予告や LEAVE を待たせないため)。
+     */
+    virtual void Flush() {}
+
+    /**
+     * @brief トランスポート層を停止する。
+     */
+    virtual void Stop() = 0;
+};
+
+} // namespace hcs_net
@@ -0,0 +1,488 @@
+#pragma once
+
+#include "common.h"
+#include <boost/asio.hpp>
+#include "hcs_common/HandlerMemory.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PipelineLatency.h"
+#include "hcs_common/Tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+
+/**
+ * @namespace hcs_net
+ * @brief HCSノードのネットワーク関連コンポーネントを格納する名前空間
+ */
+namespace hcs_net {
+
+// --- インメモリトランスポートの定数 ---
+constexpr size_t MEMORY_QUEUE_CAPACITY = 4096; ///< 受信キューの容量 (2の累乗。溢れたパケットはソケットバッファ同様に破棄する)
+constexpr size_t MEMORY_DRAIN_BATCH = 256;     ///< 1回の受信処理で取り出す最大パケット数 (同じ io_context 上の他の処理を待たせない)
+constexpr size_t MEMORY_DRAIN_HANDLER_BLOCKS = 2; ///< 受信処理の post 用ブロック数 (post は同時に1つのみ保留される)
+
+/**
+ * @brief インメモリトランスポートのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct MemoryTransportMetrics {
+    hcs_common::Counter& packets_sent;
+    hcs_common::Counter& bytes_sent;
+    hcs_common::Counter& packets_received;
+    hcs_common::Counter& bytes_received;
+    hcs_common::Counter& dropped_loss;
+    hcs_common::Counter& dropped_queue_full;
+    hcs_common::Counter& dropped_oversize;
+    hcs_common::Counter& no_route;
+
+    static MemoryTransportMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static MemoryTransportMetrics metrics{
+            registry.GetCounter("hcs_memory_packets_sent_total", "Packets queued to an in-process peer"),
+            registry.GetCounter("hcs_memory_bytes_sent_total", "Bytes queued to an in-process peer"),
+            registry.GetCounter("hcs_memory_packets_received_total", "Packets delivered from the in-process network"),
+            registry.GetCounter("hcs_memory_bytes_received_total", "Bytes delivered from the in-process network"),
+            registry.GetCounter("hcs_memory_dropped_loss_total", "Packets dropped by injected loss"),
+            registry.GetCounter("hcs_memory_dropped_queue_full_total", "Packets dropped because the receive queue was full"),
+            registry.GetCounter("hcs_memory_dropped_oversize_total", "Packets dropped because they do not fit a packet buffer"),
+            registry.GetCounter("hcs_memory_no_route_total", "Packets sent to an endpoint with no registered transport"),
+        };
+        return metrics;
+    }
+};
+
+/**
+ * @brief インメモリ網のリンク特性 (全リンク共通)。
+ * 損失・ジッタ・並べ替えの判定は送信ノードごとに seed から派生した乱数で行うため、
+ * 同じ送信順序であれば同じパケットが失われ、同じパケットが追い越される。
+ */
+struct MemoryLinkParams {
+    std::chrono::nanoseconds delay{0};                                     ///< 片方向の固定遅延
+    std::chrono::nanoseconds jitter{0};                                    ///< 一様分布ジッタの最大値
+    double loss_rate = 0.0;                                                ///< パケット損失率 (0.0 - 1.0)
+    double reorder_rate = 0.0;                                             ///< reorder_delay だけ余分に遅らせ、後続に追い越させるパケットの割合
+    std::chrono::nanoseconds reorder_delay{std::chrono::microseconds(500)}; ///< 並べ替え対象のパケットの追加遅延
+    uint64_t seed = 1;                                                     ///< 乱数シード
+
+    /**
+     * @brief 遅延の注入が必要か (不要な場合は受信キューから即座に配送する)。
+     */
+    bool Delayed() const { return delay.count() > 0 || jitter.count() > 0 || reorder_rate > 0.0; }
+};
+
+/**
+ * @brief 容量固定の多生産者・単一消費者キュー (ロックフリー)。
+ * スロットごとのシーケンス番号で生産者間の競合を解決し、満杯時はブロックせず失敗を返す。
+ */
+template <typename T>
+class BoundedMpscQueue {
+public:
+    /**
+     * @param capacity 容量 (2の累乗)
+     * @throw std::invalid_argument 容量が2の累乗でない場合
+     */
+    explicit BoundedMpscQueue(size_t capacity)
+        : slots_(new Slot[capacity]), mask_(capacity - 1)
+    {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("Queue capacity must be a power of two.");
+        }
+        for (size_t i = 0; i < capacity; ++i) slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 末尾に追加する (任意のスレッドから呼び出し可)。
+     * @return 満杯の場合はfalse (value は変更されない)
+     */
+    bool TryPush(T&& value) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & mask_];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                // このスロットが空いている: 位置の確保に成功した生産者だけが書き込む
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // 消費者が1周分追いついていない (満杯)
+            } else {
+                pos = head_.load(std::memory_order_relaxed); // 他の生産者に先を越された
+            }
+        }
+    }
+
+    /**
+     * @brief 先頭を取り出す (消費者スレッドのみ)。
+     * @return 空の場合はfalse
+     */
+    bool TryPop(T& out) {
+        Slot& slot = slots_[tail_ & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != tail_ + 1) return false;
+        out = std::move(slot.value);
+        slot.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    const size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0}; // 生産者が書き込む
+    alignas(64) size_t tail_ = 0;             // 消費者のみが読み書きする
+};
+
+class MemoryTransport;
+
+/**
+ * @brief 同一プロセス内の MemoryTransport 同士を結ぶ仮想ネットワーク。
+ * エンドポイントから受信側トランスポートへの経路表を持つ。経路の登録・削除は
+ * Start()/Stop() 時のみのため mutex で保護し、送信側は版数で無効化するキャッシュを使う。
+ */
+class MemoryNetwork {
+public:
+    explicit MemoryNetwork(const MemoryLinkParams& params = {}) : params_(params) {}
+
+    const MemoryLinkParams& Params() const { return params_; }
+
+    /**
+     * @brief エンドポイントに受信側トランスポートを登録する。
+     * @throw std::runtime_error エンドポイントが使用中の場合 (ソケットの bind 失敗に相当)
+     */
+    void Register(const Endpoint& endpoint, const std::shared_ptr<MemoryTransport>& transport) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = routes_.find(endpoint);
+        if (it != routes_.end() && !it->second.expired()) {
+            throw std::runtime_error("Memory endpoint already in use: " + endpoint.ToString());
+        }
+        routes_[endpoint] = transport;
+        version_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief エンドポイントの登録を削除する。
+     */
+    void Unregister(const Endpoint& endpoint) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        routes_.erase(endpoint);
+        version_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief エンドポイントの受信側トランスポートを返す (未登録なら nullptr)。
+     */
+    std::shared_ptr<MemoryTransport> Find(const Endpoint& endpoint) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = routes_.find(endpoint);
+        return it == routes_.end() ? nullptr : it->second.lock();
+    }
+
+    /**
+     * @brief 経路表の版数 (登録・削除のたびに増える)。
+     */
+    uint64_t Version() const { return version_.load(std::memory_order_acquire); }
+
+private:
+    const MemoryLinkParams params_;
+    mutable std::mutex mutex_;
+    std::unordered_map<Endpoint, std::weak_ptr<MemoryTransport>> routes_;
+    std::atomic<uint64_t> version_{0};
+};
+
+/**
+ * @brief ソケットの代わりにプロセス内のロックフリーキューでパケットを受け渡すトランスポート。
+ *
+ * 送信は宛先トランスポートの受信キューへの追加のみで、受信側は自身の io_context 上で
+ * キューを取り出して受信コールバックを呼ぶ。カーネルのネットワーク処理を含まないため、
+ * 暗号化・メディア・トポロジー処理のコストを切り分けたベンチマークや、
+ * 多数ノードを1プロセスで動かす再現性のある試験に用いる。
+ * MemoryLinkParams により遅延・ジッタ・損失・並べ替えを注入できる。
+ *
+ * Send() は UdpTransport と同様にノードの I/O スレッドから呼ぶこと (送信側の乱数と経路キャッシュを保護しない)。
+ */
+class MemoryTransport : public Transport, public std::enable_shared_from_this<MemoryTransport> {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param io_context 受信処理を実行する I/O コンテキスト
+     * @param network 接続する仮想ネットワーク
+     * @param local 自身のエンドポイント (受信時の送信元として相手に渡される)
+     */
+    MemoryTransport(boost::asio::io_context& io_context, std::shared_ptr<MemoryNetwork> network, const Endpoint& local)
+        : io_context_(io_context),
+          network_(std::move(network)),
+          local_(local),
+          params_(network_->Params()),
+          // 送信ノードごとに異なり、かつ実行ごとに同じ乱数列とする
+          rng_(params_.seed ^ EndpointHash{}(local)),
+          queue_(MEMORY_QUEUE_CAPACITY),
+          timer_(io_context)
+    {}
+
+    /**
+     * @brief 仮想ネットワークにエンドポイントを登録し、受信を開始する。
+     * @throw std::runtime_error エンドポイントが使用中の場合
+     */
+    void Start() override {
+        network_->Register(local_, shared_from_this());
+        running_.store(true, std::memory_order_release);
+        ScheduleDrain(); // 登録前後に届いたパケットを配送する
+        HCS_LOG_INFO("MemoryTransport", "Started on {}", local_.ToString());
+    }
+
+    /**
+     * @brief 登録を削除し、受信を停止する (キューに残ったパケットは破棄される)。
+     */
+    void Stop() override {
+        if (!running_.exchange(false)) return;
+        network_->Unregister(local_);
+        boost::system::error_code ec;
+        timer_.cancel(ec);
+        HCS_LOG_INFO("MemoryTransport", "Stopped.");
+    }
+
+    /**
+     * @brief データをプールのバッファへ複製し、宛先トランスポートの受信キューへ追加する。
+     * @param data 送信するバイトベクター (PACKET_BUFFER_SIZE - PACKET_HEADROOM を超えるものは破棄する)
+     * @param destination 宛先エンドポイント
+     */
+    void Send(const std::vector<uint8_t>& data, const Endpoint& destination) override {
+        if (data.size() > hcs_common::PACKET_BUFFER_SIZE - hcs_common::PACKET_HEADROOM) {
+            metrics_->dropped_oversize.Add();
+            HCS_LOG_WARN_EVERY("MemoryTransport", "Dropped oversize packet ({} bytes) to {}", data.size(), destination.ToString());
+            return;
+        }
+        SendPacket(hcs_common::PacketPool::Local().CopyFrom(data.data(), data.size()), destination);
+    }
+
+    /**
+     * @brief パケットバッファを複製せずに宛先トランスポートの受信キューへ追加する。
+     * @param packet 送信するパケット
+     * @param destination 宛先エンドポイント
+     */
+    void SendPacket(hcs_common::PacketRef packet, const Endpoint& destination) override {
+        HCS_TRACE_SPAN("net", "memory.send");
+        std::shared_ptr<MemoryTransport> receiver = Route(destination);
+        if (!receiver) {
+            metrics_->no_route.Add();
+            HCS_LOG_WARN_EVERY("MemoryTransport", "No route to {}", destination.ToString());
+            return;
+        }
+        if (params_.loss_rate > 0.0 && unit_(rng_) < params_.loss_rate) {
+            metrics_->dropped_loss.Add();
+            return;
+        }
+
+        const size_t size = packet->Size();
+        Packet queued{std::move(packet), local_, 0};
+        if (params_.Delayed()) queued.deliver_at_ns = hcs_common::PipelineLatency::NowNs() + InjectedDelayNs();
+        if (!receiver->Enqueue(std::move(queued))) {
+            metrics_->dropped_queue_full.Add();
+            return;
+        }
+
+        metrics_->packets_sent.Add();
+        metrics_->bytes_sent.Add(size);
+        if (auto* timing = hcs_common::ScopedPacketTiming::Current()) {
+            timing->Mark(hcs_common::PipelineStage::kSocketSend);
+        }
+    }
+
+    /**
+     * @brief 受信コールバックの設定
+     */
+    void SetReceiveCallback(ReceiveCallback callback) override {
+        receive_callback_ = std::move(callback);
+    }
+
+    /**
+     * @brief パケットバッファで受け取る受信コールバックの設定 (設定時は ReceiveCallback より優先される)
+     */
+    void SetPacketCallback(PacketCallback callback) override {
+        packet_callback_ = std::move(callback);
+    }
+
+private:
+    /**
+     * @brief キュー上のパケット。deliver_at_ns が0のものは即座に配送する。
+     */
+    struct Packet {
+        hcs_common::PacketRef data;
+        Endpoint source;
+        int64_t deliver_at_ns = 0; ///< 配送時刻 (単調時計)
+    };
+
+    /**
+     * @brief 遅延配送待ちのパケット。配送時刻が同じものは受信キューから取り出した順に配送する。
+     */
+    struct DelayedPacket {
+        int64_t deliver_at_ns;
+        uint64_t order;
+        Packet packet;
+
+        bool operator>(const DelayedPacket& other) const {
+            return deliver_at_ns > other.deliver_at_ns || (deliver_at_ns == other.deliver_at_ns && order > other.order);
+        }
+    };
+
+    boost::asio::io_context& io_context_;
+    std::shared_ptr<MemoryNetwork> network_;
+    Endpoint local_;
+    const MemoryLinkParams params_;
+    ReceiveCallback receive_callback_;
+    PacketCallback packet_callback_;
+    MemoryTransportMetrics* metrics_ = &MemoryTransportMetrics::Get();
+    std::atomic<bool> running_{false};
+
+    // 送信側 (ノードの I/O スレッドのみ)
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> unit_{0.0, 1.0};
+    std::unordered_map<Endpoint, std::shared_ptr<MemoryTransport>> routes_; // 宛先ごとの経路キャッシュ (バイナリアドレスのハッシュで引く)
+    uint64_t routes_version_ = 0;
+
+    // 受信側
+    BoundedMpscQueue<Packet> queue_;
+    std::atomic<bool> drain_pending_{false}; // 受信処理が post 済み (生産者は false → true にした場合のみ post する)
+    hcs_common::HandlerMemory drain_handler_memory_{MEMORY_DRAIN_HANDLER_BLOCKS}; // 送信側スレッドで確保し受信側で解放される
+    std::vector<DelayedPacket> delayed_;     // 配送時刻の最小ヒープ (I/O スレッドのみ)
+    uint64_t delayed_order_ = 0;
+    boost::asio::steady_timer timer_;
+    bool timer_armed_ = false;
+    int64_t timer_deadline_ns_ = 0;
+
+    /**
+     * @brief 宛先の受信側トランスポートを返す。経路表が更新されていればキャッシュを捨てる。
+     */
+    std::shared_ptr<MemoryTransport> Route(const Endpoint& destination) {
+        const uint64_t version = network_->Version();
+        if (version != routes_version_) {
+            routes_.clear();
+            routes_version_ = version;
+        }
+        auto it = routes_.find(destination);
+        if (it != routes_.end()) return it->second;
+
+        std::shared_ptr<MemoryTransport> receiver = network_->Find(destination);
+        if (receiver) routes_.emplace(destination, receiver);
+        return receiver;
+    }
+
+    /**
+     * @brief 注入する遅延 (固定遅延 + ジッタ + 並べ替え対象なら追加遅延)。
+     */
+    int64_t InjectedDelayNs() {
+        int64_t ns = params_.delay.count();
+        if (params_.jitter.count() > 0) {
+            ns += std::uniform_int_distribution<int64_t>(0, params_.jitter.count())(rng_);
+        }
+        if (params_.reorder_rate > 0.0 && unit_(rng_) < params_.reorder_rate) ns += params_.reorder_delay.count();
+        return ns;
+    }
+
+    /**
+     * @brief 受信キューにパケットを追加する (送信側のスレッドから呼ばれる)。
+     * @return キューが満杯の場合はfalse
+     */
+    bool Enqueue(Packet&& packet) {
+        if (!queue_.TryPush(std::move(packet))) return false;
+        ScheduleDrain();
+        return true;
+    }
+
+    /**
+     * @brief 受信処理がまだ post されていなければ、I/O コンテキストへ post する。
+     */
+    void ScheduleDrain() {
+        if (drain_pending_.exchange(true, std::memory_order_acq_rel)) return;
+        boost::asio::post(io_context_, hcs_common::BindHandlerMemory(drain_handler_memory_,
+                                                                      [self = shared_from_this()]() { self->Drain(); }));
+    }
+
+    /**
+     * @brief 受信キューからパケットを取り出し、配送する (I/O スレッド)。
+     */
+    void Drain() {
+        // 取り出し前に解除し、以降に追加されたパケットで再度 post されるようにする
+        drain_pending_.store(false, std::memory_order_release);
+        if (!running_.load(std::memory_order_acquire)) return;
+        HCS_TRACE_SPAN("net", "memory.drain");
+
+        Packet packet;
+        size_t count = 0;
+        while (count < MEMORY_DRAIN_BATCH && queue_.TryPop(packet)) {
+            ++count;
+            if (packet.deliver_at_ns == 0) {
+                Deliver(packet);
+            } else {
+                delayed_.push_back(DelayedPacket{packet.deliver_at_ns, delayed_order_++, std::move(packet)});
+                std::push_heap(delayed_.begin(), delayed_.end(), std::greater<DelayedPacket>());
+            }
+            if (!running_.load(std::memory_order_acquire)) return;
+        }
+        if (count == MEMORY_DRAIN_BATCH) ScheduleDrain();
+        if (!delayed_.empty()) DeliverDue();
+    }
+
+    /**
+     * @brief 配送時刻に達した遅延パケットを配送し、次の配送時刻にタイマーを設定する。
+     */
+    void DeliverDue() {
+        const int64_t now = hcs_common::PipelineLatency::NowNs();
+        while (!delayed_.empty() && delayed_.front().deliver_at_ns <= now) {
+            std::pop_heap(delayed_.begin(), delayed_.end(), std::greater<DelayedPacket>());
+            DelayedPacket due = std::move(delayed_.back());
+            delayed_.pop_back();
+            Deliver(due.packet);
+            if (!running_.load(std::memory_order_acquire)) return;
+        }
+        if (delayed_.empty()) return;
+
+        // 既により早い時刻に設定済みであれば、そのタイマーの発火時に改めて設定する
+        const int64_t deadline = delayed_.front().deliver_at_ns;
+        if (timer_armed_ && timer_deadline_ns_ <= deadline) return;
+        timer_armed_ = true;
+        timer_deadline_ns_ = deadline;
+        timer_.expires_at(std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline))));
+        timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec) return; // 再設定または Stop() による取り消し
+            self->timer_armed_ = false;
+            if (self->running_.load(std::memory_order_acquire)) self->DeliverDue();
+        });
+    }
+
+    /**
+     * @brief 受信コールバックを呼び出す (ここから受信側パイプラインの遅延計測を開始する)。
+     */
+    void Deliver(Packet& packet) {
+        HCS_TRACE_SPAN("net", "memory.receive");
+        metrics_->packets_received.Add();
+        metrics_->bytes_received.Add(packet.data->Size());
+
+        hcs_common::PacketTiming timing;
+        timing.Begin();
+        if (packet_callback_) {
+            hcs_common::ScopedPacketTiming timing_scope(timing);
+            packet_callback_(std::move(packet.data), packet.source);
+        } else if (receive_callback_) {
+            std::vector<uint8_t> data(packet.data->Data(), packet.data->Data() + packet.data->Size());
+            hcs_common::ScopedPacketTiming timing_scope(timing);
+            receive_callback_(data, packet.source);
+        }
+    }
+};
+
+} // namespace hcs_net
@@ -0,0 +1,467 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PacketBuffer.h"
+
+/**
+ * @namespace hcs_net
+ * @brief HCSノードのネットワーク関連コンポーネントを格納する名前空間
+ */
+namespace hcs_net {
+
+// --- パケットキャプチャの定数 ---
+constexpr size_t CAPTURE_DEFAULT_RING_PACKETS = 4096;                     ///< リングに保持する直近のパケット数
+constexpr size_t CAPTURE_DEFAULT_SNAPLEN = hcs_common::PACKET_BUFFER_SIZE; ///< 1パケットあたりの最大記録長 (ペイロード)
+constexpr uint32_t PCAPNG_LINKTYPE_RAW = 101;                             ///< 生の IPv4/IPv6 パケット (IP/UDP ヘッダーは合成する)
+constexpr size_t CAPTURE_IPV4_UDP_HEADER = 20 + 8;
+constexpr size_t CAPTURE_IPV6_UDP_HEADER = 40 + 8;
+
+/**
+ * @brief キャプチャ位置。pcapng のインターフェース番号として記録する。
+ */
+enum class CapturePoint : uint8_t {
+    kWire = 0,      ///< 暗号化後 (送信) / 復号前 (受信) のデータグラム
+    kPlaintext = 1, ///< 暗号化前 (送信) / 復号後 (受信) の RTP パケット
+};
+
+/**
+ * @brief パケットの向き。pcapng の epb_flags の値 (1: 受信、2: 送信) と同じ。
+ */
+enum class CaptureDirection : uint8_t {
+    kInbound = 1,
+    kOutbound = 2,
+};
+
+/**
+ * @brief キャプチャの設定。
+ */
+struct CaptureConfig {
+    std::string directory = ".";                     ///< 出力先ディレクトリ
+    size_t ring_packets = CAPTURE_DEFAULT_RING_PACKETS;
+    size_t snaplen = CAPTURE_DEFAULT_SNAPLEN;
+    uint32_t decrypt_failure_burst = 8;                 ///< この回数の復号失敗が window 内に起きたら出力する (0 で無効)
+    std::chrono::milliseconds decrypt_failure_window{1000};
+    std::chrono::milliseconds trigger_cooldown{10000};  ///< 出力の最小間隔 (同じ障害で繰り返し出力しない)
+};
+
+/**
+ * @brief キャプチャのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct CaptureMetrics {
+    hcs_common::Counter& packets;
+    hcs_common::Counter& dumps;
+    hcs_common::Counter& dump_errors;
+    hcs_common::Counter& triggers_suppressed;
+
+    static CaptureMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static CaptureMetrics metrics{
+            registry.GetCounter("hcs_capture_packets_total", "Packets recorded into capture rings"),
+            registry.GetCounter("hcs_capture_dumps_total", "Capture rings written to pcapng files"),
+            registry.GetCounter("hcs_capture_dump_errors_total", "Capture dumps that failed to write"),
+            registry.GetCounter("hcs_capture_triggers_suppressed_total", "Capture triggers ignored during the cooldown"),
+        };
+        return metrics;
+    }
+};
+
+/**
+ * @brief キャプチャしたパケット1件 (出力・再生用)。
+ */
+struct CapturedPacket {
+    CapturePoint point = CapturePoint::kWire;
+    CaptureDirection direction = CaptureDirection::kInbound;
+    int64_t timestamp_ns = 0;      ///< 実時刻 (UNIX エポックからのナノ秒)
+    Endpoint source;
+    Endpoint destination;
+    uint32_t original_length = 0;  ///< 記録長で切り詰める前のペイロード長
+    std::vector<uint8_t> payload;  ///< UDP ペイロード (記録長まで)
+};
+
+/**
+ * @brief パケットを pcapng 形式で書き出す。
+ *
+ * インターフェース0を暗号化後の "wire"、1を平文の "plaintext" とし、リンク種別は生の IP とする。
+ * UDP ペイロードの前に送信元・宛先から IPv4 (両端が IPv4 の場合) または IPv6 と UDP のヘッダーを合成するため、
+ * Wireshark でそのまま UDP/RTP として解析できる (UDP チェックサムは 0)。
+ */
+class PcapngWriter {
+public:
+    explicit PcapngWriter(std::ostream& out, size_t snaplen = CAPTURE_DEFAULT_SNAPLEN) : out_(out) {
+        WriteSectionHeader();
+        WriteInterface("wire", snaplen);
+        WriteInterface("plaintext", snaplen);
+    }
+
+    void Write(const CapturedPacket& packet) {
+        const bool v4 = packet.source.IsV4() && packet.destination.IsV4();
+        const size_t header = v4 ? CAPTURE_IPV4_UDP_HEADER : CAPTURE_IPV6_UDP_HEADER;
+        const uint32_t captured = static_cast<uint32_t>(header + packet.payload.size());
+        const uint32_t original = static_cast<uint32_t>(header + packet.original_length);
+        const size_t padded = Pad4(captured);
+        // ブロック種別・長さ・IF・時刻(2)・記録長・元の長さ + データ + epb_flags + opt_endofopt + 末尾の長さ
+        const uint32_t total = static_cast<uint32_t>(28 + padded + 8 + 4 + 4);
+
+        Put32(0x00000006);
+        Put32(total);
+        Put32(static_cast<uint32_t>(packet.point));
+        const uint64_t ts = static_cast<uint64_t>(packet.timestamp_ns);
+        Put32(static_cast<uint32_t>(ts >> 32));
+        Put32(static_cast<uint32_t>(ts));
+        Put32(captured);
+        Put32(original);
+
+        uint8_t ip_udp[CAPTURE_IPV6_UDP_HEADER] = {};
+        const uint16_t udp_length = static_cast<uint16_t>(8 + packet.original_length);
+        uint8_t* udp;
+        if (v4) {
+            const uint16_t ip_length = static_cast<uint16_t>(20 + udp_length);
+            ip_udp[0] = 0x45;
+            ip_udp[2] = static_cast<uint8_t>(ip_length >> 8);
+            ip_udp[3] = static_cast<uint8_t>(ip_length);
+            ip_udp[8] = 64;  // TTL
+            ip_udp[9] = 17;  // UDP
+            std::memcpy(ip_udp + 12, packet.source.V4Bytes(), 4);
+            std::memcpy(ip_udp + 16, packet.destination.V4Bytes(), 4);
+            const uint16_t checksum = Ipv4Checksum(ip_udp);
+            ip_udp[10] = static_cast<uint8_t>(checksum >> 8);
+            ip_udp[11] = static_cast<uint8_t>(checksum);
+            udp = ip_udp + 20;
+        } else {
+            ip_udp[0] = 0x60;
+            ip_udp[4] = static_cast<uint8_t>(udp_length >> 8);
+            ip_udp[5] = static_cast<uint8_t>(udp_length);
+            ip_udp[6] = 17;  // 次ヘッダー: UDP
+            ip_udp[7] = 64;  // ホップ数
+            std::memcpy(ip_udp + 8, packet.source.address.data(), 16);
+            std::memcpy(ip_udp + 24, packet.destination.address.data(), 16);
+            udp = ip_udp + 40;
+        }
+        udp[0] = static_cast<uint8_t>(packet.source.port >> 8);
+        udp[1] = static_cast<uint8_t>(packet.source.port);
+        udp[2] = static_cast<uint8_t>(packet.destination.port >> 8);
+        udp[3] = static_cast<uint8_t>(packet.destination.port);
+        udp[4] = static_cast<uint8_t>(udp_length >> 8);
+        udp[5] = static_cast<uint8_t>(udp_length);
+        out_.write(reinterpret_cast<const char*>(ip_udp), static_cast<std::streamsize>(header));
+        out_.write(reinterpret_cast<const char*>(packet.payload.data()), static_cast<std::streamsize>(packet.payload.size()));
+        PutZeros(padded - captured);
+
+        Put16(2);  // epb_flags
+        Put16(4);
+        Put32(static_cast<uint32_t>(packet.direction));
+        Put32(0);  // opt_endofopt
+        Put32(total);
+    }
+
+private:
+    std::ostream& out_;
+
+    static size_t Pad4(size_t n) { return (n + 3) & ~size_t{3}; }
+
+    static uint16_t Ipv4Checksum(const uint8_t* header) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < 20; i += 2) sum += (static_cast<uint32_t>(header[i]) << 8) | header[i + 1];
+        while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+        return static_cast<uint16_t>(~sum);
+    }
+
+    // pcapng はセクションのバイト順で書く (ここでは実行環境のバイト順。読み手はバイト順マジックで判定する)
+    void Put16(uint16_t v) { out_.write(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void Put32(uint32_t v) { out_.write(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void PutZeros(size_t n) {
+        static const char zeros[4] = {};
+        out_.write(zeros, static_cast<std::streamsize>(n));
+    }
+
+    void PutOption(uint16_t code, const void* value, size_t length) {
+        Put16(code);
+        Put16(static_cast<uint16_t>(length));
+        out_.write(static_cast<const char*>(value), static_cast<std::streamsize>(length));
+        PutZeros(Pad4(length) - length);
+    }
+
+    void WriteSectionHeader() {
+        static const char application[] = "HCSnode";
+        const uint32_t total = static_cast<uint32_t>(28 + 4 + Pad4(sizeof(application) - 1) + 4);
+        Put32(0x0A0D0D0A);
+        Put32(total);
+        Put32(0x1A2B3C4D);  // バイト順マジック
+        Put16(1);           // メジャーバージョン
+        Put16(0);           // マイナーバージョン
+        Put32(0xFFFFFFFF);  // セクション長 (未指定 = -1)
+        Put32(0xFFFFFFFF);
+        PutOption(4, application, sizeof(application) - 1);  // shb_userappl
+        Put32(0);
+        Put32(total);
+    }
+
+    void WriteInterface(const std::string& name, size_t snaplen) {
+        const uint8_t ts_resolution = 9;  // ナノ秒
+        // ブロック種別・長さ・リンク種別・予約・記録長 + if_name + if_tsresol + opt_endofopt + 末尾の長さ
+        const uint32_t total = static_cast<uint32_t>(16 + 4 + Pad4(name.size()) + 8 + 4 + 4);
+        Put32(0x00000001);
+        Put32(total);
+        Put16(static_cast<uint16_t>(PCAPNG_LINKTYPE_RAW));
+        Put16(0);
+        Put32(static_cast<uint32_t>(snaplen + CAPTURE_IPV6_UDP_HEADER));
+        PutOption(2, name.data(), name.size());            // if_name
+        PutOption(9, &ts_resolution, sizeof(ts_resolution)); // if_tsresol
+        Put32(0);
+        Put32(total);
+    }
+};
+
+/**
+ * @brief 直近のパケットをメモリ上のリングに保持し、トリガー時に pcapng へ書き出すキャプチャ。
+ *
+ * トランスポート (TransportAES256) が暗号化の前後でパケットを Record() に渡す。無効時の Record() は
+ * アトミック変数の読み出し1回のみで、リングのメモリも Enable() まで確保しない。
+ * 有効時はパケットを固定長スロットへ複製する (ミューテックスで直列化。デバッグ時のみのコスト)。
+ * トリガー (復号失敗の連続、親の切り替え、手動) ではリングの内容を複製して専用スレッドで書き出し、
+ * I/O スレッドをファイル書き込みで止めない。連続したトリガーは trigger_cooldown の間抑止する。
+ */
+class PacketCapture {
+public:
+    explicit PacketCapture(CaptureConfig config = {}) : config_(std::move(config)) {}
+
+    ~PacketCapture() {
+        {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            stopping_ = true;
+        }
+        writer_cv_.notify_all();
+        if (writer_.joinable()) writer_.join();
+    }
+
+    PacketCapture(const PacketCapture&) = delete;
+    PacketCapture& operator=(const PacketCapture&) = delete;
+
+    /**
+     * @brief 記録を開始する (初回はリングのメモリを確保する)。
+     */
+    void Enable() {
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        if (slots_.empty()) {
+            slots_.resize(config_.ring_packets);
+            data_.resize(config_.ring_packets * config_.snaplen);
+        }
+        enabled_.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @brief 記録を停止する (リングの内容は保持し、Trigger() で書き出せる)。
+     */
+    void Disable() { enabled_.store(false, std::memory_order_release); }
+
+    bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief パケットをリングに記録する (無効時は何もしない)。
+     * @param point キャプチャ位置
+     * @param direction 向き
+     * @param source 送信元
+     * @param destination 宛先
+     * @param data UDP ペイロード
+     * @param size ペイロード長
+     */
+    void Record(CapturePoint point, CaptureDirection direction, const Endpoint& source, const Endpoint& destination,
+                const uint8_t* data, size_t size) {
+        if (!enabled_.load(std::memory_order_relaxed)) return;
+        RecordSlow(point, direction, source, destination, data, size);
+    }
+
+    /**
+     * @brief 復号失敗を通知する。decrypt_failure_window 内に decrypt_failure_burst 回に達したら書き出す。
+     */
+    void OnDecryptFailure() {
+        if (!Enabled() || config_.decrypt_failure_burst == 0) return;
+        const auto now = std::chrono::steady_clock::now();
+        bool fire = false;
+        {
+            std::lock_guard<std::mutex> lock(ring_mutex_);
+            if (now - failure_window_start_ > config_.decrypt_failure_window) {
+                failure_window_start_ = now;
+                failures_in_window_ = 0;
+            }
+            fire = ++failures_in_window_ == config_.decrypt_failure_burst;
+        }
+        if (fire) Trigger("decrypt-failures");
+    }
+
+    /**
+     * @brief リングの内容を pcapng ファイルへ書き出す (書き込みは専用スレッドで行う)。
+     * @param reason ファイル名に含める理由 ("manual", "parent-switch" など)
+     * @param force trueの場合は抑止期間を無視する (手動の出力)
+     * @return 書き出しを受け付けた場合は出力先のパス、抑止・未記録の場合は空文字列
+     */
+    std::string Trigger(const std::string& reason, bool force = false) {
+        auto dump = std::make_unique<Dump>();
+        const auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(ring_mutex_);
+            if (count_ == 0) return {};
+            if (!force && last_trigger_ != std::chrono::steady_clock::time_point{} &&
+                now - last_trigger_ < config_.trigger_cooldown) {
+                metrics_.triggers_suppressed.Add();
+                return {};
+            }
+            last_trigger_ = now;
+            dump->packets.reserve(count_);
+            const size_t capacity = slots_.size();
+            for (size_t i = 0; i < count_; ++i) {
+                const size_t index = (next_ + capacity - count_ + i) % capacity;
+                const Slot& slot = slots_[index];
+                CapturedPacket packet;
+                packet.point = slot.point;
+                packet.direction = slot.direction;
+                packet.timestamp_ns = slot.timestamp_ns;
+                packet.source = slot.source;
+                packet.destination = slot.destination;
+                packet.original_length = slot.original_length;
+                const uint8_t* data = data_.data() + index * config_.snaplen;
+                packet.payload.assign(data, data + slot.captured_length);
+                dump->packets.push_back(std::move(packet));
+            }
+        }
+        dump->path = config_.directory + "/hcs-" + Timestamp() + "-" + std::to_string(++dump_sequence_) + "-" + reason + ".pcapng";
+        std::string path = dump->path;
+        HCS_LOG_INFO("PacketCapture", "Dumping {} packets to {} (trigger: {}).", dump->packets.size(), path, reason);
+        {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            pending_.push_back(std::move(dump));
+            if (!writer_.joinable()) writer_ = std::thread([this]() { WriterLoop(); });
+        }
+        writer_cv_.notify_one();
+        return path;
+    }
+
+    /**
+     * @brief 受け付け済みの書き出しが全て終わるまで待つ (終了時やツールから使う)。
+     */
+    void Flush() {
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        idle_cv_.wait(lock, [this]() { return pending_.empty() && !writing_; });
+    }
+
+    const CaptureConfig& Config() const { return config_; }
+
+private:
+    struct Slot {
+        int64_t timestamp_ns = 0;
+        Endpoint source;
+        Endpoint destination;
+        uint32_t original_length = 0;
+        uint32_t captured_length = 0;
+        CapturePoint point = CapturePoint::kWire;
+        CaptureDirection direction = CaptureDirection::kInbound;
+    };
+
+    struct Dump {
+        std::string path;
+        std::vector<CapturedPacket> packets;
+    };
+
+    const CaptureConfig config_;
+    std::atomic<bool> enabled_{false};
+    CaptureMetrics& metrics_ = CaptureMetrics::Get();
+
+    // リング (ring_mutex_ で保護)
+    std::mutex ring_mutex_;
+    std::vector<Slot> slots_;
+    std::vector<uint8_t> data_;  // スロットごとに snaplen バイト
+    size_t next_ = 0;
+    size_t count_ = 0;
+    std::chrono::steady_clock::time_point failure_window_start_;
+    uint32_t failures_in_window_ = 0;
+    std::chrono::steady_clock::time_point last_trigger_;
+    uint64_t dump_sequence_ = 0;
+
+    // 書き出しスレッド (writer_mutex_ で保護)
+    std::mutex writer_mutex_;
+    std::condition_variable writer_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<std::unique_ptr<Dump>> pending_;
+    bool writing_ = false;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    void RecordSlow(CapturePoint point, CaptureDirection direction, const Endpoint& source, const Endpoint& destination,
+                    const uint8_t* data, size_t size) {
+        const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const size_t captured = std::min(size, config_.snaplen);
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        if (slots_.empty()) return;
+        Slot& slot = slots_[next_];
+        slot.timestamp_ns = now_ns;
+        slot.source = source;
+        slot.destination = destination;
+        slot.original_length = static_cast<uint32_t>(size);
+        slot.captured_length = static_cast<uint32_t>(captured);
+        slot.point = point;
+        slot.direction = direction;
+        std::memcpy(data_.data() + next_ * config_.snaplen, data, captured);
+        next_ = (next_ + 1) % slots_.size();
+        if (count_ < slots_.size()) ++count_;
+        metrics_.packets.Add();
+    }
+
+    void WriterLoop() {
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        for (;;) {
+            writer_cv_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) return;  // 停止時も受け付け済みの分は書き出してから終える
+            std::unique_ptr<Dump> dump = std::move(pending_.front());
+            pending_.pop_front();
+            writing_ = true;
+            lock.unlock();
+            WriteDump(*dump);
+            lock.lock();
+            writing_ = false;
+            idle_cv_.notify_all();
+        }
+    }
+
+    void WriteDump(const Dump& dump) {
+        std::ofstream file(dump.path, std::ios::binary | std::ios::trunc);
+        if (file) {
+            PcapngWriter writer(file, config_.snaplen);
+            for (const auto& packet : dump.packets) writer.Write(packet);
+            file.flush();
+        }
+        if (!file) {
+            metrics_.dump_errors.Add();
+            HCS_LOG_ERROR("PacketCapture", "Failed to write capture file {}", dump.path);
+            return;
+        }
+        metrics_.dumps.Add();
+    }
+
+    static std::string Timestamp() {
+        const std::time_t now = std::time(nullptr);
+        std::tm tm{};
+        localtime_r(&now, &tm);
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y%m%d-%H%M%S", &tm);
+        return buf;
+    }
+};
+
+} // namespace hcs_net
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include "common.h"
+
+/**
+ * @namespace hcs_net
+ * @brief HCSノードのネットワーク関連コンポーネントを格納する名前空間
+ */
+namespace hcs_net {
+
+/**
+ * @brief コンパイル時に合成する受信処理の連鎖 (受信 → 復号 → 振り分け → 後段)。
+ *
+ * 各段は次の形の呼び出し可能オブジェクトで、受理したパケットを next へ渡し、破棄する場合は何もしない。
+ * @code
+ * template <typename Next>
+ * void operator()(hcs_common::PacketRef packet, const Endpoint& sender, Next& next);
+ * @endcode
+ * 最後の要素は (PacketRef, const Endpoint&) を受け取る終端処理。全段の型がコンパイル時に決まるため、
+ * 連鎖全体が1つの関数にインライン展開され、段の間の間接呼び出しやコールバックの保持は発生しない。
+ * トランスポートからの呼び出し (BindPacketPipeline) だけが PacketCallback を介した1回の間接呼び出しとなる。
+ */
+template <typename... Stages>
+class PacketPipeline;
+
+/**
+ * @brief 終端処理のみの連鎖
+ */
+template <typename Sink>
+class PacketPipeline<Sink> {
+public:
+    explicit PacketPipeline(Sink sink) : sink_(std::move(sink)) {}
+
+    void operator()(hcs_common::PacketRef packet, const Endpoint& sender) {
+        sink_(std::move(packet), sender);
+    }
+
+    /**
+     * @brief 終端処理 (集計値の参照用)
+     */
+    Sink& Head() { return sink_; }
+
+private:
+    Sink sink_;
+};
+
+/**
+ * @brief 先頭の段と、残りの段からなる連鎖
+ */
+template <typename Stage, typename... Rest>
+class PacketPipeline<Stage, Rest...> {
+public:
+    explicit PacketPipeline(Stage stage, Rest... rest) : stage_(std::move(stage)), rest_(std::move(rest)...) {}
+
+    void operator()(hcs_common::PacketRef packet, const Endpoint& sender) {
+        stage_(std::move(packet), sender, rest_);
+    }
+
+    /**
+     * @brief 先頭の段 (Dropped() などの集計値の参照用)
+     */
+    Stage& Head() { return stage_; }
+
+    /**
+     * @brief 残りの段からなる連鎖
+     */
+    PacketPipeline<Rest...>& Tail() { return rest_; }
+
+private:
+    Stage stage_;
+    PacketPipeline<Rest...> rest_;
+};
+
+/**
+ * @brief 段と終端処理から連鎖を作る
+ * @param stages 前段から順に並べた段。最後の要素が終端処理
+ */
+template <typename... Stages>
+PacketPipeline<std::decay_t<Stages>...> MakePacketPipeline(Stages&&... stages) {
+    return PacketPipeline<std::decay_t<Stages>...>(std::forward<Stages>(stages)...);
+}
+
+/**
+ * @brief トランスポートの受信パケットを連鎖へ渡すよう設定する (既存の PacketCallback を置き換える)。
+ * 連鎖はトランスポートの停止まで生存していること。
+ * @param transport 受信元のトランスポート (暗号化する場合は基底トランスポート)
+ * @param pipeline 受信処理の連鎖
+ */
+template <typename Pipeline>
+void BindPacketPipeline(Transport& transport, Pipeline& pipeline) {
+    transport.SetPacketCallback([&pipeline](hcs_common::PacketRef packet, const Endpoint& sender) {
+        pipeline(std::move(packet), sender);
+    });
+}
+
+} // namespace hcs_net
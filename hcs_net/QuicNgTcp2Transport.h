@@ -0,0 +1,293 @@
+#pragma once
+
+// 外部ライブラリの依存性
+#include <ngtcp2/ngtcp2.h>
+#include <openssl/ssl.h>
+#include <boost/asio.hpp>
+// プロジェクト内の依存性
+#include "TransportAES256.h" // TransportCrypto, KeyProvider
+#include "PacketCapture.h"    // デバッグ用のパケットキャプチャ
+#include "TransportBase.h"    // IMediaTransport, Endpoint (必須)
+#include "AsioEndpoint.h"     // Endpoint と Asio のエンドポイントの変換
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PipelineLatency.h"
+
+namespace hcs_net {
+
+/**
+ * @brief メディアトランスポートのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct MediaTransportMetrics {
+    hcs_common::Counter& packets_sent;
+    hcs_common::Counter& bytes_sent;
+    hcs_common::Counter& send_errors;
+    hcs_common::Counter& packets_received;
+    hcs_common::Counter& bytes_received;
+
+    static MediaTransportMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static MediaTransportMetrics metrics{
+            registry.GetCounter("hcs_media_packets_sent_total", "Media datagrams sent (after encryption)"),
+            registry.GetCounter("hcs_media_bytes_sent_total", "Media bytes sent (after encryption)"),
+            registry.GetCounter("hcs_media_send_errors_total", "Media send failures"),
+            registry.GetCounter("hcs_media_packets_received_total", "Media datagrams received (before decryption)"),
+            registry.GetCounter("hcs_media_bytes_received_total", "Media bytes received (before decryption)"),
+        };
+        return metrics;
+    }
+};
+
+
+class QuicNgTcp2Transport : public IMediaTransport,
+                           public std::enable_shared_from_this<QuicNgTcp2Transport> {
+public:
+    using RecvHandler = IMediaTransport::RecvHandler;
+
+    QuicNgTcp2Transport(boost::asio::io_context& io,
+                        std::shared_ptr<KeyProvider> kp,
+                        const std::string& local_addr,
+                        uint16_t local_port)
+        : io_(io),
+          key_provider_(kp),
+          local_addr_(local_addr),
+          local_port_(local_port),
+          socket_(io)
+    {
+        // 1. AES-GCM 暗号化の初期化 (現在のセキュアUDPの役割)
+        auto mk = key_provider_->GetMasterKey();
+        auto ms = key_provider_->GetMasterSalt();
+        crypto_ = std::make_unique<TransportCrypto>(mk, ms, "quic");
+        recv_buffer_.resize(4096);
+
+        // 2. OpenSSL TLS 1.3 コンテキストの初期化 (将来のQUIC/TLS用)
+        ssl_ctx_ = SSL_CTX_new(TLS_method());
+        if (!ssl_ctx_) {
+            HCS_LOG_ERROR("QuicNgTcp2Transport", "SSL_CTX_new failed.");
+            return;
+        }
+        SSL_CTX_set_min_proto_version(ssl_ctx_, TLS1_3_VERSION);
+        SSL_CTX_set_cipher_list(ssl_ctx_, "TLS_AES_256_GCM_SHA384");
+        SSL_CTX_set_options(ssl_ctx_, SSL_OP_NO_TLSv1_2);
+        // TODO: 証明書・秘密鍵をロード or 生成
+    }
+
+    ~QuicNgTcp2Transport() override {
+        Stop(); 
+        if (ssl_ctx_) SSL_CTX_free(ssl_ctx_);
+    }
+
+    void StartReceive(RecvHandler handler) override {
+        handler_ = std::move(handler);
+        OpenSocket();
+        AsyncReceive();
+        // ngtcp2 connection 初期化 (QUIC移行時に実装)
+        InitNgTcp2Connection();
+    }
+
+    void SetRelayHandler(RelayHandler handler) override {
+        relay_handler_ = std::move(handler);
+    }
+
+    void SetRelayActive(bool active) override {
+        relay_active_ = active;
+    }
+
+    void SendRawPacket(hcs_common::PacketRef wire, const Endpoint& dest) override {
+        // 暗号文をそのまま送る (QUIC移行時はストリームの中継となり、再暗号化が必要になる)
+        Capture(CapturePoint::kWire, CaptureDirection::kOutbound, dest, wire->Data(), wire->Size());
+        SendQuicStream(dest, std::vector<uint8_t>(wire->Data(), wire->Data() + wire->Size()), hcs_common::PacketTiming{});
+    }
+
+    bool SealPacket(hcs_common::PacketRef& packet, const Endpoint& dest) override {
+        // 暗号文をプールのバッファに置き換える (SendRawPacket で宛先ごとに QUIC ストリームへ送る)
+        std::vector<uint8_t> cipher;
+        Capture(CapturePoint::kPlaintext, CaptureDirection::kOutbound, dest, packet->Data(), packet->Size());
+        if (!crypto_->Encrypt(packet->Data(), packet->Size(), nullptr, 0, cipher)) {
+            crypto_metrics_.encrypt_errors.Add();
+            return false;
+        }
+        crypto_metrics_.encrypted.Add();
+        if (auto* current = hcs_common::ScopedPacketTiming::Current()) {
+            current->Mark(hcs_common::PipelineStage::kEncrypt);
+        }
+        packet = hcs_common::PacketPool::Local().CopyFrom(cipher.data(), cipher.size());
+        return true;
+    }
+
+    void SendPacket(hcs_common::PacketRef packet, const Endpoint& dest) override
+    {
+        // 現在はAES-GCM暗号化の上にQUICストリーム送信のフックを配置
+        std::vector<uint8_t> cipher;
+        // 1. 暗号化 (QUIC移行時は ngtcp2/TLS が担当)
+        Capture(CapturePoint::kPlaintext, CaptureDirection::kOutbound, dest, packet->Data(), packet->Size());
+        if (!crypto_->Encrypt(packet->Data(), packet->Size(), nullptr, 0, cipher)) {
+            crypto_metrics_.encrypt_errors.Add();
+            return;
+        }
+
+        crypto_metrics_.encrypted.Add();
+        Capture(CapturePoint::kWire, CaptureDirection::kOutbound, dest, cipher.data(), cipher.size());
+
+        // 送信元 (StreamEncoder) が計測中のタイミングを送信完了まで持ち越す
+        hcs_common::PacketTiming timing;
+        if (auto* current = hcs_common::ScopedPacketTiming::Current()) {
+            current->Mark(hcs_common::PipelineStage::kEncrypt);
+            timing = *current;
+        }
+
+        // 2. 送信 (QUIC移行時は ngtcp2 が UDP パケットを構築)
+        SendQuicStream(dest, cipher, timing);
+    }
+
+    /**
+     * @brief 暗号化の前後 (平文と暗号文) のパケットを記録するキャプチャを設定する (StartReceive の前に呼ぶ)
+     * @param capture 記録先 (nullptrで解除)
+     */
+    void SetCapture(std::shared_ptr<PacketCapture> capture) {
+        capture_ = std::move(capture);
+        Endpoint::Parse(local_addr_, local_port_, capture_local_);
+    }
+
+    size_t PendingSends() const override {
+        return pending_sends_;
+    }
+
+    void Stop() override {
+        boost::system::error_code ec;
+        socket_.close(ec);
+        // ngtcp2 関連のクリーンアップ
+        if (quic_conn_) {
+            ngtcp2_conn_close(quic_conn_, nullptr, 0);
+            ngtcp2_conn_del(quic_conn_);
+            quic_conn_ = nullptr;
+        }
+        if (ssl_) {
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+    }
+
+private:
+    boost::asio::io_context& io_;
+    std::shared_ptr<KeyProvider> key_provider_;
+    std::unique_ptr<TransportCrypto> crypto_;
+    RecvHandler handler_;
+    RelayHandler relay_handler_;
+    bool relay_active_ = true; // 中継先がある (false の間は暗号文を複製しない)
+
+    std::string local_addr_;
+    uint16_t local_port_;
+    boost::asio::ip::udp::socket socket_;
+    std::vector<uint8_t> recv_buffer_;
+    boost::asio::ip::udp::endpoint sender_endpoint_;
+
+    // OpenSSL TLS
+    SSL_CTX* ssl_ctx_ = nullptr;
+    SSL* ssl_ = nullptr;
+
+    // ngtcp2 connection
+    ngtcp2_conn* quic_conn_ = nullptr;
+    uint64_t stream_id_ = 0; // メディアストリームID
+    size_t pending_sends_ = 0; // 完了ハンドラ待ちの送信数
+
+    MediaTransportMetrics& metrics_ = MediaTransportMetrics::Get();
+    CryptoMetrics& crypto_metrics_ = CryptoMetrics::Get();
+
+    // デバッグ用のパケットキャプチャ (未設定・無効時は記録しない)
+    std::shared_ptr<PacketCapture> capture_;
+    Endpoint capture_local_;
+
+    void Capture(CapturePoint point, CaptureDirection direction, const Endpoint& peer, const uint8_t* data, size_t size) {
+        if (!capture_) return;
+        if (direction == CaptureDirection::kOutbound) capture_->Record(point, direction, capture_local_, peer, data, size);
+        else capture_->Record(point, direction, peer, capture_local_, data, size);
+    }
+
+    void OpenSocket() {
+        boost::asio::ip::udp::endpoint ep(boost::asio::ip::address::from_string(local_addr_), local_port_);
+        boost::system::error_code ec;
+        socket_.open(ep.protocol(), ec);
+        socket_.bind(ep, ec);
+        if (ec) HCS_LOG_ERROR("QuicNgTcp2Transport", "Socket bind error: {}", ec.message());
+    }
+
+    void AsyncReceive() {
+        socket_.async_receive_from(
+            boost::asio::buffer(recv_buffer_),
+            sender_endpoint_,
+            [self = shared_from_this()](const boost::system::error_code& ec, std::size_t bytes_recvd) {
+                self->HandleReceive(ec, bytes_recvd);
+            });
+    }
+
+    void HandleReceive(const boost::system::error_code& ec, std::size_t bytes_recvd) {
+        if (!ec && bytes_recvd > 0) {
+            hcs_common::PacketTiming timing;
+            timing.BeginReceive(0); // ngtcp2 の受信経路はカーネルの時刻を持たないため、受信時刻は現在時刻
+            metrics_.packets_received.Add();
+            metrics_.bytes_received.Add(bytes_recvd);
+            const Endpoint sender = FromUdpEndpoint(sender_endpoint_);
+            Capture(CapturePoint::kWire, CaptureDirection::kInbound, sender, recv_buffer_.data(), bytes_recvd);
+            // QUIC移行時のロジック:
+            // ngtcp2_conn_recv(quic_conn_, ...) を呼び出し、ngtcp2_callbacks::recv_stream_data で
+            // プレーンテキストを取得する。
+            
+            // 現在のロジック (AES-GCM セキュアUDP):
+            std::vector<uint8_t> plaintext;
+            if (crypto_->Decrypt(recv_buffer_.data(), bytes_recvd, nullptr, 0, plaintext)) {
+                crypto_metrics_.decrypted.Add();
+                timing.Mark(hcs_common::PipelineStage::kDecrypt);
+                Capture(CapturePoint::kPlaintext, CaptureDirection::kInbound, sender, plaintext.data(), plaintext.size());
+                hcs_common::ScopedPacketTiming timing_scope(timing);
+                // 復号化されたRTPパケットをプールのバッファに載せてStreamDecoderへ渡す
+                // (QUIC移行時は recv_stream_data のデータを直接バッファへ書き込む)
+                auto packet = hcs_common::PacketPool::Local().CopyFrom(plaintext.data(), plaintext.size());
+                if (relay_handler_ && relay_active_) {
+                    relay_handler_(hcs_common::PacketPool::Local().CopyFrom(recv_buffer_.data(), bytes_recvd), *packet, sender);
+                }
+                if (handler_) handler_(std::move(packet), sender);
+            } else {
+                crypto_metrics_.decrypt_failures.Add();
+                if (capture_) capture_->OnDecryptFailure();
+                HCS_LOG_WARN_EVERY("QuicNgTcp2Transport", "Decrypt/Auth failed on packet from {}", sender_endpoint_.address());
+            }
+        }
+        if (!ec) AsyncReceive();
+    }
+
+    void InitNgTcp2Connection() {
+        // TODO: QUIC コネクション作成、ハンドシェイク、TLS 連携の実装
+        HCS_LOG_INFO("QuicNgTcp2Transport", "NgTcp2 connection initialization placeholder running.");
+    }
+
+    void SendQuicStream(const Endpoint& dest,
+                        const std::vector<uint8_t>& data,
+                        hcs_common::PacketTiming timing)
+    {
+        // QUIC移行時のロジック:
+        // 1. ngtcp2_conn_write_stream(quic_conn_, stream_id_, ...) でストリームデータ書き込み
+        // 2. ngtcp2_conn_write_pkt(quic_conn_, ...) で送信すべき UDP パケットを生成
+        // 3. 生成されたパケットを socket_.async_send_to で送信
+        
+        // 現在のロジック (AES-GCMで暗号化済みデータを直接UDP送信):
+        // 送信完了まで暗号文を保持する (呼び出し元のバッファは送信完了前に解放される)
+        auto buffer = std::make_shared<std::vector<uint8_t>>(data);
+        ++pending_sends_;
+        socket_.async_send_to(
+            boost::asio::buffer(*buffer),
+            ToUdpEndpoint(dest),
+            [self = shared_from_this(), buffer, metrics = &metrics_, timing](const boost::system::error_code& ec, std::size_t bytes_sent) mutable {
+                --self->pending_sends_;
+                if (ec) {
+                    metrics->send_errors.Add();
+                } else {
+                    metrics->packets_sent.Add();
+                    metrics->bytes_sent.Add(bytes_sent);
+                    timing.Mark(hcs_common::PipelineStage::kSocketSend);
+                }
+            });
+    }
+};
+
+} // namespace hcs_net
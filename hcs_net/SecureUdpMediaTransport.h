@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+#include "TransportBase.h"    // IMediaTransport
+#include "TransportAES256.h"  // AES-256-GCM の暗号化層
+#include "UdpTransport.h"     // 基底の UDP トランスポート
+#include "PacketCapture.h"
+
+namespace hcs_net {
+
+/**
+ * @brief UdpTransport と TransportAES256 を IMediaTransport として束ねたメディアトランスポート。
+ *
+ * 送受信は TransportAES256 のパケットバッファ経路を通り、受信ハンドラは TransportAES256 の
+ * パケットコールバックとしてそのまま登録されるため、定常状態でヒープ確保・複製を行わない。
+ * カーネルのタイムスタンプ (SocketTimestamping) も UdpTransport の設定がそのまま使われる。
+ * 全メソッドは io_context のスレッドから呼び出すことを前提とする。
+ */
+class SecureUdpMediaTransport : public IMediaTransport,
+                                public std::enable_shared_from_this<SecureUdpMediaTransport> {
+public:
+    /**
+     * @brief コンストラクタ (ソケットはここでバインドする)
+     * @param io Boost.Asio I/Oコンテキスト
+     * @param key_provider 鍵を提供する KeyProvider
+     * @param local_addr バインドするローカルアドレス ("::" の場合はデュアルスタック)
+     * @param local_port バインドするローカルポート
+     * @throw boost::system::system_error バインドできない場合
+     * @throw std::runtime_error 鍵長が不正な場合
+     */
+    SecureUdpMediaTransport(boost::asio::io_context& io,
+                            std::shared_ptr<KeyProvider> key_provider,
+                            const std::string& local_addr,
+                            uint16_t local_port)
+        : udp_(std::make_shared<UdpTransport>(io, local_addr, local_port)),
+          secure_(std::make_shared<TransportAES256>(std::move(key_provider), udp_))
+    {
+        Endpoint::Parse(local_addr, local_port, local_);
+    }
+
+    ~SecureUdpMediaTransport() override {
+        Stop();
+    }
+
+    /**
+     * @brief カーネルのタイムスタンプの取得方法を設定する (StartReceive の前に呼ぶ)
+     */
+    void SetTimestampMode(SocketTimestampMode mode) {
+        udp_->SetTimestampMode(mode);
+    }
+
+    /**
+     * @brief 冗長配信時の重複排除を切り替える (TransportAES256::EnableDuplicateFilter)
+     */
+    void EnableDuplicateFilter(bool enabled) {
+        secure_->EnableDuplicateFilter(enabled);
+    }
+
+    /**
+     * @brief 暗号化の前後のパケットを記録するキャプチャを設定する (StartReceive の前に呼ぶ)
+     */
+    void SetCapture(std::shared_ptr<PacketCapture> capture) {
+        secure_->SetCapture(std::move(capture), local_);
+    }
+
+    void StartReceive(RecvHandler handler) override {
+        // 復号済みのバッファをそのままハンドラへ渡す (RecvHandler と PacketCallback は同じ型)
+        secure_->SetPacketCallback(std::move(handler));
+        secure_->Start();
+    }
+
+    void SetRelayHandler(RelayHandler handler) override {
+        secure_->SetRelayCallback(std::move(handler));
+    }
+
+    void SetRelayActive(bool active) override {
+        secure_->SetRelayActive(active);
+    }
+
+    void SendPacket(hcs_common::PacketRef packet, const Endpoint& dest) override {
+        secure_->SendPacket(std::move(packet), dest);
+    }
+
+    bool SealPacket(hcs_common::PacketRef& packet, const Endpoint& dest) override {
+        return secure_->SealPacket(packet, dest);
+    }
+
+    void SendRawPacket(hcs_common::PacketRef wire, const Endpoint& dest) override {
+        secure_->SendRawPacket(std::move(wire), dest);
+    }
+
+    size_t PendingSends() const override {
+        return udp_->PendingSends();
+    }
+
+    void Stop() override {
+        secure_->Stop();
+    }
+
+private:
+    std::shared_ptr<UdpTransport> udp_;
+    std::shared_ptr<TransportAES256> secure_;
+    Endpoint local_;
+};
+
+} // namespace hcs_net
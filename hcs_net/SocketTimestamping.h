@@ -0,0 +1,145 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#endif
+#include "common.h"
+
+/**
+ * @namespace hcs_net
+ * @brief HCSノードのネットワーク関連コンポーネントを格納する名前空間
+ */
+namespace hcs_net {
+
+constexpr size_t TIMESTAMP_CONTROL_SIZE = 256; ///< 受信時の補助データ (タイムスタンプ・送信元アドレスの拡張エラー) の領域
+
+/**
+ * @brief カーネルによるタイムスタンプの取得方法。
+ */
+enum class SocketTimestampMode : uint8_t {
+    kOff,      ///< 取得しない (ユーザー空間で受信ハンドラが動いた時刻を用いる)
+    kSoftware, ///< カーネルのネットワークスタックが付ける時刻 (ドライバとの受け渡し時点)
+    kHardware, ///< NIC が付ける時刻を優先する (NIC 側の設定と PHC の時刻同期 (phc2sys) が前提。無い場合はソフトウェアの時刻)
+};
+
+/**
+ * @brief 1つのデータグラムに付いたカーネルのタイムスタンプ。
+ */
+struct KernelTimestamp {
+    int64_t steady_ns = 0; ///< 単調時計 (PipelineLatency::NowNs と同じ時計) に換算した時刻。取得できない場合は0
+    uint32_t tx_id = 0;    ///< 送信タイムスタンプの場合、ソケットでの送信順の番号 (SOF_TIMESTAMPING_OPT_ID)
+    bool hardware = false; ///< NIC が付けた時刻か
+
+    explicit operator bool() const { return steady_ns != 0; }
+};
+
+/**
+ * @brief SO_TIMESTAMPING による送受信時刻の取得。
+ *
+ * カーネルはデータグラムがネットワークスタック (または NIC) を通過した時刻を記録し、
+ * 受信時は recvmsg の補助データとして、送信時はソケットのエラーキューに時刻だけを返す (OPT_TSONLY)。
+ * ユーザー空間で時刻を取ると、受信からリアクタがハンドラを呼ぶまでの待ち時間 (CPU 負荷時に増える) が
+ * RTT や遅延の計測値に混入するが、カーネルの時刻にはそれが含まれない。
+ * カーネルの時刻は実時刻 (CLOCK_REALTIME) のため、取り出す時点で単調時計との差を引いて換算する。
+ * Linux 以外では Enable() が false を返し、呼び出し側はユーザー空間の時刻で計測を続ける。
+ */
+class SocketTimestamping {
+public:
+    /**
+     * @brief ソケットで送受信のタイムスタンプを有効にする
+     * @param fd UDP ソケットのファイルディスクリプタ
+     * @param mode 取得方法 (kOff の場合は何もしない)
+     * @param transmit 送信タイムスタンプも取得するか (取得する場合はエラーキューを読み続けること)
+     * @return 有効にできた場合はtrue
+     */
+    static bool Enable(int fd, SocketTimestampMode mode, bool transmit = true) {
+#if defined(__linux__)
+        if (mode == SocketTimestampMode::kOff) return false;
+        unsigned int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (transmit) flags |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+        if (mode == SocketTimestampMode::kHardware) {
+            flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+            if (transmit) flags |= SOF_TIMESTAMPING_TX_HARDWARE;
+        }
+        return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+#else
+        (void)fd;
+        (void)mode;
+        (void)transmit;
+        return false;
+#endif
+    }
+
+    /**
+     * @brief recvmsg で受け取った補助データからタイムスタンプを取り出す
+     * @param msg recvmsg に渡したメッセージ (msg_control に TIMESTAMP_CONTROL_SIZE 以上の領域を用意すること)
+     * @return タイムスタンプ (補助データに含まれない場合は steady_ns == 0)
+     */
+    static KernelTimestamp Parse(msghdr& msg) {
+        KernelTimestamp result;
+#if defined(__linux__)
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+                // ts[0] = ソフトウェア, ts[1] = 旧形式 (未使用), ts[2] = ハードウェア (生の PHC 時刻)
+                timespec ts[3];
+                std::memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+                if (ts[2].tv_sec != 0 || ts[2].tv_nsec != 0) {
+                    result.steady_ns = ToSteadyNs(ts[2]);
+                    result.hardware = true;
+                } else if (ts[0].tv_sec != 0 || ts[0].tv_nsec != 0) {
+                    result.steady_ns = ToSteadyNs(ts[0]);
+                }
+            } else if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                       (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                // 送信タイムスタンプ: どの送信に対する時刻かは ee_data の送信順の番号で示される
+                sock_extended_err err;
+                std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                if (err.ee_errno == ENOMSG && err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) result.tx_id = err.ee_data;
+            }
+        }
+#else
+        (void)msg;
+#endif
+        return result;
+    }
+
+    /**
+     * @brief 受信したデータグラムの送信元アドレスを Endpoint に変換する
+     */
+    static Endpoint ToEndpoint(const sockaddr_storage& addr) {
+        if (addr.ss_family == AF_INET6) {
+            const auto& v6 = reinterpret_cast<const sockaddr_in6&>(addr);
+            // v4 射影アドレスも FromV6Bytes でそのまま同じ表現になる
+            return Endpoint::FromV6Bytes(v6.sin6_addr.s6_addr, ntohs(v6.sin6_port), v6.sin6_scope_id);
+        }
+        const auto& v4 = reinterpret_cast<const sockaddr_in&>(addr);
+        return Endpoint::FromV4Bytes(reinterpret_cast<const uint8_t*>(&v4.sin_addr), ntohs(v4.sin_port));
+    }
+
+private:
+    /**
+     * @brief カーネルの実時刻を単調時計に換算する (換算時点の2つの時計の差を用いる)
+     */
+    static int64_t ToSteadyNs(const timespec& kernel) {
+        timespec real{}, mono{};
+        clock_gettime(CLOCK_REALTIME, &real);
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        const int64_t offset = ToNs(real) - ToNs(mono);
+        const int64_t steady = ToNs(kernel) - offset;
+        // 換算後の時刻が現在より未来になる (時計の調整直後など) 場合は現在時刻に丸める
+        return steady > ToNs(mono) ? ToNs(mono) : steady;
+    }
+
+    static int64_t ToNs(const timespec& ts) {
+        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+};
+
+} // namespace hcs_net
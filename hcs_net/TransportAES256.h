@@ -1,9 +1,14 @@
 #pragma once
 
 #include "common.h"
+#include "DuplicateFilter.h"
+#include "PacketCapture.h"
 #include <openssl/evp.h> // OpenSSLのEVPインターフェースを使用
 #include <stdexcept>
-#include <iostream>
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PipelineLatency.h"
+#include "hcs_common/Tracing.h"
 #include <map>
 #include <random> // std::random_device を使用
 
@@ -19,6 +24,29 @@ constexpr size_t GCM_IV_SIZE = 12;           ///< GCMの初期化ベクトル(IV
 constexpr size_t GCM_TAG_SIZE = 16;          ///< GCMの認証タグサイズ (16バイト)
 constexpr size_t ENCRYPTED_OVERHEAD = GCM_IV_SIZE + GCM_TAG_SIZE; ///< 暗号化後の追加バイト数
 
+/**
+ * @brief 暗号化層のメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct CryptoMetrics {
+    hcs_common::Counter& encrypted;
+    hcs_common::Counter& encrypt_errors;
+    hcs_common::Counter& decrypted;
+    hcs_common::Counter& decrypt_failures;
+    hcs_common::Counter& duplicates_dropped;
+
+    static CryptoMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static CryptoMetrics metrics{
+            registry.GetCounter("hcs_crypto_encrypted_total", "Packets encrypted with AES-256-GCM"),
+            registry.GetCounter("hcs_crypto_encrypt_errors_total", "Encryption or send failures"),
+            registry.GetCounter("hcs_crypto_decrypted_total", "Packets decrypted and authenticated"),
+            registry.GetCounter("hcs_crypto_decrypt_failures_total", "Packets rejected by decryption or GCM authentication"),
+            registry.GetCounter("hcs_crypto_duplicates_dropped_total", "Redundant-path duplicates dropped before decryption"),
+        };
+        return metrics;
+    }
+};
+
 /**
  * @brief AES-256-GCMを使用したセキュアなトランスポート層の実装
  *
@@ -31,6 +59,7 @@ public:
      * @brief コンストラクタ
      * @param key_provider 鍵とソルトを提供する KeyProvider の共有ポインタ
      * @param base_transport 実際のネットワークI/Oを行う基底トランスポート層 (UDP/TCP実装)
+     * @throw std::runtime_error 鍵長が不正、または暗号コンテキストを初期化できない場合
      */
     TransportAES256(std::shared_ptr<KeyProvider> key_provider,
                     std::shared_ptr<Transport> base_transport)
@@ -38,13 +67,22 @@ public:
           base_transport_(std::move(base_transport)),
           // IVカウンタの初期値をランダムなシードで設定 (セキュリティの堅牢性向上)
           current_iv_counter_(std::random_device{}()), 
-          user_callback_()
+          // IV固定部には送信者ごとのランダムなID (SSRC相当) を設定し、送信者間のノンス衝突を防ぐ
+          sender_id_(std::random_device{}())
     {
-        // 基底トランスポートからの受信コールバックをラムダ式で設定
-        // std::bindよりも現代的で、キャプチャ[this]によりメンバ関数を呼び出す
-        base_transport_->SetReceiveCallback(
-            [this](const std::vector<uint8_t>& data, const Endpoint& ep) {
-                this->DecryptAndHandle(data, ep);
+        // 暗号・鍵・IV長の設定はパケットごとに繰り返さず、ここで一度だけ行う
+        // (パケットごとには IV のみを設定し、コンテキストの確保と鍵スケジュールを省く)
+        const auto& key_bytes = key_provider_->GetEncryptionKey();
+        if (key_bytes.size() != AES256_KEY_SIZE) {
+            throw std::runtime_error("Invalid encryption key size.");
+        }
+        InitCipherContext(encrypt_ctx_.get(), key_bytes.data(), true);
+        InitCipherContext(decrypt_ctx_.get(), key_bytes.data(), false);
+
+        // 基底トランスポートからはパケットバッファで受け取り、その場で復号する
+        base_transport_->SetPacketCallback(
+            [this](hcs_common::PacketRef packet, const Endpoint& ep) {
+                this->DecryptAndHandle(std::move(packet), ep);
             });
     }
 
@@ -68,213 +106,424 @@ public:
      * @param destination 宛先エンドポイント
      */
     void Send(const std::vector<uint8_t>& data, const Endpoint& destination) override {
+        // プールのバッファに IV とタグを含めて収まる大きさであれば、複製してその場で暗号化する
+        if (data.size() + GCM_TAG_SIZE <= hcs_common::PACKET_BUFFER_SIZE - hcs_common::PACKET_HEADROOM) {
+            SendPacket(hcs_common::PacketPool::Local().CopyFrom(data.data(), data.size()), destination);
+            return;
+        }
+
         try {
+            // 区間の識別子は IV のカウンタ値 (受信側の aes.decrypt と同じ値になる)
+            HCS_TRACE_SPAN("crypto", "aes.encrypt", current_iv_counter_);
             // 1. データ暗号化
+            Capture(CapturePoint::kPlaintext, CaptureDirection::kOutbound, destination, data.data(), data.size());
             std::vector<uint8_t> encrypted_packet = Encrypt(data);
+            metrics_.encrypted.Add();
+            Capture(CapturePoint::kWire, CaptureDirection::kOutbound, destination,
+                    encrypted_packet.data(), encrypted_packet.size());
+            if (auto* timing = hcs_common::ScopedPacketTiming::Current()) {
+                timing->Mark(hcs_common::PipelineStage::kEncrypt);
+            }
             
             // 2. 暗号化済みデータを基底トランスポートで送信
             base_transport_->Send(encrypted_packet, destination);
 
         } catch (const std::exception& e) {
-            std::cerr << "TransportAES256::Send error: " << e.what() << std::endl;
+            metrics_.encrypt_errors.Add();
+            HCS_LOG_ERROR_EVERY("TransportAES256", "Send error: {}", e.what());
         }
     }
 
     /**
-     * @brief 受信コールバックの設定 (コピー)
+     * @brief パケットバッファを先頭と末尾の余白を使ってその場で暗号化し、基底トランスポートで送信する
+     * @param packet 暗号化する平文 (他に参照がある場合や余白が足りない場合は複製してから暗号化する)
+     * @param destination 宛先エンドポイント
+     */
+    void SendPacket(hcs_common::PacketRef packet, const Endpoint& destination) override {
+        // 1. IV | 平文 | タグ の領域を確保し、平文をその場で暗号化
+        if (!SealPacket(packet, destination)) return;
+        // 2. 暗号化済みデータを基底トランスポートで送信
+        SendRawPacket(std::move(packet), destination);
+    }
+
+    /**
+     * @brief パケットバッファを先頭と末尾の余白を使ってその場で暗号化する (送信はしない)
+     * 同じパケットを複数の宛先へ送る場合は、一度だけ暗号化して SendRawPacket で送る。
+     * 全ての宛先が同じ IV の暗号文を受け取るため、別の経路で届いた同一パケットを下流の重複排除が識別できる。
+     * @param packet 暗号化する平文 (他に参照がある場合や余白が足りない場合は複製してから暗号化する)
+     * @param destination キャプチャに記録する宛先 (複数の宛先へ送る場合は代表の宛先。暗号文は送信時に宛先ごとに記録する)
+     * @return 暗号化できた場合はtrue (失敗はメトリクスとログに記録する)
+     */
+    bool SealPacket(hcs_common::PacketRef& packet, const Endpoint& destination) {
+        try {
+            HCS_TRACE_SPAN("crypto", "aes.encrypt", current_iv_counter_);
+            // 中継で同じ平文を複数の宛先へ送る場合など、他の参照から見えるデータは書き換えない
+            if (!packet->Unique() || packet->Headroom() < GCM_IV_SIZE || packet->Tailroom() < GCM_TAG_SIZE) {
+                packet = hcs_common::PacketPool::Local().CopyFrom(packet->Data(), packet->Size());
+            }
+
+            const size_t plaintext_size = packet->Size();
+            Capture(CapturePoint::kPlaintext, CaptureDirection::kOutbound, destination, packet->Data(), plaintext_size);
+            uint8_t* out = packet->Prepend(GCM_IV_SIZE);
+            packet->Append(GCM_TAG_SIZE);
+            EncryptTo(out + GCM_IV_SIZE, plaintext_size, out);
+            metrics_.encrypted.Add();
+            if (auto* timing = hcs_common::ScopedPacketTiming::Current()) {
+                timing->Mark(hcs_common::PipelineStage::kEncrypt);
+            }
+            return true;
+        } catch (const std::exception& e) {
+            metrics_.encrypt_errors.Add();
+            HCS_LOG_ERROR_EVERY("TransportAES256", "Send error: {}", e.what());
+            return false;
+        }
+    }
+
+    /// 中継用のコールバック (認証済みの暗号文、その平文、送信元)
+    using RelayCallback = hcs_common::InplaceFunction<void(const hcs_common::PacketRef&, const hcs_common::PacketBuffer&,
+                                                           const Endpoint&)>;
+
+    /**
+     * @brief 受信パケットを暗号文のまま中継するためのコールバックを設定する
+     *
+     * 設定時は復号の前に暗号文への参照を残し (OpenPacket は共有中のバッファを複製してから復号する)、
+     * 認証に成功したパケットについて、受信コールバックより先に暗号文と平文を渡す。
+     * 暗号文を SendRawPacket でそのまま転送すれば IV (送信者ID, カウンタ) が保たれるため、
+     * 下流の重複排除は経路によらず同一パケットを識別できる。
+     * @param callback 中継先を決めて SendRawPacket を呼ぶコールバック (空で解除)
+     */
+    void SetRelayCallback(RelayCallback callback) {
+        relay_callback_ = std::move(callback);
+    }
+
+    /**
+     * @brief 中継先があるかを設定する (既定は true)
+     * false の間は中継コールバックを呼ばず、暗号文への参照も残さないため、受信したバッファをその場で復号できる。
+     * 葉ノードのように中継先がない間は false にして、受信パケットごとの複製を避ける。
+     * @param active 中継コールバックを呼ぶ場合はtrue
+     */
+    void SetRelayActive(bool active) {
+        relay_active_.store(active, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 暗号化済みのパケットを再暗号化せずに基底トランスポートで送信する (中継・SealPacket 後の送信用)
+     * @param wire IV, 暗号文, 認証タグを連結したパケット (複数の宛先へ送る場合は参照を共有してよい)
+     * @param destination 宛先エンドポイント
+     */
+    void SendRawPacket(hcs_common::PacketRef wire, const Endpoint& destination) {
+        Capture(CapturePoint::kWire, CaptureDirection::kOutbound, destination, wire->Data(), wire->Size());
+        base_transport_->SendPacket(std::move(wire), destination);
+    }
+
+    /**
+     * @brief 受信コールバックの設定
      */
     void SetReceiveCallback(ReceiveCallback callback) override {
         user_callback_ = std::move(callback);
     }
-    
+
     /**
-     * @brief 受信コールバックの設定 (ムーブ)
+     * @brief 復号済みのパケットバッファで受け取る受信コールバックの設定 (設定時は ReceiveCallback より優先される)
      */
-    void SetReceiveCallback(ReceiveCallback&& callback) override {
-        user_callback_ = std::move(callback);
+    void SetPacketCallback(PacketCallback callback) override {
+        packet_callback_ = std::move(callback);
+    }
+
+    /**
+     * @brief 受信したパケットの受信時刻を引き継ぐ (基底トランスポートが記録していなければここから計測する)
+     */
+    static hcs_common::PacketTiming BeginReceiveTiming() {
+        hcs_common::PacketTiming timing;
+        if (auto* current = hcs_common::ScopedPacketTiming::Current()) timing = *current;
+        else timing.Begin();
+        return timing;
+    }
+
+    /**
+     * @brief 受信した暗号化パケットをその場で復号し、IVとタグを取り除く
+     * 受信コールバックを介さずに復号する場合 (DecryptStage) に直接呼ぶ。重複・認証失敗はメトリクスとログに記録する。
+     * @param packet IV, 暗号文, 認証タグを連結したパケット (他に参照がある場合は複製してから復号する)
+     * @param sender 送信元エンドポイント
+     * @param timing kDecrypt を記録するタイミング
+     * @return 受理した場合はtrue、破棄した場合はfalse
+     */
+    bool OpenPacket(hcs_common::PacketRef& packet, const Endpoint& sender, hcs_common::PacketTiming& timing) {
+        Capture(CapturePoint::kWire, CaptureDirection::kInbound, sender, packet->Data(), packet->Size());
+        HCS_TRACE_SPAN_NAMED(span, "crypto", "aes.decrypt");
+        uint32_t stream_id = 0;
+        uint64_t seq = 0;
+        if ((dedup_enabled_ || hcs_common::Tracer::Enabled()) && packet->Size() >= ENCRYPTED_OVERHEAD) {
+            // IVは平文で運ばれるため、復号前に (送信者ID, カウンタ) を読める (区間の識別子にも使う)
+            ParseIv(packet->Data(), stream_id, seq);
+            HCS_TRACE_SET_ID(span, seq);
+            // 復号前の重複判定: ビットマップ参照のみで後着分を破棄できる
+            if (dedup_enabled_ && duplicate_filter_.IsDuplicate(stream_id, seq)) {
+                metrics_.duplicates_dropped.Add();
+                return false;
+            }
+        }
+
+        try {
+            // 他の参照から見える暗号文 (中継で転送中のものなど) は書き換えない
+            if (!packet->Unique()) {
+                const int64_t received_ns = packet->ReceiveTimestamp();
+                packet = hcs_common::PacketPool::Local().CopyFrom(packet->Data(), packet->Size());
+                packet->SetReceiveTimestamp(received_ns);
+            }
+            // 暗号文の位置にその場で復号し、IVとタグを取り除く
+            const size_t plaintext_len = DecryptTo(packet->Data(), packet->Size(), packet->Data() + GCM_IV_SIZE);
+            packet->Consume(GCM_IV_SIZE);
+            packet->Resize(plaintext_len);
+        } catch (const std::runtime_error& e) {
+            metrics_.decrypt_failures.Add();
+            HCS_LOG_WARN_EVERY("TransportAES256", "Decrypt error: {} from {}", e.what(), sender);
+            if (capture_) capture_->OnDecryptFailure();
+            return false;
+        }
+        metrics_.decrypted.Add();
+        timing.Mark(hcs_common::PipelineStage::kDecrypt);
+        Capture(CapturePoint::kPlaintext, CaptureDirection::kInbound, sender, packet->Data(), packet->Size());
+
+        // 認証に成功したパケットのみを受理済みとして記録する
+        if (dedup_enabled_) duplicate_filter_.Mark(stream_id, seq);
+        return true;
+    }
+
+    /**
+     * @brief 受信パケットの重複排除を有効/無効にする (冗長配信モード用)
+     *
+     * 有効時は、復号前にIVの (送信者ID, カウンタ) をビットマップで照合し、
+     * 既に受理した同一パケットを復号せずに破棄する。中継ノードは暗号文を
+     * そのまま転送する (SetRelayCallback/SendRawPacket) ため、2つの親から届く同一パケットはIVも一致する。
+     * @param enabled trueで重複排除を有効化
+     */
+    void EnableDuplicateFilter(bool enabled) {
+        dedup_enabled_ = enabled;
+        if (!enabled) duplicate_filter_.Reset();
+    }
+
+    /**
+     * @brief 暗号化の前後 (平文と暗号文) のパケットを記録するキャプチャを設定する
+     * 起動前に設定すること。記録の有効/無効は PacketCapture::Enable()/Disable() で切り替える。
+     * @param capture 記録先 (nullptrで解除)
+     * @param local 自ノードのエンドポイント (記録するパケットの送信元/宛先に使う)
+     */
+    void SetCapture(std::shared_ptr<PacketCapture> capture, const Endpoint& local) {
+        capture_ = std::move(capture);
+        capture_local_ = local;
     }
 
 private:
     std::shared_ptr<KeyProvider> key_provider_;
     std::shared_ptr<Transport> base_transport_;
     ReceiveCallback user_callback_;
+    PacketCallback packet_callback_;
+    RelayCallback relay_callback_;
+    std::atomic<bool> relay_active_{true}; // 中継先がある (false の間は中継コールバックを呼ばない)
+
+    // 鍵設定済みの暗号コンテキスト (パケットごとに IV のみを再設定して使い回す)
+    using CipherContext = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+    CipherContext encrypt_ctx_{EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free};
+    CipherContext decrypt_ctx_{EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free};
 
     // GCM IV/Nonceの安全性を確保するためのカウンタ
     uint64_t current_iv_counter_;
+    // IVの固定部 (先頭4バイト) に埋め込む送信者ID
+    uint32_t sender_id_;
+
+    // 冗長配信時の先着優先重複排除
+    bool dedup_enabled_ = false;
+    DuplicateFilter duplicate_filter_;
+
+    CryptoMetrics& metrics_ = CryptoMetrics::Get();
+
+    // デバッグ用のパケットキャプチャ (未設定・無効時は記録しない)
+    std::shared_ptr<PacketCapture> capture_;
+    Endpoint capture_local_;
 
     /**
-     * @brief データをAES-256-GCMで暗号化する
-     * @param plaintext 暗号化する平文
-     * @return IV, 暗号文, 認証タグを連結したバイトベクター
+     * @brief パケットをキャプチャに記録する (向きに応じて自ノードと相手を送信元/宛先に割り当てる)
      */
-    std::vector<uint8_t> Encrypt(const std::vector<uint8_t>& plaintext) {
-        // 鍵の取得
-        const auto& key_bytes = key_provider_->GetEncryptionKey();
-        if (key_bytes.size() != AES256_KEY_SIZE) {
-            throw std::runtime_error("Invalid encryption key size.");
+    void Capture(CapturePoint point, CaptureDirection direction, const Endpoint& peer, const uint8_t* data, size_t size) {
+        if (!capture_) return;
+        if (direction == CaptureDirection::kOutbound) capture_->Record(point, direction, capture_local_, peer, data, size);
+        else capture_->Record(point, direction, peer, capture_local_, data, size);
+    }
+
+    /**
+     * @brief 暗号コンテキストに暗号・IV長・鍵を設定する
+     * @param ctx 設定するコンテキスト
+     * @param key AES256_KEY_SIZE バイトの鍵
+     * @param encrypt trueで暗号化用、falseで復号用
+     */
+    static void InitCipherContext(EVP_CIPHER_CTX* ctx, const uint8_t* key, bool encrypt) {
+        if (!ctx) {
+            throw std::runtime_error("Failed to create EVP_CIPHER_CTX.");
         }
-        
-        // 1. IV（ノンス）の生成
+        const int enc = encrypt ? 1 : 0;
+        if (1 != EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL, enc))
+            throw std::runtime_error("EVP_CipherInit_ex failed.");
+        if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_SIZE, NULL))
+            throw std::runtime_error("EVP_CTRL_GCM_SET_IVLEN failed.");
+        if (1 != EVP_CipherInit_ex(ctx, NULL, NULL, key, NULL, enc))
+            throw std::runtime_error("EVP_CipherInit_ex (key) failed.");
+    }
+
+    /**
+     * @brief 次のIVを書き込む (先頭4バイトは送信者ID、残り8バイトはカウンタ値。いずれもビッグエンディアン)
+     * @param iv GCM_IV_SIZE バイトの出力先
+     */
+    void NextIv(uint8_t* iv) {
         uint64_t iv_value = current_iv_counter_++;
-        
-        // GCM_IV_SIZE (12バイト) のIVを作成
-        std::vector<uint8_t> iv(GCM_IV_SIZE);
-        // IVの最初の4バイトは固定値（例：0x00, 0x00, 0x00, 0x01）
-        iv[0] = 0x00; iv[1] = 0x00; iv[2] = 0x00; iv[3] = 0x01;
-        // 残りの8バイトをカウンタ値とする（リトルエンディアンでコピー）
+        iv[0] = (uint8_t)(sender_id_ >> 24); iv[1] = (uint8_t)(sender_id_ >> 16);
+        iv[2] = (uint8_t)(sender_id_ >> 8);  iv[3] = (uint8_t)(sender_id_);
         for (int i = 0; i < 8; ++i) {
             iv[GCM_IV_SIZE - 1 - i] = (uint8_t)(iv_value >> (i * 8));
         }
+    }
 
-        // 2. 暗号化処理の準備
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) {
-            throw std::runtime_error("Failed to create EVP_CIPHER_CTX.");
-        }
+    /**
+     * @brief データをAES-256-GCMで暗号化し、IV | 暗号文 | 認証タグ を書き込む
+     * @param plaintext 暗号化する平文 (out + GCM_IV_SIZE と同じ位置であれば、その場で暗号化される)
+     * @param size 平文のサイズ
+     * @param out 出力先 (ENCRYPTED_OVERHEAD + size バイト)
+     */
+    void EncryptTo(const uint8_t* plaintext, size_t size, uint8_t* out) {
+        EVP_CIPHER_CTX* ctx = encrypt_ctx_.get();
 
+        // 1. IV（ノンス）の生成と設定 (鍵は設定済み)
+        uint8_t* iv = out;
+        NextIv(iv);
+        if (1 != EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv))
+            throw std::runtime_error("EVP_EncryptInit_ex (iv) failed.");
+
+        // 2. 暗号化本体
+        uint8_t* ciphertext = out + GCM_IV_SIZE;
         int len = 0;
-        int ciphertext_len = 0;
-        std::vector<uint8_t> ciphertext(plaintext.size());
+        if (1 != EVP_EncryptUpdate(ctx, ciphertext, &len, plaintext, (int)size))
+            throw std::runtime_error("EVP_EncryptUpdate failed.");
 
-        try {
-            // 初期化
-            if (1 != EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL))
-                throw std::runtime_error("EVP_EncryptInit_ex failed.");
+        // 3. 最終処理 (GCMでは追加の出力はない)
+        int final_len = 0;
+        if (1 != EVP_EncryptFinal_ex(ctx, ciphertext + len, &final_len))
+            throw std::runtime_error("EVP_EncryptFinal_ex failed.");
 
-            // 鍵とIVの設定
-            if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_SIZE, NULL))
-                throw std::runtime_error("EVP_CTRL_GCM_SET_IVLEN failed.");
-            
-            if (1 != EVP_EncryptInit_ex(ctx, NULL, NULL, key_bytes.data(), iv.data()))
-                throw std::runtime_error("EVP_EncryptInit_ex (key/iv) failed.");
-            
-            // 3. 暗号化本体
-            if (1 != EVP_EncryptUpdate(ctx, ciphertext.data(), &len, plaintext.data(), (int)plaintext.size()))
-                throw std::runtime_error("EVP_EncryptUpdate failed.");
-            ciphertext_len = len;
-
-            // 4. 最終処理
-            if (1 != EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len))
-                throw std::runtime_error("EVP_EncryptFinal_ex failed.");
-            ciphertext_len += len;
-            
-            // 5. 認証タグの取得
-            std::vector<uint8_t> tag(GCM_TAG_SIZE);
-            if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_SIZE, tag.data()))
-                throw std::runtime_error("EVP_CTRL_GCM_GET_TAG failed.");
-
-            // 6. 結果の結合 (IV | 暗号文 | タグ)
-            std::vector<uint8_t> result;
-            result.reserve(GCM_IV_SIZE + ciphertext_len + GCM_TAG_SIZE);
-            result.insert(result.end(), iv.begin(), iv.end());
-            result.insert(result.end(), ciphertext.begin(), ciphertext.begin() + ciphertext_len);
-            result.insert(result.end(), tag.begin(), tag.end());
-            
-            EVP_CIPHER_CTX_free(ctx);
-            return result;
+        // 4. 認証タグの取得
+        if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_SIZE, ciphertext + size))
+            throw std::runtime_error("EVP_CTRL_GCM_GET_TAG failed.");
+    }
 
-        } catch (...) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw; // 例外を再スロー
-        }
+    /**
+     * @brief データをAES-256-GCMで暗号化する
+     * @param plaintext 暗号化する平文
+     * @return IV, 暗号文, 認証タグを連結したバイトベクター
+     */
+    std::vector<uint8_t> Encrypt(const std::vector<uint8_t>& plaintext) {
+        std::vector<uint8_t> result(ENCRYPTED_OVERHEAD + plaintext.size());
+        EncryptTo(plaintext.data(), plaintext.size(), result.data());
+        return result;
     }
     
     /**
-     * @brief データを復号化してユーザーコールバックに渡す
-     * @param encrypted_data IV, 暗号文, 認証タグを連結したバイトベクター
+     * @brief データをその場で復号化してユーザーコールバックに渡す
+     * @param packet IV, 暗号文, 認証タグを連結したパケット
      * @param sender 送信元エンドポイント
      */
-    void DecryptAndHandle(const std::vector<uint8_t>& encrypted_data, const Endpoint& sender) {
-        try {
-            std::vector<uint8_t> plaintext = Decrypt(encrypted_data);
-            
-            // 成功した場合、ユーザー設定のコールバックを呼び出す
-            if (user_callback_) {
-                user_callback_(plaintext, sender);
-            }
-        } catch (const std::runtime_error& e) {
-            std::cerr << "TransportAES256::Decrypt error: " << e.what() 
-                      << " from " << sender.ToString() << std::endl;
+    void DecryptAndHandle(hcs_common::PacketRef packet, const Endpoint& sender) {
+        hcs_common::PacketTiming timing = BeginReceiveTiming();
+        // 中継先がある場合のみ暗号文への参照を残す (共有中のバッファは OpenPacket が複製してから復号する)
+        hcs_common::PacketRef wire;
+        if (relay_callback_ && relay_active_.load(std::memory_order_relaxed)) wire = packet;
+        if (!OpenPacket(packet, sender, timing)) return;
+
+        // 成功した場合、中継 (暗号文のまま) の後にユーザー設定のコールバックを呼び出す
+        hcs_common::ScopedPacketTiming timing_scope(timing);
+        if (wire) relay_callback_(wire, *packet, sender);
+        if (packet_callback_) {
+            packet_callback_(std::move(packet), sender);
+        } else if (user_callback_) {
+            std::vector<uint8_t> plaintext(packet->Data(), packet->Data() + packet->Size());
+            user_callback_(plaintext, sender);
+        }
+    }
+
+    /**
+     * @brief IVから送信者IDとカウンタ値を取り出す
+     * @param iv GCM_IV_SIZE バイトのIVへのポインタ
+     * @param stream_id 送信者ID (IV先頭4バイト) の出力先
+     * @param seq カウンタ値 (IV後半8バイト) の出力先
+     */
+    static void ParseIv(const uint8_t* iv, uint32_t& stream_id, uint64_t& seq) {
+        stream_id = ((uint32_t)iv[0] << 24) | ((uint32_t)iv[1] << 16) |
+                    ((uint32_t)iv[2] << 8) | (uint32_t)iv[3];
+        seq = 0;
+        for (size_t i = 4; i < GCM_IV_SIZE; ++i) {
+            seq = (seq << 8) | iv[i];
         }
     }
 
     /**
      * @brief AES-256-GCMでデータを復号化する
-     * @param encrypted_packet IV, 暗号文, 認証タグを連結したバイトベクター
-     * @return 復号化された平文
+     * @param encrypted_packet IV, 暗号文, 認証タグを連結したデータ
+     * @param size データのサイズ
+     * @param plaintext 平文の出力先 (暗号文の位置 encrypted_packet + GCM_IV_SIZE であれば、その場で復号される)
+     * @return 平文のサイズ
      * @throw std::runtime_error 認証失敗または復号化エラーの場合
      */
-    std::vector<uint8_t> Decrypt(const std::vector<uint8_t>& encrypted_packet) {
-        if (encrypted_packet.size() < ENCRYPTED_OVERHEAD) {
+    size_t DecryptTo(const uint8_t* encrypted_packet, size_t size, uint8_t* plaintext) {
+        if (size < ENCRYPTED_OVERHEAD) {
             throw std::runtime_error("Encrypted packet is too short.");
         }
 
-        const auto& key_bytes = key_provider_->GetEncryptionKey();
-        if (key_bytes.size() != AES256_KEY_SIZE) {
-            throw std::runtime_error("Invalid decryption key size.");
-        }
+        // 1. パケットの分解 (IV、暗号文、タグへのポインタ)
+        const size_t ciphertext_len = size - ENCRYPTED_OVERHEAD;
+        const uint8_t* iv_ptr = encrypted_packet;
+        const uint8_t* ciphertext_ptr = encrypted_packet + GCM_IV_SIZE;
+        const uint8_t* tag_ptr = encrypted_packet + size - GCM_TAG_SIZE;
 
-        // 1. パケットの分解
-        const size_t iv_offset = 0;
-        const size_t ciphertext_offset = GCM_IV_SIZE;
-        const size_t tag_offset = encrypted_packet.size() - GCM_TAG_SIZE;
-        const size_t ciphertext_len = encrypted_packet.size() - ENCRYPTED_OVERHEAD;
-
-        // IV、暗号文、タグへのポインタ
-        const uint8_t* iv_ptr = encrypted_packet.data() + iv_offset;
-        const uint8_t* ciphertext_ptr = encrypted_packet.data() + ciphertext_offset;
-        const uint8_t* tag_ptr = encrypted_packet.data() + tag_offset;
-
-        // 2. 復号化処理の準備
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) {
-            throw std::runtime_error("Failed to create EVP_CIPHER_CTX for decryption.");
-        }
+        // 2. IVの設定 (鍵は設定済み)
+        EVP_CIPHER_CTX* ctx = decrypt_ctx_.get();
+        if (1 != EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv_ptr))
+            throw std::runtime_error("EVP_DecryptInit_ex (iv) failed.");
 
+        // 3. 復号化本体
         int len = 0;
-        int plaintext_len = 0;
-        std::vector<uint8_t> plaintext(ciphertext_len);
-        
-        try {
-            // 初期化
-            if (1 != EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL))
-                throw std::runtime_error("EVP_DecryptInit_ex failed.");
-
-            // IV長の指定
-            if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_SIZE, NULL))
-                throw std::runtime_error("EVP_CTRL_GCM_SET_IVLEN failed.");
-
-            // 鍵とIVの設定
-            if (1 != EVP_DecryptInit_ex(ctx, NULL, NULL, key_bytes.data(), iv_ptr))
-                throw std::runtime_error("EVP_DecryptInit_ex (key/iv) failed.");
-
-            // 3. 復号化本体
-            if (1 != EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext_ptr, (int)ciphertext_len))
-                throw std::runtime_error("EVP_DecryptUpdate failed.");
-            plaintext_len = len;
-
-            // 4. 認証タグの設定
-            if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_SIZE, (void*)tag_ptr))
-                throw std::runtime_error("EVP_CTRL_GCM_SET_TAG failed.");
-
-            // 5. 最終処理と認証
-            if (1 != EVP_DecryptFinal_ex(ctx, plaintext.data() + len, &len)) {
-                // 認証失敗
-                throw std::runtime_error("Authentication failed (MAC error). Packet forged or corrupted.");
-            }
-            plaintext_len += len;
-            
-            // 復号化に成功した場合、結果を返す
-            plaintext.resize(plaintext_len);
-            
-            EVP_CIPHER_CTX_free(ctx);
-            return plaintext;
-
-        } catch (...) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw; // 例外を再スロー
+        if (1 != EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext_ptr, (int)ciphertext_len))
+            throw std::runtime_error("EVP_DecryptUpdate failed.");
+        size_t plaintext_len = len;
+
+        // 4. 認証タグの設定
+        if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_SIZE, (void*)tag_ptr))
+            throw std::runtime_error("EVP_CTRL_GCM_SET_TAG failed.");
+
+        // 5. 最終処理と認証
+        if (1 != EVP_DecryptFinal_ex(ctx, plaintext + len, &len)) {
+            // 認証失敗
+            throw std::runtime_error("Authentication failed (MAC error). Packet forged or corrupted.");
         }
+        return plaintext_len + len;
     }
 };
 
+/**
+ * @brief PacketPipeline の復号段。TransportAES256 の受信コールバックを介さずに復号し、受理したパケットを次段へ渡す。
+ * 連鎖は基底トランスポートに BindPacketPipeline で設定する (TransportAES256 は送信と鍵・重複排除の状態を受け持つ)。
+ */
+class DecryptStage {
+public:
+    explicit DecryptStage(TransportAES256& transport) : transport_(&transport) {}
+
+    template <typename Next>
+    void operator()(hcs_common::PacketRef packet, const Endpoint& sender, Next& next) {
+        hcs_common::PacketTiming timing = TransportAES256::BeginReceiveTiming();
+        if (!transport_->OpenPacket(packet, sender, timing)) return;
+        hcs_common::ScopedPacketTiming timing_scope(timing);
+        next(std::move(packet), sender);
+    }
+
+private:
+    TransportAES256* transport_;
+};
+
 } // namespace hcs_net
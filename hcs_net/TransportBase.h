@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "common.h" // Endpoint, PacketRef
+#include "hcs_common/InplaceFunction.h"
+
+namespace hcs_net {
+
+/**
+ * @brief メディアパケット (RTP) を送受信するトランスポートの抽象インターフェース。
+ *
+ * HCSNode はこのインターフェースを通じて、エンコーダ・デコーダ・中継をトランスポート実装
+ * (SecureUdpMediaTransport / QuicNgTcp2Transport) に接続する。暗号化と復号は実装側で行い、
+ * 受信ハンドラには復号・認証済みのパケットバッファが渡される。
+ * パケットごとに呼ばれる経路のため、ハンドラは InplaceFunction とし、データは PacketRef のまま
+ * 受け渡す (ヒープ確保・複製・送信完了の post を行わない)。
+ * 全メソッドは io_context のスレッドから呼び出すことを前提とする。
+ */
+class IMediaTransport {
+public:
+    /// 受信ハンドラ (復号済みのパケット、送信元)。パケットはハンドラが所有し、その場で書き換えてよい
+    using RecvHandler = hcs_common::InplaceFunction<void(hcs_common::PacketRef, const Endpoint&)>;
+    /// 中継ハンドラ (認証済みの暗号文、その平文、送信元)。受信ハンドラより先に呼ばれる
+    using RelayHandler = hcs_common::InplaceFunction<void(const hcs_common::PacketRef&, const hcs_common::PacketBuffer&,
+                                                          const Endpoint&)>;
+
+    virtual ~IMediaTransport() = default;
+
+    /**
+     * @brief ソケットを開いて受信を開始し、ハンドラを登録する。
+     * @throw std::runtime_error ソケットを開けない場合
+     */
+    virtual void StartReceive(RecvHandler handler) = 0;
+
+    /**
+     * @brief 認証済みの受信パケットを暗号文のまま中継するためのハンドラを登録する (StartReceive の前に呼ぶ)。
+     * ハンドラは SendRawPacket で暗号文を転送する。再暗号化しないため、下流の重複排除 (IV で照合) が
+     * 経路によらず同一パケットを識別できる。
+     */
+    virtual void SetRelayHandler(RelayHandler handler) = 0;
+
+    /**
+     * @brief 中継先があるかを伝える (既定では何もせず、中継ハンドラを常に呼ぶ)。
+     * 中継先がない間は受信した暗号文への参照を残さず、復号のための複製を省ける。
+     * @param active 中継ハンドラを呼ぶ必要がある場合はtrue
+     */
+    virtual void SetRelayActive(bool active) { (void)active; }
+
+    /**
+     * @brief 平文のパケットを暗号化して送信する。
+     * 他に参照がなく余白が足りていれば、パケットバッファの上でその場で暗号化する。
+     * 送信完了の通知は行わず、失敗はトランスポートのメトリクスとログに記録される。
+     * @param packet 送信する平文 (複数の宛先へ送る場合は参照を共有してよい)
+     * @param dest 宛先
+     */
+    virtual void SendPacket(hcs_common::PacketRef packet, const Endpoint& dest) = 0;
+
+    /**
+     * @brief 平文のパケットを暗号化する (送信はしない)。
+     * 同じパケットを複数の宛先へ送る場合は一度だけ暗号化し、SendRawPacket で宛先ごとに送る。
+     * 全ての宛先が同じ IV の暗号文を受け取るため、下流の重複排除が経路によらず同一パケットを識別できる。
+     * @param packet 暗号化する平文 (成功時は暗号文に置き換わる。他に参照がある場合は複製してから暗号化する)
+     * @param dest キャプチャに記録する宛先 (複数の宛先へ送る場合は代表の宛先)
+     * @return 暗号化できた場合はtrue (失敗はトランスポートのメトリクスとログに記録される)
+     */
+    virtual bool SealPacket(hcs_common::PacketRef& packet, const Endpoint& dest) = 0;
+
+    /**
+     * @brief 暗号化済みのパケット (RelayHandler に渡された暗号文・SealPacket の結果) を再暗号化せずに送信する。
+     * @param wire 送信する暗号文 (複数の宛先へ送る場合は参照を共有してよい)
+     * @param dest 宛先
+     */
+    virtual void SendRawPacket(hcs_common::PacketRef wire, const Endpoint& dest) = 0;
+
+    /**
+     * @brief 送信を依頼済みで、まだ完了していないパケット数。
+     * 停止時のドレインで、送信キューを送出しきったかの判定に用いる。
+     */
+    virtual size_t PendingSends() const { return 0; }
+
+    /**
+     * @brief ソケットを閉じる (送信中のパケットは破棄される)。
+     */
+    virtual void Stop() = 0;
+};
+
+} // namespace hcs_net
@@ -1,8 +1,18 @@
 #pragma once
 
 #include "common.h"
+#include "AsioEndpoint.h"
+#include "SocketTimestamping.h"
 #include <boost/asio.hpp> // Boost.Asioの使用を想定
-#include <iostream>
+#include "hcs_common/HandlerMemory.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PipelineLatency.h"
+#include "hcs_common/Tracing.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
 #include <memory> // shared_from_this を利用
 
 /**
@@ -17,6 +27,39 @@ using UdpSocket = asio::ip::udp::socket;
 using UdpEndpoint = asio::ip::udp::endpoint;
 using IoContext = asio::io_context;
 
+constexpr size_t UDP_SEND_HANDLER_BLOCKS = 512; ///< 送信完了ハンドラ用に事前確保するブロック数 (同時に保留できる送信数の目安)
+constexpr size_t UDP_RECEIVE_BATCH = 32;        ///< 受信可能の通知1回あたりに読み出す最大データグラム数 (カーネルのタイムスタンプ使用時)
+constexpr size_t UDP_TX_TIMESTAMP_SLOTS = 1024; ///< 送信タイムスタンプを待つ送信の記録数 (これを超えて遅れた時刻は捨てる)
+
+/**
+ * @brief UDPトランスポートのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct UdpTransportMetrics {
+    hcs_common::Counter& packets_sent;
+    hcs_common::Counter& bytes_sent;
+    hcs_common::Counter& send_errors;
+    hcs_common::Counter& packets_received;
+    hcs_common::Counter& bytes_received;
+    hcs_common::Counter& receive_errors;
+    hcs_common::Counter& rx_timestamps;
+    hcs_common::Counter& tx_timestamps;
+
+    static UdpTransportMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static UdpTransportMetrics metrics{
+            registry.GetCounter("hcs_udp_packets_sent_total", "UDP datagrams sent"),
+            registry.GetCounter("hcs_udp_bytes_sent_total", "UDP payload bytes sent"),
+            registry.GetCounter("hcs_udp_send_errors_total", "UDP send failures"),
+            registry.GetCounter("hcs_udp_packets_received_total", "UDP datagrams received"),
+            registry.GetCounter("hcs_udp_bytes_received_total", "UDP payload bytes received"),
+            registry.GetCounter("hcs_udp_receive_errors_total", "UDP receive failures"),
+            registry.GetCounter("hcs_udp_kernel_rx_timestamps_total", "UDP datagrams received with a kernel timestamp"),
+            registry.GetCounter("hcs_udp_kernel_tx_timestamps_total", "Kernel transmit timestamps matched to a sent datagram"),
+        };
+        return metrics;
+    }
+};
+
 /**
  * @brief UDPを使用したトランスポート層の具象実装
  * * このクラスは、hcs_net::Transport インターフェースを実装し、
@@ -37,13 +80,46 @@ public:
         receive_buffer_.resize(65536); // 最大UDPパケットサイズに設定
     }
 
+    /**
+     * @brief 指定アドレスにバインドするコンストラクタ
+     * IPv6 の未指定アドレス ("::") ではデュアルスタックで待ち受け、IPv4 のピアとも送受信する。
+     * @param io_context AsioのI/Oコンテキスト
+     * @param local_address バインドするローカルアドレス (IPv4/IPv6)
+     * @param local_port バインドするローカルポート番号
+     * @throw boost::system::system_error アドレスが不正、またはバインドできない場合
+     */
+    UdpTransport(IoContext& io_context, const std::string& local_address, unsigned short local_port)
+        : io_context_(io_context),
+          socket_(io_context)
+    {
+        const UdpEndpoint local(asio::ip::make_address(local_address), local_port);
+        socket_.open(local.protocol());
+        if (local.address().is_v6() && local.address().is_unspecified()) {
+            socket_.set_option(asio::ip::v6_only(false));
+            dual_stack_ = true;
+        }
+        socket_.bind(local);
+        receive_buffer_.resize(65536);
+    }
+
     /**
      * @brief トランスポート層の起動（非同期受信の開始）
      */
     void Start() override {
+        // カーネルのタイムスタンプを有効にできなければ、従来どおり受信ハンドラの時刻で計測する
+        if (timestamp_mode_ != SocketTimestampMode::kOff) {
+            kernel_timestamps_ = SocketTimestamping::Enable(socket_.native_handle(), timestamp_mode_);
+            if (kernel_timestamps_) {
+                socket_.non_blocking(true);
+                WaitErrorQueue();
+            } else {
+                HCS_LOG_WARN("UdpTransport", "Kernel timestamping is unavailable; latency is measured in user space.");
+            }
+        }
         // 非同期受信処理を開始
         StartReceive();
-        std::cout << "UdpTransport started on port " << socket_.local_endpoint().port() << std::endl;
+        HCS_LOG_INFO("UdpTransport", "Started on port {} (kernel timestamps: {})", socket_.local_endpoint().port(),
+                     kernel_timestamps_ ? "on" : "off");
     }
 
     /**
@@ -54,9 +130,9 @@ public:
             boost::system::error_code ec;
             socket_.close(ec);
             if (ec) {
-                std::cerr << "Error closing UDP socket: " << ec.message() << std::endl;
+                HCS_LOG_ERROR("UdpTransport", "Error closing UDP socket: {}", ec.message());
             }
-            std::cout << "UdpTransport stopped." << std::endl;
+            HCS_LOG_INFO("UdpTransport", "Stopped.");
         }
     }
 
@@ -66,27 +142,23 @@ public:
      * @param destination 宛先エンドポイント (hcs_net::Endpoint)
      */
     void Send(const std::vector<uint8_t>& data, const Endpoint& destination) override {
-        // hcs_net::Endpointをasio::ip::udp::endpointに変換
-        asio::ip::address address = asio::ip::make_address(destination.ip);
-        UdpEndpoint asio_endpoint(address, destination.port);
+        // 送信完了まで送信データを保持する (呼び出し元のバッファは送信完了前に解放されうる)
+        // プールのバッファに収まる大きさであれば、ヒープ確保なしで複製する
+        if (data.size() <= hcs_common::PACKET_BUFFER_SIZE - hcs_common::PACKET_HEADROOM) {
+            SendPacket(hcs_common::PacketPool::Local().CopyFrom(data.data(), data.size()), destination);
+            return;
+        }
+        auto buffer = std::make_shared<std::vector<uint8_t>>(data);
+        AsyncSend(buffer->data(), buffer->size(), destination, std::move(buffer));
+    }
 
-        // 非同期送信。ハンドラで宛先とデータサイズをキャプチャし、ログ出力に使用する
-        socket_.async_send_to(
-            asio::buffer(data),
-            asio_endpoint,
-            // dest に destination.ToString() の結果をコピーして、エラー時のログに使用
-            [data_size = data.size(), dest = destination.ToString()](boost::system::error_code ec, std::size_t transferred) {
-                if (ec) {
-                    // エラー発生時、宛先とエラーメッセージを出力
-                    std::cerr << "UDP Send failed to " << dest << ": " << ec.message() << std::endl;
-                } else if (transferred != data_size) {
-                    // UDPでは通常発生しないが、念のため部分送信の警告を出力
-                    std::cerr << "Warning: Only " << transferred << "/" << data_size << " bytes transferred to " << dest << std::endl;
-                } else {
-                    // 送信成功ログはここでは省略（デバッグ時に有効化するとよい）
-                    // std::cout << "UDP Send success to " << dest << ": " << transferred << " bytes." << std::endl;
-                }
-            });
+    /**
+     * @brief パケットバッファを複製せずに送信する (送信完了までバッファの参照を保持する)
+     */
+    void SendPacket(hcs_common::PacketRef packet, const Endpoint& destination) override {
+        const uint8_t* data = packet->Data();
+        const size_t size = packet->Size();
+        AsyncSend(data, size, destination, std::move(packet));
     }
 
     /**
@@ -95,29 +167,128 @@ public:
     void SetReceiveCallback(ReceiveCallback callback) override {
         receive_callback_ = std::move(callback);
     }
-    
+
     /**
-     * @brief 受信コールバックの設定 (ムーブ)
+     * @brief パケットバッファで受け取る受信コールバックの設定 (Start() 前に設定すること)
+     * 設定時はプールのバッファへ直接受信する。PACKET_BUFFER_SIZE - PACKET_HEADROOM を超える
+     * データグラムは切り詰められる (暗号化層では認証失敗として破棄される)。
      */
-    void SetReceiveCallback(ReceiveCallback&& callback) override {
-        receive_callback_ = std::move(callback);
+    void SetPacketCallback(PacketCallback callback) override {
+        packet_callback_ = std::move(callback);
+    }
+
+    /**
+     * @brief カーネルによる送受信タイムスタンプの取得方法を設定する (Start() 前に設定すること。既定は kSoftware)
+     *
+     * 有効時は受信したデータグラムのカーネルの受信時刻を PacketBuffer と PacketTiming に載せ、
+     * 受信側の遅延計測の起点とする。送信側はエラーキューに返る送信時刻で kSocketSend を記録する。
+     */
+    void SetTimestampMode(SocketTimestampMode mode) {
+        timestamp_mode_ = mode;
     }
 
+    /**
+     * @brief カーネルのタイムスタンプが有効か (Start() 後に確定する)
+     */
+    bool KernelTimestamps() const { return kernel_timestamps_; }
+
+    /**
+     * @brief 送信を依頼済みで、完了ハンドラがまだ呼ばれていない送信数 (停止時のドレインの判定に用いる)
+     */
+    size_t PendingSends() const { return pending_sends_; }
+
 private:
     IoContext& io_context_;
     UdpSocket socket_;
     ReceiveCallback receive_callback_;
+    PacketCallback packet_callback_;
     UdpEndpoint remote_endpoint_; // 受信時の送信元を保持
-    std::vector<uint8_t> receive_buffer_; // 受信バッファ
+    std::vector<uint8_t> receive_buffer_; // 受信バッファ (バイトベクターで受け取る場合)
+    hcs_common::PacketRef receive_packet_; // 受信バッファ (パケットバッファで受け取る場合)
+    UdpTransportMetrics* metrics_ = &UdpTransportMetrics::Get();
+    hcs_common::HandlerMemory send_handler_memory_{UDP_SEND_HANDLER_BLOCKS}; // 送信完了ハンドラの格納領域
+    SocketTimestampMode timestamp_mode_ = SocketTimestampMode::kSoftware;
+    bool kernel_timestamps_ = false;
+    bool dual_stack_ = false;  // IPv6 ソケットで IPv4 のピアにも送る (宛先を IPv4 射影アドレスにする)
+    size_t pending_sends_ = 0; // 完了ハンドラ待ちの送信数
+
+    /**
+     * @brief 送信タイムスタンプを待っている送信の記録 (ソケットでの送信順の番号で引く)
+     */
+    struct PendingTxTimestamp {
+        uint32_t id = 0;
+        int64_t encrypted_ns = 0; // 直前の段 (暗号化) の完了時刻。0 は記録なし
+    };
+    std::array<PendingTxTimestamp, UDP_TX_TIMESTAMP_SLOTS> pending_tx_{};
+    uint32_t next_tx_id_ = 0; // カーネルが次の送信に付ける番号 (SOF_TIMESTAMPING_OPT_ID は有効化時点から0で始まる)
+
+    /**
+     * @brief 送信完了まで keep_alive でデータを保持し、非同期送信する
+     */
+    template <typename KeepAlive>
+    void AsyncSend(const uint8_t* data, size_t size, const Endpoint& destination, KeepAlive keep_alive) {
+        HCS_TRACE_SPAN("net", "udp.send");
+        // hcs_net::Endpointをasio::ip::udp::endpointに変換 (バイナリアドレスの複製のみで、文字列の解析は行わない)
+        UdpEndpoint asio_endpoint = dual_stack_ ? ToUdpEndpointV6(destination) : ToUdpEndpoint(destination);
+        ++pending_sends_;
+
+        // 上位層 (暗号化・エンコーダ) が計測中のタイミングを送信完了まで持ち越す
+        hcs_common::PacketTiming timing;
+        if (auto* current = hcs_common::ScopedPacketTiming::Current()) timing = *current;
+
+        // 非同期送信。ハンドラで宛先とデータサイズをキャプチャし、ログ出力に使用する
+        socket_.async_send_to(
+            asio::buffer(data, size),
+            asio_endpoint,
+            // 解決済みの宛先をコピーしておき、文字列化はエラー時のログ出力でのみ行う。
+            // ハンドラは事前確保したブロックに格納し (パケットごとのヒープ確保を避ける)、
+            // その領域を持つインスタンスを self で完了まで生存させる
+            hcs_common::BindHandlerMemory(send_handler_memory_,
+            [self = shared_from_this(), keep_alive = std::move(keep_alive), data_size = size, dest = asio_endpoint, metrics = metrics_, timing](boost::system::error_code ec, std::size_t transferred) mutable {
+                --self->pending_sends_;
+                if (ec) {
+                    metrics->send_errors.Add();
+                    // エラー発生時、宛先とエラーメッセージを出力
+                    HCS_LOG_WARN_EVERY("UdpTransport", "Send failed to {}: {}", dest, ec.message());
+                } else if (transferred != data_size) {
+                    // UDPでは通常発生しないが、念のため部分送信の警告を出力
+                    HCS_LOG_WARN_EVERY("UdpTransport", "Only {}/{} bytes transferred to {}", transferred, data_size, dest);
+                } else {
+                    metrics->packets_sent.Add();
+                    metrics->bytes_sent.Add(transferred);
+                    // カーネルの送信時刻が届く場合はそちらで記録する (完了ハンドラの時刻はリアクタの待ち時間を含む)
+                    if (self->kernel_timestamps_) self->ExpectTxTimestamp(timing);
+                    else timing.Mark(hcs_common::PipelineStage::kSocketSend);
+                    HCS_TRACE_INSTANT("net", "udp.send_complete");
+                    // 送信成功ログはTraceレベル (通常のビルドではコンパイル時に除去される)
+                    HCS_LOG_TRACE("UdpTransport", "Send success to {}: {} bytes.", dest, transferred);
+                }
+            }));
+    }
 
     /**
      * @brief 非同期受信を開始する
      */
     void StartReceive() {
+        if (kernel_timestamps_) {
+            // 補助データ (タイムスタンプ) は async_receive_from では受け取れないため、
+            // 受信可能になるのを待って recvmsg で読み出す
+            socket_.async_wait(UdpSocket::wait_read, [self = shared_from_this()](boost::system::error_code ec) {
+                self->HandleReadable(ec);
+            });
+            return;
+        }
+        // パケットバッファで受け取る場合は、プールのバッファへ直接受信する
+        asio::mutable_buffer buffer = asio::buffer(receive_buffer_);
+        if (packet_callback_) {
+            receive_packet_ = hcs_common::PacketPool::Local().Acquire();
+            buffer = asio::buffer(receive_packet_->Data(), receive_packet_->Capacity());
+        }
+
         // socket_.async_receive_from のためのキャプチャが安全であることを保証するため
         // shared_from_this を使用してインスタンスの寿命を延ばす
         socket_.async_receive_from(
-            asio::buffer(receive_buffer_),
+            buffer,
             remote_endpoint_,
             [self = shared_from_this()](boost::system::error_code ec, std::size_t bytes_received) {
                 self->HandleReceive(ec, bytes_received);
@@ -129,29 +300,134 @@ private:
      */
     void HandleReceive(const boost::system::error_code& ec, std::size_t bytes_received) {
         if (!ec) {
-            // 受信成功
-            std::vector<uint8_t> received_data(receive_buffer_.begin(), receive_buffer_.begin() + bytes_received);
-            
-            // hcs_net::Endpointに変換
-            Endpoint sender_endpoint = {
-                remote_endpoint_.address().to_string(), 
-                remote_endpoint_.port()
-            };
-
-            // コールバックを呼び出し
-            if (receive_callback_) {
-                receive_callback_(received_data, sender_endpoint);
-            }
+            // hcs_net::Endpointに変換 (文字列化せずにアドレスのバイト列をそのまま使う)
+            Deliver(bytes_received, FromUdpEndpoint(remote_endpoint_), 0);
             
             // 次の非同期受信を開始
             StartReceive();
         } else if (ec != asio::error::operation_aborted) {
             // 停止以外のエラー
-            std::cerr << "UDP Receive error: " << ec.message() << std::endl;
+            metrics_->receive_errors.Add();
+            HCS_LOG_ERROR_EVERY("UdpTransport", "Receive error: {}", ec.message());
             // エラーが発生しても、再度受信を開始する
             StartReceive(); 
         }
     }
+
+    /**
+     * @brief 受信したデータグラムを受信コールバックへ渡す
+     * @param bytes_received 受信バイト数 (receive_packet_ または receive_buffer_ に格納済み)
+     * @param sender 送信元
+     * @param kernel_ns カーネルの受信時刻 (単調時計、不明な場合は0)
+     */
+    void Deliver(std::size_t bytes_received, const Endpoint& sender, int64_t kernel_ns) {
+        // 受信から復号・後段の処理までを1区間とする (復号の区間が入れ子になる)
+        HCS_TRACE_SPAN("net", "udp.receive");
+        // 受信成功 (ここから受信側パイプラインの遅延計測を開始する。起点はカーネルの受信時刻)
+        hcs_common::PacketTiming timing;
+        timing.BeginReceive(kernel_ns);
+        metrics_->packets_received.Add();
+        metrics_->bytes_received.Add(bytes_received);
+
+        // コールバックを呼び出し
+        if (packet_callback_) {
+            receive_packet_->Resize(bytes_received);
+            receive_packet_->SetReceiveTimestamp(timing.received_ns);
+            hcs_common::ScopedPacketTiming timing_scope(timing);
+            packet_callback_(std::move(receive_packet_), sender);
+        } else if (receive_callback_) {
+            std::vector<uint8_t> received_data(receive_buffer_.begin(), receive_buffer_.begin() + bytes_received);
+            hcs_common::ScopedPacketTiming timing_scope(timing);
+            receive_callback_(received_data, sender);
+        }
+    }
+
+    /**
+     * @brief 受信可能の通知を受けて、溜まっているデータグラムを補助データ付きで読み出す
+     */
+    void HandleReadable(const boost::system::error_code& ec) {
+        if (ec) {
+            if (ec == asio::error::operation_aborted || !socket_.is_open()) return;
+            metrics_->receive_errors.Add();
+            HCS_LOG_ERROR_EVERY("UdpTransport", "Receive error: {}", ec.message());
+            StartReceive();
+            return;
+        }
+        for (size_t i = 0; i < UDP_RECEIVE_BATCH && socket_.is_open(); ++i) {
+            uint8_t* data = receive_buffer_.data();
+            size_t capacity = receive_buffer_.size();
+            if (packet_callback_) {
+                if (!receive_packet_) receive_packet_ = hcs_common::PacketPool::Local().Acquire();
+                data = receive_packet_->Data();
+                capacity = receive_packet_->Capacity();
+            }
+
+            sockaddr_storage from{};
+            iovec iov{data, capacity};
+            alignas(cmsghdr) uint8_t control[TIMESTAMP_CONTROL_SIZE];
+            msghdr msg{};
+            msg.msg_name = &from;
+            msg.msg_namelen = sizeof(from);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            const ssize_t received = ::recvmsg(socket_.native_handle(), &msg, MSG_DONTWAIT);
+            if (received < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) break;
+                metrics_->receive_errors.Add();
+                HCS_LOG_ERROR_EVERY("UdpTransport", "Receive error: {}", std::strerror(errno));
+                break;
+            }
+
+            const KernelTimestamp stamp = SocketTimestamping::Parse(msg);
+            if (stamp) metrics_->rx_timestamps.Add();
+            Deliver(static_cast<size_t>(received), SocketTimestamping::ToEndpoint(from), stamp.steady_ns);
+        }
+        if (socket_.is_open()) StartReceive();
+    }
+
+    /**
+     * @brief 送信したデータグラムのカーネルの送信時刻を待つ (送信完了の順はカーネルが付ける番号の順と一致する)
+     */
+    void ExpectTxTimestamp(const hcs_common::PacketTiming& timing) {
+        PendingTxTimestamp& slot = pending_tx_[next_tx_id_ % UDP_TX_TIMESTAMP_SLOTS];
+        slot.id = next_tx_id_++;
+        slot.encrypted_ns = timing.Started() ? timing.last_ns : 0;
+    }
+
+    /**
+     * @brief エラーキューに送信タイムスタンプが届くのを待つ
+     */
+    void WaitErrorQueue() {
+        socket_.async_wait(UdpSocket::wait_error, [self = shared_from_this()](boost::system::error_code ec) {
+            if (ec || !self->socket_.is_open()) return;
+            self->DrainErrorQueue();
+            self->WaitErrorQueue();
+        });
+    }
+
+    /**
+     * @brief エラーキューの送信タイムスタンプを読み出し、対応する送信の kSocketSend を記録する
+     */
+    void DrainErrorQueue() {
+        for (;;) {
+            alignas(cmsghdr) uint8_t control[TIMESTAMP_CONTROL_SIZE];
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (::recvmsg(socket_.native_handle(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+
+            const KernelTimestamp stamp = SocketTimestamping::Parse(msg);
+            if (!stamp) continue;
+            PendingTxTimestamp& slot = pending_tx_[stamp.tx_id % UDP_TX_TIMESTAMP_SLOTS];
+            if (slot.id != stamp.tx_id || slot.encrypted_ns == 0) continue;
+            metrics_->tx_timestamps.Add();
+            hcs_common::PipelineLatency::Record(hcs_common::PipelineStage::kSocketSend,
+                                                std::max<int64_t>(0, stamp.steady_ns - slot.encrypted_ns));
+            slot.encrypted_ns = 0;
+        }
+    }
 };
 
 } // namespace hcs_net
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <arpa/inet.h> // inet_pton/inet_ntop (文字列との変換は設定・ログ出力時のみ)
+#include <net/if.h>    // if_nametoindex
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
-#include <memory>
-#include <cstdint>
-#include <functional> // std::function を使用
+#include "hcs_common/InplaceFunction.h"
+#include "hcs_common/PacketBuffer.h"
 
 /**
  * @namespace hcs_net
@@ -14,26 +24,132 @@ namespace hcs_net {
 
 /**
  * @brief ネットワークエンドポイント (IPアドレスとポート) を表す構造体
+ *
+ * アドレスは16バイトのバイナリ形式で保持する (IPv4 は IPv4 射影アドレス ::ffff:a.b.c.d)。
+ * 送受信のたびに文字列の解析・書式化を行わず、比較とハッシュはバイト列に対して行う。
+ * 自明にコピー可能で、パケットと一緒に値で受け渡してよい。
+ * 文字列との変換は設定の読み込み (文字列を取るコンストラクタ/Parse) とログ出力 (ToString) でのみ行う。
  */
 struct Endpoint {
-    std::string address; ///< IPアドレス (IPv4またはIPv6)
-    uint16_t port;       ///< UDP/TCPポート番号
+    std::array<uint8_t, 16> address{}; ///< IPv6 アドレス (ネットワークバイトオーダー。IPv4 は射影アドレス)
+    uint32_t scope_id = 0;             ///< IPv6 リンクローカルアドレスのスコープID (インターフェース番号)
+    uint16_t port = 0;                 ///< UDP/TCPポート番号
 
     /**
-     * @brief デフォルトコンストラクタ
+     * @brief デフォルトコンストラクタ (未指定アドレス :: 、ポート0)
      */
     Endpoint() = default;
-    
+
+    /**
+     * @brief 文字列のアドレスから作る (設定値の読み込み用)
+     * @param addr IPv4 ("192.0.2.1") または IPv6 ("2001:db8::1"、"fe80::1%eth0") のアドレス
+     * @param p ポート番号
+     * @throw std::invalid_argument アドレスとして解釈できない場合
+     */
+    Endpoint(const std::string& addr, uint16_t p) {
+        if (!Parse(addr, p, *this)) throw std::invalid_argument("Invalid IP address: " + addr);
+    }
+
+    /**
+     * @brief 文字列のアドレスを解析する
+     * @return 解析できた場合はtrue (失敗時は out を変更しない)
+     */
+    static bool Parse(const std::string& addr, uint16_t port, Endpoint& out) {
+        Endpoint ep;
+        ep.port = port;
+        in_addr v4{};
+        if (inet_pton(AF_INET, addr.c_str(), &v4) == 1) {
+            ep.SetV4Bytes(reinterpret_cast<const uint8_t*>(&v4));
+            out = ep;
+            return true;
+        }
+        // IPv6 はスコープ (%eth0 または %2) を分けて解析する
+        const size_t percent = addr.find('%');
+        const std::string host = addr.substr(0, percent);
+        in6_addr v6{};
+        if (inet_pton(AF_INET6, host.c_str(), &v6) != 1) return false;
+        std::memcpy(ep.address.data(), &v6, ep.address.size());
+        if (percent != std::string::npos) {
+            const std::string scope = addr.substr(percent + 1);
+            char* end = nullptr;
+            const unsigned long numeric = std::strtoul(scope.c_str(), &end, 10);
+            ep.scope_id = (!scope.empty() && *end == '\0') ? static_cast<uint32_t>(numeric) : if_nametoindex(scope.c_str());
+            if (ep.scope_id == 0) return false;
+        }
+        out = ep;
+        return true;
+    }
+
+    /**
+     * @brief IPv4 アドレス (ネットワークバイトオーダーの4バイト) から作る
+     */
+    static Endpoint FromV4Bytes(const uint8_t* bytes, uint16_t port) {
+        Endpoint ep;
+        ep.SetV4Bytes(bytes);
+        ep.port = port;
+        return ep;
+    }
+
+    /**
+     * @brief IPv6 アドレス (16バイト) から作る
+     */
+    static Endpoint FromV6Bytes(const uint8_t* bytes, uint16_t port, uint32_t scope_id = 0) {
+        Endpoint ep;
+        std::memcpy(ep.address.data(), bytes, ep.address.size());
+        ep.scope_id = scope_id;
+        ep.port = port;
+        return ep;
+    }
+
+    /**
+     * @brief IPv4 (射影アドレス) か
+     */
+    bool IsV4() const {
+        static constexpr uint8_t kMappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+        return std::memcmp(address.data(), kMappedPrefix, sizeof(kMappedPrefix)) == 0;
+    }
+
+    /**
+     * @brief IPv4 アドレスの4バイト (IsV4() の場合のみ有効)
+     */
+    const uint8_t* V4Bytes() const { return address.data() + 12; }
+
+    /**
+     * @brief 同じホスト (アドレスとスコープが一致し、ポートは問わない) か
+     */
+    bool SameHost(const Endpoint& other) const {
+        return address == other.address && scope_id == other.scope_id;
+    }
+
+    /**
+     * @brief ポートを差し替えたエンドポイントを返す (制御ポートから届いた送信元のメディア送信先など)
+     */
+    Endpoint WithPort(uint16_t p) const {
+        Endpoint ep = *this;
+        ep.port = p;
+        return ep;
+    }
+
     /**
-     * @brief コンストラクタ
+     * @brief アドレスを文字列で返す (IPv4 は元の表記に戻す)。ログ・設定の出力用
      */
-    Endpoint(const std::string& addr, uint16_t p) : address(addr), port(p) {}
+    std::string Address() const {
+        char buf[INET6_ADDRSTRLEN + IF_NAMESIZE + 1] = {};
+        if (IsV4()) {
+            inet_ntop(AF_INET, V4Bytes(), buf, sizeof(buf));
+            return buf;
+        }
+        inet_ntop(AF_INET6, address.data(), buf, sizeof(buf));
+        std::string text = buf;
+        if (scope_id != 0) text += "%" + std::to_string(scope_id);
+        return text;
+    }
 
     /**
-     * @brief エンドポイントを "IP:Port" 形式の文字列で返す
+     * @brief エンドポイントを "IP:Port" 形式 (IPv6 は "[IP]:Port") の文字列で返す
      */
     std::string ToString() const {
-        return address + ":" + std::to_string(port);
+        return IsV4() ? Address() + ":" + std::to_string(port) : "[" + Address() + "]:" + std::to_string(port);
     }
 
     // --- 比較演算子 ---
@@ -42,7 +158,7 @@ struct Endpoint {
      * @brief 等価比較演算子
      */
     bool operator==(const Endpoint& other) const {
-        return address == other.address && port == other.port;
+        return port == other.port && SameHost(other);
     }
 
     /**
@@ -54,10 +170,44 @@ struct Endpoint {
      * @brief 順序比較演算子 (std::map/std::setのキーとして使用可能にするため)
      */
     bool operator<(const Endpoint& other) const {
-        return address < other.address || (address == other.address && port < other.port);
+        const int c = std::memcmp(address.data(), other.address.data(), address.size());
+        if (c != 0) return c < 0;
+        if (scope_id != other.scope_id) return scope_id < other.scope_id;
+        return port < other.port;
+    }
+
+private:
+    void SetV4Bytes(const uint8_t* bytes) {
+        address.fill(0);
+        address[10] = 0xFF;
+        address[11] = 0xFF;
+        std::memcpy(address.data() + 12, bytes, 4);
+    }
+};
+
+static_assert(std::is_trivially_copyable<Endpoint>::value, "Endpoint must stay trivially copyable");
+
+/**
+ * @brief Endpoint のハッシュ (std::unordered_map のキー用)
+ */
+struct EndpointHash {
+    size_t operator()(const Endpoint& ep) const noexcept {
+        uint64_t hi = 0, lo = 0;
+        std::memcpy(&hi, ep.address.data(), sizeof(hi));
+        std::memcpy(&lo, ep.address.data() + 8, sizeof(lo));
+        uint64_t h = hi * 0x9E3779B97F4A7C15ull;
+        h ^= (lo + (static_cast<uint64_t>(ep.scope_id) << 16 | ep.port)) * 0xC2B2AE3D27D4EB4Full;
+        return static_cast<size_t>(h ^ (h >> 29));
     }
 };
 
+/**
+ * @brief ログ出力用 ("IP:Port")
+ */
+inline std::ostream& operator<<(std::ostream& os, const Endpoint& ep) {
+    return os << ep.ToString();
+}
+
 /**
  * @brief マスター鍵とソルトを管理するための抽象インターフェース
  */
@@ -105,19 +255,49 @@ public:
     virtual void Send(const std::vector<uint8_t>& data, const Endpoint& destination) = 0;
 
     /**
-     * @brief 受信コールバックの型定義
+     * @brief 受信コールバックの型定義 (パケットごとに呼ばれるため、ヒープ確保を行わない InplaceFunction とする)
      */
-    using ReceiveCallback = std::function<void(const std::vector<uint8_t>&, const Endpoint&)>;
+    using ReceiveCallback = hcs_common::InplaceFunction<void(const std::vector<uint8_t>&, const Endpoint&)>;
     
     /**
-     * @brief 受信コールバックの設定 (コピー)
+     * @brief 受信コールバックの設定 (値渡しのため、右辺値はムーブされる)
      */
     virtual void SetReceiveCallback(ReceiveCallback callback) = 0;
-    
+
+    // --- パケットバッファによるデータ経路 (定常状態でヒープ確保を行わない) ---
+
     /**
-     * @brief 受信コールバックの設定 (ムーブ)
+     * @brief プールのパケットバッファを送信する。
+     * 既定の実装はバイトベクターへ複製して Send() を呼ぶ。複製なしで送信できる実装はオーバーライドする。
+     * @param packet 送信するパケット (参照が他にない場合、実装は余白を使ってその場で書き換えることがある)
+     * @param destination 宛先エンドポイント
      */
-    virtual void SetReceiveCallback(ReceiveCallback&& callback) = 0; 
+    virtual void SendPacket(hcs_common::PacketRef packet, const Endpoint& destination) {
+        Send(std::vector<uint8_t>(packet->Data(), packet->Data() + packet->Size()), destination);
+    }
+
+    /**
+     * @brief パケットバッファで受け取る受信コールバックの型定義
+     * 複数の処理段をインライン展開して1回の呼び出しにまとめる場合は PacketPipeline.h を使う。
+     */
+    using PacketCallback = hcs_common::InplaceFunction<void(hcs_common::PacketRef, const Endpoint&)>;
+
+    /**
+     * @brief パケットバッファで受け取る受信コールバックの設定 (設定時は ReceiveCallback より優先される)
+     * 既定の実装は ReceiveCallback で受け取ったデータをプールのバッファへ複製して渡す。
+     */
+    virtual void SetPacketCallback(PacketCallback callback) {
+        // コールバック自体は ReceiveCallback の格納領域に収まらないため、設定時に一度だけ確保して共有する
+        auto shared = std::make_shared<PacketCallback>(std::move(callback));
+        SetReceiveCallback([shared](const std::vector<uint8_t>& data, const Endpoint& sender) {
+            (*shared)(hcs_common::PacketPool::Local().CopyFrom(data.data(), data.size()), sender);
+        });
+    }
 };
 
 } // namespace hcs_net
+
+namespace std {
+template <>
+struct hash<hcs_net::Endpoint> : hcs_net::EndpointHash {};
+} // namespace std
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/**
+ * @namespace hcs_sim
+ * @brief 単一プロセスで多数のHCSノードを仮想時間上で動かす離散イベントシミュレータ
+ */
+namespace hcs_sim {
+
+using SimTime = std::chrono::nanoseconds; ///< シミュレーション開始からの仮想経過時間
+
+/**
+ * @brief 仮想時計を持つ離散イベントスケジューラ。
+ * イベントは時刻順 (同時刻なら登録順) に実行され、実行中は Now() がそのイベント時刻を返す。
+ * 待ち時間は発生しないため、実時間よりはるかに高速に進む。
+ */
+class EventScheduler {
+public:
+    using Action = std::function<void()>;
+
+    /**
+     * @brief 現在の仮想時刻を返す。
+     */
+    SimTime Now() const { return now_; }
+
+    /**
+     * @brief 現在時刻から delay 後にイベントを登録する。
+     * @param delay 遅延時間 (負値は0として扱う)
+     * @param action 実行する処理
+     */
+    void Schedule(SimTime delay, Action action) {
+        if (delay < SimTime::zero()) delay = SimTime::zero();
+        ScheduleAt(now_ + delay, std::move(action));
+    }
+
+    /**
+     * @brief 指定した仮想時刻にイベントを登録する。
+     * @param at 実行時刻 (過去の時刻は現在時刻として扱う)
+     * @param action 実行する処理
+     */
+    void ScheduleAt(SimTime at, Action action) {
+        queue_.push(Event{at < now_ ? now_ : at, next_seq_++, std::move(action)});
+    }
+
+    /**
+     * @brief 指定時刻までイベントを実行する。
+     * @param until 終了時刻 (この時刻ちょうどのイベントまで実行する)
+     * @return 実行したイベント数
+     */
+    uint64_t RunUntil(SimTime until) {
+        uint64_t executed = 0;
+        while (!queue_.empty() && queue_.top().at <= until) {
+            // top() は const 参照のため、実行前に取り出してからポップする
+            Event ev = std::move(const_cast<Event&>(queue_.top()));
+            queue_.pop();
+            now_ = ev.at;
+            ev.action();
+            ++executed;
+        }
+        now_ = until;
+        return executed;
+    }
+
+    /**
+     * @brief 未実行のイベント数を返す。
+     */
+    size_t Pending() const { return queue_.size(); }
+
+private:
+    struct Event {
+        SimTime at;
+        uint64_t seq;
+        Action action;
+    };
+
+    /**
+     * @brief 時刻の早い順 (同時刻は登録順) に取り出すための比較
+     */
+    struct Later {
+        bool operator()(const Event& a, const Event& b) const {
+            return a.at != b.at ? a.at > b.at : a.seq > b.seq;
+        }
+    };
+
+    std::priority_queue<Event, std::vector<Event>, Later> queue_;
+    SimTime now_{0};
+    uint64_t next_seq_ = 0;
+};
+
+} // namespace hcs_sim
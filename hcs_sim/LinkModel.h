@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "EventScheduler.h"
+
+namespace hcs_sim {
+
+/**
+ * @brief リンク特性のパラメータ。
+ */
+struct LinkParams {
+    SimTime base_delay = std::chrono::milliseconds(2);  ///< 片方向の固定遅延
+    SimTime distance_delay = std::chrono::milliseconds(20); ///< ノード間距離1.0あたりの追加遅延
+    SimTime jitter = std::chrono::milliseconds(1);      ///< 一様分布ジッタの最大値
+    double loss_rate = 0.0;                             ///< パケット損失率 (0.0 - 1.0)
+    double bandwidth_bps = 100e6;                       ///< 送信ノードごとの送出帯域 (bps, 0 で無制限)
+};
+
+/**
+ * @brief ノード間リンクのモデル (遅延・ジッタ・損失・帯域・ネットワーク分断)。
+ * 各ノードは単位正方形内の座標を持ち、距離に比例した伝搬遅延を受ける。
+ * 帯域は送信ノードごとの送出キューとしてモデル化し、直前の送信が終わるまで次を送れない。
+ */
+class LinkModel {
+public:
+    /**
+     * @brief リンクモデルを初期化する。
+     * @param node_count ノード数
+     * @param params リンク特性
+     * @param seed 乱数シード (同一シードで結果が再現する)
+     */
+    LinkModel(size_t node_count, const LinkParams& params, uint64_t seed)
+        : params_(params), rng_(seed), positions_(node_count), busy_until_(node_count, SimTime::zero()),
+          partition_side_(node_count, 0)
+    {
+        std::uniform_real_distribution<double> coord(0.0, 1.0);
+        for (auto& p : positions_) p = {coord(rng_), coord(rng_)};
+    }
+
+    /**
+     * @brief 2ノード間の平常時の片方向遅延 (ジッタなし) を返す。
+     */
+    SimTime PropagationDelay(size_t from, size_t to) const {
+        double dx = positions_[from].x - positions_[to].x;
+        double dy = positions_[from].y - positions_[to].y;
+        double dist = std::sqrt(dx * dx + dy * dy);
+        return params_.base_delay +
+               SimTime(static_cast<int64_t>(dist * static_cast<double>(params_.distance_delay.count())));
+    }
+
+    /**
+     * @brief パケット送信をモデル化し、到着までの遅延を返す。
+     * @param from 送信ノード
+     * @param to 受信ノード
+     * @param bytes パケットサイズ
+     * @param now 送信時刻
+     * @param delay 到着までの遅延 (出力)
+     * @return 配送される場合はtrue (損失・分断時はfalse)
+     */
+    bool Transmit(size_t from, size_t to, size_t bytes, SimTime now, SimTime& delay) {
+        // 送出帯域: 直前の送信が終わってからシリアライズする
+        SimTime start = busy_until_[from] > now ? busy_until_[from] : now;
+        if (params_.bandwidth_bps > 0) {
+            busy_until_[from] = start + SimTime(static_cast<int64_t>(bytes * 8 * 1e9 / params_.bandwidth_bps));
+        } else {
+            busy_until_[from] = start;
+        }
+
+        if (partitioned_ && partition_side_[from] != partition_side_[to]) return false;
+        if (params_.loss_rate > 0.0 && loss_(rng_) < params_.loss_rate) return false;
+
+        SimTime jitter{0};
+        if (params_.jitter.count() > 0) {
+            jitter = SimTime(std::uniform_int_distribution<int64_t>(0, params_.jitter.count())(rng_));
+        }
+        delay = (busy_until_[from] - now) + PropagationDelay(from, to) + jitter;
+        return true;
+    }
+
+    /**
+     * @brief ノード集合を2つに分断する (side が異なるノード間の通信を遮断する)。
+     * @param side ノードごとの所属側 (0 または 1)
+     */
+    void Partition(std::vector<int> side) {
+        partition_side_ = std::move(side);
+        partitioned_ = true;
+    }
+
+    /**
+     * @brief ネットワーク分断を解消する。
+     */
+    void Heal() { partitioned_ = false; }
+
+    /**
+     * @brief シミュレーション全体で共有する乱数生成器を返す。
+     */
+    std::mt19937_64& Rng() { return rng_; }
+
+private:
+    struct Position { double x = 0.0; double y = 0.0; };
+
+    LinkParams params_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> loss_{0.0, 1.0};
+    std::vector<Position> positions_;
+    std::vector<SimTime> busy_until_; ///< ノードごとの送出キューが空く時刻
+    std::vector<int> partition_side_;
+    bool partitioned_ = false;
+};
+
+} // namespace hcs_sim
@@ -0,0 +1,846 @@
+#pragma once
+
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "HCSNode.h"
+#include "hcs_common/AllocationCounter.h"
+#include "hcs_common/LatencyHistogram.h"
+#include "hcs_common/NodeConfig.h"
+#include "hcs_common/PacketBuffer.h"
+#include "hcs_common/PipelineLatency.h"
+#include "hcs_common/Tracing.h"
+#include "hcs_control/ControlMessages.h"
+#include "hcs_control/SubscriptionTable.h"
+#include "hcs_media/RtpPacket.h"
+#include "hcs_net/MemoryTransport.h"
+#include "hcs_net/PacketCapture.h"
+#include "hcs_net/PacketPipeline.h"
+#include "hcs_net/PBKDF2KeyProvider.h"
+#include "hcs_net/TransportAES256.h"
+#include "hcs_net/UdpTransport.h"
+
+namespace hcs_sim {
+
+// --- ループバックベンチマークの定数 ---
+constexpr size_t LOOPBACK_MIN_PACKET_SIZE = hcs_media::RTP_HEADER_SIZE + sizeof(int64_t); ///< RTPヘッダー + 送信時刻
+constexpr std::chrono::microseconds LOOPBACK_SEND_TICK(500);   ///< 送信ペーシングの周期
+constexpr size_t LOOPBACK_MAX_BURST = 256;                      ///< 1周期に送る最大パケット数 (遅れを一度に取り戻さない)
+constexpr std::chrono::milliseconds LOOPBACK_DRAIN_TIME(200);   ///< 送信終了後、到着を待つ時間
+constexpr double LOOPBACK_MIN_SEND_RATIO = 0.95;                ///< 送信側が目標レートのこの割合を下回ったら持続不能とみなす
+constexpr int LOOPBACK_SEARCH_STEPS = 4;                        ///< 最大レート探索での二分探索の回数
+constexpr double LOOPBACK_WARMUP_FRACTION = 0.25;               ///< ヒープ確保回数の計測から除く送信開始直後の割合 (プール等の拡張期間)
+constexpr uint32_t LOOPBACK_SSRC = 0x4C4F4F50;                  ///< ベンチマークのパケットの SSRC ("node" ではエンコーダのダミーフレームと区別する)
+constexpr const char* LOOPBACK_NODE_TRANSPORT = "node";         ///< HCSNode の組で計測するトランスポート名
+constexpr uint16_t LOOPBACK_NODE_PORTS = 4;                     ///< "node" の組あたりのポート数 (送信・受信ノードのメディアと制御)
+constexpr std::chrono::milliseconds LOOPBACK_JOIN_SETTLE(100);  ///< "node" で JOIN を送ってから送信を始めるまでの待ち時間
+constexpr const char* LOOPBACK_GROUP = "loopback";              ///< "node" の送信ノードが送信元となるグループ
+constexpr const char* LOOPBACK_PASSPHRASE = "hcs-loopback-benchmark"; ///< 全ノード共通の鍵導出のパスフレーズ
+constexpr uint8_t LOOPBACK_SALT_BYTE = 0x5A;                    ///< 鍵導出のソルトの各バイト
+constexpr const char* LOOPBACK_SALT_HEX = "5a";                 ///< 同、設定ファイルの16進表記
+
+/**
+ * @brief ループバックベンチマークの条件 (1回の計測分)。
+ */
+struct LoopbackConfig {
+    std::string transport = "udp";             ///< 基底トランスポート ("udp" / "memory")、または HCSNode の組 ("node")
+    size_t pairs = 1;                          ///< 送信ノードと受信ノードの組数 (ノードごとに1スレッド)
+    size_t packet_size = 1200;                 ///< 暗号化前の RTP パケットサイズ (バイト)
+    double rate_pps = 10000.0;                 ///< 組あたりの送信レート (packets/s)
+    std::chrono::milliseconds duration{2000};  ///< 送信時間
+    uint16_t base_port = 47000;                ///< 組 i の送信ノードは base+2i、受信ノードは base+2i+1 を使う ("node" は base+4i から4つ)
+    hcs_net::MemoryLinkParams link;            ///< "memory" で注入する遅延・損失・並べ替え
+    std::shared_ptr<hcs_net::PacketCapture> capture; ///< 設定時は全ノードの暗号化層のパケットを記録する ("node" を除く)
+    hcs_net::SocketTimestampMode timestamps = hcs_net::SocketTimestampMode::kSoftware; ///< "udp" のカーネルタイムスタンプ
+};
+
+/**
+ * @brief 1回の計測結果。レートは全組の合計、CPU 使用率はノードあたりの平均 (1コア = 1.0)。
+ */
+struct LoopbackResult {
+    LoopbackConfig config;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    double offered_pps = 0.0;
+    double sent_pps = 0.0;
+    double received_pps = 0.0;
+    double loss_rate = 0.0;
+    double gbps = 0.0;              ///< 受信した RTP パケット (暗号化前) のスループット
+    double sender_cpu = 0.0;
+    double receiver_cpu = 0.0;
+    double latency_p50_us = 0.0;    ///< 送信ノードのパケット化から受信ノードの解析完了まで
+    double latency_p99_us = 0.0;
+    double latency_p999_us = 0.0;
+    double sender_allocs_per_packet = -1.0;   ///< ウォームアップ後の送信ノードのスレッドのヒープ確保回数/パケット (-1 は計数無効)
+    double receiver_allocs_per_packet = -1.0; ///< 同、受信ノード
+    uint64_t pool_heap_allocations = 0;       ///< 計測中にパケットバッファプールが行ったヒープ確保の回数
+
+    /**
+     * @brief 目標レートを持続できたか (損失率が閾値以下で、送信側も目標レートに追従できた)。
+     */
+    bool Sustainable(double loss_threshold) const {
+        return loss_rate <= loss_threshold && sent_pps >= offered_pps * LOOPBACK_MIN_SEND_RATIO;
+    }
+
+    /**
+     * @brief 表形式の見出し行を出力する。
+     */
+    static void PrintHeader(std::ostream& os) {
+        os << "transport pairs  size   offered_pps      recv_pps    loss     Gbps  cpu_tx  cpu_rx   p50_us   p99_us  p999_us"
+              "  alloc_tx  alloc_rx\n";
+    }
+
+    /**
+     * @brief 表形式の1行を出力する。
+     */
+    void Print(std::ostream& os) const {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-9s %5zu %5zu %13.0f %13.0f %7.4f %8.3f %7.2f %7.2f %8.1f %8.1f %8.1f",
+                      config.transport.c_str(), config.pairs, config.packet_size, offered_pps, received_pps,
+                      loss_rate, gbps, sender_cpu, receiver_cpu, latency_p50_us, latency_p99_us, latency_p999_us);
+        os << line;
+        if (sender_allocs_per_packet < 0.0) {
+            os << "         -         -\n";
+        } else {
+            std::snprintf(line, sizeof(line), " %9.3f %9.3f\n", sender_allocs_per_packet, receiver_allocs_per_packet);
+            os << line;
+        }
+    }
+
+    /**
+     * @brief 回帰比較用に1行のJSONとして出力する。
+     */
+    void PrintJson(std::ostream& os) const {
+        os << "{\"transport\":\"" << config.transport << "\",\"pairs\":" << config.pairs
+           << ",\"packet_size\":" << config.packet_size << ",\"duration_sec\":" << config.duration.count() / 1000.0
+           << ",\"sent\":" << sent << ",\"received\":" << received
+           << ",\"offered_pps\":" << offered_pps << ",\"sent_pps\":" << sent_pps
+           << ",\"received_pps\":" << received_pps << ",\"loss_rate\":" << loss_rate << ",\"gbps\":" << gbps
+           << ",\"sender_cpu\":" << sender_cpu << ",\"receiver_cpu\":" << receiver_cpu
+           << ",\"latency_p50_us\":" << latency_p50_us << ",\"latency_p99_us\":" << latency_p99_us
+           << ",\"latency_p999_us\":" << latency_p999_us
+           << ",\"sender_allocs_per_packet\":" << sender_allocs_per_packet
+           << ",\"receiver_allocs_per_packet\":" << receiver_allocs_per_packet
+           << ",\"pool_heap_allocations\":" << pool_heap_allocations << "}\n";
+    }
+};
+
+/**
+ * @brief 名前から基底トランスポートを生成する。
+ * @param name トランスポート名 ("udp" / "memory")
+ * @param io ノードの I/O コンテキスト
+ * @param local ノード自身のエンドポイント
+ * @param network "memory" で接続する仮想ネットワーク (計測ごとに1つ)
+ * @param timestamps "udp" で取得するカーネルのタイムスタンプ
+ * @throw std::invalid_argument 未知のトランスポート名の場合
+ */
+inline std::shared_ptr<hcs_net::Transport> MakeBaseTransport(const std::string& name, boost::asio::io_context& io,
+                                                             const hcs_net::Endpoint& local,
+                                                             const std::shared_ptr<hcs_net::MemoryNetwork>& network,
+                                                             hcs_net::SocketTimestampMode timestamps) {
+    if (name == "udp") {
+        auto udp = std::make_shared<hcs_net::UdpTransport>(io, local.port);
+        udp->SetTimestampMode(timestamps);
+        return udp;
+    }
+    if (name == "memory") return std::make_shared<hcs_net::MemoryTransport>(io, network, local);
+    throw std::invalid_argument("unknown transport " + name);
+}
+
+/**
+ * @brief 1プロセス内で送信ノードと受信ノードの組を動かし、メディア経路全体の性能を計測する。
+ *
+ * 各ノードは HCSNode のメディア経路と同じ部品 (RTP パケット化 → TransportAES256 → 基底トランスポート、
+ * 受信側は 基底トランスポート → 復号 → RTP 解析) を持ち、専用の io_context スレッドで動く。
+ * 送信ノードは一定周期で目標レートに追いつくまでパケットを送り、ペイロード先頭に埋め込んだ
+ * 送信時刻から受信側でエンドツーエンド遅延を求める。段ごとの遅延は PipelineLatency に記録される。
+ *
+ * トランスポート "node" では各ノードが設定から組み立てた HCSNode で、送信ノードは送信元のグループの購読者へ
+ * HCSNode::PublishMedia() で送り (SecureUdpMediaTransport)、受信ノードは StreamDecoder で解析したパケットを計測する。
+ */
+class LoopbackBenchmark {
+public:
+    LoopbackBenchmark()
+        : key_provider_(std::make_shared<hcs_net::PBKDF2KeyProvider>(
+              LOOPBACK_PASSPHRASE, std::vector<uint8_t>(hcs_net::PBKDF2_SALT_SIZE, LOOPBACK_SALT_BYTE))) {}
+
+    /**
+     * @brief 指定した条件で1回計測する。
+     */
+    LoopbackResult Run(const LoopbackConfig& config) {
+        if (config.pairs == 0) throw std::invalid_argument("pairs must be at least 1");
+        if (config.packet_size < LOOPBACK_MIN_PACKET_SIZE) {
+            throw std::invalid_argument("packet size must be at least " + std::to_string(LOOPBACK_MIN_PACKET_SIZE));
+        }
+
+        auto& pool_allocations = hcs_common::PacketPoolMetrics::Get().heap_allocations;
+        const uint64_t pool_allocations_before = pool_allocations.Value();
+        auto latency = std::make_unique<hcs_common::LatencyHistogram>();
+        auto network = std::make_shared<hcs_net::MemoryNetwork>(config.link);
+        const bool hosted = config.transport == LOOPBACK_NODE_TRANSPORT;
+        std::unique_ptr<PassphraseFile> passphrase;
+        if (hosted) passphrase = std::make_unique<PassphraseFile>();
+        std::vector<std::unique_ptr<Pair>> pairs;
+        for (size_t i = 0; i < config.pairs; ++i) {
+            if (hosted) {
+                const uint16_t first_port = static_cast<uint16_t>(config.base_port + LOOPBACK_NODE_PORTS * i);
+                pairs.push_back(std::make_unique<NodePair>(config, passphrase->Path(), i, first_port, *latency));
+                continue;
+            }
+            const uint16_t tx_port = static_cast<uint16_t>(config.base_port + 2 * i);
+            hcs_net::Endpoint tx_local("127.0.0.1", tx_port);
+            hcs_net::Endpoint rx_local("127.0.0.1", static_cast<uint16_t>(tx_port + 1));
+            pairs.push_back(std::make_unique<TransportPair>(config, key_provider_, network, tx_local, rx_local, *latency));
+        }
+
+        for (auto& pair : pairs) pair->Prepare();
+        for (auto& pair : pairs) pair->Connect();
+        if (hosted) std::this_thread::sleep_for(LOOPBACK_JOIN_SETTLE);
+        const auto start = std::chrono::steady_clock::now();
+        const auto end = start + config.duration;
+        for (auto& pair : pairs) pair->StartSending(start, end);
+
+        std::this_thread::sleep_until(end + LOOPBACK_DRAIN_TIME);
+        for (auto& pair : pairs) pair->Stop();
+
+        LoopbackResult result;
+        result.config = config;
+        AllocationWindow sender_allocs, receiver_allocs;
+        for (const auto& pair : pairs) {
+            result.sent += pair->traffic->sent;
+            result.received += pair->traffic->received;
+            result.sender_cpu += pair->SenderCpu();
+            result.receiver_cpu += pair->ReceiverCpu();
+            sender_allocs.Merge(pair->traffic->sender_allocs);
+            receiver_allocs.Merge(pair->traffic->receiver_allocs);
+        }
+        if (hcs_common::AllocationCounter::Enabled()) {
+            result.sender_allocs_per_packet = sender_allocs.PerPacket();
+            result.receiver_allocs_per_packet = receiver_allocs.PerPacket();
+        }
+        result.pool_heap_allocations = pool_allocations.Value() - pool_allocations_before;
+        const double seconds = std::chrono::duration<double>(config.duration).count();
+        result.offered_pps = config.rate_pps * static_cast<double>(config.pairs);
+        result.sent_pps = static_cast<double>(result.sent) / seconds;
+        result.received_pps = static_cast<double>(result.received) / seconds;
+        result.loss_rate = result.sent ? 1.0 - static_cast<double>(result.received) / static_cast<double>(result.sent) : 0.0;
+        result.gbps = result.received_pps * static_cast<double>(config.packet_size) * 8.0 / 1e9;
+        result.sender_cpu /= static_cast<double>(config.pairs);
+        result.receiver_cpu /= static_cast<double>(config.pairs);
+
+        static constexpr double QUANTILES[] = {0.5, 0.99, 0.999};
+        uint64_t values[3];
+        latency->Quantiles(QUANTILES, values, 3);
+        result.latency_p50_us = static_cast<double>(values[0]) / 1000.0;
+        result.latency_p99_us = static_cast<double>(values[1]) / 1000.0;
+        result.latency_p999_us = static_cast<double>(values[2]) / 1000.0;
+        return result;
+    }
+
+    /**
+     * @brief 持続可能な最大レートを探索する。
+     * 開始レートから倍々に上げ、持続できなくなったら直前のレートとの間を二分探索する。
+     * @param config 探索の開始条件 (rate_pps が開始レート)
+     * @param loss_threshold 許容する損失率
+     * @return 持続できた最大レートでの計測結果 (開始レートでも持続できない場合は最後の計測結果)
+     */
+    LoopbackResult FindMaxSustainableRate(LoopbackConfig config, double loss_threshold) {
+        LoopbackResult best;
+        bool found = false;
+        double low = 0.0;
+        double high = 0.0;
+        while (high == 0.0) {
+            LoopbackResult result = Run(config);
+            if (result.Sustainable(loss_threshold)) {
+                best = result;
+                found = true;
+                low = config.rate_pps;
+                config.rate_pps *= 2.0;
+            } else {
+                if (!found) best = result;
+                high = config.rate_pps;
+            }
+        }
+        for (int step = 0; step < LOOPBACK_SEARCH_STEPS; ++step) {
+            config.rate_pps = (low + high) / 2.0;
+            LoopbackResult result = Run(config);
+            if (result.Sustainable(loss_threshold)) {
+                best = result;
+                found = true;
+                low = config.rate_pps;
+            } else {
+                high = config.rate_pps;
+            }
+        }
+        return best;
+    }
+
+private:
+    std::shared_ptr<hcs_net::KeyProvider> key_provider_;
+
+    /**
+     * @brief 専用スレッドで io_context を回すノードの共通部分 (スレッドの CPU 使用率を計測する)。
+     */
+    class NodeThread {
+    public:
+        explicit NodeThread(std::string name) : name_(std::move(name)), work_(boost::asio::make_work_guard(io_)) {}
+        virtual ~NodeThread() = default;
+        NodeThread(const NodeThread&) = delete;
+        NodeThread& operator=(const NodeThread&) = delete;
+
+        boost::asio::io_context& Io() { return io_; }
+
+        /**
+         * @brief ノードのスレッド上で停止処理を行い、スレッドの終了を待つ。
+         */
+        void Stop() {
+            if (!thread_.joinable()) return;
+            boost::asio::post(io_, [this]() {
+                if (on_stop_) on_stop_();
+                Shutdown();
+            });
+            thread_.join();
+        }
+
+        /**
+         * @brief 停止時にノードのスレッド上で実行する処理 (タイマーの取り消しなど) を設定する。
+         */
+        void SetOnStop(std::function<void()> on_stop) { on_stop_ = std::move(on_stop); }
+
+        /**
+         * @brief io_context を回していた間のスレッドの CPU 使用率 (1コア = 1.0)。Stop() 後に有効。
+         */
+        double CpuUtilization() const {
+            return wall_ns_ > 0 ? static_cast<double>(cpu_ns_) / static_cast<double>(wall_ns_) : 0.0;
+        }
+
+    protected:
+        /**
+         * @brief ノードのスレッドを開始する。
+         * @param on_thread io_context を回す前にスレッド上で実行する処理 (CPU 使用率には含めない)
+         */
+        void Launch(std::function<void()> on_thread = nullptr) {
+            thread_ = std::thread([this, on_thread = std::move(on_thread)]() {
+                if (hcs_common::Tracer::Enabled()) hcs_common::Tracer::Instance().SetThreadName(name_);
+                if (on_thread) on_thread();
+                const auto started = std::chrono::steady_clock::now();
+                const int64_t cpu_started = ThreadCpuNs();
+                io_.run();
+                wall_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+                cpu_ns_ = ThreadCpuNs() - cpu_started;
+            });
+        }
+
+        /**
+         * @brief ノードのスレッド上で呼ばれる停止処理。最後に ReleaseWork() を呼ぶか io_context を止める。
+         */
+        virtual void Shutdown() { ReleaseWork(); }
+
+        /**
+         * @brief 残りのハンドラを処理した後に io_context を抜けられるようにする。
+         */
+        void ReleaseWork() { work_.reset(); }
+
+    private:
+        std::string name_;
+        boost::asio::io_context io_;
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
+        std::function<void()> on_stop_;
+        std::thread thread_;
+        int64_t wall_ns_ = 0;
+        int64_t cpu_ns_ = 0;
+
+        static int64_t ThreadCpuNs() {
+            timespec cpu{};
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+            return static_cast<int64_t>(cpu.tv_sec) * 1'000'000'000 + cpu.tv_nsec;
+        }
+    };
+
+    /**
+     * @brief 専用スレッドで動くノード (基底トランスポート + 暗号化層)。
+     */
+    class Node : public NodeThread {
+    public:
+        Node(const std::string& transport, const hcs_net::Endpoint& local, std::shared_ptr<hcs_net::KeyProvider> key_provider,
+             const std::shared_ptr<hcs_net::MemoryNetwork>& network, hcs_net::SocketTimestampMode timestamps)
+            : NodeThread("node " + local.ToString()),
+              base_(MakeBaseTransport(transport, Io(), local, network, timestamps)),
+              secure_(std::make_shared<hcs_net::TransportAES256>(std::move(key_provider), base_)) {}
+
+        ~Node() override { Stop(); }
+
+        hcs_net::Transport& Base() { return *base_; }
+        hcs_net::TransportAES256& Secure() { return *secure_; }
+
+        /**
+         * @brief トランスポートを起動し、ノードのスレッドを開始する。
+         */
+        void Start() {
+            secure_->Start();
+            Launch();
+        }
+
+    protected:
+        void Shutdown() override {
+            secure_->Stop();
+            ReleaseWork();
+        }
+
+    private:
+        std::shared_ptr<hcs_net::Transport> base_;
+        std::shared_ptr<hcs_net::TransportAES256> secure_;
+    };
+
+    /**
+     * @brief 専用スレッドで動く HCSNode (設定から組み立てた実際のノード)。
+     */
+    class HostedNode : public NodeThread {
+    public:
+        /**
+         * @param name スレッド名
+         * @param overrides ノードの設定 (既定値への "section.key=value" の上書き指定)
+         * @throw std::runtime_error 設定が不正な場合
+         */
+        HostedNode(const std::string& name, std::vector<std::string> overrides)
+            : NodeThread(name),
+              node_(std::make_shared<hcs::HCSNode>(
+                  Io(), std::make_shared<hcs_common::NodeConfigStore>("", std::move(overrides)))),
+              started_future_(started_.get_future()) {}
+
+        ~HostedNode() override { Stop(); }
+
+        hcs::HCSNode& Get() { return *node_; }
+
+        /**
+         * @brief ノードのスレッドで HCSNode::Start() (鍵の導出を含む) を行ってから io_context を回す。
+         * 起動の完了は WaitStarted() で待つ (複数のノードの鍵の導出を並行に進めるため)。
+         */
+        void Start() {
+            Launch([this]() {
+                try {
+                    node_->Start();
+                    started_.set_value();
+                } catch (...) {
+                    started_.set_exception(std::current_exception());
+                    ReleaseWork();
+                }
+            });
+        }
+
+        /**
+         * @brief 起動の完了を待つ。
+         * @throw std::exception 起動に失敗した場合は HCSNode::Start() の例外
+         */
+        void WaitStarted() { started_future_.get(); }
+
+    protected:
+        void Shutdown() override {
+            // ドレインを経て全ソケットを閉じた後に io_context を止める (HCSNodeDaemon と同じ)
+            node_->Stop([this]() { Io().stop(); });
+        }
+
+    private:
+        std::shared_ptr<hcs::HCSNode> node_;
+        std::promise<void> started_;
+        std::future<void> started_future_;
+    };
+
+    /**
+     * @brief ウォームアップ後の区間でのスレッドのヒープ確保回数 (ノードのスレッド上でのみ操作する)。
+     */
+    struct AllocationWindow {
+        bool opened = false;
+        uint64_t allocations = 0;
+        uint64_t packets = 0;
+
+        void Open(uint64_t packet_count) {
+            opened = true;
+            allocations = hcs_common::AllocationCounter::ThreadAllocations();
+            packets = packet_count;
+        }
+
+        void Close(uint64_t packet_count) {
+            if (!opened) return;
+            allocations = hcs_common::AllocationCounter::ThreadAllocations() - allocations;
+            packets = packet_count - packets;
+        }
+
+        void Merge(const AllocationWindow& other) {
+            if (!other.opened) return;
+            allocations += other.allocations;
+            packets += other.packets;
+        }
+
+        double PerPacket() const {
+            return packets ? static_cast<double>(allocations) / static_cast<double>(packets) : 0.0;
+        }
+    };
+
+    /**
+     * @brief 1組の送信のペーシングと受信側の計測。カウンタはそれぞれのノードのスレッドだけが更新する。
+     */
+    struct Traffic {
+        /// パケット化した RTP パケットを送信ノードの送信経路へ渡す処理 (送信ノードのスレッドで呼ばれる)
+        using Publish = std::function<void(hcs_common::PacketRef)>;
+
+        const LoopbackConfig& config;
+        hcs_common::LatencyHistogram& latency;
+        Publish publish;
+        boost::asio::steady_timer timer;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+        std::chrono::steady_clock::time_point warm;  // ヒープ確保回数の計測開始時刻
+        int64_t warm_ns = 0;
+        uint64_t sent = 0;     // 送信ノードのスレッドのみが更新
+        uint64_t received = 0; // 受信ノードのスレッドのみが更新
+        AllocationWindow sender_allocs;   // 送信ノードのスレッドのみが更新
+        AllocationWindow receiver_allocs; // 受信ノードのスレッドのみが更新
+
+        Traffic(const LoopbackConfig& cfg, hcs_common::LatencyHistogram& histogram, boost::asio::io_context& sender_io,
+                Publish publish_fn)
+            : config(cfg), latency(histogram), publish(std::move(publish_fn)), timer(sender_io) {}
+
+        /**
+         * @brief 送信の期間を決め、送信ノードのスレッドで最初の周期を予約する。
+         */
+        void Begin(std::chrono::steady_clock::time_point start_time, std::chrono::steady_clock::time_point end_time) {
+            start = start_time;
+            end = end_time;
+            warm = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>((end - start) * LOOPBACK_WARMUP_FRACTION);
+            warm_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(warm.time_since_epoch()).count();
+            boost::asio::post(timer.get_executor(), [this]() { Tick(); });
+        }
+
+        /**
+         * @brief 送信ノードの停止時に呼ぶ (送信ノードのスレッド)。
+         */
+        void StopSending() {
+            timer.cancel();
+            sender_allocs.Close(sent);
+        }
+
+        /**
+         * @brief 受信ノードの停止時に呼ぶ (受信ノードのスレッド)。
+         */
+        void StopReceiving() { receiver_allocs.Close(received); }
+
+        /**
+         * @brief 開始からの経過時間に対する目標送信数に追いつくまで送信し、次の周期を予約する。
+         */
+        void Tick() {
+            HCS_TRACE_SPAN("loopback", "loopback.tick");
+            const auto now = std::chrono::steady_clock::now();
+            const auto until = std::min(now, end);
+            const double elapsed = std::chrono::duration<double>(until - start).count();
+            const uint64_t due = static_cast<uint64_t>(elapsed * config.rate_pps);
+            const uint64_t burst = due > sent ? std::min<uint64_t>(due - sent, LOOPBACK_MAX_BURST) : 0;
+            if (!sender_allocs.opened && now >= warm) sender_allocs.Open(sent);
+            for (uint64_t i = 0; i < burst; ++i) SendOne();
+            if (now >= end) return;
+
+            timer.expires_after(LOOPBACK_SEND_TICK);
+            timer.async_wait([this](const boost::system::error_code& ec) {
+                if (!ec) Tick();
+            });
+        }
+
+        /**
+         * @brief プールのバッファにパケット化し、送信経路へ渡す (暗号化はバッファ上でその場で行われる)。
+         */
+        void SendOne() {
+            HCS_TRACE_SPAN("media", "encoder.frame", sent);
+            hcs_common::PacketTiming timing;
+            timing.Begin();
+            hcs_common::PacketRef packet = hcs_media::AcquireDummyRtpPacket(
+                config.packet_size - hcs_media::RTP_HEADER_SIZE, hcs_common::PipelineLatency::MediaClockNow());
+            hcs_media::SetRtpSsrc(packet->Data(), LOOPBACK_SSRC);
+            const int64_t sent_at = hcs_common::PipelineLatency::NowNs();
+            std::memcpy(packet->Data() + hcs_media::RTP_HEADER_SIZE, &sent_at, sizeof(sent_at));
+            timing.Mark(hcs_common::PipelineStage::kPacketize);
+
+            hcs_common::ScopedPacketTiming timing_scope(timing);
+            publish(std::move(packet));
+            ++sent;
+        }
+
+        /**
+         * @brief 受信ノードで解析を終えたパケットのエンドツーエンド遅延を記録する (段ごとの遅延は記録しない)。
+         * @return 送信時刻を読み出せた場合はtrue
+         */
+        bool Record(const hcs_common::PacketBuffer& packet) {
+            const int64_t now_ns = hcs_common::PipelineLatency::NowNs();
+            if (!receiver_allocs.opened && now_ns >= warm_ns) receiver_allocs.Open(received);
+
+            size_t payload_offset = 0;
+            if (!hcs_media::ParseRtpHeader(packet.Data(), packet.Size(), payload_offset) ||
+                packet.Size() < LOOPBACK_MIN_PACKET_SIZE) return false;
+            int64_t sent_at = 0;
+            std::memcpy(&sent_at, packet.Data() + payload_offset, sizeof(sent_at));
+            latency.Record(now_ns - sent_at);
+            ++received;
+            return true;
+        }
+
+        /**
+         * @brief 復号済みのバッファを複製せずに解析し、エンドツーエンドと段ごとの遅延を記録する。
+         */
+        void Receive(const hcs_common::PacketBuffer& packet) {
+            hcs_common::PacketTiming timing;
+            if (auto* current = hcs_common::ScopedPacketTiming::Current()) timing = *current;
+            if (!Record(packet)) return;
+            hcs_common::PipelineLatency::RecordNetwork(hcs_media::RtpTimestamp(packet.Data()), packet.ReceiveTimestamp());
+            timing.Mark(hcs_common::PipelineStage::kJitterBuffer);
+            timing.Mark(hcs_common::PipelineStage::kFrameComplete);
+        }
+    };
+
+    /**
+     * @brief 送信ノードと受信ノードの組。
+     */
+    struct Pair {
+        std::unique_ptr<Traffic> traffic; // 派生クラスが送信ノードの作成後に作り、ノードの破棄より前に解放する
+
+        virtual ~Pair() = default;
+
+        /**
+         * @brief 受信の準備を始める (全組で並行に進める部分)。
+         */
+        virtual void Prepare() = 0;
+
+        /**
+         * @brief Prepare() の完了を待ち、受信ノードを送信ノードに接続する。
+         */
+        virtual void Connect() {}
+
+        /**
+         * @brief 送信ノードを動かし、送信を始める。
+         */
+        virtual void StartSending(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) = 0;
+
+        /**
+         * @brief 両ノードを停止する (以降は CPU 使用率とカウンタが確定する)。
+         */
+        virtual void Stop() = 0;
+
+        virtual double SenderCpu() const = 0;
+        virtual double ReceiverCpu() const = 0;
+    };
+
+    /**
+     * @brief 受信の終端処理 (受信パイプラインの最後の段)。
+     */
+    struct ReceiveSink {
+        Traffic* traffic;
+        void operator()(hcs_common::PacketRef packet, const hcs_net::Endpoint&) { traffic->Receive(*packet); }
+    };
+
+    /**
+     * @brief 映像以外のパケットを破棄する終端処理。
+     */
+    struct DiscardSink {
+        void operator()(hcs_common::PacketRef, const hcs_net::Endpoint&) {}
+    };
+
+    /**
+     * @brief 受信 → 復号 → 振り分け → 解析 をコンパイル時に合成した受信処理 (ノードの実際の受信経路と同じ構成)。
+     */
+    using ReceivePipeline = hcs_net::PacketPipeline<hcs_net::DecryptStage, hcs_media::RtpDemuxStage<DiscardSink>, ReceiveSink>;
+
+    /**
+     * @brief 基底トランスポートと暗号化層を直接組み合わせた組 ("udp" / "memory")。
+     */
+    struct TransportPair : Pair {
+        Node sender;
+        Node receiver;
+        hcs_net::Endpoint destination;
+        std::unique_ptr<ReceivePipeline> receive_pipeline;
+
+        TransportPair(const LoopbackConfig& cfg, const std::shared_ptr<hcs_net::KeyProvider>& key_provider,
+                      const std::shared_ptr<hcs_net::MemoryNetwork>& network, const hcs_net::Endpoint& tx_local,
+                      const hcs_net::Endpoint& rx_local, hcs_common::LatencyHistogram& histogram)
+            : sender(cfg.transport, tx_local, key_provider, network, cfg.timestamps),
+              receiver(cfg.transport, rx_local, key_provider, network, cfg.timestamps),
+              destination(rx_local)
+        {
+            traffic = std::make_unique<Traffic>(cfg, histogram, sender.Io(), [this](hcs_common::PacketRef packet) {
+                sender.Secure().SendPacket(std::move(packet), destination);
+            });
+            receive_pipeline = std::make_unique<ReceivePipeline>(
+                hcs_net::DecryptStage(receiver.Secure()), hcs_media::RtpDemuxStage<DiscardSink>(DiscardSink{}),
+                ReceiveSink{traffic.get()});
+            // 基底トランスポートから連鎖を直接呼び、復号以降の段をコールバックを介さずにインライン展開する
+            hcs_net::BindPacketPipeline(receiver.Base(), *receive_pipeline);
+            if (cfg.capture) {
+                sender.Secure().SetCapture(cfg.capture, tx_local);
+                receiver.Secure().SetCapture(cfg.capture, rx_local);
+            }
+            sender.SetOnStop([this]() { traffic->StopSending(); });
+            receiver.SetOnStop([this]() { traffic->StopReceiving(); });
+        }
+
+        ~TransportPair() override {
+            // タイマーは送信ノードの io_context に属するため、ノードより先に解放する
+            Stop();
+            traffic.reset();
+        }
+
+        void Prepare() override { receiver.Start(); }
+
+        void StartSending(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) override {
+            traffic->Begin(start, end);
+            sender.Start();
+        }
+
+        void Stop() override {
+            sender.Stop();
+            receiver.Stop();
+        }
+
+        double SenderCpu() const override { return sender.CpuUtilization(); }
+        double ReceiverCpu() const override { return receiver.CpuUtilization(); }
+    };
+
+    /**
+     * @brief 2つの HCSNode の組 ("node")。
+     * 送信ノードはグループの送信元として PublishMedia() で購読者へ送り、受信ノードは
+     * SecureUdpMediaTransport → StreamDecoder の受信経路で解析したパケットを計測する。
+     */
+    struct NodePair : Pair {
+        HostedNode sender;
+        HostedNode receiver;
+        uint16_t sender_control_port;
+        uint16_t receiver_media_port;
+
+        /**
+         * @param first_port 送信ノードのメディア・制御、受信ノードのメディア・制御の順に連続するポートの先頭
+         */
+        NodePair(const LoopbackConfig& cfg, const std::string& passphrase_file, size_t index, uint16_t first_port,
+                 hcs_common::LatencyHistogram& histogram)
+            : sender("hcs-node tx" + std::to_string(index),
+                     NodeOverrides(cfg, passphrase_file, "loopback-tx" + std::to_string(index), first_port, true)),
+              receiver("hcs-node rx" + std::to_string(index),
+                       NodeOverrides(cfg, passphrase_file, "loopback-rx" + std::to_string(index),
+                                     static_cast<uint16_t>(first_port + 2), false)),
+              sender_control_port(static_cast<uint16_t>(first_port + 1)),
+              receiver_media_port(static_cast<uint16_t>(first_port + 2))
+        {
+            traffic = std::make_unique<Traffic>(cfg, histogram, sender.Io(), [this](hcs_common::PacketRef packet) {
+                sender.Get().PublishMedia(std::move(packet));
+            });
+            // エンコーダのダミーフレームは SSRC で除き、ベンチマークのパケットのみを計測する
+            receiver.Get().SetMediaHandler([traffic = traffic.get()](const hcs_common::PacketBuffer& packet, size_t) {
+                if (hcs_media::RtpSsrc(packet.Data()) == LOOPBACK_SSRC) traffic->Record(packet);
+            });
+            sender.SetOnStop([this]() { traffic->StopSending(); });
+            receiver.SetOnStop([this]() { traffic->StopReceiving(); });
+        }
+
+        ~NodePair() override {
+            Stop();
+            traffic.reset();
+        }
+
+        void Prepare() override {
+            sender.Start();
+            receiver.Start();
+        }
+
+        void Connect() override {
+            sender.WaitStarted();
+            receiver.WaitStarted();
+            // ADVERTISE は送信ノード自身の制御ポート宛てにマルチキャストされ、同一ホストで別の制御ポートを使う
+            // 受信ノードには届かないため、受信ノードに代わって JOIN を送る
+            // (送信ノードは送信元アドレスと JOIN のメディアポートから受信ノードのメディアの宛先を決める)
+            boost::asio::io_context io;
+            boost::asio::ip::udp::socket socket(io, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+            const std::vector<uint8_t> join =
+                hcs_control::EncodeJoin(receiver_media_port, hcs_control::ALL_LAYERS, LOOPBACK_GROUP);
+            socket.send_to(boost::asio::buffer(join),
+                           boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), sender_control_port));
+        }
+
+        void StartSending(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) override {
+            traffic->Begin(start, end);
+        }
+
+        void Stop() override {
+            sender.Stop();
+            receiver.Stop();
+        }
+
+        double SenderCpu() const override { return sender.CpuUtilization(); }
+        double ReceiverCpu() const override { return receiver.CpuUtilization(); }
+
+        /**
+         * @brief ループバック上のノードの設定。
+         * エンコーダのダミーフレームは最長の間隔に抑え、停止時は子ノードのハンドオフを待たない。
+         */
+        static std::vector<std::string> NodeOverrides(const LoopbackConfig& cfg, const std::string& passphrase_file,
+                                                      const std::string& id, uint16_t media_port, bool source) {
+            const char* timestamps = cfg.timestamps == hcs_net::SocketTimestampMode::kOff        ? "off"
+                                   : cfg.timestamps == hcs_net::SocketTimestampMode::kHardware ? "hardware"
+                                                                                               : "software";
+            std::string salt;
+            for (size_t i = 0; i < hcs_net::PBKDF2_SALT_SIZE; ++i) salt += LOOPBACK_SALT_HEX;
+            std::vector<std::string> overrides{
+                "node.id=" + id,
+                "node.address=127.0.0.1",
+                "node.log_level=warn",
+                "transport.media_port=" + std::to_string(media_port),
+                "transport.control_port=" + std::to_string(media_port + 1),
+                "transport.timestamps=" + std::string(timestamps),
+                "crypto.passphrase_file=" + passphrase_file,
+                "crypto.salt=" + salt,
+                "timeouts.frame_interval=1s",
+                "timeouts.handoff=0ms",
+            };
+            if (source) overrides.push_back(std::string("groups.source=") + LOOPBACK_GROUP);
+            return overrides;
+        }
+    };
+
+    /**
+     * @brief "node" のノードが読み込むパスフレーズのファイル (計測の間だけ存在する)。
+     */
+    class PassphraseFile {
+    public:
+        PassphraseFile() {
+            char path[] = "/tmp/hcs-loopback-XXXXXX";
+            const int fd = mkstemp(path);
+            if (fd < 0) throw std::runtime_error("Failed to create passphrase file");
+            const std::string text = std::string(LOOPBACK_PASSPHRASE) + "\n";
+            const bool written = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+            close(fd);
+            path_ = path;
+            if (!written) {
+                std::remove(path);
+                throw std::runtime_error("Failed to write passphrase file " + path_);
+            }
+        }
+
+        ~PassphraseFile() { std::remove(path_.c_str()); }
+        PassphraseFile(const PassphraseFile&) = delete;
+        PassphraseFile& operator=(const PassphraseFile&) = delete;
+
+        const std::string& Path() const { return path_; }
+
+    private:
+        std::string path_;
+    };
+};
+
+} // namespace hcs_sim
@@ -0,0 +1,636 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "EventScheduler.h"
+#include "LinkModel.h"
+#include "hcs_control/TopologyManager.h"
+#include "hcs_control/TopologySnapshotWriter.h"
+
+namespace hcs_sim {
+
+/**
+ * @brief シミュレーション条件。
+ */
+struct SimConfig {
+    size_t node_count = 200;        ///< ノード数
+    size_t group_count = 1;         ///< グループ数 (グループ g の送信元はノード g)
+    size_t neighbors = 0;           ///< ADVERTISE を受信する近隣数 (0 = 同一リンク上の全ノード)
+    SimTime duration = std::chrono::seconds(60);
+    SimTime advertise_interval = std::chrono::seconds(5);
+    SimTime heartbeat_interval = std::chrono::seconds(1);
+    SimTime health_check_interval = std::chrono::milliseconds(100);
+    SimTime media_interval{0};      ///< 親から子へのメディア送信間隔 (0 = メディアを模擬しない)
+    SimTime control_tick{0};        ///< ADVERTISE をまとめて適用する間隔 (0 = 受信ごとに即時適用)
+    int max_tree_depth = 8;
+    bool redundant = false;         ///< 冗長 (二重親) 配信モード
+    LinkParams link;
+    uint64_t seed = 1;
+
+    // --- 障害注入 ---
+    SimTime kill_at{-1};            ///< ノード停止を注入する時刻 (負値で無効)
+    double kill_fraction = 0.0;     ///< 停止させる非送信元ノードの割合
+    SimTime partition_at{-1};       ///< ネットワークを二分する時刻 (負値で無効)
+    SimTime heal_at{-1};            ///< 分断を解消する時刻 (負値で解消しない)
+    SimTime drain_at{-1};           ///< 計画停止 (DEPARTING による子ノードのハンドオフ) を始める時刻 (負値で無効)
+    double drain_fraction = 0.0;    ///< 計画停止させる中継ノード (子を持つ非送信元ノード) の割合
+    SimTime handoff_timeout = std::chrono::seconds(2);                ///< 停止するノードが全ての子の LEAVE を待つ上限
+    SimTime handoff_confirm_timeout = std::chrono::milliseconds(500); ///< 子が新しい親からの受信を待つ上限
+    SimTime departure_resend_interval = std::chrono::milliseconds(100); ///< DEPARTING の再送間隔
+};
+
+/**
+ * @brief シミュレーション結果。回帰ベンチマークとして比較できる値をまとめる。
+ */
+struct SimReport {
+    double simulated_sec = 0.0;
+    double wall_sec = 0.0;
+    uint64_t events = 0;
+    uint64_t advertise_sent = 0;
+    uint64_t heartbeat_sent = 0;
+    uint64_t control_delivered = 0;
+    uint64_t control_dropped = 0;
+    uint64_t media_delivered = 0;
+    uint64_t parent_switches = 0;
+    uint64_t max_switches_per_node = 0;
+    double initial_convergence_sec = -1.0; ///< 開始から (障害注入前の) 最後の親変更までの時間
+    double fault_convergence_sec = -1.0;   ///< 最後の障害注入から最後の親変更までの時間
+    double attached_fraction = 0.0;        ///< 終了時に全グループで親を持つ生存ノードの割合
+    int max_depth = 0;                     ///< 終了時の配信ツリーの最大深さ
+    double cpu_us_per_node_mean = 0.0;     ///< ノードあたりのトポロジー処理CPU時間 (実時間μs)
+    double cpu_us_per_node_max = 0.0;
+    uint64_t drained_nodes = 0;            ///< 計画停止したノード数
+    uint64_t handoff_confirmed = 0;        ///< 新しい親からの受信を確認して LEAVE を返した子 (グループごと)
+    uint64_t handoff_timeouts = 0;         ///< 受信を確認できないまま期限で LEAVE を返した子
+    uint64_t handoff_unconfirmed = 0;      ///< LEAVE が届かないまま停止するノードが上限に達した子
+    double handoff_max_ms = 0.0;           ///< 計画停止の開始から子の LEAVE が届くまでの最大時間
+
+    /**
+     * @brief 人間向けのサマリを出力する。
+     */
+    void Print(std::ostream& os) const {
+        os << "=== HCS Topology Simulation Report ===\n"
+           << "Simulated time        : " << simulated_sec << " s (wall " << wall_sec << " s, x"
+           << (wall_sec > 0 ? simulated_sec / wall_sec : 0.0) << ")\n"
+           << "Events executed       : " << events << "\n"
+           << "Control messages      : advertise=" << advertise_sent << " heartbeat=" << heartbeat_sent
+           << " delivered=" << control_delivered << " dropped=" << control_dropped << "\n"
+           << "Media packets         : delivered=" << media_delivered << "\n"
+           << "Parent switches       : total=" << parent_switches << " max/node=" << max_switches_per_node << "\n"
+           << "Convergence           : initial=" << initial_convergence_sec << " s, after fault="
+           << fault_convergence_sec << " s\n"
+           << "Attached nodes        : " << attached_fraction * 100.0 << " % (max depth " << max_depth << ")\n"
+           << "Topology CPU per node : mean=" << cpu_us_per_node_mean << " us, max=" << cpu_us_per_node_max << " us\n"
+           << "Planned departures    : nodes=" << drained_nodes << " confirmed=" << handoff_confirmed
+           << " timeouts=" << handoff_timeouts << " unconfirmed=" << handoff_unconfirmed
+           << " (max " << handoff_max_ms << " ms)\n";
+    }
+
+    /**
+     * @brief 回帰比較用に1行のJSONとして出力する。
+     */
+    void PrintJson(std::ostream& os) const {
+        os << "{\"simulated_sec\":" << simulated_sec << ",\"wall_sec\":" << wall_sec
+           << ",\"events\":" << events << ",\"advertise_sent\":" << advertise_sent
+           << ",\"heartbeat_sent\":" << heartbeat_sent << ",\"control_delivered\":" << control_delivered
+           << ",\"control_dropped\":" << control_dropped << ",\"media_delivered\":" << media_delivered
+           << ",\"parent_switches\":" << parent_switches << ",\"max_switches_per_node\":" << max_switches_per_node
+           << ",\"initial_convergence_sec\":" << initial_convergence_sec
+           << ",\"fault_convergence_sec\":" << fault_convergence_sec
+           << ",\"attached_fraction\":" << attached_fraction << ",\"max_depth\":" << max_depth
+           << ",\"cpu_us_per_node_mean\":" << cpu_us_per_node_mean
+           << ",\"cpu_us_per_node_max\":" << cpu_us_per_node_max
+           << ",\"drained_nodes\":" << drained_nodes << ",\"handoff_confirmed\":" << handoff_confirmed
+           << ",\"handoff_timeouts\":" << handoff_timeouts << ",\"handoff_unconfirmed\":" << handoff_unconfirmed
+           << ",\"handoff_max_ms\":" << handoff_max_ms << "}\n";
+    }
+};
+
+/**
+ * @brief 多数の TopologyManager を仮想時計とリンクモデルの上で動かすシミュレーション。
+ * 制御メッセージはシリアライズせず構造体のまま配送し、トポロジー制御ロジックのみを検証する。
+ */
+class TopologySimulation {
+public:
+    explicit TopologySimulation(const SimConfig& config)
+        : config_(config), link_(config.node_count, config.link, config.seed)
+    {
+        nodes_.resize(config_.node_count);
+        std::uniform_int_distribution<int> quality(20, 100);
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            SimNode& node = nodes_[i];
+            node.ip = MakeIp(i);
+            node.topology = std::make_unique<hcs_control::TopologyManager>(node.ip);
+            node.topology->SetClock([this]() { return VirtualNow(); });
+            node.topology->SetMaxTreeDepth(config_.max_tree_depth);
+            node.topology->SetRedundantMode(config_.redundant);
+            node.metrics.bandwidth_score = quality(link_.Rng());
+            node.metrics.stability_score = quality(link_.Rng());
+            node.primary.assign(config_.group_count, "");
+            node.secondary.assign(config_.group_count, "");
+            index_of_[node.ip] = i;
+        }
+        for (size_t g = 0; g < config_.group_count && g < nodes_.size(); ++g) {
+            groups_.push_back("group-" + std::to_string(g));
+            nodes_[g].topology->AddSourceGroup(groups_.back());
+        }
+        BuildNeighborSets();
+    }
+
+    /**
+     * @brief スナップショットの出力先を設定する (ダッシュボードでの再生用)。
+     * @param out 出力ストリーム
+     * @param interval 出力間隔 (仮想時間)
+     */
+    void SetSnapshotOutput(std::ostream* out, SimTime interval) {
+        snapshot_out_ = out;
+        snapshot_interval_ = interval;
+    }
+
+    /**
+     * @brief シミュレーションを実行し、結果を返す。
+     */
+    SimReport Run() {
+        auto wall_start = std::chrono::steady_clock::now();
+        std::uniform_int_distribution<int64_t> phase(0, std::max<int64_t>(1, config_.advertise_interval.count()));
+
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            // 全ノードが同時に送信しないよう、周期タイマーの位相をずらす
+            SimTime offset(phase(link_.Rng()));
+            ScheduleAdvertise(i, offset);
+            ScheduleHeartbeat(i, offset % std::max<int64_t>(1, config_.heartbeat_interval.count()));
+            ScheduleHealthCheck(i, offset % std::max<int64_t>(1, config_.health_check_interval.count()));
+            if (config_.media_interval.count() > 0) {
+                ScheduleMedia(i, offset % config_.media_interval.count());
+            }
+            if (config_.control_tick.count() > 0) {
+                ScheduleControlTick(i, offset % config_.control_tick.count());
+            }
+        }
+        if (config_.kill_at.count() >= 0) scheduler_.ScheduleAt(config_.kill_at, [this]() { KillNodes(); });
+        if (config_.partition_at.count() >= 0) scheduler_.ScheduleAt(config_.partition_at, [this]() { PartitionNetwork(); });
+        if (config_.heal_at.count() >= 0) scheduler_.ScheduleAt(config_.heal_at, [this]() { link_.Heal(); MarkFault(); });
+        if (config_.drain_at.count() >= 0) scheduler_.ScheduleAt(config_.drain_at, [this]() { DrainNodes(); });
+        if (snapshot_out_) {
+            for (auto& node : nodes_) {
+                node.snapshot = std::make_unique<hcs_control::TopologySnapshotWriter>(*snapshot_out_);
+            }
+            ScheduleSnapshot(SimTime::zero());
+        }
+
+        report_.events = scheduler_.RunUntil(config_.duration);
+        report_.wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+        Summarize();
+        return report_;
+    }
+
+private:
+    /**
+     * @brief 親の停止予告を受けて新しい親へ切り替え、そこからの受信を待っている状態 (HCSNode::PendingHandoff)。
+     */
+    struct PendingHandoff {
+        size_t group = 0;
+        size_t old_parent = 0;
+        std::string new_parent;
+    };
+
+    /**
+     * @brief シミュレーション上の1ノード。
+     */
+    struct SimNode {
+        std::string ip;
+        std::unique_ptr<hcs_control::TopologyManager> topology;
+        std::unique_ptr<hcs_control::TopologySnapshotWriter> snapshot;
+        hcs_control::NodeMetrics metrics;
+        std::vector<size_t> neighbors;       ///< ADVERTISE の配送先 (空なら全ノード)
+        std::vector<std::string> primary;    ///< グループごとの現在のプライマリ親
+        std::vector<std::string> secondary;  ///< グループごとの現在のセカンダリ親
+        std::set<size_t> children;           ///< 自ノードを親としているノード
+        std::set<std::pair<size_t, size_t>> departing_children; ///< 計画停止中に LEAVE を待つ (子ノード, グループ)
+        std::vector<PendingHandoff> handoffs; ///< 子として新しい親からの受信を待っている切り替え
+        SimTime drain_started{-1};           ///< 計画停止の開始時刻 (負値なら停止中でない)
+        bool alive = true;
+        uint64_t switches = 0;
+        std::chrono::steady_clock::duration cpu{0};
+    };
+
+    SimConfig config_;
+    EventScheduler scheduler_;
+    LinkModel link_;
+    std::vector<SimNode> nodes_;
+    std::vector<std::string> groups_;
+    std::unordered_map<std::string, size_t> index_of_;
+    SimReport report_;
+    SimTime last_change_{-1};
+    SimTime last_fault_{-1};
+    SimTime last_change_before_fault_{-1};
+    std::ostream* snapshot_out_ = nullptr;
+    SimTime snapshot_interval_ = std::chrono::seconds(1);
+
+    static std::string MakeIp(size_t i) {
+        return "10." + std::to_string((i >> 16) & 0xFF) + "." + std::to_string((i >> 8) & 0xFF) + "." +
+               std::to_string(i & 0xFF);
+    }
+
+    std::chrono::steady_clock::time_point VirtualNow() const {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(scheduler_.Now()));
+    }
+
+    /**
+     * @brief TopologyManager の呼び出しを実時間で計測し、ノードのCPU時間に加算する。
+     */
+    template <typename F>
+    void Measure(SimNode& node, F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        node.cpu += std::chrono::steady_clock::now() - start;
+    }
+
+    void BuildNeighborSets() {
+        if (config_.neighbors == 0 || config_.neighbors + 1 >= nodes_.size()) return;
+        // ランダムな k 近隣 (双方向) のオーバーレイ
+        std::uniform_int_distribution<size_t> pick(0, nodes_.size() - 1);
+        std::vector<std::set<size_t>> sets(nodes_.size());
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            while (sets[i].size() < config_.neighbors) {
+                size_t j = pick(link_.Rng());
+                if (j == i) continue;
+                sets[i].insert(j);
+                sets[j].insert(i);
+            }
+        }
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            nodes_[i].neighbors.assign(sets[i].begin(), sets[i].end());
+        }
+    }
+
+    // --- 周期イベント ---
+
+    void ScheduleAdvertise(size_t i, SimTime delay) {
+        scheduler_.Schedule(delay, [this, i]() {
+            if (!nodes_[i].alive) return;
+            // 計画停止中は親候補にならないよう通知しない (HCSNode::SendAdvertise と同じ)
+            if (nodes_[i].drain_started.count() < 0) SendAdvertise(i);
+            ScheduleAdvertise(i, config_.advertise_interval);
+        });
+    }
+
+    void ScheduleHeartbeat(size_t i, SimTime delay) {
+        scheduler_.Schedule(delay, [this, i]() {
+            if (!nodes_[i].alive) return;
+            for (size_t child : nodes_[i].children) {
+                ++report_.heartbeat_sent;
+                Deliver(i, child, 64, [this, i, child]() {
+                    Measure(nodes_[child], [&]() { nodes_[child].topology->HandleHeartbeat(nodes_[i].ip, ""); });
+                });
+            }
+            ScheduleHeartbeat(i, config_.heartbeat_interval);
+        });
+    }
+
+    void ScheduleHealthCheck(size_t i, SimTime delay) {
+        scheduler_.Schedule(delay, [this, i]() {
+            if (!nodes_[i].alive) return;
+            Measure(nodes_[i], [&]() {
+                for (const auto& gid : groups_) nodes_[i].topology->CheckParentHealth(gid);
+            });
+            TrackParents(i);
+            ScheduleHealthCheck(i, config_.health_check_interval);
+        });
+    }
+
+    void ScheduleMedia(size_t i, SimTime delay) {
+        scheduler_.Schedule(delay, [this, i]() {
+            if (!nodes_[i].alive) return;
+            // 計画停止中は、切り替えた子にも LEAVE が届くまで送り続ける (make-before-break)
+            std::set<size_t> receivers = nodes_[i].children;
+            for (const auto& [child, g] : nodes_[i].departing_children) receivers.insert(child);
+            for (size_t child : receivers) {
+                SimTime d;
+                if (!link_.Transmit(i, child, 1200, scheduler_.Now(), d)) continue;
+                scheduler_.Schedule(d, [this, i, child]() {
+                    if (!nodes_[child].alive) return;
+                    ++report_.media_delivered;
+                    Measure(nodes_[child], [&]() { nodes_[child].topology->HandleMediaActivity(nodes_[i].ip); });
+                    ConfirmHandoffs(child, i);
+                });
+            }
+            ScheduleMedia(i, config_.media_interval);
+        });
+    }
+
+    void ScheduleControlTick(size_t i, SimTime delay) {
+        scheduler_.Schedule(delay, [this, i]() {
+            if (!nodes_[i].alive) return;
+            Measure(nodes_[i], [&]() { nodes_[i].topology->FlushAdvertiseBatch(); });
+            TrackParents(i);
+            ScheduleControlTick(i, config_.control_tick);
+        });
+    }
+
+    void ScheduleSnapshot(SimTime delay) {
+        scheduler_.Schedule(delay, [this]() {
+            long long t_ms = std::chrono::duration_cast<std::chrono::milliseconds>(scheduler_.Now()).count();
+            for (auto& node : nodes_) {
+                if (node.alive) node.snapshot->Write(*node.topology, t_ms);
+            }
+            ScheduleSnapshot(snapshot_interval_);
+        });
+    }
+
+    // --- メッセージ配送 ---
+
+    void SendAdvertise(size_t i) {
+        SimNode& node = nodes_[i];
+        auto msg = std::make_shared<hcs_control::AdvertiseMessage>();
+        Measure(node, [&]() { *msg = node.topology->BuildAdvertise(node.metrics); });
+        if (msg->groups.empty()) return; // 経路を持たないノードは通知しない
+
+        // 概算サイズ: 固定部 + グループごとの経路 (IPv6アドレス16バイト/ホップ)
+        size_t bytes = 142;
+        for (const auto& [gid, route] : msg->routes) bytes += 24 + route.path.size() * 16;
+
+        ++report_.advertise_sent;
+        bool first = true;
+        auto send_to = [&](size_t j) {
+            if (j == i) return;
+            // リンクローカルマルチキャスト: 送出帯域は1回分のみ消費する
+            SimTime d;
+            if (!link_.Transmit(i, j, first ? bytes : 0, scheduler_.Now(), d)) {
+                ++report_.control_dropped;
+                return;
+            }
+            first = false;
+            scheduler_.Schedule(d, [this, i, j, msg]() {
+                if (!nodes_[j].alive) return;
+                hcs_control::AdvertiseMessage copy = *msg;
+                // 受信側が計測するRTTとして、リンクの往復伝搬遅延を与える
+                copy.metrics.rtt_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    link_.PropagationDelay(i, j) * 2).count();
+                ++report_.control_delivered;
+                if (config_.control_tick.count() > 0) {
+                    Measure(nodes_[j], [&]() { nodes_[j].topology->EnqueueAdvertise(std::move(copy)); });
+                    return;
+                }
+                Measure(nodes_[j], [&]() { nodes_[j].topology->HandleAdvertise(copy); });
+                TrackParents(j);
+            });
+        };
+        if (node.neighbors.empty()) {
+            for (size_t j = 0; j < nodes_.size(); ++j) send_to(j);
+        } else {
+            for (size_t j : node.neighbors) send_to(j);
+        }
+    }
+
+    template <typename F>
+    void Deliver(size_t from, size_t to, size_t bytes, F&& on_arrival) {
+        SimTime d;
+        if (!link_.Transmit(from, to, bytes, scheduler_.Now(), d)) {
+            ++report_.control_dropped;
+            return;
+        }
+        scheduler_.Schedule(d, [this, to, f = std::forward<F>(on_arrival)]() {
+            if (!nodes_[to].alive) return;
+            ++report_.control_delivered;
+            f();
+        });
+    }
+
+    /**
+     * @brief ノードの親選定の変化を検出し、親切替回数と子ノード集合を更新する。
+     */
+    void TrackParents(size_t i) {
+        SimNode& node = nodes_[i];
+        bool changed = false;
+        std::set<size_t> old_parents = ParentIndices(node);
+        for (size_t g = 0; g < groups_.size(); ++g) {
+            std::string primary = node.topology->SelectBestParent(groups_[g]);
+            std::string secondary = node.topology->SelectSecondaryParent(groups_[g]);
+            if (primary != node.primary[g]) {
+                if (!node.primary[g].empty()) {
+                    ++node.switches;
+                    ++report_.parent_switches;
+                }
+                last_change_ = scheduler_.Now();
+                if (last_fault_.count() < 0) last_change_before_fault_ = last_change_;
+                node.primary[g] = primary;
+                changed = true;
+            }
+            if (secondary != node.secondary[g]) {
+                node.secondary[g] = secondary;
+                changed = true;
+            }
+        }
+        if (!changed) return;
+
+        // 旧親の子集合から外し、現在の親の子集合に登録する
+        std::set<size_t> new_parents = ParentIndices(node);
+        for (size_t p : old_parents) {
+            if (!new_parents.count(p)) nodes_[p].children.erase(i);
+        }
+        for (size_t p : new_parents) {
+            // 計画停止中のノードは新しい子を受け付けない (HCSNode は停止中の JOIN を拒否する)
+            if (nodes_[p].drain_started.count() < 0) nodes_[p].children.insert(i);
+        }
+    }
+
+    std::set<size_t> ParentIndices(const SimNode& node) const {
+        std::set<size_t> result;
+        for (size_t g = 0; g < groups_.size(); ++g) {
+            for (const auto* ip : {&node.primary[g], &node.secondary[g]}) {
+                auto it = index_of_.find(*ip);
+                if (it != index_of_.end()) result.insert(it->second);
+            }
+        }
+        return result;
+    }
+
+    // --- 障害注入 ---
+
+    void MarkFault() {
+        last_fault_ = scheduler_.Now();
+    }
+
+    void KillNodes() {
+        std::vector<size_t> candidates;
+        for (size_t i = groups_.size(); i < nodes_.size(); ++i) {
+            if (nodes_[i].alive) candidates.push_back(i);
+        }
+        std::shuffle(candidates.begin(), candidates.end(), link_.Rng());
+        size_t count = static_cast<size_t>(candidates.size() * config_.kill_fraction);
+        for (size_t k = 0; k < count; ++k) {
+            nodes_[candidates[k]].alive = false;
+            nodes_[candidates[k]].children.clear();
+        }
+        MarkFault();
+    }
+
+    /**
+     * @brief 子を持つ中継ノードの一定割合を計画停止させる (HCSNode::Stop のハンドオフ段)。
+     */
+    void DrainNodes() {
+        std::vector<size_t> candidates;
+        for (size_t i = groups_.size(); i < nodes_.size(); ++i) {
+            if (nodes_[i].alive && !nodes_[i].children.empty()) candidates.push_back(i);
+        }
+        std::shuffle(candidates.begin(), candidates.end(), link_.Rng());
+        size_t count = static_cast<size_t>(candidates.size() * config_.drain_fraction);
+        for (size_t k = 0; k < count; ++k) {
+            const size_t i = candidates[k];
+            SimNode& node = nodes_[i];
+            node.drain_started = scheduler_.Now();
+            for (size_t child : node.children) {
+                for (size_t g = 0; g < groups_.size(); ++g) {
+                    if (nodes_[child].primary[g] == node.ip || nodes_[child].secondary[g] == node.ip) {
+                        node.departing_children.emplace(child, g);
+                    }
+                }
+            }
+            ++report_.drained_nodes;
+            SendDepartures(i);
+            scheduler_.Schedule(config_.handoff_timeout, [this, i]() {
+                if (!nodes_[i].alive) return;
+                report_.handoff_unconfirmed += nodes_[i].departing_children.size();
+                FinishDrain(i);
+            });
+        }
+        MarkFault();
+    }
+
+    /**
+     * @brief LEAVE を返していない子へ、停止の予告と推奨する代わりの親を送る (LEAVE が届くまで再送する)。
+     */
+    void SendDepartures(size_t i) {
+        SimNode& node = nodes_[i];
+        if (!node.alive || node.departing_children.empty()) return;
+        for (size_t g = 0; g < groups_.size(); ++g) {
+            auto recommended = std::make_shared<std::vector<std::string>>();
+            Measure(node, [&]() { *recommended = node.topology->RecommendReplacements(groups_[g], 3); });
+            for (const auto& [child, child_group] : node.departing_children) {
+                if (child_group != g) continue;
+                Deliver(i, child, 64, [this, i, child = child, g, recommended]() {
+                    HandleDeparture(child, i, g, *recommended);
+                });
+            }
+        }
+        scheduler_.Schedule(config_.departure_resend_interval, [this, i]() { SendDepartures(i); });
+    }
+
+    /**
+     * @brief 子ノードが親の停止予告を処理する (HCSNode::HandleParentDeparture)。
+     */
+    void HandleDeparture(size_t child, size_t parent, size_t g, const std::vector<std::string>& recommended) {
+        SimNode& node = nodes_[child];
+        for (const auto& h : node.handoffs) {
+            if (h.group == g && h.old_parent == parent) return; // 予告の再送
+        }
+        hcs_control::ParentHandoff handoff;
+        Measure(node, [&]() {
+            handoff = node.topology->HandleParentDeparture(nodes_[parent].ip, groups_[g], recommended);
+        });
+        if (handoff.new_parent.empty()) return; // 代わりがなければ親の停止後に障害検出で切り替える
+        TrackParents(child);
+        if (handoff.receiving) {
+            SendLeave(child, parent, g, true);
+            return;
+        }
+        // 新しい親からの受信を待ち、期限までに届かなければ LEAVE を送る
+        node.handoffs.push_back(PendingHandoff{g, parent, handoff.new_parent});
+        scheduler_.Schedule(config_.handoff_confirm_timeout, [this, child, parent, g]() {
+            auto& handoffs = nodes_[child].handoffs;
+            auto it = std::find_if(handoffs.begin(), handoffs.end(), [&](const PendingHandoff& h) {
+                return h.group == g && h.old_parent == parent;
+            });
+            if (it == handoffs.end() || !nodes_[child].alive) return;
+            handoffs.erase(it);
+            SendLeave(child, parent, g, false);
+        });
+    }
+
+    /**
+     * @brief 新しい親からのメディアの到着で切り替えを確定する (HCSNode::ConfirmHandoffs)。
+     */
+    void ConfirmHandoffs(size_t child, size_t sender) {
+        auto& handoffs = nodes_[child].handoffs;
+        for (auto it = handoffs.begin(); it != handoffs.end();) {
+            if (it->new_parent != nodes_[sender].ip) {
+                ++it;
+                continue;
+            }
+            SendLeave(child, it->old_parent, it->group, true);
+            it = handoffs.erase(it);
+        }
+    }
+
+    /**
+     * @brief 停止する親へ LEAVE を送る。全ての子の LEAVE が届いた親は停止する。
+     * @param confirmed 新しい親からの受信を確認した切り替えか
+     */
+    void SendLeave(size_t child, size_t parent, size_t g, bool confirmed) {
+        Deliver(child, parent, 64, [this, child, parent, g, confirmed]() {
+            SimNode& node = nodes_[parent];
+            if (node.departing_children.erase({child, g}) == 0) return; // 再送への応答
+            ++(confirmed ? report_.handoff_confirmed : report_.handoff_timeouts);
+            const double ms = std::chrono::duration<double, std::milli>(scheduler_.Now() - node.drain_started).count();
+            report_.handoff_max_ms = std::max(report_.handoff_max_ms, ms);
+            if (node.departing_children.empty()) FinishDrain(parent);
+        });
+    }
+
+    void FinishDrain(size_t i) {
+        nodes_[i].alive = false;
+        nodes_[i].children.clear();
+        nodes_[i].departing_children.clear();
+    }
+
+    void PartitionNetwork() {
+        std::vector<int> side(nodes_.size());
+        for (size_t i = 0; i < side.size(); ++i) side[i] = static_cast<int>(i % 2);
+        link_.Partition(std::move(side));
+        MarkFault();
+    }
+
+    void Summarize() {
+        report_.simulated_sec = std::chrono::duration<double>(config_.duration).count();
+        if (last_change_before_fault_.count() >= 0) {
+            report_.initial_convergence_sec = std::chrono::duration<double>(last_change_before_fault_).count();
+        }
+        if (last_fault_.count() >= 0 && last_change_ >= last_fault_) {
+            report_.fault_convergence_sec = std::chrono::duration<double>(last_change_ - last_fault_).count();
+        }
+
+        size_t alive = 0, attached = 0;
+        double cpu_total = 0.0;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            const SimNode& node = nodes_[i];
+            double cpu_us = std::chrono::duration<double, std::micro>(node.cpu).count();
+            cpu_total += cpu_us;
+            report_.cpu_us_per_node_max = std::max(report_.cpu_us_per_node_max, cpu_us);
+            report_.max_switches_per_node = std::max(report_.max_switches_per_node, node.switches);
+            if (!node.alive) continue;
+            ++alive;
+            for (const auto& sel : node.topology->GetParentSelections()) {
+                report_.max_depth = std::max(report_.max_depth, sel.depth);
+            }
+            // 全グループについて、送信元自身であるか親を持っていれば接続済みとみなす
+            bool all = true;
+            for (size_t g = 0; g < groups_.size(); ++g) {
+                if (i != g && node.topology->SelectBestParent(groups_[g]).empty()) all = false;
+            }
+            if (all) ++attached;
+        }
+        report_.cpu_us_per_node_mean = nodes_.empty() ? 0.0 : cpu_total / nodes_.size();
+        report_.attached_fraction = alive ? static_cast<double>(attached) / alive : 0.0;
+    }
+};
+
+} // namespace hcs_sim
@@ -0,0 +1,220 @@
+// PacketCapture が書き出した pcapng ファイルをオフラインで再生するツール
+// 記録した受信パケットを実際の受信処理 (TransportAES256 の復号 → RTP 振り分け) に通し、
+// 復号の成否と SSRC ごとの RTP の連続性 (欠落・順序逆転・重複) を出力する。
+// 暗号文 (--point=wire) を再生する場合は、送信ノードと同じパスフレーズとソルトを指定する。
+//
+// 使用例:
+//   CaptureReplay --input=hcs-20260101-120000-1-decrypt-failures.pcapng --passphrase=secret --salt=5a5a...
+//   CaptureReplay --input=capture.pcapng --point=plaintext --json
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "hcs_common/Logger.h"
+#include "hcs_media/RtpPacket.h"
+#include "hcs_net/CaptureReplay.h"
+#include "hcs_net/PacketPipeline.h"
+#include "hcs_net/PBKDF2KeyProvider.h"
+#include "hcs_net/TransportAES256.h"
+
+namespace {
+
+constexpr uint32_t RTP_DUPLICATE_WINDOW = 64; ///< 重複を判定する直近のシーケンス番号の範囲
+
+void PrintUsage() {
+    std::cerr <<
+        "Usage: CaptureReplay --input=PATH [options]\n"
+        "  --input=PATH         再生する pcapng ファイル\n"
+        "  --point=POINT        再生するキャプチャ位置 (wire, plaintext; default wire)\n"
+        "  --local=ADDR:PORT    このエンドポイント宛てのパケットのみを再生する (default 全て)\n"
+        "  --passphrase=TEXT    wire: 鍵導出のパスフレーズ\n"
+        "  --salt=HEX           wire: 鍵導出のソルト (16進数)\n"
+        "  --json               結果を1行ずつJSONで出力する\n";
+}
+
+std::vector<uint8_t> ParseHex(const std::string& hex) {
+    if (hex.size() % 2 != 0) throw std::invalid_argument("hex string must have an even length");
+    std::vector<uint8_t> bytes;
+    bytes.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        bytes.push_back(static_cast<uint8_t>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+    }
+    return bytes;
+}
+
+hcs_net::Endpoint ParseEndpoint(const std::string& value) {
+    const size_t colon = value.rfind(':');
+    if (colon == std::string::npos) throw std::invalid_argument("endpoint must be ADDR:PORT");
+    std::string host = value.substr(0, colon);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+    return hcs_net::Endpoint(host, static_cast<uint16_t>(std::stoul(value.substr(colon + 1))));
+}
+
+/**
+ * @brief SSRC ごとの RTP シーケンス番号の連続性。
+ */
+struct RtpStreamStats {
+    hcs_net::Endpoint source;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t lost = 0;       // 欠けているシーケンス番号の数 (後着で埋まった分は除く)
+    uint64_t reordered = 0;  // 先行するパケットより後に届いたパケット数
+    uint64_t duplicates = 0;
+    int64_t highest = -1;    // 周回を含めた最大のシーケンス番号
+    uint64_t window = 0;     // highest から遡った受信済みのビットマップ (bit0 = highest)
+
+    void Add(uint16_t seq, size_t size) {
+        ++packets;
+        bytes += size;
+        if (highest < 0) {
+            highest = seq;
+            window = 1;
+            return;
+        }
+        // 直近の最大値に最も近い周回のシーケンス番号に拡張する
+        const int16_t delta = static_cast<int16_t>(seq - static_cast<uint16_t>(highest));
+        const int64_t extended = highest + delta;
+        if (extended > highest) {
+            const uint64_t advance = static_cast<uint64_t>(extended - highest);
+            lost += advance - 1;
+            window = advance >= RTP_DUPLICATE_WINDOW ? 1 : (window << advance) | 1;
+            highest = extended;
+            return;
+        }
+        const uint64_t behind = static_cast<uint64_t>(highest - extended);
+        if (behind < RTP_DUPLICATE_WINDOW && (window & (uint64_t{1} << behind))) {
+            ++duplicates;
+            return;
+        }
+        ++reordered;
+        if (lost > 0) --lost;
+        if (behind < RTP_DUPLICATE_WINDOW) window |= uint64_t{1} << behind;
+    }
+};
+
+struct ReplayStats {
+    std::map<uint32_t, RtpStreamStats> streams;
+    uint64_t other = 0; // 映像以外のペイロードタイプ (RTCP など)
+};
+
+struct StatsSink {
+    ReplayStats* stats;
+    void operator()(hcs_common::PacketRef packet, const hcs_net::Endpoint& sender) {
+        const uint8_t* data = packet->Data();
+        const uint32_t ssrc = (uint32_t(data[8]) << 24) | (uint32_t(data[9]) << 16) | (uint32_t(data[10]) << 8) | uint32_t(data[11]);
+        const uint16_t seq = static_cast<uint16_t>((data[2] << 8) | data[3]);
+        RtpStreamStats& stream = stats->streams[ssrc];
+        stream.source = sender;
+        stream.Add(seq, packet->Size());
+    }
+};
+
+struct OtherSink {
+    ReplayStats* stats;
+    void operator()(hcs_common::PacketRef, const hcs_net::Endpoint&) { ++stats->other; }
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string input;
+    hcs_net::CapturePoint point = hcs_net::CapturePoint::kWire;
+    hcs_net::Endpoint local;
+    std::string passphrase;
+    std::vector<uint8_t> salt;
+    bool json = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            std::string key = arg, value;
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                key = arg.substr(0, eq);
+                value = arg.substr(eq + 1);
+            }
+
+            if (key == "--input") input = value;
+            else if (key == "--point") {
+                if (value == "wire") point = hcs_net::CapturePoint::kWire;
+                else if (value == "plaintext") point = hcs_net::CapturePoint::kPlaintext;
+                else throw std::invalid_argument("unknown capture point " + value);
+            }
+            else if (key == "--local") local = ParseEndpoint(value);
+            else if (key == "--passphrase") passphrase = value;
+            else if (key == "--salt") salt = ParseHex(value);
+            else if (key == "--json") json = true;
+            else if (key == "--help" || key == "-h") { PrintUsage(); return 0; }
+            else throw std::invalid_argument("unknown option " + arg);
+        }
+        if (input.empty()) throw std::invalid_argument("--input is required");
+        if (point == hcs_net::CapturePoint::kWire && passphrase.empty()) {
+            throw std::invalid_argument("--passphrase is required to replay wire packets");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[CaptureReplay] Invalid arguments: " << e.what() << "\n";
+        PrintUsage();
+        return 1;
+    }
+
+    hcs_common::Logger::SetLevel(hcs_common::LogLevel::kWarn);
+
+    try {
+        hcs_net::PcapngReader reader(input);
+        auto replay = std::make_shared<hcs_net::CaptureReplayTransport>(reader.ReadAll());
+
+        ReplayStats stats;
+        auto demux = hcs_media::MakeRtpDemuxStage(OtherSink{&stats});
+        size_t replayed = 0;
+        uint64_t decrypt_failures = 0;
+        uint64_t rtp_dropped = 0;
+        if (point == hcs_net::CapturePoint::kWire) {
+            // 記録した暗号文を受信ノードと同じ復号処理に通す
+            auto& failures = hcs_net::CryptoMetrics::Get().decrypt_failures;
+            const uint64_t failures_before = failures.Value();
+            auto key_provider = std::make_shared<hcs_net::PBKDF2KeyProvider>(passphrase, salt);
+            hcs_net::TransportAES256 secure(key_provider, replay);
+            auto pipeline = hcs_net::MakePacketPipeline(hcs_net::DecryptStage(secure), demux, StatsSink{&stats});
+            hcs_net::BindPacketPipeline(*replay, pipeline);
+            replayed = replay->Replay(point, local);
+            decrypt_failures = failures.Value() - failures_before;
+            rtp_dropped = pipeline.Tail().Head().Dropped();
+        } else {
+            auto pipeline = hcs_net::MakePacketPipeline(demux, StatsSink{&stats});
+            hcs_net::BindPacketPipeline(*replay, pipeline);
+            replayed = replay->Replay(point, local);
+            rtp_dropped = pipeline.Head().Dropped();
+        }
+        hcs_common::Logger::Instance().Flush();
+
+        if (json) {
+            std::cout << "{\"input\":\"" << input << "\",\"packets\":" << replay->Packets().size()
+                      << ",\"replayed\":" << replayed << ",\"decrypt_failures\":" << decrypt_failures
+                      << ",\"rtp_dropped\":" << rtp_dropped << ",\"other\":" << stats.other << "}\n";
+            for (const auto& [ssrc, stream] : stats.streams) {
+                std::cout << "{\"ssrc\":" << ssrc << ",\"source\":\"" << stream.source << "\",\"packets\":" << stream.packets
+                          << ",\"bytes\":" << stream.bytes << ",\"lost\":" << stream.lost
+                          << ",\"reordered\":" << stream.reordered << ",\"duplicates\":" << stream.duplicates << "}\n";
+            }
+        } else {
+            std::cout << input << ": " << replay->Packets().size() << " packets, " << replayed << " replayed, "
+                      << decrypt_failures << " decrypt failures, " << rtp_dropped << " non-RTP, "
+                      << stats.other << " non-media\n";
+            for (const auto& [ssrc, stream] : stats.streams) {
+                std::cout << "  ssrc=0x" << std::hex << ssrc << std::dec << " from " << stream.source
+                          << " packets=" << stream.packets << " bytes=" << stream.bytes << " lost=" << stream.lost
+                          << " reordered=" << stream.reordered << " duplicates=" << stream.duplicates << "\n";
+            }
+        }
+    } catch (const std::exception& e) {
+        hcs_common::Logger::Instance().Flush();
+        std::cerr << "[CaptureReplay] Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,116 +1,1001 @@
 #include "HCSNode.h"
 #include <stdexcept>
 #include <algorithm>
+#include <csignal>
 #include <cstdint>
+#include <future>
+#include <tuple>
+#include <thread>
+#include <net/if.h>
+#include <pthread.h>
 
 // HCSNodeの実装に必要な具体的なトランスポートクラスと鍵プロバイダのインクルード
 #include "hcs_net/ControlUdpTransport.h"
+#include "hcs_net/SecureUdpMediaTransport.h"
+#if HCS_HAVE_NGTCP2
 #include "hcs_net/QuicNgTcp2Transport.h"
-#include "hcs_control/KeyProvider.h"
+#endif
+#include "hcs_net/PBKDF2KeyProvider.h"
+#include "hcs_net/ControlPiggyback.h"
+#include "hcs_control/ControlMessages.h"
+#include "hcs_control/SubscriptionTable.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/PipelineLatency.h"
+#include "hcs_common/Tracing.h"
 
-// 制御メッセージタイプ定義（簡易プロトコル）
-// 実際にはProtocol Buffersなどを使用してデシリアライズを行う
-#define MSG_TYPE_ADVERTISE 1
-#define MSG_TYPE_HEARTBEAT 2
+// 制御メッセージタイプ (MSG_TYPE_*) と ADVERTISE の形式は hcs_control/ControlMessages.h で定義する
+
+// ADVERTISE を送る間隔 (制御ティックの整数倍に丸める。起動後最初のティックで1回目を送る)
+constexpr std::chrono::milliseconds ADVERTISE_INTERVAL{1000};
+// ADVERTISE で通知する帯域スコア (帯域を計測するまでは全ノードで同じ値とし、深さと RTT で親を選ばせる)
+constexpr int ADVERTISE_BANDWIDTH_SCORE = 50;
+// 安定性スコアが上限 (100) に達する稼働時間
+constexpr std::chrono::seconds STABILITY_FULL_UPTIME{3600};
+// 子ノードへ HEARTBEAT を送る間隔 (制御ティックの整数倍に丸める。メディア送信中は相乗りする)
+constexpr std::chrono::milliseconds HEARTBEAT_INTERVAL{500};
+// 停止時に送信中のパケット数を確認する間隔
+constexpr std::chrono::milliseconds EGRESS_DRAIN_POLL{1};
+// 停止時に子ノードの切り替えを確認する間隔と、停止の予告を再送する間隔
+constexpr std::chrono::milliseconds HANDOFF_POLL{5};
+constexpr std::chrono::milliseconds DEPARTURE_RESEND_INTERVAL{100};
+// 停止の予告で推奨する代わりの親の最大数
+constexpr size_t MAX_RECOMMENDED_PARENTS = 3;
+// 子として新しい親へ JOIN してから、受信を確認できなくても旧い親へ LEAVE を送るまでの時間
+constexpr std::chrono::milliseconds HANDOFF_CONFIRM_TIMEOUT{500};
+// 選定中の親へ JOIN を再送する間隔 (JOIN は UDP で送るため、喪失しても購読が成立するようにする)
+constexpr std::chrono::milliseconds JOIN_REFRESH_INTERVAL{2000};
+// 中継時のレイヤー番号 (RTP にレイヤーの識別子がまだないため、全パケットを基本レイヤーとして扱う)
+constexpr uint8_t RELAY_BASE_LAYER = 0;
+
+namespace {
+
+/**
+ * @brief 処理中の制御メッセージの受信時刻 (トランスポートがカーネルの時刻を設定していればその時刻)。
+ */
+int64_t ReceivedNs() {
+    const hcs_common::PacketTiming* timing = hcs_common::ScopedPacketTiming::Current();
+    return timing && timing->received_ns != 0 ? timing->received_ns : hcs_common::PipelineLatency::NowNs();
+}
+
+/**
+ * @brief 設定のマルチキャストスコープを ControlUdpTransport の値に変換する (値は検証済み)。
+ */
+hcs_net::MulticastScope ToMulticastScope(const std::string& scope) {
+    if (scope == "site") return hcs_net::MulticastScope::kSiteLocal;
+    if (scope == "organization") return hcs_net::MulticastScope::kOrganizationLocal;
+    return hcs_net::MulticastScope::kLinkLocal;
+}
+
+hcs_net::SocketTimestampMode ToTimestampMode(const std::string& mode) {
+    if (mode == "off") return hcs_net::SocketTimestampMode::kOff;
+    if (mode == "hardware") return hcs_net::SocketTimestampMode::kHardware;
+    return hcs_net::SocketTimestampMode::kSoftware;
+}
+
+} // namespace
 
 namespace hcs {
 
-HCSNode::HCSNode(boost::asio::io_context& io_context, unsigned short media_port, unsigned short control_port)
-    : io_context_(io_context), 
-      media_port_(media_port), 
-      control_port_(control_port)
+HCSNode::HCSNode(boost::asio::io_context& io_context, std::shared_ptr<hcs_common::NodeConfigStore> config)
+    : io_context_(io_context),
+      config_(std::move(config)),
+      drain_timer_(io_context),
+      control_tick_timer_(io_context)
 {
-    std::cout << "--- HCSNode Initialization ---\n";
+    // 設定は起動時に検証済みで以降変わらないため、各コンポーネントはここで一度だけ構成する
+    // (ソケットを持つトランスポートとデータパスは Start() のたびに作り直す)
+    const hcs_common::NodeConfig& cfg = config_->Config();
+    self_node_id_ = cfg.node_id;
+    HCS_LOG_INFO("HCSNode", "HCSNode Initialization: ID={}", self_node_id_);
+    for (auto& component_state : component_states_) component_state.store(LifecycleState::kStopped);
 
     // 1. 制御層 (TopologyManager) の初期化
-    topology_manager_ = std::make_unique<hcs_control::TopologyManager>();
-    
-    // 鍵プロバイダのインスタンス化 (トランスポート層の暗号化に必要)
-    std::shared_ptr<hcs_control::KeyProvider> key_provider = std::make_shared<hcs_control::KeyProvider>();
-
-    // 2. データパス層 (Encoder/Decoder) の初期化
-    stream_encoder_ = std::make_shared<hcs_media::StreamEncoder>();
-    stream_decoder_ = std::make_shared<hcs_media::StreamDecoder>();
-
-    // 3. トランスポート層の初期化
-    // Media Transport: IMediaTransportインターフェースをQuicNgTcp2Transportで実現 (セキュアUDP)
-    // "127.0.0.1"はローカルアドレスのプレースホルダー
-    media_transport_ = std::make_shared<hcs_net::QuicNgTcp2Transport>(
-        io_context_, 
-        key_provider, 
-        "127.0.0.1", 
-        media_port_
+    // 自ノードのアドレスはピアの経路 (パスベクトル) に現れる表記と揃え、ループ検出に用いる
+    const hcs_net::Endpoint self(cfg.node_address.empty() ? cfg.transport.address : cfg.node_address, 0);
+    topology_manager_ = std::make_unique<hcs_control::TopologyManager>(self.Address());
+    topology_manager_->SetBootstrapTimeout(static_cast<int>(cfg.timeouts.bootstrap_failover.count()));
+    for (const auto& gid : cfg.groups.source) topology_manager_->AddSourceGroup(gid);
+    subscription_table_ = std::make_shared<hcs_control::SubscriptionTable>();
+    joined_groups_.insert(cfg.groups.join.begin(), cfg.groups.join.end());
+
+    // 2. 小さな制御メッセージはメディアパケットに相乗りさせ、期限内に送信がなければ制御トランスポートで送る
+    control_piggyback_ = std::make_shared<hcs_net::ControlPiggyback>(
+        io_context_,
+        [this](const std::vector<uint8_t>& message, const hcs_net::Endpoint& dest) {
+            if (control_transport_) control_transport_->AsyncSendTo(message, dest);
+        }
     );
-    
-    // Control Transport: IControlTransportインターフェースをControlUdpTransportで実現 (シンプルなUDP)
-    control_transport_ = std::make_shared<hcs_net::ControlUdpTransport>(
-        io_context_, 
-        control_port_
+    // 中継先では暗号文ごと上流の相乗りも届くため、載せたノードのアドレスを添えて自ノード宛てと区別させる
+    control_piggyback_->SetOrigin(self);
+    // 相乗りした制御メッセージは、単独の制御データグラムと同じルーティングで処理する
+    control_piggyback_->SetControlHandler(
+        [this](const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint) {
+            this->RouteControlMessage(message, sender_endpoint);
+        }
     );
 
-    std::cout << "Node configured for Media Port: " << media_port_
-              << ", Control Port: " << control_port_ << std::endl;
+    // 診断用のキャプチャ (設定で有効にした場合のみ。メトリクスのエクスポータは Start() で開く)
+    if (!cfg.diagnostics.capture_dir.empty()) {
+        hcs_net::CaptureConfig capture;
+        capture.directory = cfg.diagnostics.capture_dir;
+        capture.ring_packets = cfg.pools.capture_ring_packets;
+        EnableCapture(capture);
+    }
+
+    // 調整値は再読み込みのたびに I/O スレッドで反映する
+    ApplyTunables(config_->Tunables());
+    config_->OnReload([this](const hcs_common::NodeTunables& tunables) {
+        boost::asio::post(io_context_, [this, tunables]() { ApplyTunables(tunables); });
+    });
+
+    HCS_LOG_INFO("HCSNode", "Node configured for Media ({}): [{}]:{}, Control Port: {}", cfg.transport.media_backend,
+                 cfg.transport.address, cfg.transport.media_port, cfg.transport.control_port);
+}
+
+HCSNode::~HCSNode() {
+    // ドレインを経ずに破棄された場合もソケットとシグナルの待ち受けは確実に閉じる
+    CloseAll();
 }
 
 void HCSNode::Start() {
-    std::cout << "\n--- HCSNode Start Sequence ---\n";
+    const LifecycleState current = State();
+    if (current != LifecycleState::kStopped && current != LifecycleState::kFailed) {
+        throw std::logic_error(std::string("[HCSNode] Start() called while ") + StateName(current));
+    }
 
-    // 1. 制御層の起動
-    topology_manager_->Start();
-    std::cout << "Topology Manager started.\n";
+    // 起動手順の各段を区間として記録し、タイムライン上で順序と所要時間を確認できるようにする
+    HCS_TRACE_SPAN("node", "node.start");
+    HCS_LOG_INFO("HCSNode", "HCSNode Start Sequence");
+    const auto started = std::chrono::steady_clock::now();
+    const hcs_common::NodeConfig& cfg = config_->Config();
+    SetState(LifecycleState::kStarting);
+    joined_parents_.clear(); // 再起動後は最初の制御ティックで選定中の親へ JOIN し直す
 
-    // 2. メディア・トランスポートの起動とデコーダへの接続
-    // StreamDecoderはIMediaTransportに自身のHandleRtpPacketを登録し、受信パスを設定する
-    stream_decoder_->StartDecoding(media_transport_);
-    std::cout << "Media Decoder successfully connected to Media Transport's receive path.\n";
+    NodeComponent stage = NodeComponent::kKeyProvider;
+    long long key_ms = 0;
+    try {
+        // 1. 鍵の導出。PBKDF2 は起動時間の大半を占めるため、ワーカースレッドで 2〜3 と並行させる
+        // (鍵の設定は再読み込みされないため、同じプロセスでの再起動では導出済みの鍵を使い回す)
+        SetComponentState(NodeComponent::kKeyProvider, LifecycleState::kStarting);
+        std::future<std::pair<std::shared_ptr<hcs_net::KeyProvider>, long long>> key_future;
+        if (!key_provider_) {
+            key_future = std::async(std::launch::async, [&cfg]() {
+                HCS_TRACE_SPAN("node", "node.start.key_provider");
+                const auto begin = std::chrono::steady_clock::now();
+                std::shared_ptr<hcs_net::KeyProvider> provider =
+                    std::make_shared<hcs_net::PBKDF2KeyProvider>(cfg.crypto.passphrase, cfg.crypto.salt);
+                const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - begin);
+                return std::make_pair(std::move(provider), static_cast<long long>(elapsed.count()));
+            });
+        }
 
-    // 3. 制御・トランスポートの起動とメッセージハンドラへの接続
-    // Control Transportは受信したパケットをHCSNodeのHandleControlMessageに渡す
-    control_transport_->StartReceive(
-        [this](const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint) {
-            this->HandleControlMessage(message, sender_endpoint);
+        // 2. 制御層の起動 (鍵に依存しない)
+        stage = NodeComponent::kTopology;
+        SetComponentState(stage, LifecycleState::kStarting);
+        {
+            HCS_TRACE_SPAN("node", "node.start.topology_manager");
+            topology_manager_->Start();
+            ScheduleControlTick();
         }
-    );
-    std::cout << "Control Transport started and connected to Control Message Handler.\n";
+        SetComponentState(stage, LifecycleState::kRunning);
 
-    // 4. エンコーダのトランスポート設定（送信パスの確立）
-    // StreamEncoderは送信時にmedia_transport_を利用する
-    stream_encoder_->SetTransport(media_transport_);
-    std::cout << "Media Encoder successfully linked to Media Transport for sending.\n";
+        // Control Transportは受信したパケットをHCSNodeのHandleControlMessageに渡す
+        stage = NodeComponent::kControlTransport;
+        SetComponentState(stage, LifecycleState::kStarting);
+        {
+            HCS_TRACE_SPAN("node", "node.start.control_transport");
+            control_transport_ = CreateControlTransport();
+            control_transport_->StartReceive(
+                [this](const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint) {
+                    this->HandleControlMessage(message, sender_endpoint);
+                }
+            );
+            // 参加中のグループのディスカバリに (再起動時は再度) 参加する
+            for (const auto& gid : joined_groups_) {
+                control_transport_->JoinGroup(gid);
+                HCS_LOG_INFO("HCSNode", "Joined multicast discovery for group {}.", gid);
+            }
+        }
+        SetComponentState(stage, LifecycleState::kRunning);
 
-    // TODO: 初期ADVERTISEメッセージの送信ロジックを開始
-    
-    std::cout << "HCSNode is fully operational, waiting for I/O events.\n";
+        // 3. 診断 (メトリクスのエクスポータ、SIGHUP による再読み込み、SIGUSR2 によるキャプチャの出力)
+        stage = NodeComponent::kDiagnostics;
+        SetComponentState(stage, LifecycleState::kStarting);
+        if (cfg.diagnostics.metrics_port != 0) StartMetricsExporter(cfg.diagnostics.metrics_port);
+        reload_signals_ = std::make_unique<boost::asio::signal_set>(io_context_, SIGHUP);
+        WaitReloadSignal();
+        if (packet_capture_) {
+            capture_signals_ = std::make_unique<boost::asio::signal_set>(io_context_, SIGUSR2);
+            WaitCaptureSignal();
+        }
+        SetComponentState(stage, LifecycleState::kRunning);
+
+        // 4. メディア・トランスポートの起動 (ここで鍵の導出を待つ)
+        stage = NodeComponent::kKeyProvider;
+        if (key_future.valid()) std::tie(key_provider_, key_ms) = key_future.get();
+        SetComponentState(stage, LifecycleState::kRunning);
+
+        stage = NodeComponent::kMediaTransport;
+        SetComponentState(stage, LifecycleState::kStarting);
+        {
+            HCS_TRACE_SPAN("node", "node.start.media_transport");
+            media_transport_ = CreateMediaTransport(key_provider_);
+        }
+
+        // 5. デコーダへの接続。StreamDecoderはIMediaTransportに受信ハンドラを登録し、受信パスを設定する
+        stage = NodeComponent::kDecoder;
+        SetComponentState(stage, LifecycleState::kStarting);
+        {
+            HCS_TRACE_SPAN("node", "node.start.decoder");
+            // 認証済みのパケットは復号結果をデコーダへ渡す前に、暗号文のまま子ノードへ中継する
+            media_transport_->SetRelayHandler(
+                [this](const hcs_common::PacketRef& wire, const hcs_common::PacketBuffer&, const hcs_net::Endpoint& sender) {
+                    RelayFromParent(wire, sender);
+                }
+            );
+            // 中継の経路と子ノードが揃うまでは暗号文を残さない (UpdateRelayActive で切り替える)
+            media_transport_->SetRelayActive(false);
+            stream_decoder_ = std::make_shared<hcs_media::StreamDecoder>();
+            stream_decoder_->SetControlExtractor(
+                [this, piggyback = control_piggyback_](hcs_common::PacketBuffer& rtp_packet, const hcs_net::Endpoint& sender) {
+                    piggyback->ExtractFrom(rtp_packet, sender);
+                    // 親からのメディアの到着を生存判定に用いる (HEARTBEAT より短い間隔で障害を検出できる)
+                    RecordMediaActivity(sender);
+                    // 親の計画停止中は、新しい親からの最初のメディアで切り替えを確定する
+                    if (handoff_pending_.load(std::memory_order_acquire)) ConfirmHandoffs(sender.Address());
+                }
+            );
+            stream_decoder_->SetPayloadHandler(media_handler_);
+            stream_decoder_->StartDecoding(media_transport_);
+        }
+        SetComponentState(NodeComponent::kMediaTransport, LifecycleState::kRunning);
+        SetComponentState(stage, LifecycleState::kRunning);
+
+        // 6. エンコーダのトランスポート設定（送信パスの確立）
+        stage = NodeComponent::kEncoder;
+        SetComponentState(stage, LifecycleState::kStarting);
+        {
+            HCS_TRACE_SPAN("node", "node.start.encoder");
+            stream_encoder_ = std::make_shared<hcs_media::StreamEncoder>(io_context_);
+            stream_encoder_->SetFrameInterval(cfg.timeouts.frame_interval);
+            stream_encoder_->SetTransport(media_transport_);
+            stream_encoder_->SetControlPiggyback(control_piggyback_);
+            // 送信元のグループがあれば、エンコーダの出力をそのグループの購読者へ送る
+            source_slots_.clear();
+            for (const auto& gid : cfg.groups.source) {
+                const int slot = subscription_table_->RegisterGroup(gid);
+                if (slot >= 0) source_slots_.push_back(slot);
+            }
+            if (!source_slots_.empty()) {
+                stream_encoder_->SetPacketSink([this](hcs_common::PacketRef packet) {
+                    PublishToSubscribers(std::move(packet));
+                });
+                stream_encoder_->StartPublishing();
+            }
+        }
+        SetComponentState(stage, LifecycleState::kRunning);
+    } catch (const std::exception& e) {
+        // 起動済みのコンポーネントを閉じ、同じポートで直ちに再試行できる状態に戻す
+        HCS_LOG_ERROR("HCSNode", "Failed to start {}: {}", ComponentName(stage), e.what());
+        CloseAll();
+        SetComponentState(stage, LifecycleState::kFailed);
+        SetState(LifecycleState::kFailed);
+        throw;
+    }
+
+    // 最初の ADVERTISE は次の制御ティックで送る
+    running_since_ = std::chrono::steady_clock::now();
+    accepting_.store(true, std::memory_order_release);
+    SetState(LifecycleState::kRunning);
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    NodeLifecycleMetrics::Get().start_duration_ms.Set(elapsed.count());
+    HCS_LOG_INFO("HCSNode", "HCSNode is fully operational in {} ms (key derivation {} ms, overlapped with control plane startup).",
+                 elapsed.count(), key_ms);
 }
 
-void HCSNode::Stop() {
-    std::cout << "\n--- HCSNode Stop Sequence ---\n";
-    
-    // 1. 各トランスポート層の停止 (ソケットを閉じる)
-    if (media_transport_) media_transport_->Stop();
-    if (control_transport_) control_transport_->Stop();
+void HCSNode::Stop(std::function<void()> on_stopped) {
+    // 全段を I/O スレッドで進める (送信完了のハンドラと同じスレッドで送信中の数を確認するため)
+    boost::asio::dispatch(io_context_, [this, on_stopped = std::move(on_stopped)]() mutable {
+        const LifecycleState current = State();
+        if (current == LifecycleState::kDraining) {
+            // 停止中に再度呼ばれた場合は、進行中のドレインの完了を待つ
+            auto previous = std::move(on_stopped_);
+            on_stopped_ = [previous = std::move(previous), on_stopped = std::move(on_stopped)]() {
+                if (previous) previous();
+                if (on_stopped) on_stopped();
+            };
+            return;
+        }
+        if (current != LifecycleState::kRunning) {
+            if (on_stopped) on_stopped();
+            return;
+        }
+
+        HCS_TRACE_INSTANT("node", "node.drain");
+        const hcs_common::NodeConfig& cfg = config_->Config();
+        HCS_LOG_INFO("HCSNode", "HCSNode Stop Sequence (handoff up to {} ms, drain up to {} ms)",
+                     cfg.timeouts.handoff.count(), cfg.timeouts.drain.count());
+        SetState(LifecycleState::kDraining);
+        drain_started_ = std::chrono::steady_clock::now();
+        on_stopped_ = std::move(on_stopped);
+
+        // 0. 新規の JOIN を拒否し、子ノードへ停止を予告する。切り替えが済むまで中継と制御ループは続ける
+        accepting_.store(false, std::memory_order_release);
+        if (cfg.timeouts.handoff.count() > 0 && !subscription_table_->ActiveGroups().empty()) {
+            handoff_active_ = true;
+            handoff_deadline_ = drain_started_ + cfg.timeouts.handoff;
+            SendDepartures();
+            CheckHandoff();
+            return;
+        }
+        DrainEgress();
+    });
+}
+
+void HCSNode::SendDepartures() {
+    for (const auto& [gid, children] : subscription_table_->ActiveGroups()) {
+        // 自ノードの親を先頭に推奨する (子ノードから見て深さが1つ浅くなるだけで、経路は自ノードの上流と同じ)
+        const std::vector<std::string> recommended = topology_manager_->RecommendReplacements(gid, MAX_RECOMMENDED_PARENTS);
+        const std::vector<uint8_t> departing = hcs_control::EncodeDeparting(gid, recommended);
+        // 子ノードの購読はメディアポートで登録されているため、JOIN の送信元の制御ポートへ送る
+        for (const auto& sub : children) control_transport_->AsyncSendTo(departing, sub.ControlEndpoint());
+    }
+    control_transport_->Flush();
+    last_departure_sent_ = std::chrono::steady_clock::now();
+}
+
+void HCSNode::CheckHandoff() {
+    if (!handoff_active_) return;
+    if (subscription_table_->ActiveGroups().empty()) {
+        FinishHandoff();
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= handoff_deadline_) {
+        size_t remaining = 0;
+        for (const auto& [gid, children] : subscription_table_->ActiveGroups()) remaining += children.size();
+        NodeLifecycleMetrics::Get().handoff_unconfirmed.Add(remaining);
+        HCS_LOG_WARN("HCSNode", "Handoff timeout reached with {} child subscriptions unconfirmed.", remaining);
+        FinishHandoff();
+        return;
+    }
+    // 予告は UDP で送るため、切り替えを確認できない子ノードへは定期的に再送する
+    if (now - last_departure_sent_ >= DEPARTURE_RESEND_INTERVAL) SendDepartures();
+
+    drain_timer_.expires_after(HANDOFF_POLL);
+    drain_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec) return; // FinishHandoff() または CloseAll() によるキャンセル
+        CheckHandoff();
+    });
+}
+
+void HCSNode::FinishHandoff() {
+    handoff_active_ = false;
+    drain_timer_.cancel();
+    const auto handoff_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - drain_started_).count();
+    NodeLifecycleMetrics::Get().handoff_duration_ms.Set(handoff_ms);
+    HCS_LOG_INFO("HCSNode", "Handoff to new parents finished in {} ms.", handoff_ms);
+    // キャンセルしたタイマーのハンドラより後に、次の段へ進む
+    boost::asio::post(io_context_, [this]() { DrainEgress(); });
+}
+
+void HCSNode::DrainEgress() {
+    // 1. 受け付けの停止: フレームの生成とデコーダへの投入を止める
+    control_tick_timer_.cancel();
+    stream_encoder_->Stop();
+    SetComponentState(NodeComponent::kEncoder, LifecycleState::kStopped);
+    stream_decoder_->Stop();
+    SetComponentState(NodeComponent::kDecoder, LifecycleState::kStopped);
+    SetComponentState(NodeComponent::kTopology, LifecycleState::kStopped);
+    SetComponentState(NodeComponent::kMediaTransport, LifecycleState::kDraining);
+    SetComponentState(NodeComponent::kControlTransport, LifecycleState::kDraining);
+
+    // 2. 送信キューの送出: 相乗り待ちの制御メッセージを単独で送る
+    control_piggyback_->FlushAll();
+
+    // 3. 親へ LEAVE を送り、まとめ送りのキューと合わせて即時に送出する
+    SendLeaveToParents();
+    control_transport_->Flush();
+
+    // 4. 送信中のパケットが無くなってからソケットを閉じる
+    egress_started_ = std::chrono::steady_clock::now();
+    WaitForEgressDrain();
+}
+
+void HCSNode::HandleParentDeparture(const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint) {
+    std::string group_id;
+    std::vector<std::string> recommended;
+    if (!hcs_control::DecodeDeparting(message, group_id, recommended)) {
+        HCS_LOG_WARN_EVERY("Router", "Malformed DEPARTING from {}", sender_endpoint);
+        return;
+    }
+    {
+        // 予告の再送: 新しい親からの受信の確認を待っている
+        std::lock_guard<std::mutex> lock(handoff_mutex_);
+        auto it = pending_handoffs_.find(group_id);
+        if (it != pending_handoffs_.end() && it->second.old_parent == sender_endpoint) return;
+    }
+
+    const std::string parent = sender_endpoint.Address();
+    const hcs_control::ParentHandoff handoff = topology_manager_->HandleParentDeparture(parent, group_id, recommended);
+    if (handoff.new_parent.empty()) {
+        // 代わりがない場合は LEAVE を返さず、親が停止するまで受信を続ける (以降は障害検出による切り替え)
+        return;
+    }
+    if (handoff.receiving) {
+        // 新しい親から既に受信しているため、直ちに切り替えを確定する (予告の再送に対しては LEAVE の再送になる)
+        control_transport_->AsyncSendTo(
+            hcs_control::EncodeLeave(config_->Config().transport.media_port, group_id), sender_endpoint);
+        joined_parents_[group_id].erase(parent);
+        return;
+    }
+
+    // 新しい親へ JOIN し、そこからメディアが届くまでは停止する親からも受信を続ける (make-before-break)
+    SendJoin(handoff.new_parent, group_id);
+    joined_parents_[group_id].insert(handoff.new_parent);
+    {
+        std::lock_guard<std::mutex> lock(handoff_mutex_);
+        pending_handoffs_[group_id] = PendingHandoff{sender_endpoint, handoff.new_parent,
+                                                     std::chrono::steady_clock::now() + HANDOFF_CONFIRM_TIMEOUT};
+        handoff_pending_.store(true, std::memory_order_release);
+    }
+    // 新しい親から届くメディアも、次の制御ティックを待たずに子ノードへ中継する
+    UpdateRelayRoutes();
+    // 両方の親から届く同じパケットは重複排除で1つにする
+    if (auto media = std::dynamic_pointer_cast<hcs_net::SecureUdpMediaTransport>(media_transport_)) {
+        media->EnableDuplicateFilter(true);
+    }
+    HCS_LOG_INFO("HCSNode", "Parent {} of group {} is departing; joined {}.", parent, group_id, handoff.new_parent);
+}
+
+void HCSNode::SendJoin(const std::string& parent_ip, const std::string& group_id) {
+    const hcs_common::NodeConfig& cfg = config_->Config();
+    hcs_net::Endpoint dest;
+    if (!hcs_net::Endpoint::Parse(parent_ip, cfg.transport.control_port, dest)) return;
+    control_transport_->AsyncSendTo(
+        hcs_control::EncodeJoin(cfg.transport.media_port, hcs_control::ALL_LAYERS, group_id), dest);
+}
+
+void HCSNode::SendLeave(const std::string& parent_ip, const std::string& group_id) {
+    const hcs_common::NodeConfig& cfg = config_->Config();
+    hcs_net::Endpoint dest;
+    if (!hcs_net::Endpoint::Parse(parent_ip, cfg.transport.control_port, dest)) return;
+    control_transport_->AsyncSendTo(hcs_control::EncodeLeave(cfg.transport.media_port, group_id), dest);
+}
+
+void HCSNode::ReconcileParents(bool refresh) {
+    // LeaveGroup で離脱したグループは、JOIN を送った全ての親へ LEAVE を送る
+    for (auto it = joined_parents_.begin(); it != joined_parents_.end();) {
+        if (joined_groups_.count(it->first)) {
+            ++it;
+            continue;
+        }
+        for (const auto& parent : it->second) SendLeave(parent, it->first);
+        it = joined_parents_.erase(it);
+    }
+
+    std::set<std::string> handing_off;
+    if (handoff_pending_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(handoff_mutex_);
+        for (const auto& [gid, handoff] : pending_handoffs_) handing_off.insert(gid);
+    }
+    for (const auto& gid : joined_groups_) {
+        if (handing_off.count(gid)) continue;
+        // 冗長配信中はセカンダリ親からも受信する
+        std::set<std::string> selected;
+        for (const std::string& parent : {topology_manager_->SelectBestParent(gid),
+                                          topology_manager_->SelectSecondaryParent(gid)}) {
+            if (!parent.empty()) selected.insert(parent);
+        }
+        std::set<std::string>& joined = joined_parents_[gid];
+        for (const auto& parent : joined) {
+            if (selected.count(parent)) continue;
+            SendLeave(parent, gid);
+            HCS_LOG_INFO("HCSNode", "Sent LEAVE for group {} to former parent {}.", gid, parent);
+        }
+        for (const auto& parent : selected) {
+            if (!joined.count(parent)) {
+                HCS_LOG_INFO("HCSNode", "Sent JOIN for group {} to parent {}.", gid, parent);
+            } else if (!refresh) {
+                continue;
+            }
+            SendJoin(parent, gid);
+        }
+        joined = std::move(selected);
+    }
+}
+
+void HCSNode::ConfirmHandoffs(const std::string& media_sender) {
+    std::vector<std::pair<std::string, hcs_net::Endpoint>> confirmed;
+    bool drained = false;
+    {
+        std::lock_guard<std::mutex> lock(handoff_mutex_);
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = pending_handoffs_.begin(); it != pending_handoffs_.end();) {
+            const bool received = !media_sender.empty() && it->second.new_parent == media_sender;
+            if (received || (media_sender.empty() && now >= it->second.deadline)) {
+                if (!received) {
+                    HCS_LOG_WARN("HCSNode", "No media from new parent {} of group {} yet; leaving the old parent anyway.",
+                                 it->second.new_parent, it->first);
+                }
+                confirmed.emplace_back(it->first, it->second.old_parent);
+                it = pending_handoffs_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        drained = pending_handoffs_.empty();
+        handoff_pending_.store(!drained, std::memory_order_release);
+    }
+    if (confirmed.empty()) return;
 
-    // 2. データパス層の停止 (FFmpegリソースの解放など)
+    // LEAVE が停止する親への切り替えの確認となる (親は全ての子から LEAVE を受けてから停止する)
+    boost::asio::post(io_context_, [this, confirmed = std::move(confirmed), drained]() {
+        const uint16_t media_port = config_->Config().transport.media_port;
+        for (const auto& [gid, old_parent] : confirmed) {
+            control_transport_->AsyncSendTo(hcs_control::EncodeLeave(media_port, gid), old_parent);
+            joined_parents_[gid].erase(old_parent.Address());
+            HCS_LOG_INFO("HCSNode", "Handoff of group {} confirmed; sent LEAVE to {}.", gid, old_parent);
+        }
+        if (drained) {
+            if (auto media = std::dynamic_pointer_cast<hcs_net::SecureUdpMediaTransport>(media_transport_)) {
+                media->EnableDuplicateFilter(config_->Tunables().redundant);
+            }
+        }
+    });
+}
+
+void HCSNode::SendLeaveToParents() {
+    // 冗長配信中のセカンダリ親や切り替え中の新旧の親を含め、JOIN を送った全ての親へ LEAVE を送る
+    for (const auto& [gid, parents] : joined_parents_) {
+        for (const auto& parent : parents) {
+            SendLeave(parent, gid);
+            HCS_LOG_INFO("HCSNode", "Sent LEAVE for group {} to parent {}.", gid, parent);
+        }
+    }
+    joined_parents_.clear();
+}
+
+void HCSNode::WaitForEgressDrain() {
+    const size_t pending = media_transport_->PendingSends() + control_transport_->PendingSends();
+    const auto elapsed = std::chrono::steady_clock::now() - egress_started_;
+    if (pending > 0 && elapsed < config_->Config().timeouts.drain) {
+        drain_timer_.expires_after(EGRESS_DRAIN_POLL);
+        drain_timer_.async_wait([this](const boost::system::error_code& ec) {
+            if (ec) return; // CloseAll() によるキャンセル
+            WaitForEgressDrain();
+        });
+        return;
+    }
+    if (pending > 0) {
+        NodeLifecycleMetrics::Get().drain_timeouts.Add();
+        HCS_LOG_WARN("HCSNode", "Drain timeout reached with {} sends pending; closing sockets.", pending);
+    }
+
+    CloseAll();
+    const auto drain_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - drain_started_).count();
+    NodeLifecycleMetrics::Get().drain_duration_ms.Set(drain_ms);
+    HCS_LOG_INFO("HCSNode", "HCSNode components stopped and resources released in {} ms.", drain_ms);
+    hcs_common::Logger::Instance().Flush();
+    SetState(LifecycleState::kStopped);
+
+    auto on_stopped = std::move(on_stopped_);
+    on_stopped_ = nullptr;
+    if (on_stopped) on_stopped();
+}
+
+void HCSNode::CloseAll() {
+    HCS_TRACE_SPAN("node", "node.close");
+    accepting_.store(false, std::memory_order_release);
+    control_tick_timer_.cancel();
+    drain_timer_.cancel();
+    if (reload_signals_) {
+        boost::system::error_code ec;
+        reload_signals_->cancel(ec);
+    }
+    if (capture_signals_) {
+        boost::system::error_code ec;
+        capture_signals_->cancel(ec);
+    }
+    if (metrics_exporter_) metrics_exporter_->Stop();
+
+    // データパス層を止めてから、各トランスポート層のソケットを閉じる
     if (stream_encoder_) stream_encoder_->Stop();
     if (stream_decoder_) stream_decoder_->Stop();
-    
-    std::cout << "HCSNode components stopped and resources released.\n";
+    if (media_transport_) media_transport_->Stop();
+    if (control_transport_) control_transport_->Stop();
+
+    // 書き出し中のキャプチャを完了させてから終了する
+    if (packet_capture_) packet_capture_->Flush();
+
+    for (size_t i = 0; i < component_states_.size(); ++i) {
+        SetComponentState(static_cast<NodeComponent>(i), LifecycleState::kStopped);
+    }
 }
 
-void HCSNode::HandleControlMessage(const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint) {
-    // 制御メッセージの受信と初期ロギング
-    std::cout << "[ControlHandler] Received " << message.size() << " bytes from "
-              << sender_endpoint.address << ":" << sender_endpoint.port << std::endl;
+std::shared_ptr<hcs_net::IControlTransport> HCSNode::CreateControlTransport() const {
+    // Control Transport: IControlTransportインターフェースをControlUdpTransportで実現 (シンプルなUDP)
+    const hcs_common::NodeConfig& cfg = config_->Config();
+    auto control_transport = std::make_shared<hcs_net::ControlUdpTransport>(io_context_, cfg.transport.control_port);
+    control_transport->SetMulticastScope(ToMulticastScope(cfg.transport.multicast_scope), cfg.transport.multicast_hop_limit);
+    if (!cfg.transport.multicast_interface.empty()) {
+        const unsigned int if_index = if_nametoindex(cfg.transport.multicast_interface.c_str());
+        if (if_index == 0) {
+            throw std::runtime_error("[HCSNode] Unknown multicast interface: " + cfg.transport.multicast_interface);
+        }
+        control_transport->SetMulticastInterface(if_index);
+    }
+    control_transport->SetTimestampMode(ToTimestampMode(cfg.transport.timestamps));
+    control_transport->SetCoalescingDelay(config_->Tunables().control_coalescing);
+    return control_transport;
+}
+
+std::shared_ptr<hcs_net::IMediaTransport> HCSNode::CreateMediaTransport(
+    std::shared_ptr<hcs_net::KeyProvider> key_provider) const {
+    const hcs_common::NodeConfig& cfg = config_->Config();
+#if HCS_HAVE_NGTCP2
+    if (cfg.transport.media_backend == "quic") {
+        auto quic = std::make_shared<hcs_net::QuicNgTcp2Transport>(
+            io_context_, std::move(key_provider), cfg.transport.address, cfg.transport.media_port);
+        // 暗号化の前後のパケットを記録し、復号失敗が続いた場合はトランスポートが出力を要求する
+        if (packet_capture_) quic->SetCapture(packet_capture_);
+        return quic;
+    }
+#endif
+    // Media Transport: IMediaTransportインターフェースをSecureUdpMediaTransportで実現 (AES-256-GCM の UDP)
+    auto udp = std::make_shared<hcs_net::SecureUdpMediaTransport>(
+        io_context_, std::move(key_provider), cfg.transport.address, cfg.transport.media_port);
+    udp->SetTimestampMode(ToTimestampMode(cfg.transport.timestamps));
+    udp->EnableDuplicateFilter(config_->Tunables().redundant);
+    if (packet_capture_) udp->SetCapture(packet_capture_);
+    return udp;
+}
+
+void HCSNode::SetState(LifecycleState state) {
+    state_.store(state, std::memory_order_release);
+    NodeLifecycleMetrics::Get().state.Set(static_cast<int64_t>(state));
+}
+
+void HCSNode::SetComponentState(NodeComponent component, LifecycleState state) {
+    const LifecycleState previous = component_states_[static_cast<size_t>(component)].exchange(state);
+    if (previous == state) return;
+    HCS_LOG_DEBUG("HCSNode", "Component {}: {} -> {}", ComponentName(component), StateName(previous), StateName(state));
+}
+
+const char* HCSNode::StateName(LifecycleState state) {
+    switch (state) {
+        case LifecycleState::kStopped:  return "stopped";
+        case LifecycleState::kStarting: return "starting";
+        case LifecycleState::kRunning:  return "running";
+        case LifecycleState::kDraining: return "draining";
+        case LifecycleState::kFailed:   return "failed";
+    }
+    return "unknown";
+}
+
+const char* HCSNode::ComponentName(NodeComponent component) {
+    switch (component) {
+        case NodeComponent::kKeyProvider:      return "key_provider";
+        case NodeComponent::kTopology:         return "topology";
+        case NodeComponent::kControlTransport: return "control_transport";
+        case NodeComponent::kDiagnostics:      return "diagnostics";
+        case NodeComponent::kMediaTransport:   return "media_transport";
+        case NodeComponent::kDecoder:          return "decoder";
+        case NodeComponent::kEncoder:          return "encoder";
+        case NodeComponent::kCount:            break;
+    }
+    return "unknown";
+}
+
+void HCSNode::SendHeartbeat(const hcs_net::Endpoint& child, const std::string& group_id) {
+    // 子ノードへメディアを送信中であれば次のRTPパケットに相乗りし、単独の制御データグラムは発生しない
+    std::vector<uint8_t> heartbeat(1 + group_id.size());
+    heartbeat[0] = MSG_TYPE_HEARTBEAT;
+    std::copy(group_id.begin(), group_id.end(), heartbeat.begin() + 1);
+    control_piggyback_->Submit(heartbeat, child, config_->Tunables().heartbeat_piggyback);
+}
+
+void HCSNode::SendHeartbeats() {
+    // 子ノードの購読はメディアポートで登録されているため、相乗りできない場合は JOIN の送信元の制御ポートへ送る
+    for (const auto& [gid, children] : subscription_table_->ActiveGroups()) {
+        for (const auto& sub : children) SendHeartbeat(sub.ControlEndpoint(), gid);
+    }
+}
+
+void HCSNode::RecordMediaActivity(const hcs_net::Endpoint& sender) {
+    // ピアはアドレスの文字列で管理されるため、送信元が前のパケットと同じであれば変換を省く
+    if (media_activity_ip_.empty() || !sender.SameHost(media_activity_sender_)) {
+        media_activity_sender_ = sender;
+        media_activity_ip_ = sender.Address();
+    }
+    topology_manager_->HandleMediaActivity(media_activity_ip_);
+}
+
+void HCSNode::JoinGroup(const std::string& group_id) {
+    // グループ専用のマルチキャストアドレスに join することで、無関係なグループのADVERTISEはNICで破棄される
+    if (!joined_groups_.insert(group_id).second) return;
+    if (ComponentState(NodeComponent::kControlTransport) != LifecycleState::kRunning) return; // Start() で参加する
+    control_transport_->JoinGroup(group_id);
+    HCS_LOG_INFO("HCSNode", "Joined multicast discovery for group {}.", group_id);
+}
+
+void HCSNode::LeaveGroup(const std::string& group_id) {
+    if (joined_groups_.erase(group_id) == 0) return;
+    if (ComponentState(NodeComponent::kControlTransport) != LifecycleState::kRunning) return;
+    control_transport_->LeaveGroup(group_id);
+    HCS_LOG_INFO("HCSNode", "Left multicast discovery for group {}.", group_id);
+}
+
+size_t HCSNode::SendToSubscribers(int group_slot, uint8_t layer, const hcs_common::PacketRef& wire) {
+    // スナップショットを1回だけ取得し、以降はロックなしで連続配列を走査する
+    const auto* subscribers = subscription_table_->Subscribers(group_slot);
+    if (!subscribers) return 0;
+    size_t sent = 0;
+    for (const auto& sub : subscribers->children) {
+        if (!sub.WantsLayer(layer)) continue;
+        // 暗号文の参照を共有して渡す (送信完了まで同じバッファを全ての宛先で使う)
+        media_transport_->SendRawPacket(wire, sub.endpoint);
+        ++sent;
+    }
+    return sent;
+}
+
+void HCSNode::RelayMediaPacket(int group_slot, uint8_t layer, const hcs_common::PacketRef& wire) {
+    const size_t relayed = SendToSubscribers(group_slot, layer, wire);
+    if (relayed > 0) NodeLifecycleMetrics::Get().relayed_packets.Add(relayed);
+}
+
+void HCSNode::PublishToSubscribers(hcs_common::PacketRef packet) {
+    // 暗号化は購読者がいる場合に一度だけ行う (代表の宛先はキャプチャの記録にのみ用いる)
+    const hcs_net::Endpoint* representative = nullptr;
+    for (const int slot : source_slots_) {
+        const auto* subscribers = subscription_table_->Subscribers(slot);
+        if (subscribers && !subscribers->children.empty()) {
+            representative = &subscribers->children.front().endpoint;
+            break;
+        }
+    }
+    if (!representative) return;
+    // 全ての購読者へ同じ暗号文を送るため、全員に共通する保留中の制御メッセージ (HEARTBEAT など) を暗号化の前に載せる
+    if (control_piggyback_->HasPending() && packet->Unique()) {
+        piggyback_dests_.clear();
+        for (const int slot : source_slots_) {
+            const auto* subscribers = subscription_table_->Subscribers(slot);
+            if (!subscribers) continue;
+            for (const auto& sub : subscribers->children) {
+                if (sub.WantsLayer(RELAY_BASE_LAYER)) piggyback_dests_.push_back(sub.endpoint);
+            }
+        }
+        control_piggyback_->AttachToAll(*packet, piggyback_dests_);
+    }
+    if (!media_transport_->SealPacket(packet, *representative)) return;
+
+    size_t published = 0;
+    for (const int slot : source_slots_) published += SendToSubscribers(slot, RELAY_BASE_LAYER, packet);
+    if (published > 0) NodeLifecycleMetrics::Get().published_packets.Add(published);
+}
+
+void HCSNode::PublishMedia(hcs_common::PacketRef packet) {
+    if (ComponentState(NodeComponent::kEncoder) != LifecycleState::kRunning) return;
+    PublishToSubscribers(std::move(packet));
+}
+
+void HCSNode::SetMediaHandler(hcs_media::StreamDecoder::PayloadHandler handler) {
+    media_handler_ = std::move(handler);
+}
+
+void HCSNode::RelayFromParent(const hcs_common::PacketRef& wire, const hcs_net::Endpoint& sender) {
+    // 同じ親から複数のグループを受信している場合は、それぞれのグループの購読者へ中継する
+    for (const auto& route : relay_routes_) {
+        if (route.parent.SameHost(sender)) RelayMediaPacket(route.slot, RELAY_BASE_LAYER, wire);
+    }
+}
 
+void HCSNode::UpdateRelayRoutes() {
+    std::vector<std::pair<std::string, std::string>> parents; // (GroupID, 親IP)
+    for (const auto& selection : topology_manager_->GetParentSelections()) {
+        if (!joined_groups_.count(selection.group_id)) continue;
+        parents.emplace_back(selection.group_id, selection.primary_ip);
+        parents.emplace_back(selection.group_id, selection.secondary_ip);
+    }
+    if (handoff_pending_.load(std::memory_order_acquire)) {
+        // 切り替え中は新旧の両方の親から受信しているため、どちらから届いても中継する
+        std::lock_guard<std::mutex> lock(handoff_mutex_);
+        for (const auto& [gid, handoff] : pending_handoffs_) {
+            parents.emplace_back(gid, handoff.new_parent);
+            parents.emplace_back(gid, handoff.old_parent.Address());
+        }
+    }
+
+    std::vector<RelayRoute> routes;
+    for (const auto& [gid, ip] : parents) {
+        RelayRoute route;
+        if (ip.empty() || !hcs_net::Endpoint::Parse(ip, 0, route.parent)) continue;
+        // 子ノードの JOIN より先にスロットを確保しておく (受信経路ではグループ名を引かない)
+        route.slot = subscription_table_->RegisterGroup(gid);
+        if (route.slot < 0) continue;
+        const bool duplicate = std::any_of(routes.begin(), routes.end(), [&route](const RelayRoute& r) {
+            return r.slot == route.slot && r.parent.SameHost(route.parent);
+        });
+        if (!duplicate) routes.push_back(route);
+    }
+    relay_routes_ = std::move(routes);
+    UpdateRelayActive();
+}
+
+void HCSNode::UpdateRelayActive() {
+    if (!media_transport_) return;
+    const bool active = std::any_of(relay_routes_.begin(), relay_routes_.end(), [this](const RelayRoute& route) {
+        return subscription_table_->Subscribers(route.slot) != nullptr;
+    });
+    media_transport_->SetRelayActive(active);
+}
+
+void HCSNode::StartMetricsExporter(uint16_t port) {
+    if (metrics_exporter_) metrics_exporter_->Stop();
+    metrics_exporter_ = std::make_shared<hcs_common::MetricsHttpExporter>(io_context_, port);
+    metrics_exporter_->Start();
+}
+
+void HCSNode::EnableTracing() {
+    hcs_common::Tracer::SetEnabled(true);
+    // I/O スレッドの行に名前を付ける (リングは I/O スレッド上で確保される)
+    boost::asio::post(io_context_, []() { hcs_common::Tracer::Instance().SetThreadName("hcs-io"); });
+    HCS_LOG_INFO("HCSNode", "Tracing enabled. Fetch /trace from the metrics exporter to export a Chrome trace.");
+}
+
+void HCSNode::EnableCapture(const hcs_net::CaptureConfig& config) {
+    // 暗号化の前後のパケットはメディアトランスポートが記録する (Start() で作成時に設定する)
+    packet_capture_ = std::make_shared<hcs_net::PacketCapture>(config);
+    packet_capture_->Enable();
+
+    // 親の切り替えは経路障害の兆候のため、切り替え直前のパケットを残す
+    topology_manager_->SetParentChangeHandler(
+        [capture = packet_capture_](const std::string& group_id, const std::string& old_parent, const std::string& new_parent) {
+            HCS_LOG_INFO("HCSNode", "Parent of group {} changed from {} to {}; dumping capture.",
+                         group_id, old_parent, new_parent);
+            capture->Trigger("parent-switch");
+        }
+    );
+
+    HCS_LOG_INFO("HCSNode", "Packet capture enabled ({} packets, output: {}). Send SIGUSR2 to dump.",
+                 config.ring_packets, config.directory);
+}
+
+void HCSNode::WaitCaptureSignal() {
+    capture_signals_->async_wait([this](const boost::system::error_code& ec, int) {
+        if (ec) return; // Stop() によるキャンセル
+        packet_capture_->Trigger("manual", true);
+        WaitCaptureSignal();
+    });
+}
+
+void HCSNode::Run() {
+    const hcs_common::NodeConfig& cfg = config_->Config();
+    auto run = [this, &cfg](size_t index) {
+        // 最初のパケットでプールを拡張しないよう、I/O スレッド自身のプールに事前確保する
+        hcs_common::PacketPool::Local().Reserve(cfg.pools.packet_buffers);
+        if (cfg.threads.pin_cpus) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+                HCS_LOG_WARN("HCSNode", "Failed to pin I/O thread {} to a CPU.", index);
+            }
+        }
+        io_context_.run();
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < cfg.threads.io_threads; ++i) threads.emplace_back(run, i);
+    run(0);
+    for (auto& thread : threads) thread.join();
+}
+
+void HCSNode::WaitReloadSignal() {
+    reload_signals_->async_wait([this](const boost::system::error_code& ec, int) {
+        if (ec) return; // Stop() によるキャンセル
+        // 失敗した場合は現在の設定のまま動作を続ける (詳細は NodeConfigStore がログに出す)
+        config_->Reload();
+        WaitReloadSignal();
+    });
+}
+
+void HCSNode::ApplyTunables(const hcs_common::NodeTunables& tunables) {
+    hcs_common::Logger::SetLevel(tunables.log_level);
+    hcs_common::Tracer::SetEnabled(tunables.tracing);
+
+    hcs_control::PhiAccrualConfig detector;
+    detector.suspect_phi = tunables.suspect_phi;
+    detector.failed_phi = tunables.failed_phi;
+    topology_manager_->SetFailureDetectorConfig(detector);
+    topology_manager_->SetRedundantMode(tunables.redundant);
+    topology_manager_->SetMaxTreeDepth(tunables.max_tree_depth);
+
+    if (control_transport_) control_transport_->SetCoalescingDelay(tunables.control_coalescing);
+    if (auto media = std::dynamic_pointer_cast<hcs_net::SecureUdpMediaTransport>(media_transport_)) {
+        media->EnableDuplicateFilter(tunables.redundant);
+    }
+    // heartbeat_piggyback と probe_interval は使用時に NodeConfigStore::Tunables() から読む
+}
+
+void HCSNode::ScheduleControlTick() {
+    control_tick_timer_.expires_after(config_->Config().timeouts.control_tick);
+    control_tick_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec) return; // Stop() によるキャンセル
+
+        HCS_TRACE_SPAN("node", "node.control_tick");
+        // ティック中に受信したADVERTISEを送信元ごとに重複排除し、グループごとに1回だけランキングを更新する
+        hcs_control::AdvertiseBatchStats stats = topology_manager_->FlushAdvertiseBatch();
+        if (stats.received > 0) {
+            HCS_LOG_DEBUG("Router", "Applied ADVERTISE batch: received={}, senders={}, groups={}.",
+                          stats.received, stats.senders, stats.groups);
+        }
+        // PROBE は probe_interval ごと (制御ティックの整数倍に丸める)
+        const auto probe_ticks = std::max<int64_t>(
+            1, config_->Tunables().probe_interval / config_->Config().timeouts.control_tick);
+        ++control_ticks_;
+        const auto advertise_ticks = std::max<int64_t>(1, ADVERTISE_INTERVAL / config_->Config().timeouts.control_tick);
+        if ((control_ticks_ - 1) % static_cast<uint64_t>(advertise_ticks) == 0) SendAdvertise();
+        if (control_ticks_ % static_cast<uint64_t>(probe_ticks) == 0) SendProbes();
+        const auto heartbeat_ticks = std::max<int64_t>(1, HEARTBEAT_INTERVAL / config_->Config().timeouts.control_tick);
+        if (control_ticks_ % static_cast<uint64_t>(heartbeat_ticks) == 0) SendHeartbeats();
+        // 親の生存を phi-accrual で評価し、障害時はセカンダリの昇格または再選定に進む
+        for (const auto& gid : joined_groups_) topology_manager_->CheckParentHealth(gid);
+        // 新しい親からメディアが届かないまま期限を過ぎた切り替えを確定する
+        if (handoff_pending_.load(std::memory_order_acquire)) ConfirmHandoffs("");
+        // 選定中の親へ JOIN し、選定から外れた親へ LEAVE を送る
+        const auto join_refresh_ticks = std::max<int64_t>(1, JOIN_REFRESH_INTERVAL / config_->Config().timeouts.control_tick);
+        ReconcileParents(control_ticks_ % static_cast<uint64_t>(join_refresh_ticks) == 0);
+        // 親の選定結果の変化を中継の経路に反映し、差し替えた購読者一覧を猶予の後に解放する
+        UpdateRelayRoutes();
+        subscription_table_->ReclaimRetired();
+        ScheduleControlTick();
+    });
+}
+
+void HCSNode::SendAdvertise() {
+    if (!accepting_.load(std::memory_order_acquire)) return;
+    hcs_control::NodeMetrics metrics;
+    metrics.bandwidth_score = ADVERTISE_BANDWIDTH_SCORE;
+    const auto uptime = std::chrono::steady_clock::now() - running_since_;
+    metrics.stability_score = static_cast<int>(std::min<int64_t>(100, uptime * 100 / STABILITY_FULL_UPTIME));
+    const hcs_control::AdvertiseMessage msg = topology_manager_->BuildAdvertise(metrics);
+    if (msg.groups.empty()) return; // 経路を持たないノードは親候補にならないため通知しない
+
+    // 全グループの経路を1つのメッセージで送る (ピアの状態はメッセージごとに置き換えるため、グループごとに分けない)。
+    // 宛先はグループ専用のマルチキャストアドレスで、スコープと hop limit は制御トランスポートの設定に従う
+    const std::vector<uint8_t> advertise = hcs_control::EncodeAdvertise(msg);
+    for (const auto& gid : msg.groups) control_transport_->AsyncSendToGroup(advertise, gid);
+}
+
+void HCSNode::SendProbes() {
+    // ピアの制御ポートは自ノードと同じとする (ADVERTISE の送信元ポートと同じ前提)
+    for (const auto& [ip, peer] : topology_manager_->GetPeers()) {
+        hcs_net::Endpoint dest;
+        if (!hcs_net::Endpoint::Parse(ip, config_->Config().transport.control_port, dest)) continue;
+        std::vector<uint8_t> probe{MSG_TYPE_PROBE};
+        // t1 は送信の直前にトランスポートが書き込む
+        rtt_probe_.WriteProbe(ip, 0, probe);
+        control_transport_->SendTimestamped(std::move(probe), dest);
+    }
+}
+
+void HCSNode::HandleControlMessage(const std::vector<uint8_t>& message, const hcs_net::Endpoint& sender_endpoint) {
     // 制御メッセージのデシリアライズとルーティング
-    // 受信した生のメッセージデータ (message) をRouteControlMessageに渡す
-    RouteControlMessage(message);
+    // 高レート受信時のCPU負荷を抑えるため、メッセージごとのログ出力は行わない
+    // 受信した生のメッセージデータ (message) と送信元をRouteControlMessageに渡す
+    RouteControlMessage(message, sender_endpoint);
     
-    // 実際のアプリケーションでは、送信元エンドポイント(sender_endpoint)の情報も
-    // RouteControlMessageやTopologyManagerに渡してピアの状態を正確に更新する必要があります。
+    // 実際のアプリケーションでは、送信元エンドポイント(sender_endpoint)の情報を
+    // TopologyManagerにも渡してピアの状態を正確に更新する必要があります。
 }
 
-void HCSNode::RouteControlMessage(const std::vector<uint8_t>& message_data) {
+void HCSNode::RouteControlMessage(const std::vector<uint8_t>& message_data, const hcs_net::Endpoint& sender_endpoint) {
     if (message_data.empty()) return;
 
     // メッセージタイプは最初の1バイトと仮定 (簡易的なデシリアライズ)
@@ -121,28 +1006,86 @@ void HCSNode::RouteControlMessage(const std::vector<uint8_t>& message_data) {
 
     switch (message_type) {
         case MSG_TYPE_ADVERTISE: {
-            // AdvertiseMessage構造体を仮定してデシリアライズ
-            // 受信パケットから情報を取り出す代わりにダミーデータを使用
             hcs_control::AdvertiseMessage adv_msg;
-            // 本来は sender_endpoint からIPを取得すべきだが、ダミーで固定
-            adv_msg.ip = "192.168.1.10"; 
-            adv_msg.metrics.rtt_ms = 50; 
-            adv_msg.metrics.hop_count = 1;
-            adv_msg.groups = {"VideoGroup1", "PublicFeed"};
-
-            topology_manager_->HandleAdvertise(adv_msg);
-            std::cout << "[Router] Routed ADVERTISE message to TopologyManager (Metrics: RTT="
-                      << adv_msg.metrics.rtt_ms << "ms, Groups: " << adv_msg.groups.size() << ").\n";
+            if (!hcs_control::DecodeAdvertise(message_data, adv_msg)) {
+                HCS_LOG_WARN_EVERY("Router", "Malformed ADVERTISE from {}", sender_endpoint);
+                break;
+            }
+            // ピアは送信元アドレスで識別する (HEARTBEAT・PROBE・メディアと同じキー)
+            adv_msg.ip = sender_endpoint.Address();
+            if (adv_msg.ip == topology_manager_->GetSelfIp()) break; // 自ノードが送ったマルチキャストの折り返し
+            // 自ノードが計測したRTTがあればそれを用いる (広告側の自己申告ではなく受信側の計測値で親を選ぶ)
+            if (const long long rtt_ms = rtt_probe_.RttMs(adv_msg.ip); rtt_ms >= 0) adv_msg.metrics.rtt_ms = rtt_ms;
+
+            // ランキングの更新は次の制御ティックでまとめて行う
+            topology_manager_->EnqueueAdvertise(std::move(adv_msg));
             break;
         }
         case MSG_TYPE_HEARTBEAT: {
-            // 受信元IPとグループIDもパケットペイロードから取得すべき
-            topology_manager_->HandleHeartbeat("192.168.1.10", "VideoGroup1");
-            std::cout << "[Router] Routed HEARTBEAT message to TopologyManager.\n";
+            // 相乗りした HEARTBEAT の送信元は親のメディアエンドポイントだが、ピアはアドレスで識別する
+            const std::string group_id(message_data.begin() + 1, message_data.end());
+            topology_manager_->HandleHeartbeat(sender_endpoint.Address(), group_id);
+            break;
+        }
+        case MSG_TYPE_JOIN: {
+            // 子ノードの購読登録。送信先は送信元アドレスと通知されたメディアポートから解決しておく
+            if (!accepting_.load(std::memory_order_acquire)) {
+                // 停止中は新しい子を受け付けない (子は次の候補の親へ JOIN し直す)
+                HCS_LOG_WARN_EVERY("Router", "Rejected JOIN from {} while the node is not running", sender_endpoint);
+                break;
+            }
+            uint16_t media_port = 0;
+            uint32_t layer_mask = 0;
+            std::string group_id;
+            if (!hcs_control::DecodeJoin(message_data, media_port, layer_mask, group_id)) {
+                HCS_LOG_WARN_EVERY("Router", "Malformed JOIN from {}", sender_endpoint);
+                break;
+            }
+            hcs_net::Endpoint child = sender_endpoint.WithPort(media_port);
+            if (!subscription_table_->Join(group_id, child, layer_mask, sender_endpoint.port)) {
+                HCS_LOG_WARN_EVERY("Router", "Rejected JOIN for group {} from {}", group_id, sender_endpoint);
+                break;
+            }
+            UpdateRelayActive();
+            break;
+        }
+        case MSG_TYPE_LEAVE: {
+            // LEAVE は制御ポートから届くため、JOIN と同じく通知されたメディアポートで購読を特定する
+            // (同じアドレスの別ノードの購読は残す)
+            uint16_t media_port = 0;
+            std::string group_id;
+            if (!hcs_control::DecodeLeave(message_data, media_port, group_id)) {
+                HCS_LOG_WARN_EVERY("Router", "Malformed LEAVE from {}", sender_endpoint);
+                break;
+            }
+            if (subscription_table_->Leave(group_id, sender_endpoint.WithPort(media_port))) UpdateRelayActive();
+            break;
+        }
+        case MSG_TYPE_PROBE: {
+            // 受信時刻 (t2) はカーネルの時刻を用い、応答までの待ち時間 (t3 - t2) は計測側で差し引かれる。
+            // t3 は送信の直前にトランスポートが書き込む
+            std::vector<uint8_t> reply{MSG_TYPE_PROBE_REPLY};
+            if (hcs_control::RttProbe::WriteReply(message_data.data() + 1, message_data.size() - 1, ReceivedNs(), 0,
+                                                  reply)) {
+                control_transport_->SendTimestamped(std::move(reply), sender_endpoint);
+            }
+            break;
+        }
+        case MSG_TYPE_DEPARTING: {
+            HandleParentDeparture(message_data, sender_endpoint);
+            break;
+        }
+        case MSG_TYPE_PROBE_REPLY: {
+            const std::string peer = sender_endpoint.Address();
+            if (rtt_probe_.HandleReply(peer, message_data.data() + 1, message_data.size() - 1, ReceivedNs())) {
+                const hcs_control::RttEstimate* est = rtt_probe_.Estimate(peer);
+                HCS_LOG_DEBUG("Router", "RTT to {}: {} us (srtt {} us, delay gradient {}).", peer,
+                              est->last_rtt_ns / 1000, est->srtt_ns / 1000, est->delay_gradient);
+            }
             break;
         }
         default:
-            std::cerr << "[Router] Unknown control message type: " << (int)message_type << std::endl;
+            HCS_LOG_WARN_EVERY("Router", "Unknown control message type: {}", message_type);
             break;
     }
 }
@@ -0,0 +1,87 @@
+// HCSNode を設定ファイルから起動し、SIGINT / SIGTERM で段階的に停止するデーモン
+// 停止は HCSNode::Stop のドレイン (受け付けの停止 → 送信キューの送出 → LEAVE → ソケットのクローズ) を経る。
+// 2回目のシグナルではドレインを待たずに終了する。SIGHUP は HCSNode が設定の再読み込みに用いる。
+//
+// 使用例:
+//   HCSNodeDaemon --config=/etc/hcs/node.conf
+//   HCSNodeDaemon --config=node.conf --set=transport.media_port=6004 --set=diagnostics.metrics_port=9100
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include "HCSNode.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/NodeConfig.h"
+
+namespace {
+
+void PrintUsage() {
+    std::cerr <<
+        "Usage: HCSNodeDaemon --config=PATH [options]\n"
+        "  --config=PATH        設定ファイル (NodeConfigCheck で事前に検証できる)\n"
+        "  --set=KEY=VALUE      設定の上書き (section.key=value、複数指定可)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    std::vector<std::string> overrides;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            std::string key = arg, value;
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                key = arg.substr(0, eq);
+                value = arg.substr(eq + 1);
+            }
+            if (key == "--config") path = value;
+            else if (key == "--set") overrides.push_back(value);
+            else if (key == "--help") {
+                PrintUsage();
+                return 0;
+            } else {
+                PrintUsage();
+                return 1;
+            }
+        }
+        if (path.empty()) {
+            PrintUsage();
+            return 1;
+        }
+
+        auto config = std::make_shared<hcs_common::NodeConfigStore>(path, overrides);
+        boost::asio::io_context io;
+        auto node = std::make_shared<hcs::HCSNode>(io, config);
+        node->Start();
+
+        boost::asio::signal_set stop_signals(io, SIGINT, SIGTERM);
+        stop_signals.async_wait([&](const boost::system::error_code& ec, int signal) {
+            if (ec) return;
+            HCS_LOG_INFO("HCSNodeDaemon", "Received signal {}; draining.", signal);
+            // ドレイン中の2回目のシグナルは即時終了とする
+            stop_signals.async_wait([&io](const boost::system::error_code& ec, int) {
+                if (!ec) io.stop();
+            });
+            node->Stop([&]() {
+                boost::system::error_code ignored;
+                stop_signals.cancel(ignored);
+                io.stop();
+            });
+        });
+
+        node->Run();
+    } catch (const std::exception& e) {
+        hcs_common::Logger::Instance().Flush();
+        std::cerr << "[HCSNodeDaemon] Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    hcs_common::Logger::Instance().Flush();
+    return 0;
+}
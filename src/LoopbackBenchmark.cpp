@@ -0,0 +1,210 @@
+// メディア経路のエンドツーエンド・ループバックベンチマーク
+// 1プロセス内で送信ノードと受信ノードの組をループバック上で動かし、
+// パケット化 → 暗号化 → 送信 → 受信 → 復号 → RTP 解析 の全経路の
+// 持続可能な最大 pps・Gbps・ノードあたりの CPU 使用率・遅延パーセンタイルを出力する。
+// トランスポート・組数 (スレッド数)・パケットサイズを掃引し、スケーリングを確認できる。
+// --transports=node では各ノードを HCSNode として起動し、送信元の公開から StreamDecoder までの実際の経路を計測する。
+// ウォームアップ後のノードのスレッドでのパケットあたりのヒープ確保回数 (alloc_tx/alloc_rx) も出力する。
+//
+// 使用例:
+//   LoopbackBenchmark --pairs=1,2,4 --sizes=200,1200 --rate=20000
+//   LoopbackBenchmark --pairs=1,2 --sizes=1200 --sweep --json --output=loopback.ndjson
+//   LoopbackBenchmark --transports=udp,node --pairs=1,2 --rate=20000  (部品の組み合わせと HCSNode を比較する)
+//   LoopbackBenchmark --transports=memory --delay-us=200 --jitter-us=50 --loss=0.01 --reorder=0.05
+//   LoopbackBenchmark --transports=memory --rate=1000 --capture=/tmp  (計測ごとに直近のパケットを pcapng に出力)
+//   LoopbackBenchmark --rate=1000 --duration=0.5 --trace=loopback.trace.json  (chrome://tracing / Perfetto で表示)
+//   LoopbackBenchmark --timestamps=off --metrics=user.prom  (カーネルのタイムスタンプなしの段ごとの遅延と比較する)
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "hcs_common/AllocationCounter.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/Tracing.h"
+#include "hcs_sim/LoopbackBenchmark.h"
+
+// 送受信ノードのスレッドのヒープ確保回数を数え、データ経路のゼロアロケーションを検証する
+HCS_DEFINE_COUNTING_OPERATOR_NEW();
+
+namespace {
+
+void PrintUsage() {
+    std::cerr <<
+        "Usage: LoopbackBenchmark [options]\n"
+        "  --transports=LIST    基底トランスポートの一覧 (udp, memory, node; default udp)\n"
+        "                       node: 組ごとに2つの HCSNode を起動し、PublishMedia → SecureUdpMediaTransport →\n"
+        "                       StreamDecoder の経路を計測する (ポートは組ごとに4つ。--capture と memory の注入は対象外)\n"
+        "  --pairs=LIST         送信/受信ノードの組数の一覧 (default 1)\n"
+        "  --sizes=LIST         RTP パケットサイズ (バイト) の一覧 (default 1200)\n"
+        "  --rate=PPS           組あたりの送信レート。--sweep 時は探索の開始レート (default 10000)\n"
+        "  --duration=SEC       1回の計測の送信時間 (default 2)\n"
+        "  --sweep              損失率が --loss-threshold 以下となる最大レートを探索する\n"
+        "  --loss-threshold=R   --sweep で許容する損失率 (default 0.001)\n"
+        "  --base-port=PORT     UDP の先頭ポート (default 47000)\n"
+        "  --delay-us=US        memory: 片方向の固定遅延 (default 0)\n"
+        "  --jitter-us=US       memory: ジッタの最大値 (default 0)\n"
+        "  --loss=RATE          memory: パケット損失率 0.0-1.0 (default 0)\n"
+        "  --reorder=RATE       memory: 後続に追い越させるパケットの割合 (default 0)\n"
+        "  --seed=N             memory: 損失・並べ替えの乱数シード (default 1)\n"
+        "  --output=PATH        結果を NDJSON で追記する\n"
+        "  --metrics=PATH       終了時のメトリクス (段ごとの遅延を含む) を Prometheus テキスト形式で出力する\n"
+        "  --capture=DIR        暗号化層の前後のパケットを記録し、計測ごとに DIR へ pcapng で出力する\n"
+        "  --trace=PATH         トレースを記録し、終了時に Chrome trace event 形式の JSON で出力する\n"
+        "  --timestamps=MODE    udp: カーネルの送受信タイムスタンプ (off, software, hardware; default software)\n"
+        "  --json               結果を1行ずつJSONで出力する\n";
+}
+
+/**
+ * @brief "a,b,c" 形式の値を要素に分解する。
+ */
+std::vector<std::string> SplitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    if (items.empty()) throw std::invalid_argument("empty list");
+    return items;
+}
+
+std::chrono::nanoseconds Micros(double us) {
+    return std::chrono::nanoseconds(static_cast<int64_t>(us * 1e3));
+}
+
+std::vector<size_t> ParseSizeList(const std::string& value) {
+    std::vector<size_t> numbers;
+    for (const auto& item : SplitList(value)) numbers.push_back(std::stoul(item));
+    return numbers;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    hcs_sim::LoopbackConfig base;
+    std::vector<std::string> transports{"udp"};
+    std::vector<size_t> pair_counts{1};
+    std::vector<size_t> sizes{base.packet_size};
+    bool sweep = false;
+    double loss_threshold = 0.001;
+    std::string output_path;
+    std::string metrics_path;
+    std::string capture_dir;
+    std::string trace_path;
+    bool json = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            std::string key = arg, value;
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                key = arg.substr(0, eq);
+                value = arg.substr(eq + 1);
+            }
+
+            if (key == "--transports") transports = SplitList(value);
+            else if (key == "--pairs") pair_counts = ParseSizeList(value);
+            else if (key == "--sizes") sizes = ParseSizeList(value);
+            else if (key == "--rate") base.rate_pps = std::stod(value);
+            else if (key == "--duration") base.duration = std::chrono::milliseconds(static_cast<int64_t>(std::stod(value) * 1000));
+            else if (key == "--sweep") sweep = true;
+            else if (key == "--loss-threshold") loss_threshold = std::stod(value);
+            else if (key == "--base-port") base.base_port = static_cast<uint16_t>(std::stoul(value));
+            else if (key == "--delay-us") base.link.delay = Micros(std::stod(value));
+            else if (key == "--jitter-us") base.link.jitter = Micros(std::stod(value));
+            else if (key == "--loss") base.link.loss_rate = std::stod(value);
+            else if (key == "--reorder") base.link.reorder_rate = std::stod(value);
+            else if (key == "--seed") base.link.seed = std::stoull(value);
+            else if (key == "--output") output_path = value;
+            else if (key == "--metrics") metrics_path = value;
+            else if (key == "--capture") capture_dir = value;
+            else if (key == "--timestamps") {
+                if (value == "off") base.timestamps = hcs_net::SocketTimestampMode::kOff;
+                else if (value == "software") base.timestamps = hcs_net::SocketTimestampMode::kSoftware;
+                else if (value == "hardware") base.timestamps = hcs_net::SocketTimestampMode::kHardware;
+                else throw std::invalid_argument("unknown timestamp mode " + value);
+            }
+            else if (key == "--trace") trace_path = value;
+            else if (key == "--json") json = true;
+            else if (key == "--help" || key == "-h") { PrintUsage(); return 0; }
+            else throw std::invalid_argument("unknown option " + arg);
+        }
+        if (base.rate_pps <= 0.0 || base.duration.count() <= 0) {
+            throw std::invalid_argument("--rate and --duration must be positive");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[LoopbackBenchmark] Invalid arguments: " << e.what() << "\n";
+        PrintUsage();
+        return 1;
+    }
+
+    // 送受信のログが計測を乱さないよう、警告以上に絞る
+    hcs_common::Logger::SetLevel(hcs_common::LogLevel::kWarn);
+
+    try {
+        std::ofstream output_file;
+        if (!output_path.empty()) {
+            output_file.open(output_path, std::ios::out | std::ios::app);
+            if (!output_file) throw std::runtime_error("Failed to open output file: " + output_path);
+        }
+
+        if (!capture_dir.empty()) {
+            hcs_net::CaptureConfig capture_config;
+            capture_config.directory = capture_dir;
+            base.capture = std::make_shared<hcs_net::PacketCapture>(capture_config);
+            base.capture->Enable();
+        }
+
+        // リングはスレッドごとに直近のイベントのみを保持するため、短い計測で使う
+        if (!trace_path.empty()) hcs_common::Tracer::SetEnabled(true);
+
+        hcs_sim::LoopbackBenchmark benchmark;
+        if (!json) hcs_sim::LoopbackResult::PrintHeader(std::cout);
+        for (const auto& transport : transports) {
+            for (size_t pairs : pair_counts) {
+                for (size_t size : sizes) {
+                    hcs_sim::LoopbackConfig config = base;
+                    config.transport = transport;
+                    config.pairs = pairs;
+                    config.packet_size = size;
+
+                    hcs_sim::LoopbackResult result = sweep
+                        ? benchmark.FindMaxSustainableRate(config, loss_threshold)
+                        : benchmark.Run(config);
+                    hcs_common::Logger::Instance().Flush();
+                    if (json) {
+                        result.PrintJson(std::cout);
+                    } else {
+                        result.Print(std::cout);
+                    }
+                    std::cout.flush();
+                    if (output_file.is_open()) result.PrintJson(output_file);
+                    if (base.capture) {
+                        const std::string path = base.capture->Trigger("manual", true);
+                        base.capture->Flush();
+                        if (!path.empty()) std::cerr << "[LoopbackBenchmark] Capture written to " << path << "\n";
+                    }
+                }
+            }
+        }
+
+        if (!trace_path.empty() && !hcs_common::Tracer::Instance().WriteChromeTraceFile(trace_path)) {
+            throw std::runtime_error("Failed to write trace file: " + trace_path);
+        }
+        if (!metrics_path.empty() && !hcs_common::MetricsRegistry::Instance().WriteTextFile(metrics_path)) {
+            throw std::runtime_error("Failed to write metrics file: " + metrics_path);
+        }
+    } catch (const std::exception& e) {
+        hcs_common::Logger::Instance().Flush();
+        std::cerr << "[LoopbackBenchmark] Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
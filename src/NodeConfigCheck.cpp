@@ -0,0 +1,67 @@
+// ノードの設定ファイルを検証し、正規化した設定を出力するツール
+// HCSNode と同じローダー (hcs_common/NodeConfig.h) で読み込むため、デプロイ前に
+// 起動時と同じエラー (未知のキー・型や範囲の誤り・値どうしの矛盾) をまとめて確認できる。
+// 出力にはパスフレーズを含めず、実行中に再読み込みできるキーには "# reloadable" を付ける。
+//
+// 使用例:
+//   NodeConfigCheck --config=/etc/hcs/node.conf
+//   NodeConfigCheck --config=node.conf --set=transport.media_port=6004 --set=topology.redundant=on
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "hcs_common/Logger.h"
+#include "hcs_common/NodeConfig.h"
+
+namespace {
+
+void PrintUsage() {
+    std::cerr <<
+        "Usage: NodeConfigCheck --config=PATH [options]\n"
+        "  --config=PATH        検証する設定ファイル\n"
+        "  --set=KEY=VALUE      設定の上書き (section.key=value、複数指定可)\n"
+        "  --quiet              正規化した設定を出力しない (終了コードのみ)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    std::vector<std::string> overrides;
+    bool quiet = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            std::string key = arg, value;
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                key = arg.substr(0, eq);
+                value = arg.substr(eq + 1);
+            }
+            if (key == "--config") path = value;
+            else if (key == "--set") overrides.push_back(value);
+            else if (key == "--quiet") quiet = true;
+            else if (key == "--help") {
+                PrintUsage();
+                return 0;
+            } else {
+                PrintUsage();
+                return 1;
+            }
+        }
+        if (path.empty()) {
+            PrintUsage();
+            return 1;
+        }
+
+        const hcs_common::NodeConfig config = hcs_common::NodeConfigLoader::Load(path, overrides);
+        if (!quiet) std::cout << hcs_common::NodeConfigLoader::Render(config);
+    } catch (const std::exception& e) {
+        hcs_common::Logger::Instance().Flush();
+        std::cerr << "[NodeConfigCheck] Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "hcs_media/StreamDecoder.h"
+#include "hcs_media/RtpPacket.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PipelineLatency.h"
+#include <memory>
+#include <utility>
+
+namespace hcs_media {
+
+namespace {
+
+/**
+ * @brief デコーダのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct DecoderMetrics {
+    hcs_common::Counter& packets;
+    hcs_common::Counter& payload_bytes;
+    hcs_common::Counter& invalid_packets;
+
+    static DecoderMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static DecoderMetrics metrics{
+            registry.GetCounter("hcs_decoder_packets_total", "RTP packets parsed and handed to the decoder"),
+            registry.GetCounter("hcs_decoder_payload_bytes_total", "RTP payload bytes handed to the decoder"),
+            registry.GetCounter("hcs_decoder_invalid_packets_total", "Packets dropped because the RTP header was invalid"),
+        };
+        return metrics;
+    }
+};
+
+} // namespace
+
+// =========================================================================
+
+StreamDecoder::StreamDecoder(const std::string& group_id)
+: group_id_(group_id)
+{
+    // FFmpeg/Libde265 デコーダコンテキストの初期化ロジックはここに入る
+}
+
+StreamDecoder::~StreamDecoder() {
+    Stop();
+}
+
+void StreamDecoder::StartDecoding(std::shared_ptr<hcs_net::IMediaTransport> transport) {
+    HCS_LOG_INFO("Decoder", "Starting decoder for group: {}", group_id_);
+    transport_ = std::move(transport);
+    decoding_ = true;
+    // トランスポートが復号したパケットを受け取る (デコーダが先に破棄された場合は捨てる)
+    transport_->StartReceive(
+        [weak = std::weak_ptr<StreamDecoder>(shared_from_this())](hcs_common::PacketRef packet,
+                                                                  const hcs_net::Endpoint& sender) {
+            if (auto self = weak.lock()) self->HandlePacket(std::move(packet), sender);
+        }
+    );
+}
+
+void StreamDecoder::Stop() {
+    if (!decoding_) return;
+    HCS_LOG_INFO("Decoder", "Stopping decoder.");
+    // ソケットはHCSNodeがドレインの後に閉じるため、ここでは以降のパケットを破棄するだけにする
+    decoding_ = false;
+}
+
+void StreamDecoder::SetControlExtractor(ControlExtractor extractor) {
+    // 受信したRTPパケットから相乗りした制御メッセージを取り出す処理 (ControlPiggyback::ExtractFrom)
+    control_extractor_ = std::move(extractor);
+}
+
+void StreamDecoder::SetPayloadHandler(PayloadHandler handler) {
+    payload_handler_ = std::move(handler);
+}
+
+// 受信処理のメインコールバック
+void StreamDecoder::HandlePacket(hcs_common::PacketRef packet, const hcs_net::Endpoint& sender) {
+    if (!decoding_ || !packet || packet->Empty()) return;
+
+    // 1. 受信データの復号化と検証
+    // IMediaTransport層で既にAES-GCMによる復号化と認証タグの検証が行われている。
+
+    // トランスポート層が受信・復号の段を記録したタイミングを引き継ぐ (なければここから計測する)
+    hcs_common::PacketTiming timing;
+    if (auto* current = hcs_common::ScopedPacketTiming::Current()) timing = *current;
+    else timing.Begin();
+
+    // 2. RTPパケットの処理とデコーダへの投入 (復号済みのバッファの上でそのまま処理する)
+    ProcessReceivedPacket(*packet, sender, timing);
+}
+
+void StreamDecoder::ProcessReceivedPacket(hcs_common::PacketBuffer& packet, const hcs_net::Endpoint& sender,
+                                          hcs_common::PacketTiming& timing) {
+    // 0. 相乗りした制御メッセージの取り出し (ヘッダー拡張を取り除き、通常のRTPパケットに戻す)
+    if (control_extractor_) control_extractor_(packet, sender);
+
+    size_t payload_offset = 0;
+    
+    // 1. RTPヘッダー解析
+    const uint8_t* rtp_payload = ParseRtpHeader(packet.Data(), packet.Size(), payload_offset);
+
+    if (rtp_payload) {
+        // ペイロードデータサイズ
+        size_t payload_size = packet.Size() - payload_offset;
+        DecoderMetrics::Get().packets.Add();
+        DecoderMetrics::Get().payload_bytes.Add(payload_size);
+
+        HCS_LOG_TRACE("Decoder", "Decrypted and parsed RTP. Payload size: {} bytes from {}", payload_size, sender);
+
+        // RTPタイムスタンプは送信側のキャプチャ時刻 (StreamEncoder が設定)
+        hcs_common::PipelineLatency::RecordNetwork(RtpTimestamp(packet.Data()), timing.received_ns);
+
+        // ジッタバッファは未実装のため、パケットは即座に払い出される
+        timing.Mark(hcs_common::PipelineStage::kJitterBuffer);
+
+        // 2. 【FFmpeg/デコーダ連携箇所】
+        // デコーダにペイロードを投入
+        // 例: avcodec_send_packet()
+        // 通常は、バッファリング、ジッタバッファ管理、RTPシーケンス番号チェックなどがここに入る。
+        // DecodePacket(rtp_payload, payload_size);
+        if (payload_handler_) payload_handler_(packet, payload_offset);
+
+        // 3. デコーダから出力されたフレーム (AVFrame) をレンダラーなどに渡す処理
+        // HandleDecodedFrame(...);
+        timing.Mark(hcs_common::PipelineStage::kFrameComplete);
+    } else {
+        DecoderMetrics::Get().invalid_packets.Add();
+        HCS_LOG_WARN_EVERY("Decoder", "Invalid RTP packet size or content from {}", sender);
+    }
+}
+
+} // namespace hcs_media
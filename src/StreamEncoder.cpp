@@ -0,0 +1,165 @@
+#include "hcs_media/StreamEncoder.h"
+#include "hcs_media/RtpPacket.h"
+#include "hcs_net/ControlPiggyback.h"
+#include "hcs_common/Logger.h"
+#include "hcs_common/Metrics.h"
+#include "hcs_common/PipelineLatency.h"
+#include "hcs_common/Tracing.h"
+#include <chrono>
+#include <stdexcept>
+
+namespace hcs_media {
+
+namespace {
+
+/**
+ * @brief エンコーダのメトリクス。レジストリ上の系列を全インスタンスで共有する。
+ */
+struct EncoderMetrics {
+    hcs_common::Counter& frames;
+    hcs_common::Counter& packets_sent;
+    hcs_common::Histogram& packet_size;
+
+    static EncoderMetrics& Get() {
+        auto& registry = hcs_common::MetricsRegistry::Instance();
+        static EncoderMetrics metrics{
+            registry.GetCounter("hcs_encoder_frames_total", "Frames encoded and packetized"),
+            registry.GetCounter("hcs_encoder_packets_sent_total", "RTP packets handed to the transport"),
+            registry.GetHistogram("hcs_encoder_packet_size_bytes", "RTP packet size before encryption",
+                                  {64, 128, 256, 512, 1024, 1200, 1400}),
+        };
+        return metrics;
+    }
+};
+
+} // namespace
+
+StreamEncoder::StreamEncoder(boost::asio::io_context& io_context)
+: io_context_(io_context),
+  encoding_timer_(io_context)
+{
+    // FFmpegコンテキストの初期化ロジックはここに入る
+}
+
+StreamEncoder::~StreamEncoder() {
+    Stop();
+}
+
+void StreamEncoder::SetTransport(std::shared_ptr<hcs_net::IMediaTransport> transport) {
+    transport_ = std::move(transport);
+}
+
+void StreamEncoder::SetDestination(const hcs_net::Endpoint& dest) {
+    dest_endpoint_ = dest;
+    HCS_LOG_INFO("Encoder", "Destination set to {}", dest_endpoint_);
+}
+
+void StreamEncoder::SetPacketSink(PacketSink sink) {
+    sink_ = std::move(sink);
+}
+
+void StreamEncoder::SetControlPiggyback(std::shared_ptr<hcs_net::ControlPiggyback> piggyback) {
+    // 送信するRTPパケットに、同じ宛先への保留中の制御メッセージを相乗りさせる
+    piggyback_ = std::move(piggyback);
+}
+
+void StreamEncoder::SetFrameInterval(std::chrono::milliseconds interval) {
+    // 次にスケジュールするフレームから反映される
+    frame_interval_ = interval;
+}
+
+void StreamEncoder::StartPublishing() {
+    if (!transport_ && !sink_) {
+        throw std::logic_error("StreamEncoder::StartPublishing called without a transport or packet sink.");
+    }
+    HCS_LOG_INFO("Encoder", "Starting publishing loop.");
+    publishing_ = true;
+    // フレーム間隔ごとにフレーム処理をシミュレート (既定は約33ミリ秒 = 30 FPS)
+    encoding_timer_.expires_after(frame_interval_);
+    encoding_timer_.async_wait(
+        // async_waitのコールバックで shared_from_this を使用して自身をライフタイム管理
+        [self = shared_from_this()](const boost::system::error_code& ec) {
+            self->HandleEncodingTimer(ec);
+        }
+    );
+}
+
+void StreamEncoder::Stop() {
+    if (!publishing_) return;
+    HCS_LOG_INFO("Encoder", "Stopping encoder and canceling timer.");
+    publishing_ = false;
+    // タイマーをキャンセルし、新しいフレームの生成を止める
+    // (トランスポート層の停止はHCSNodeがドレインの後に行う)
+    boost::system::error_code ec;
+    encoding_timer_.cancel(ec);
+}
+
+// エンコーディングと送信のメインループ駆動コールバック
+void StreamEncoder::HandleEncodingTimer(const boost::system::error_code& ec) {
+    if (ec == boost::asio::error::operation_aborted || !publishing_) {
+        // Stop() によってキャンセルされた
+        return;
+    }
+    if (ec) {
+        HCS_LOG_ERROR("Encoder", "Timer error: {}", ec.message());
+        return;
+    }
+
+    // 1. フレームの処理とRTPパケット化
+    ProcessNextFrame(); 
+
+    // 2. 次のフレーム処理をスケジュール (前回の予定時刻を基準にし、処理時間で周期がずれないようにする)
+    encoding_timer_.expires_at(encoding_timer_.expiry() + frame_interval_);
+    encoding_timer_.async_wait(
+        [self = shared_from_this()](const boost::system::error_code& next_ec) {
+            self->HandleEncodingTimer(next_ec);
+        }
+    );
+}
+
+void StreamEncoder::ProcessNextFrame() {
+    // 【FFmpeg 連携箇所】
+    // 1. FFmpeg: avcodec_send_frame() -> avcodec_receive_packet() でAVPacket(エンコード済みNALU)を取得
+    // 2. RTPパケット化: 取得したAVPacketをMTUサイズ(例:1400バイト)以下のRTPパケット群に分割
+
+    // キャプチャ時点から各段の遅延を計測する
+    hcs_common::PacketTiming timing;
+    timing.Begin();
+    const uint32_t capture_timestamp = hcs_common::PipelineLatency::MediaClockNow();
+    // フレームの区間 (暗号化・送信の区間が入れ子になる)。識別子は RTP タイムスタンプ
+    HCS_TRACE_SPAN("media", "encoder.frame", capture_timestamp);
+    timing.Mark(hcs_common::PipelineStage::kEncode);
+
+    // ダミーのRTPパケットを生成 (今回は単一の大きなパケットを想定)
+    size_t dummy_frame_size = 1200; // 1200バイトのペイロードを想定
+    // (プールのバッファに先頭の余白を残して書き込み、暗号化の IV とタグもその場で付加できるようにする)
+    hcs_common::PacketRef rtp_packet = AcquireDummyRtpPacket(dummy_frame_size, capture_timestamp);
+    
+    // 宛先への保留中の制御メッセージ (HEARTBEAT等) があれば、暗号化前にヘッダー拡張として載せる
+    // (シンクへ渡す場合は宛先を知るシンク側が載せる。HCSNode は全ての購読者に共通するものを載せる)
+    if (piggyback_ && !sink_) piggyback_->AttachTo(*rtp_packet, dest_endpoint_);
+    timing.Mark(hcs_common::PipelineStage::kPacketize);
+
+    HCS_LOG_TRACE("Encoder", "Encoded frame ({} bytes). Sending...", rtp_packet->Size());
+    EncoderMetrics::Get().frames.Add();
+    EncoderMetrics::Get().packet_size.Observe(rtp_packet->Size());
+
+    // 生成したRTPパケットをトランスポート層へ渡し、暗号化と非同期送信を実行させる
+    // (暗号化と送信完了の段はトランスポート層が同じタイミングに記録する)
+    hcs_common::ScopedPacketTiming timing_scope(timing);
+    SendRtpPacket(std::move(rtp_packet));
+}
+
+// 実際の送信をトランスポート層に依頼する
+void StreamEncoder::SendRtpPacket(hcs_common::PacketRef rtp_packet) {
+    // トランスポート層 (SecureUdpMediaTransport) が、バッファの上でその場で AES-GCM による暗号化を行う。
+    // 暗号化・送信の失敗はトランスポート層のメトリクスに記録される。
+    if (sink_) {
+        sink_(std::move(rtp_packet));
+    } else {
+        transport_->SendPacket(std::move(rtp_packet), dest_endpoint_);
+    }
+    EncoderMetrics::Get().packets_sent.Add();
+}
+
+} // namespace hcs_media
@@ -0,0 +1,137 @@
+// 制御メッセージ (ADVERTISE / JOIN / LEAVE / DEPARTING) の符号化と解析のテスト。
+
+#include <gtest/gtest.h>
+#include "hcs_control/ControlMessages.h"
+
+namespace {
+
+using namespace hcs_control;
+
+TEST(ControlMessagesTest, DepartingRoundTrip) {
+    const std::vector<std::string> recommended = {"192.0.2.2", "2001:db8::3"};
+    const std::vector<uint8_t> message = EncodeDeparting("G1", recommended);
+    ASSERT_EQ(message[0], MSG_TYPE_DEPARTING);
+
+    std::string group_id;
+    std::vector<std::string> decoded;
+    ASSERT_TRUE(DecodeDeparting(message, group_id, decoded));
+    EXPECT_EQ(group_id, "G1");
+    EXPECT_EQ(decoded, recommended);
+}
+
+TEST(ControlMessagesTest, DepartingWithoutReplacements) {
+    std::string group_id;
+    std::vector<std::string> decoded = {"stale"};
+    ASSERT_TRUE(DecodeDeparting(EncodeDeparting("G1", {}), group_id, decoded));
+    EXPECT_TRUE(decoded.empty());
+}
+
+TEST(ControlMessagesTest, DepartingSkipsOverlongAddresses) {
+    const std::vector<uint8_t> message = EncodeDeparting("G1", {std::string(300, 'x'), "192.0.2.2"});
+    std::string group_id;
+    std::vector<std::string> decoded;
+    ASSERT_TRUE(DecodeDeparting(message, group_id, decoded));
+    EXPECT_EQ(decoded, std::vector<std::string>{"192.0.2.2"});
+}
+
+TEST(ControlMessagesTest, DepartingRejectsMalformed) {
+    const std::vector<uint8_t> message = EncodeDeparting("G1", {"192.0.2.2"});
+    std::string group_id;
+    std::vector<std::string> decoded;
+    for (size_t size = 0; size < message.size(); ++size) {
+        EXPECT_FALSE(DecodeDeparting({message.begin(), message.begin() + size}, group_id, decoded)) << size;
+    }
+    std::vector<uint8_t> trailing = message;
+    trailing.push_back(0);
+    EXPECT_FALSE(DecodeDeparting(trailing, group_id, decoded));
+    EXPECT_FALSE(DecodeDeparting(EncodeDeparting("", {}), group_id, decoded));
+    EXPECT_FALSE(DecodeDeparting(EncodeLeave(5004, "G1"), group_id, decoded));
+}
+
+TEST(ControlMessagesTest, JoinRoundTrip) {
+    const std::vector<uint8_t> message = EncodeJoin(5004, 0x80000003u, "G1");
+    ASSERT_EQ(message.size(), JOIN_HEADER_SIZE + 2);
+
+    uint16_t media_port = 0;
+    uint32_t layer_mask = 0;
+    std::string group_id;
+    ASSERT_TRUE(DecodeJoin(message, media_port, layer_mask, group_id));
+    EXPECT_EQ(media_port, 5004);
+    EXPECT_EQ(layer_mask, 0x80000003u);
+    EXPECT_EQ(group_id, "G1");
+
+    // グループIDのない JOIN は不正
+    EXPECT_FALSE(DecodeJoin(EncodeJoin(5004, 1, ""), media_port, layer_mask, group_id));
+    EXPECT_FALSE(DecodeJoin(EncodeLeave(5004, "G1"), media_port, layer_mask, group_id));
+}
+
+TEST(ControlMessagesTest, LeaveRoundTrip) {
+    const std::vector<uint8_t> message = EncodeLeave(5004, "G1");
+    EXPECT_EQ(message, (std::vector<uint8_t>{MSG_TYPE_LEAVE, 0x13, 0x8C, 'G', '1'}));
+
+    uint16_t media_port = 0;
+    std::string group_id;
+    ASSERT_TRUE(DecodeLeave(message, media_port, group_id));
+    EXPECT_EQ(media_port, 5004);
+    EXPECT_EQ(group_id, "G1");
+
+    // グループIDのない LEAVE は不正
+    EXPECT_FALSE(DecodeLeave(EncodeLeave(5004, ""), media_port, group_id));
+    EXPECT_FALSE(DecodeLeave(EncodeJoin(5004, 1, "G1"), media_port, group_id));
+}
+
+TEST(ControlMessagesTest, AdvertiseRoundTrip) {
+    AdvertiseMessage msg;
+    msg.ip = "ignored";
+    msg.metrics.hop_count = 2;
+    msg.metrics.bandwidth_score = 50;
+    msg.metrics.stability_score = 75;
+    msg.groups = {"G1", "G2"};
+    GroupRoute route;
+    route.hops_to_source = 2;
+    route.source_seq = 0xDEADBEEFu;
+    route.path = {"192.0.2.1", "192.0.2.2", "192.0.2.3"};
+    msg.routes["G1"] = route;
+
+    AdvertiseMessage decoded;
+    ASSERT_TRUE(DecodeAdvertise(EncodeAdvertise(msg), decoded));
+    EXPECT_TRUE(decoded.ip.empty()); // 送信元IPは受信側が決める
+    EXPECT_EQ(decoded.metrics.hop_count, 2);
+    EXPECT_EQ(decoded.metrics.bandwidth_score, 50);
+    EXPECT_EQ(decoded.metrics.stability_score, 75);
+    EXPECT_EQ(decoded.groups, msg.groups);
+    ASSERT_EQ(decoded.routes.size(), 1u); // 経路のない G2 はグループのみ
+    EXPECT_EQ(decoded.routes["G1"].hops_to_source, 2);
+    EXPECT_EQ(decoded.routes["G1"].source_seq, 0xDEADBEEFu);
+    EXPECT_EQ(decoded.routes["G1"].path, route.path);
+}
+
+TEST(ControlMessagesTest, AdvertiseClampsMetrics) {
+    AdvertiseMessage msg;
+    msg.metrics.hop_count = 1000;
+    msg.metrics.bandwidth_score = -5;
+    msg.metrics.stability_score = 100000;
+    AdvertiseMessage decoded;
+    ASSERT_TRUE(DecodeAdvertise(EncodeAdvertise(msg), decoded));
+    EXPECT_EQ(decoded.metrics.hop_count, 255);
+    EXPECT_EQ(decoded.metrics.bandwidth_score, 0);
+    EXPECT_EQ(decoded.metrics.stability_score, 65535);
+    EXPECT_TRUE(decoded.groups.empty());
+}
+
+TEST(ControlMessagesTest, AdvertiseRejectsTruncated) {
+    AdvertiseMessage msg;
+    msg.groups = {"G1"};
+    msg.routes["G1"] = GroupRoute{0, 1, {"192.0.2.1"}};
+    const std::vector<uint8_t> message = EncodeAdvertise(msg);
+    for (size_t size = 0; size < message.size(); ++size) {
+        AdvertiseMessage decoded;
+        EXPECT_FALSE(DecodeAdvertise({message.begin(), message.begin() + size}, decoded)) << size;
+    }
+    std::vector<uint8_t> trailing = message;
+    trailing.push_back(0);
+    AdvertiseMessage decoded;
+    EXPECT_FALSE(DecodeAdvertise(trailing, decoded));
+}
+
+} // namespace
@@ -0,0 +1,153 @@
+// ControlPiggyback の相乗り (AttachTo / AttachToAll) と取り出し (ExtractFrom) の往復、中継されたメッセージの扱いのテスト。
+
+#include <gtest/gtest.h>
+#include "hcs_media/RtpPacket.h"
+#include "hcs_net/ControlPiggyback.h"
+
+namespace {
+
+using hcs_net::ControlPiggyback;
+using hcs_net::Endpoint;
+
+class ControlPiggybackTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        piggyback_ = std::make_shared<ControlPiggyback>(io_, [this](const std::vector<uint8_t>&, const Endpoint&) {
+            ++fallback_sent_;
+        });
+        piggyback_->SetControlHandler([this](const std::vector<uint8_t>& message, const Endpoint& sender) {
+            received_.push_back(message);
+            senders_.push_back(sender);
+        });
+    }
+
+    boost::asio::io_context io_;
+    std::shared_ptr<ControlPiggyback> piggyback_;
+    std::vector<std::vector<uint8_t>> received_;
+    std::vector<Endpoint> senders_;
+    int fallback_sent_ = 0;
+    const Endpoint child_{"127.0.0.2", 5004};
+    const Endpoint sibling_{"127.0.0.3", 5004};
+    const Endpoint parent_{"127.0.0.1", 5004};
+};
+
+TEST_F(ControlPiggybackTest, PacketBufferRoundTripRestoresPacket) {
+    const std::vector<uint8_t> small = {2, 'G', '1'};
+    const std::vector<uint8_t> large(hcs_net::MAX_PIGGYBACK_MESSAGE_SIZE, 0x5A);
+    // 送信元の要素を添えても最大長のメッセージは単独で載るが、他のメッセージとは同じパケットに入らない
+    piggyback_->SetOrigin(parent_);
+    piggyback_->Submit(small, child_, std::chrono::milliseconds(100));
+    piggyback_->Submit(large, child_, std::chrono::milliseconds(100));
+
+    auto packet = hcs_media::AcquireDummyRtpPacket(1200, 42);
+    const std::vector<uint8_t> original(packet->Data(), packet->Data() + packet->Size());
+    const size_t first = piggyback_->AttachTo(*packet, child_);
+    const size_t second = piggyback_->AttachTo(*packet, child_);
+    EXPECT_GT(first, 0u);
+    EXPECT_EQ(second, 0u); // 1パケットには1回だけ相乗りする
+
+    EXPECT_TRUE(piggyback_->ExtractFrom(*packet, parent_));
+    EXPECT_EQ(std::vector<uint8_t>(packet->Data(), packet->Data() + packet->Size()), original);
+    ASSERT_EQ(received_.size(), 1u);
+    EXPECT_EQ(received_[0], small);
+    EXPECT_EQ(senders_[0], parent_);
+
+    // 入りきらなかったメッセージは次のパケットに載る
+    auto next = hcs_media::AcquireDummyRtpPacket(1200, 43);
+    EXPECT_GT(piggyback_->AttachTo(*next, child_), 0u);
+    EXPECT_TRUE(piggyback_->ExtractFrom(*next, parent_));
+    ASSERT_EQ(received_.size(), 2u);
+    EXPECT_EQ(received_[1], large);
+    EXPECT_EQ(fallback_sent_, 0);
+}
+
+TEST_F(ControlPiggybackTest, VectorRoundTripRestoresPacket) {
+    const std::vector<uint8_t> message = {4, 'G', '2'};
+    piggyback_->Submit(message, child_, std::chrono::milliseconds(100));
+
+    auto packet = hcs_media::AcquireDummyRtpPacket(1200, 7);
+    std::vector<uint8_t> rtp(packet->Data(), packet->Data() + packet->Size());
+    const std::vector<uint8_t> original = rtp;
+    EXPECT_GT(piggyback_->AttachTo(rtp, child_), 0u);
+    EXPECT_GT(rtp.size(), original.size());
+
+    EXPECT_TRUE(piggyback_->ExtractFrom(rtp, parent_));
+    EXPECT_EQ(rtp, original);
+    ASSERT_EQ(received_.size(), 1u);
+    EXPECT_EQ(received_[0], message);
+}
+
+TEST_F(ControlPiggybackTest, OnlyAttachesToMatchingDestination) {
+    piggyback_->Submit({2, 'G'}, child_, std::chrono::milliseconds(100));
+    auto packet = hcs_media::AcquireDummyRtpPacket(1200, 1);
+    EXPECT_EQ(piggyback_->AttachTo(*packet, Endpoint("127.0.0.3", 5004)), 0u);
+    EXPECT_FALSE(piggyback_->ExtractFrom(*packet, parent_));
+    EXPECT_TRUE(received_.empty());
+}
+
+TEST_F(ControlPiggybackTest, FlushAllSendsPendingMessagesDirectly) {
+    piggyback_->Submit({2, 'G'}, child_, std::chrono::milliseconds(100));
+    piggyback_->FlushAll();
+    EXPECT_EQ(fallback_sent_, 1);
+    auto packet = hcs_media::AcquireDummyRtpPacket(1200, 1);
+    EXPECT_EQ(piggyback_->AttachTo(*packet, child_), 0u);
+}
+
+TEST_F(ControlPiggybackTest, AttachToAllCarriesOnlyCommonMessages) {
+    const std::vector<uint8_t> heartbeat = {2, 'G', '1'};
+    const std::vector<uint8_t> only_child = {4, 'G', '1'};
+    piggyback_->Submit(only_child, child_, std::chrono::milliseconds(100));
+    piggyback_->Submit(heartbeat, child_, std::chrono::milliseconds(100));
+    piggyback_->Submit(heartbeat, sibling_, std::chrono::milliseconds(100));
+
+    // 同じホストが重複していても1つの宛先として扱う
+    auto packet = hcs_media::AcquireDummyRtpPacket(1200, 1);
+    EXPECT_EQ(piggyback_->AttachToAll(*packet, {child_, sibling_, child_.WithPort(5006)}), 1u);
+    EXPECT_TRUE(piggyback_->ExtractFrom(*packet, parent_));
+    ASSERT_EQ(received_.size(), 1u);
+    EXPECT_EQ(received_[0], heartbeat);
+
+    // 一部の宛先向けのメッセージはその宛先のキューに残る
+    auto for_sibling = hcs_media::AcquireDummyRtpPacket(1200, 2);
+    EXPECT_EQ(piggyback_->AttachTo(*for_sibling, sibling_), 0u);
+    auto for_child = hcs_media::AcquireDummyRtpPacket(1200, 3);
+    EXPECT_EQ(piggyback_->AttachTo(*for_child, child_), 1u);
+    EXPECT_TRUE(piggyback_->ExtractFrom(*for_child, parent_));
+    ASSERT_EQ(received_.size(), 2u);
+    EXPECT_EQ(received_[1], only_child);
+    EXPECT_FALSE(piggyback_->HasPending());
+}
+
+TEST_F(ControlPiggybackTest, AttachToAllNeedsPendingForEveryDestination) {
+    piggyback_->Submit({2, 'G'}, child_, std::chrono::milliseconds(100));
+    auto packet = hcs_media::AcquireDummyRtpPacket(1200, 1);
+    EXPECT_EQ(piggyback_->AttachToAll(*packet, {child_, sibling_}), 0u);
+    EXPECT_TRUE(piggyback_->HasPending());
+}
+
+TEST_F(ControlPiggybackTest, IgnoresMessagesRelayedFromUpstream) {
+    const std::vector<uint8_t> heartbeat = {2, 'G', '1'};
+    piggyback_->SetOrigin(parent_);
+    piggyback_->Submit(heartbeat, child_, std::chrono::milliseconds(100));
+    piggyback_->Submit(heartbeat, child_, std::chrono::milliseconds(100));
+
+    // 載せたノードから直接届いたものは処理する
+    auto direct = hcs_media::AcquireDummyRtpPacket(1200, 1);
+    const std::vector<uint8_t> original(direct->Data(), direct->Data() + direct->Size());
+    ASSERT_EQ(piggyback_->AttachTo(*direct, child_), 2u);
+    EXPECT_TRUE(piggyback_->ExtractFrom(*direct, parent_.WithPort(6000)));
+    EXPECT_EQ(std::vector<uint8_t>(direct->Data(), direct->Data() + direct->Size()), original);
+    EXPECT_EQ(received_.size(), 2u);
+
+    // 中継ノードが暗号文ごと転送したものは、拡張を取り除くが処理しない
+    piggyback_->Submit(heartbeat, child_, std::chrono::milliseconds(100));
+    auto relayed = hcs_media::AcquireDummyRtpPacket(1200, 2);
+    ASSERT_EQ(piggyback_->AttachTo(*relayed, child_), 1u);
+    EXPECT_TRUE(piggyback_->ExtractFrom(*relayed, child_));
+    EXPECT_EQ(relayed->Size(), original.size());
+    EXPECT_EQ(received_.size(), 2u);
+    EXPECT_EQ(piggyback_->GetStats().relayed, 1u);
+    EXPECT_EQ(piggyback_->GetStats().extracted, 3u);
+}
+
+} // namespace
@@ -0,0 +1,80 @@
+// DuplicateFilter のウィンドウ境界のテスト。
+
+#include <gtest/gtest.h>
+#include "hcs_net/DuplicateFilter.h"
+
+namespace {
+
+using hcs_net::DuplicateFilter;
+using hcs_net::DEDUP_WINDOW_BITS;
+
+TEST(DuplicateFilterTest, UnknownStreamIsNotDuplicate) {
+    DuplicateFilter filter;
+    EXPECT_FALSE(filter.IsDuplicate(1, 0));
+    EXPECT_FALSE(filter.IsDuplicate(1, 12345));
+}
+
+TEST(DuplicateFilterTest, MarkedSequenceIsDuplicatePerStream) {
+    DuplicateFilter filter;
+    filter.Mark(1, 100);
+    EXPECT_TRUE(filter.IsDuplicate(1, 100));
+    EXPECT_FALSE(filter.IsDuplicate(1, 99));
+    EXPECT_FALSE(filter.IsDuplicate(1, 101));
+    EXPECT_FALSE(filter.IsDuplicate(2, 100));
+}
+
+TEST(DuplicateFilterTest, OldestSequenceInsideWindowIsTracked) {
+    DuplicateFilter filter;
+    const uint64_t highest = 5000;
+    filter.Mark(1, highest);
+    const uint64_t oldest = highest - (DEDUP_WINDOW_BITS - 1);
+    EXPECT_FALSE(filter.IsDuplicate(1, oldest));
+    filter.Mark(1, oldest);
+    EXPECT_TRUE(filter.IsDuplicate(1, oldest));
+    EXPECT_TRUE(filter.IsDuplicate(1, highest));
+}
+
+TEST(DuplicateFilterTest, SequenceOutsideWindowIsRejected) {
+    DuplicateFilter filter;
+    const uint64_t highest = 5000;
+    filter.Mark(1, highest);
+    EXPECT_TRUE(filter.IsDuplicate(1, highest - DEDUP_WINDOW_BITS));
+    // ウィンドウ外の記録は無視され、ウィンドウ内の状態を壊さない
+    filter.Mark(1, highest - DEDUP_WINDOW_BITS);
+    EXPECT_FALSE(filter.IsDuplicate(1, highest - 1));
+}
+
+TEST(DuplicateFilterTest, AdvancingClearsReusedBits) {
+    DuplicateFilter filter;
+    filter.Mark(1, 10);
+    filter.Mark(1, 10 + DEDUP_WINDOW_BITS - 1);
+    EXPECT_TRUE(filter.IsDuplicate(1, 10));
+    EXPECT_FALSE(filter.IsDuplicate(1, 11));
+    // 10 と同じビット位置を使う 10 + DEDUP_WINDOW_BITS を記録すると、10 は窓の外になり
+    // ビットは新しい番号のものとして扱われる
+    filter.Mark(1, 10 + DEDUP_WINDOW_BITS);
+    EXPECT_TRUE(filter.IsDuplicate(1, 10 + DEDUP_WINDOW_BITS));
+    EXPECT_FALSE(filter.IsDuplicate(1, 11));
+    filter.Mark(1, 11 + DEDUP_WINDOW_BITS);
+    EXPECT_TRUE(filter.IsDuplicate(1, 11 + DEDUP_WINDOW_BITS));
+    EXPECT_FALSE(filter.IsDuplicate(1, 12));
+}
+
+TEST(DuplicateFilterTest, LargeJumpResetsWindow) {
+    DuplicateFilter filter;
+    for (uint64_t seq = 0; seq < 64; ++seq) filter.Mark(1, seq);
+    const uint64_t jumped = 64 + 10 * DEDUP_WINDOW_BITS;
+    filter.Mark(1, jumped);
+    EXPECT_TRUE(filter.IsDuplicate(1, jumped));
+    EXPECT_FALSE(filter.IsDuplicate(1, jumped - 1));
+    EXPECT_FALSE(filter.IsDuplicate(1, jumped - (DEDUP_WINDOW_BITS - 1)));
+}
+
+TEST(DuplicateFilterTest, ResetForgetsStreams) {
+    DuplicateFilter filter;
+    filter.Mark(1, 7);
+    filter.Reset();
+    EXPECT_FALSE(filter.IsDuplicate(1, 7));
+}
+
+} // namespace
@@ -0,0 +1,74 @@
+// Endpoint の文字列解析とスコープIDのテスト。
+
+#include <gtest/gtest.h>
+#include <net/if.h>
+#include "hcs_net/common.h"
+
+namespace {
+
+using hcs_net::Endpoint;
+
+TEST(EndpointTest, ParsesIPv4AsMappedAddress) {
+    Endpoint ep;
+    ASSERT_TRUE(Endpoint::Parse("192.0.2.10", 5004, ep));
+    EXPECT_TRUE(ep.IsV4());
+    EXPECT_EQ(ep.Address(), "192.0.2.10");
+    EXPECT_EQ(ep.ToString(), "192.0.2.10:5004");
+    EXPECT_EQ(ep.address[10], 0xFF);
+    EXPECT_EQ(ep.address[11], 0xFF);
+}
+
+TEST(EndpointTest, ParsesIPv6) {
+    Endpoint ep;
+    ASSERT_TRUE(Endpoint::Parse("2001:db8::1", 5005, ep));
+    EXPECT_FALSE(ep.IsV4());
+    EXPECT_EQ(ep.scope_id, 0u);
+    EXPECT_EQ(ep.ToString(), "[2001:db8::1]:5005");
+}
+
+TEST(EndpointTest, ParsesNumericAndNamedScope) {
+    Endpoint numeric;
+    ASSERT_TRUE(Endpoint::Parse("fe80::1%7", 5004, numeric));
+    EXPECT_EQ(numeric.scope_id, 7u);
+    EXPECT_EQ(numeric.Address(), "fe80::1%7");
+
+    const unsigned int lo = if_nametoindex("lo");
+    if (lo == 0) GTEST_SKIP() << "loopback interface 'lo' not found";
+    Endpoint named;
+    ASSERT_TRUE(Endpoint::Parse("fe80::1%lo", 5004, named));
+    EXPECT_EQ(named.scope_id, lo);
+    EXPECT_TRUE(named.SameHost(Endpoint("fe80::1%" + std::to_string(lo), 1)));
+}
+
+TEST(EndpointTest, RejectsInvalidInputWithoutTouchingOutput) {
+    Endpoint ep("192.0.2.1", 1);
+    const Endpoint before = ep;
+    EXPECT_FALSE(Endpoint::Parse("not-an-address", 5004, ep));
+    EXPECT_FALSE(Endpoint::Parse("192.0.2.256", 5004, ep));
+    EXPECT_FALSE(Endpoint::Parse("fe80::1%no-such-interface0", 5004, ep));
+    EXPECT_FALSE(Endpoint::Parse("fe80::1%", 5004, ep));
+    EXPECT_EQ(ep, before);
+    EXPECT_THROW(Endpoint("bogus", 1), std::invalid_argument);
+}
+
+TEST(EndpointTest, AddressRoundTrips) {
+    for (const std::string text : {"127.0.0.1", "239.255.0.1", "::1", "ff02::1%1", "2001:db8::abcd"}) {
+        Endpoint ep;
+        ASSERT_TRUE(Endpoint::Parse(text, 9, ep)) << text;
+        Endpoint again;
+        ASSERT_TRUE(Endpoint::Parse(ep.Address(), 9, again)) << text;
+        EXPECT_EQ(ep, again) << text;
+    }
+}
+
+TEST(EndpointTest, ComparisonIgnoresPortOnlyForSameHost) {
+    const Endpoint a("192.0.2.1", 5004);
+    const Endpoint b = a.WithPort(5005);
+    EXPECT_TRUE(a.SameHost(b));
+    EXPECT_NE(a, b);
+    EXPECT_TRUE(a < b);
+    EXPECT_FALSE(a.SameHost(Endpoint("::ffff:192.0.2.2", 5004)));
+    EXPECT_EQ(a, Endpoint("::ffff:192.0.2.1", 5004));
+}
+
+} // namespace
@@ -0,0 +1,254 @@
+// ループバック上の HCSNode の結合テスト (制御メッセージの相乗り、起動失敗、計画停止のハンドオフ)。
+
+#include <gtest/gtest.h>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <thread>
+#include <unistd.h>
+#include "HCSNode.h"
+#include "hcs_control/ControlMessages.h"
+#include "hcs_net/ControlUdpTransport.h"
+
+namespace {
+
+const std::string kGroup = "G1";
+const std::string kSalt = "00112233445566778899aabbccddeeff";
+constexpr uint16_t kBasePort = 47900;
+
+/**
+ * @brief 自身のスレッドで io_context を回す HCSNode。
+ */
+class TestNode {
+public:
+    explicit TestNode(std::vector<std::string> overrides)
+        : work_(boost::asio::make_work_guard(io_)),
+          node_(std::make_shared<hcs::HCSNode>(
+              io_, std::make_shared<hcs_common::NodeConfigStore>("", std::move(overrides)))) {}
+
+    ~TestNode() { Stop(); }
+
+    hcs::HCSNode& Get() { return *node_; }
+
+    /**
+     * @brief ノードのスレッドで Start() してから io_context を回す (起動の完了まで待つ)。
+     */
+    void Start() {
+        std::promise<void> started;
+        auto future = started.get_future();
+        thread_ = std::thread([this, &started]() {
+            try {
+                node_->Start();
+                started.set_value();
+            } catch (...) {
+                started.set_exception(std::current_exception());
+                work_.reset();
+            }
+            io_.run();
+        });
+        future.get();
+    }
+
+    /**
+     * @brief ドレインを経て停止し、スレッドの終了を待つ。
+     */
+    void Stop() {
+        if (!thread_.joinable()) return;
+        boost::asio::post(io_, [this]() { node_->Stop([this]() { io_.stop(); }); });
+        thread_.join();
+    }
+
+private:
+    boost::asio::io_context io_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
+    std::shared_ptr<hcs::HCSNode> node_;
+    std::thread thread_;
+};
+
+/**
+ * @brief 子ノードに代わって制御メッセージを送受信するソケット (ループバックの空きポート)。
+ */
+class ControlPeer {
+public:
+    uint16_t Port() const { return socket_.local_endpoint().port(); }
+
+    void Send(const std::vector<uint8_t>& message, uint16_t port) {
+        socket_.send_to(boost::asio::buffer(message),
+                        boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+    }
+
+    /**
+     * @brief 期限までに受信したメッセージ (バンドルは分解する) のうち、type が一致する最初のものを返す。
+     * @return 期限までに届かなければfalse
+     */
+    bool Receive(uint8_t type, std::chrono::milliseconds timeout, std::vector<uint8_t>& out) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline) {
+            std::vector<uint8_t> datagram(2048);
+            size_t received = 0;
+            boost::asio::ip::udp::endpoint sender;
+            socket_.async_receive_from(boost::asio::buffer(datagram), sender,
+                                       [&received](const boost::system::error_code& ec, size_t n) {
+                                           if (!ec) received = n;
+                                       });
+            io_.restart();
+            io_.run_until(deadline);
+            if (!io_.stopped()) {
+                socket_.cancel();
+                io_.restart();
+                io_.run();
+            }
+            datagram.resize(received);
+            for (auto& message : Split(datagram)) {
+                if (!message.empty() && message[0] == type) {
+                    out = std::move(message);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    boost::asio::io_context io_;
+    boost::asio::ip::udp::socket socket_{io_, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0)};
+
+    static std::vector<std::vector<uint8_t>> Split(const std::vector<uint8_t>& datagram) {
+        if (datagram.empty() || datagram[0] != hcs_net::CONTROL_BUNDLE_TYPE) return {datagram};
+        std::vector<std::vector<uint8_t>> messages;
+        for (size_t pos = 1; pos + 2 <= datagram.size();) {
+            const size_t size = (static_cast<size_t>(datagram[pos]) << 8) | datagram[pos + 1];
+            pos += 2;
+            if (pos + size > datagram.size()) break;
+            messages.emplace_back(datagram.begin() + pos, datagram.begin() + pos + size);
+            pos += size;
+        }
+        return messages;
+    }
+};
+
+/**
+ * @brief 一時パスフレーズファイルと、ノードごとの設定の組み立て。
+ */
+class HCSNodeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char path[] = "/tmp/hcs_test_passphraseXXXXXX";
+        const int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        passphrase_file_ = path;
+        std::ofstream(passphrase_file_) << "correct horse battery staple\n";
+    }
+
+    void TearDown() override { std::remove(passphrase_file_.c_str()); }
+
+    /**
+     * @brief media_port と media_port + 1 (制御) を使うノードの設定。
+     */
+    std::vector<std::string> Overrides(const std::string& id, uint16_t media_port,
+                                       const std::vector<std::string>& extra = {}) const {
+        std::vector<std::string> overrides{
+            "node.id=" + id,
+            "node.address=127.0.0.1",
+            "node.log_level=error",
+            "transport.media_port=" + std::to_string(media_port),
+            "transport.control_port=" + std::to_string(media_port + 1),
+            "crypto.passphrase_file=" + passphrase_file_,
+            "crypto.salt=" + kSalt,
+            "timeouts.handoff=0ms",
+        };
+        overrides.insert(overrides.end(), extra.begin(), extra.end());
+        return overrides;
+    }
+
+    /**
+     * @brief 受信ノードに代わって、送信ノードの制御ポートへ JOIN を送る
+     * (同一ホストの別の制御ポートにはディスカバリの ADVERTISE が届かないため)。
+     */
+    static void SendJoin(uint16_t parent_control_port, uint16_t child_media_port) {
+        boost::asio::io_context io;
+        boost::asio::ip::udp::socket socket(io, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        const std::vector<uint8_t> join = hcs_control::EncodeJoin(child_media_port, hcs_control::ALL_LAYERS, kGroup);
+        socket.send_to(boost::asio::buffer(join),
+                       boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), parent_control_port));
+    }
+
+    std::string passphrase_file_;
+};
+
+TEST_F(HCSNodeTest, HeartbeatsRideOnPublishedMedia) {
+    TestNode source(Overrides("source", kBasePort, {"groups.source=" + kGroup}));
+    TestNode child(Overrides("child", kBasePort + 2));
+    source.Start();
+    child.Start();
+    SendJoin(kBasePort + 1, kBasePort + 2);
+
+    // エンコーダのフレーム (約 33ms 間隔) が HEARTBEAT (500ms 間隔) の相乗りの待ち時間内に送られる
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    source.Stop();
+    child.Stop();
+
+    const hcs_net::PiggybackStats sent = source.Get().GetPiggybackStats();
+    const hcs_net::PiggybackStats received = child.Get().GetPiggybackStats();
+    EXPECT_GT(sent.piggybacked, 0u);
+    EXPECT_GT(received.extracted, 0u);
+    EXPECT_EQ(received.relayed, 0u);
+}
+
+TEST_F(HCSNodeTest, StartFailsWhenControlPortIsInUse) {
+    TestNode first(Overrides("first", kBasePort + 10));
+    first.Start();
+    // 制御ポートだけを first と重ねる
+    TestNode second(Overrides("second", kBasePort + 12, {"transport.control_port=" + std::to_string(kBasePort + 11)}));
+    EXPECT_THROW(second.Start(), std::runtime_error);
+    EXPECT_EQ(second.Get().State(), hcs::LifecycleState::kFailed);
+    EXPECT_EQ(second.Get().ComponentState(hcs::NodeComponent::kControlTransport), hcs::LifecycleState::kFailed);
+    EXPECT_EQ(first.Get().State(), hcs::LifecycleState::kRunning);
+}
+
+TEST_F(HCSNodeTest, HandoffFollowsDepartingJoinLeave) {
+    TestNode old_parent(Overrides("old", kBasePort + 20, {"groups.source=" + kGroup, "timeouts.handoff=3000ms"}));
+    TestNode new_parent(Overrides("new", kBasePort + 22));
+    old_parent.Start();
+    new_parent.Start();
+    // 同じアドレスの2つの子ノード (メディアポートと制御ポートがそれぞれ異なる)
+    ControlPeer first;
+    ControlPeer second;
+    first.Send(hcs_control::EncodeJoin(kBasePort + 30, hcs_control::ALL_LAYERS, kGroup), kBasePort + 21);
+    second.Send(hcs_control::EncodeJoin(kBasePort + 32, hcs_control::ALL_LAYERS, kGroup), kBasePort + 21);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const uint64_t unconfirmed = hcs::NodeLifecycleMetrics::Get().handoff_unconfirmed.Value();
+    auto stopped = std::async(std::launch::async, [&old_parent]() { old_parent.Stop(); });
+
+    // DEPARTING は JOIN の送信元 (子ノードの制御ポート) へ届く
+    std::vector<uint8_t> message;
+    ASSERT_TRUE(first.Receive(MSG_TYPE_DEPARTING, std::chrono::milliseconds(1000), message));
+    std::string group_id;
+    std::vector<std::string> recommended;
+    ASSERT_TRUE(hcs_control::DecodeDeparting(message, group_id, recommended));
+    EXPECT_EQ(group_id, kGroup);
+    ASSERT_TRUE(second.Receive(MSG_TYPE_DEPARTING, std::chrono::milliseconds(1000), message));
+
+    // 1つ目の子ノードは新しい親へ JOIN してから、停止する親へ LEAVE を返す
+    first.Send(hcs_control::EncodeJoin(kBasePort + 30, hcs_control::ALL_LAYERS, kGroup), kBasePort + 23);
+    first.Send(hcs_control::EncodeLeave(kBasePort + 30, kGroup), kBasePort + 21);
+    // 新しい親の HEARTBEAT も JOIN の送信元へ届く (メディアがないため相乗りせずに送られる)
+    EXPECT_TRUE(first.Receive(MSG_TYPE_HEARTBEAT, std::chrono::milliseconds(2000), message));
+
+    // LEAVE はメディアポートの一致する購読だけを削除するため、もう一方への予告の再送は続く
+    EXPECT_EQ(stopped.wait_for(std::chrono::milliseconds(0)), std::future_status::timeout);
+    EXPECT_TRUE(second.Receive(MSG_TYPE_DEPARTING, std::chrono::milliseconds(500), message));
+
+    second.Send(hcs_control::EncodeLeave(kBasePort + 32, kGroup), kBasePort + 21);
+    EXPECT_EQ(stopped.wait_for(std::chrono::milliseconds(1500)), std::future_status::ready);
+    stopped.get();
+    EXPECT_EQ(old_parent.Get().State(), hcs::LifecycleState::kStopped);
+    EXPECT_EQ(hcs::NodeLifecycleMetrics::Get().handoff_unconfirmed.Value(), unconfirmed);
+    new_parent.Stop();
+}
+
+} // namespace
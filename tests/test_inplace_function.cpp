@@ -0,0 +1,112 @@
+// InplaceFunction の複製・ムーブ・代入で捕捉した状態が正しく構築・破棄されることのテスト。
+
+#include <gtest/gtest.h>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "hcs_common/InplaceFunction.h"
+
+namespace {
+
+using hcs_common::InplaceFunction;
+
+/**
+ * @brief 生存中のインスタンス数を数える呼び出し可能オブジェクト。
+ */
+struct Tracked {
+    static int live;
+    int value;
+
+    explicit Tracked(int v) : value(v) { ++live; }
+    Tracked(const Tracked& other) : value(other.value) { ++live; }
+    Tracked(Tracked&& other) noexcept : value(other.value) { ++live; }
+    ~Tracked() { --live; }
+
+    int operator()(int x) const { return value + x; }
+};
+int Tracked::live = 0;
+
+class InplaceFunctionTest : public ::testing::Test {
+protected:
+    void SetUp() override { Tracked::live = 0; }
+    void TearDown() override { EXPECT_EQ(Tracked::live, 0); }
+};
+
+TEST_F(InplaceFunctionTest, EmptyCallThrows) {
+    InplaceFunction<int(int)> empty;
+    EXPECT_FALSE(empty);
+    EXPECT_THROW(empty(1), std::bad_function_call);
+    InplaceFunction<int(int)> null = nullptr;
+    EXPECT_THROW(null(1), std::bad_function_call);
+}
+
+TEST_F(InplaceFunctionTest, CopyDuplicatesCapturedState) {
+    InplaceFunction<int(int)> original = Tracked(10);
+    EXPECT_EQ(Tracked::live, 1);
+    InplaceFunction<int(int)> copy(original);
+    EXPECT_EQ(Tracked::live, 2);
+    EXPECT_EQ(original(1), 11);
+    EXPECT_EQ(copy(2), 12);
+
+    // 状態を持つラムダの複製は独立して変化する
+    int calls = 0;
+    InplaceFunction<int()> counter = [n = 0, &calls]() mutable { ++calls; return ++n; };
+    EXPECT_EQ(counter(), 1);
+    InplaceFunction<int()> counter_copy = counter;
+    EXPECT_EQ(counter(), 2);
+    EXPECT_EQ(counter_copy(), 2);
+    EXPECT_EQ(calls, 3);
+}
+
+TEST_F(InplaceFunctionTest, MoveLeavesSourceEmpty) {
+    InplaceFunction<int(int)> source = Tracked(5);
+    InplaceFunction<int(int)> moved(std::move(source));
+    EXPECT_EQ(Tracked::live, 1);
+    EXPECT_FALSE(source);
+    EXPECT_THROW(source(0), std::bad_function_call);
+    EXPECT_EQ(moved(1), 6);
+
+    InplaceFunction<int(int)> target = Tracked(100);
+    EXPECT_EQ(Tracked::live, 2);
+    target = std::move(moved);
+    // 代入先の元の内容は破棄される
+    EXPECT_EQ(Tracked::live, 1);
+    EXPECT_FALSE(moved);
+    EXPECT_EQ(target(1), 6);
+}
+
+TEST_F(InplaceFunctionTest, CopyAssignmentReplacesAndSelfAssignmentKeeps) {
+    InplaceFunction<int(int)> a = Tracked(1);
+    InplaceFunction<int(int)> b = Tracked(2);
+    a = b;
+    EXPECT_EQ(Tracked::live, 2);
+    EXPECT_EQ(a(0), 2);
+    EXPECT_EQ(b(0), 2);
+
+    InplaceFunction<int(int)>& alias = a;
+    a = alias;
+    a = std::move(alias);
+    EXPECT_EQ(Tracked::live, 2);
+    EXPECT_EQ(a(0), 2);
+
+    a = nullptr;
+    EXPECT_FALSE(a);
+    EXPECT_EQ(Tracked::live, 1);
+}
+
+TEST_F(InplaceFunctionTest, CapturedSharedPtrIsReleasedWithLastCopy) {
+    auto state = std::make_shared<int>(7);
+    std::weak_ptr<int> weak = state;
+    InplaceFunction<int()> f = [state]() { return *state; };
+    state.reset();
+    {
+        InplaceFunction<int()> copy = f;
+        InplaceFunction<int()> moved = std::move(f);
+        EXPECT_EQ(weak.use_count(), 2);
+        EXPECT_EQ(copy(), 7);
+        EXPECT_EQ(moved(), 7);
+    }
+    EXPECT_TRUE(weak.expired());
+}
+
+} // namespace
@@ -0,0 +1,91 @@
+// LatencyHistogram のバケット境界 (相対精度) と、分位点・件数の集計のテスト。
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "hcs_common/LatencyHistogram.h"
+
+namespace {
+
+using hcs_common::LATENCY_BUCKET_COUNT;
+using hcs_common::LATENCY_MAX_VALUE_BITS;
+using hcs_common::LatencyHistogram;
+
+constexpr uint64_t kMaxValue = (uint64_t{1} << LATENCY_MAX_VALUE_BITS) - 1;
+
+TEST(LatencyHistogramTest, SmallValuesHaveExactBuckets) {
+    for (uint64_t v = 0; v < 128; ++v) {
+        const size_t index = LatencyHistogram::BucketIndex(v);
+        EXPECT_EQ(LatencyHistogram::BucketLowerBound(index), v);
+        EXPECT_EQ(LatencyHistogram::BucketUpperBound(index), v);
+    }
+}
+
+TEST(LatencyHistogramTest, BucketsCoverValuesWithBoundedRelativeError) {
+    std::vector<uint64_t> values{128, 129, 255, 256, 1000, 999'999, 1'000'000, 123'456'789, kMaxValue};
+    for (int bit = 7; bit < LATENCY_MAX_VALUE_BITS; ++bit) {
+        values.push_back(uint64_t{1} << bit);
+        values.push_back((uint64_t{1} << bit) - 1);
+        values.push_back((uint64_t{1} << bit) + 1);
+    }
+    for (uint64_t v : values) {
+        const size_t index = LatencyHistogram::BucketIndex(v);
+        ASSERT_LT(index, LATENCY_BUCKET_COUNT) << v;
+        const uint64_t lower = LatencyHistogram::BucketLowerBound(index);
+        const uint64_t upper = LatencyHistogram::BucketUpperBound(index);
+        EXPECT_LE(lower, v);
+        EXPECT_GE(upper, v);
+        // バケット幅は下限の 1/64 以下
+        EXPECT_LE(upper - lower + 1, lower / 64) << v;
+    }
+    // 最大値は最後のバケットに入る (使われないバケットを確保しない)
+    EXPECT_EQ(LatencyHistogram::BucketIndex(kMaxValue), LATENCY_BUCKET_COUNT - 1);
+}
+
+TEST(LatencyHistogramTest, AdjacentBucketsAreContiguous) {
+    for (size_t i = 0; i + 1 < LATENCY_BUCKET_COUNT; ++i) {
+        ASSERT_EQ(LatencyHistogram::BucketUpperBound(i) + 1, LatencyHistogram::BucketLowerBound(i + 1)) << i;
+    }
+}
+
+TEST(LatencyHistogramTest, QuantilesTrackUniformDistribution) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.Percentile(0.5), 0u);
+    for (int64_t v = 1; v <= 100'000; ++v) histogram.Record(v * 1000);
+    EXPECT_EQ(histogram.Count(), 100'000u);
+    EXPECT_EQ(histogram.Sum(), uint64_t{1000} * 100'000 * 100'001 / 2);
+
+    const double quantiles[] = {0.5, 0.99, 0.999};
+    const double expected[] = {50'000'000.0, 99'000'000.0, 99'900'000.0};
+    uint64_t values[3];
+    EXPECT_EQ(histogram.Quantiles(quantiles, values, 3), 100'000u);
+    for (int i = 0; i < 3; ++i) EXPECT_NEAR(static_cast<double>(values[i]), expected[i], expected[i] * 0.016) << quantiles[i];
+}
+
+TEST(LatencyHistogramTest, ClampsOutOfRangeValues) {
+    LatencyHistogram histogram;
+    histogram.Record(-5);
+    EXPECT_EQ(histogram.Percentile(1.0), 0u);
+    histogram.Record(INT64_MAX);
+    EXPECT_EQ(histogram.Sum(), kMaxValue);
+    EXPECT_GE(histogram.Percentile(1.0), LatencyHistogram::BucketLowerBound(LATENCY_BUCKET_COUNT - 1));
+}
+
+TEST(LatencyHistogramTest, AggregatesShardsAcrossThreads) {
+    LatencyHistogram histogram;
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 10'000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&histogram]() {
+            for (int i = 0; i < kPerThread; ++i) histogram.Record(1000);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(histogram.Count(), uint64_t{kThreads} * kPerThread);
+    EXPECT_EQ(histogram.Sum(), uint64_t{kThreads} * kPerThread * 1000);
+    EXPECT_NEAR(static_cast<double>(histogram.Percentile(0.5)), 1000.0, 1000.0 * 0.016);
+}
+
+} // namespace
@@ -0,0 +1,112 @@
+// 非同期ロガーのリングバッファ (満杯時の破棄と件数) と、書式化・レート制限のテスト。
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include "hcs_common/Logger.h"
+
+namespace {
+
+using hcs_common::LOG_RING_CAPACITY;
+using hcs_common::LogRecord;
+using hcs_common::LogRing;
+
+/**
+ * @brief レコードを確保して公開する (成功した場合はtrue)。
+ */
+bool Push(LogRing& ring, uint32_t value) {
+    LogRecord* record = ring.TryClaim();
+    if (!record) return false;
+    record->suppressed = value;
+    ring.Commit();
+    return true;
+}
+
+TEST(LogRingTest, DropsAndCountsWhenFull) {
+    auto ring = std::make_unique<LogRing>();
+    for (uint32_t i = 0; i < LOG_RING_CAPACITY; ++i) ASSERT_TRUE(Push(*ring, i));
+    // 満杯ではブロックせずに破棄し、件数だけを数える
+    EXPECT_FALSE(Push(*ring, 0));
+    EXPECT_FALSE(Push(*ring, 0));
+    EXPECT_EQ(ring->TakeDropped(), 2u);
+    EXPECT_EQ(ring->TakeDropped(), 0u);
+
+    uint32_t expected = 0;
+    const size_t drained = ring->Drain([&](const LogRecord& record) { EXPECT_EQ(record.suppressed, expected++); });
+    EXPECT_EQ(drained, LOG_RING_CAPACITY);
+    EXPECT_TRUE(Push(*ring, 0));
+}
+
+TEST(LogRingTest, DrainsInOrderAcrossWraparound) {
+    auto ring = std::make_unique<LogRing>();
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    // 容量を何周かするまで、書き込みと排出を交互に行う
+    for (int round = 0; round < 5; ++round) {
+        for (size_t i = 0; i < LOG_RING_CAPACITY - 1; ++i) ASSERT_TRUE(Push(*ring, next++));
+        ring->Drain([&](const LogRecord& record) { EXPECT_EQ(record.suppressed, expected++); });
+    }
+    EXPECT_EQ(expected, next);
+    EXPECT_EQ(ring->TakeDropped(), 0u);
+}
+
+/**
+ * @brief ロガーの出力を一時ファイルへ向け、Flush() 後の内容を読む。
+ */
+class LoggerOutputTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        out_ = std::tmpfile();
+        ASSERT_NE(out_, nullptr);
+        hcs_common::Logger::Instance().Flush();
+        hcs_common::Logger::Instance().SetOutput(out_);
+    }
+
+    void TearDown() override {
+        hcs_common::Logger::Instance().Flush();
+        hcs_common::Logger::Instance().SetOutput(nullptr);
+        std::fclose(out_);
+    }
+
+    std::string Output() {
+        hcs_common::Logger::Instance().Flush();
+        std::fflush(out_);
+        std::rewind(out_);
+        std::string text;
+        char buf[512];
+        size_t n;
+        while ((n = std::fread(buf, 1, sizeof(buf), out_)) > 0) text.append(buf, n);
+        return text;
+    }
+
+    std::FILE* out_ = nullptr;
+};
+
+TEST_F(LoggerOutputTest, FormatsArgumentsInPlaceholders) {
+    HCS_LOG_INFO("Test", "int={} uint={} str={} bool={} char={} extra={}", -3, 7u, std::string("abc"), true, 'x');
+    const std::string text = Output();
+    EXPECT_NE(text.find(" INFO [Test] int=-3 uint=7 str=abc bool=true char=x extra={}\n"), std::string::npos) << text;
+}
+
+TEST_F(LoggerOutputTest, MarksTruncatedArguments) {
+    HCS_LOG_WARN("Test", "long={}", std::string(hcs_common::LOG_ARG_CAPACITY * 2, 'a'));
+    const std::string text = Output();
+    EXPECT_NE(text.find(" WARN [Test] long=aaaa"), std::string::npos) << text;
+    EXPECT_NE(text.find(" [truncated]\n"), std::string::npos) << text;
+}
+
+TEST_F(LoggerOutputTest, RateLimitedSiteReportsSuppressedCount) {
+    // 呼び出し箇所ごとに制限されるため、同じ箇所から出力する
+    auto log = [](int i) { HCS_LOG_RATE_LIMITED(hcs_common::LogLevel::kWarn, 50, "Test", "limited {}", i); };
+    for (int i = 0; i < 5; ++i) log(i);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    log(5);
+    const std::string text = Output();
+    EXPECT_NE(text.find("limited 0\n"), std::string::npos) << text;
+    EXPECT_EQ(text.find("limited 1"), std::string::npos) << text;
+    EXPECT_NE(text.find("limited 5 [suppressed 4 similar]\n"), std::string::npos) << text;
+}
+
+} // namespace
@@ -0,0 +1,81 @@
+// MemoryTransport の受信キュー (BoundedMpscQueue) の満杯時の失敗、順序、複数生産者からの投入のテスト。
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "hcs_net/MemoryTransport.h"
+
+namespace {
+
+using hcs_net::BoundedMpscQueue;
+
+TEST(BoundedMpscQueueTest, RejectsNonPowerOfTwoCapacity) {
+    EXPECT_THROW(BoundedMpscQueue<int>(0), std::invalid_argument);
+    EXPECT_THROW(BoundedMpscQueue<int>(6), std::invalid_argument);
+    EXPECT_NO_THROW(BoundedMpscQueue<int>(8));
+}
+
+TEST(BoundedMpscQueueTest, FailsWithoutConsumingValueWhenFull) {
+    BoundedMpscQueue<std::unique_ptr<int>> queue(4);
+    std::unique_ptr<int> out;
+    EXPECT_FALSE(queue.TryPop(out));
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(queue.TryPush(std::make_unique<int>(i)));
+
+    // 満杯ではブロックせず失敗し、渡した値は呼び出し側に残る
+    auto rejected = std::make_unique<int>(99);
+    EXPECT_FALSE(queue.TryPush(std::move(rejected)));
+    ASSERT_NE(rejected, nullptr);
+    EXPECT_EQ(*rejected, 99);
+
+    ASSERT_TRUE(queue.TryPop(out));
+    EXPECT_EQ(*out, 0);
+    EXPECT_TRUE(queue.TryPush(std::move(rejected)));
+}
+
+TEST(BoundedMpscQueueTest, PopsInOrderAcrossWraparound) {
+    BoundedMpscQueue<int> queue(4);
+    int next = 0;
+    int expected = 0;
+    // 容量を何周かするまで、書き込みと取り出しを交互に行う
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 3; ++i) ASSERT_TRUE(queue.TryPush(int{next++}));
+        int out = -1;
+        while (queue.TryPop(out)) EXPECT_EQ(out, expected++);
+    }
+    EXPECT_EQ(expected, next);
+}
+
+TEST(BoundedMpscQueueTest, DeliversEveryItemFromConcurrentProducers) {
+    constexpr int kProducers = 4;
+    constexpr int kPerProducer = 20'000;
+    BoundedMpscQueue<int> queue(64);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < kPerProducer; ++i) {
+                while (!queue.TryPush(p * kPerProducer + i)) std::this_thread::yield();
+            }
+        });
+    }
+
+    // 生産者ごとの順序は保たれ、取りこぼしも重複もない
+    std::vector<int> next(kProducers, 0);
+    int received = 0;
+    while (received < kProducers * kPerProducer) {
+        int value = 0;
+        if (!queue.TryPop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        const int producer = value / kPerProducer;
+        ASSERT_EQ(value % kPerProducer, next[producer]++);
+        ++received;
+    }
+    for (auto& producer : producers) producer.join();
+    int value = 0;
+    EXPECT_FALSE(queue.TryPop(value));
+}
+
+} // namespace
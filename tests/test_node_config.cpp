@@ -0,0 +1,99 @@
+// NodeConfigLoader の検証エラーのテスト。
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include "hcs_common/NodeConfig.h"
+
+namespace {
+
+using hcs_common::NodeConfig;
+using hcs_common::NodeConfigLoader;
+
+const std::string kSalt = "00112233445566778899aabbccddeeff";
+
+/**
+ * @brief テストごとに一時パスフレーズファイルを用意する。
+ */
+class NodeConfigTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char path[] = "/tmp/hcs_test_passphraseXXXXXX";
+        const int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        passphrase_file_ = path;
+        std::ofstream(passphrase_file_) << "correct horse battery staple\n";
+    }
+
+    void TearDown() override { std::remove(passphrase_file_.c_str()); }
+
+    /**
+     * @brief 鍵設定を含む最小限の設定文字列に extra を加える。
+     */
+    std::string Config(const std::string& extra) const {
+        return "[crypto]\npassphrase_file = " + passphrase_file_ + "\nsalt = " + kSalt + "\n" + extra;
+    }
+
+    /**
+     * @brief 解析に失敗することを確認し、例外メッセージを返す。
+     */
+    std::string ParseError(const std::string& text, const std::vector<std::string>& overrides = {}) const {
+        try {
+            NodeConfigLoader::Parse(text, "test.conf", overrides);
+        } catch (const std::invalid_argument& e) {
+            return e.what();
+        }
+        ADD_FAILURE() << "Parse succeeded unexpectedly";
+        return "";
+    }
+
+    std::string passphrase_file_;
+};
+
+TEST_F(NodeConfigTest, AcceptsUnicastTransportAddress) {
+    const NodeConfig config = NodeConfigLoader::Parse(Config("[transport]\naddress = 192.0.2.10\n"), "test.conf");
+    EXPECT_EQ(config.transport.address, "192.0.2.10");
+    EXPECT_EQ(config.crypto.passphrase, "correct horse battery staple");
+    EXPECT_EQ(config.crypto.salt.size(), 16u);
+}
+
+TEST_F(NodeConfigTest, WildcardAddressRequiresNodeAddress) {
+    const std::string error = ParseError(Config(""));
+    EXPECT_NE(error.find("node.address is required"), std::string::npos) << error;
+
+    const NodeConfig config = NodeConfigLoader::Parse(Config("[node]\naddress = 192.0.2.10\n"), "test.conf");
+    EXPECT_EQ(config.transport.address, "::");
+    EXPECT_EQ(config.node_address, "192.0.2.10");
+}
+
+TEST_F(NodeConfigTest, RejectsNonUnicastNodeAddress) {
+    for (const std::string address : {"0.0.0.0", "::", "239.1.2.3", "ff02::1", "host.example"}) {
+        const std::string error = ParseError(Config("[node]\naddress = " + address + "\n"));
+        EXPECT_NE(error.find("node.address must be a unicast IP address"), std::string::npos) << address;
+    }
+}
+
+TEST_F(NodeConfigTest, ReportsAllValidationErrorsTogether) {
+    const std::string error = ParseError(
+        Config("[node]\naddress = 192.0.2.10\n[transport]\nmedia_port = 6000\ncontrol_port = 6000\n"),
+        {"crypto.salt=0011"});
+    EXPECT_NE(error.find("2 error(s)"), std::string::npos) << error;
+    EXPECT_NE(error.find("media_port and control_port must differ"), std::string::npos) << error;
+    EXPECT_NE(error.find("crypto.salt must be 16 bytes"), std::string::npos) << error;
+}
+
+TEST_F(NodeConfigTest, ReportsSyntaxErrorsWithLocation) {
+    const std::string error = ParseError(Config("[node]\naddress = 192.0.2.10\nbogus = 1\naddress = 192.0.2.11\n"));
+    EXPECT_NE(error.find("test.conf:6: unknown key node.bogus"), std::string::npos) << error;
+    EXPECT_NE(error.find("test.conf:7: duplicate key node.address"), std::string::npos) << error;
+}
+
+TEST_F(NodeConfigTest, RejectsEmptyPassphraseFile) {
+    std::ofstream(passphrase_file_, std::ios::trunc) << "\n";
+    const std::string error = ParseError(Config("[node]\naddress = 192.0.2.10\n"));
+    EXPECT_NE(error.find("is empty"), std::string::npos) << error;
+}
+
+} // namespace
@@ -0,0 +1,108 @@
+// PacketPool のスレッドローカルな再利用、他スレッドからの返却の回収、終了したスレッドのプールの引き継ぎのテスト。
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+#include "hcs_common/PacketBuffer.h"
+
+namespace {
+
+using hcs_common::PACKET_HEADROOM;
+using hcs_common::PACKET_POOL_CHUNK;
+using hcs_common::PacketBuffer;
+using hcs_common::PacketPool;
+using hcs_common::PacketPoolMetrics;
+using hcs_common::PacketRef;
+
+uint64_t HeapAllocations() { return PacketPoolMetrics::Get().heap_allocations.Value(); }
+
+/**
+ * @brief 別スレッドで fn を実行し、終了を待つ。
+ */
+template <typename Fn>
+void RunOnThread(Fn&& fn) {
+    std::thread thread(std::forward<Fn>(fn));
+    thread.join();
+}
+
+TEST(PacketPoolTest, ReusesBufferReleasedOnOwningThread) {
+    PacketPool& pool = PacketPool::Local();
+    pool.Reserve(1);
+    const uint64_t before = HeapAllocations();
+    PacketBuffer* first = nullptr;
+    {
+        PacketRef packet = pool.Acquire();
+        first = packet.Get();
+        packet->Append(100);
+        packet->SetReceiveTimestamp(42);
+    }
+    PacketRef again = pool.Acquire(16);
+    EXPECT_EQ(again.Get(), first);
+    // 再利用時は長さ・余白・受信時刻を初期化する
+    EXPECT_EQ(again->Size(), 0u);
+    EXPECT_EQ(again->Headroom(), 16u);
+    EXPECT_EQ(again->ReceiveTimestamp(), 0);
+    EXPECT_EQ(HeapAllocations(), before);
+}
+
+TEST(PacketPoolTest, SharedRefReturnsBufferOnLastRelease) {
+    PacketRef packet = PacketPool::Local().CopyFrom(reinterpret_cast<const uint8_t*>("abc"), 3);
+    EXPECT_TRUE(packet->Unique());
+    PacketRef copy = packet;
+    EXPECT_FALSE(packet->Unique());
+    packet.Reset();
+    EXPECT_TRUE(copy->Unique());
+    EXPECT_EQ(std::memcmp(copy->Data(), "abc", 3), 0);
+    EXPECT_EQ(copy->Headroom(), PACKET_HEADROOM);
+}
+
+TEST(PacketPoolTest, CollectsBuffersReleasedOnOtherThreads) {
+    // 空きリストを使い切る数を取得してから、すべてを別スレッドで返却する
+    constexpr size_t kCount = PACKET_POOL_CHUNK * 2;
+    std::vector<PacketRef> packets;
+    PacketPool& pool = PacketPool::Local();
+    for (size_t i = 0; i < kCount; ++i) packets.push_back(pool.Acquire());
+    std::set<PacketBuffer*> released;
+    for (const auto& packet : packets) released.insert(packet.Get());
+    RunOnThread([&packets]() { packets.clear(); });
+
+    // 返却されたバッファは所有スレッドが回収して再利用し、ヒープからは拡張しない
+    const uint64_t before = HeapAllocations();
+    size_t reused = 0;
+    for (size_t i = 0; i < kCount; ++i) {
+        packets.push_back(pool.Acquire());
+        reused += released.count(packets.back().Get());
+    }
+    EXPECT_EQ(HeapAllocations(), before);
+    EXPECT_GE(reused, kCount - PACKET_POOL_CHUNK);
+}
+
+TEST(PacketPoolTest, NewThreadAdoptsPoolOfExitedThread) {
+    PacketPool* exited_pool = nullptr;
+    PacketRef outstanding;
+    RunOnThread([&]() {
+        exited_pool = &PacketPool::Local();
+        outstanding = exited_pool->Acquire();
+    });
+    const PacketBuffer* buffer = outstanding.Get();
+    // 所有スレッドの終了後に返却されたバッファも、引き継いだスレッドが回収する
+    outstanding.Reset();
+
+    RunOnThread([&]() {
+        PacketPool& pool = PacketPool::Local();
+        EXPECT_EQ(&pool, exited_pool);
+        const uint64_t before = HeapAllocations();
+        std::vector<PacketRef> held;
+        bool found = false;
+        while (!found && HeapAllocations() == before) {
+            held.push_back(pool.Acquire());
+            found = held.back().Get() == buffer;
+        }
+        EXPECT_TRUE(found);
+    });
+}
+
+} // namespace
@@ -0,0 +1,86 @@
+// PhiAccrualDetector の閾値判定のテスト。
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include "hcs_control/PhiAccrualDetector.h"
+
+namespace {
+
+using hcs_control::PhiAccrualConfig;
+using hcs_control::PhiAccrualDetector;
+using Clock = PhiAccrualDetector::Clock;
+using std::chrono::milliseconds;
+
+/**
+ * @brief 一定間隔で count 回の生存シグナルを記録し、最終到着時刻を返す。
+ */
+Clock::time_point Train(PhiAccrualDetector& detector, Clock::time_point start, milliseconds interval, int count,
+                        size_t window_size = 100) {
+    Clock::time_point t = start;
+    for (int i = 0; i < count; ++i) {
+        detector.Heartbeat(t, window_size);
+        if (i + 1 < count) t += interval;
+    }
+    return t;
+}
+
+TEST(PhiAccrualTest, NoPhiUntilMinSamples) {
+    PhiAccrualConfig config;
+    PhiAccrualDetector detector;
+    const Clock::time_point start{};
+    // min_samples = 3 の間隔には4回の到着が必要
+    const auto last = Train(detector, start, milliseconds(100), 3);
+    EXPECT_FALSE(detector.HasEnoughSamples(config));
+    EXPECT_EQ(detector.Phi(last + std::chrono::seconds(10), config), 0.0);
+    detector.Heartbeat(last + milliseconds(100), config.window_size);
+    EXPECT_TRUE(detector.HasEnoughSamples(config));
+}
+
+TEST(PhiAccrualTest, PhiStaysLowAtExpectedInterval) {
+    PhiAccrualConfig config;
+    PhiAccrualDetector detector;
+    const auto last = Train(detector, Clock::time_point{}, milliseconds(100), 20);
+    EXPECT_LT(detector.Phi(last + milliseconds(100), config), config.suspect_phi);
+}
+
+TEST(PhiAccrualTest, PhiCrossesSuspectThenFailed) {
+    PhiAccrualConfig config;
+    PhiAccrualDetector detector;
+    const auto last = Train(detector, Clock::time_point{}, milliseconds(100), 20);
+
+    // 間隔 100ms・標準偏差の下限 20ms では、平均 + 約3σ で疑い、平均 + 約6σ で障害となる
+    milliseconds suspect_at{0}, failed_at{0};
+    double previous = 0.0;
+    for (milliseconds elapsed{0}; elapsed <= milliseconds(1000); elapsed += milliseconds(5)) {
+        const double phi = detector.Phi(last + elapsed, config);
+        EXPECT_GE(phi, previous); // 経過時間に対して単調に増える
+        previous = phi;
+        if (suspect_at.count() == 0 && phi >= config.suspect_phi) suspect_at = elapsed;
+        if (failed_at.count() == 0 && phi >= config.failed_phi) failed_at = elapsed;
+    }
+    EXPECT_GT(suspect_at, milliseconds(140));
+    EXPECT_LT(suspect_at, milliseconds(200));
+    EXPECT_GT(failed_at, suspect_at);
+    EXPECT_LT(failed_at, milliseconds(300));
+}
+
+TEST(PhiAccrualTest, AcceptablePauseDelaysDetection) {
+    PhiAccrualConfig config;
+    PhiAccrualDetector detector;
+    const auto last = Train(detector, Clock::time_point{}, milliseconds(100), 20);
+    const auto probe = last + milliseconds(250);
+    const double without_pause = detector.Phi(probe, config);
+    config.acceptable_pause = milliseconds(200);
+    EXPECT_GE(without_pause, config.failed_phi);
+    EXPECT_LT(detector.Phi(probe, config), config.suspect_phi);
+}
+
+TEST(PhiAccrualTest, ResetForgetsLearnedIntervals) {
+    PhiAccrualConfig config;
+    PhiAccrualDetector detector;
+    Train(detector, Clock::time_point{}, milliseconds(100), 20);
+    detector.Reset();
+    EXPECT_FALSE(detector.HasEnoughSamples(config));
+}
+
+} // namespace
@@ -0,0 +1,134 @@
+// SubscriptionTable の copy-on-write による更新と、差し替えたスナップショットの遅延解放のテスト。
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "hcs_control/SubscriptionTable.h"
+
+namespace {
+
+using hcs_control::ALL_LAYERS;
+using hcs_control::GroupSubscribers;
+using hcs_control::SubscriptionTable;
+using hcs_net::Endpoint;
+
+const Endpoint kChildA{"192.0.2.1", 5004};
+const Endpoint kChildB{"192.0.2.2", 5004};
+
+TEST(SubscriptionTableTest, RegisterGroupReturnsStableSlots) {
+    SubscriptionTable table(2);
+    const int g1 = table.RegisterGroup("G1");
+    const int g2 = table.RegisterGroup("G2");
+    EXPECT_NE(g1, g2);
+    EXPECT_EQ(table.RegisterGroup("G1"), g1);
+    EXPECT_EQ(table.FindGroup("G2"), g2);
+    EXPECT_EQ(table.FindGroup("G3"), -1);
+    // スロット配列は再確保しないため、上限を超える登録と JOIN は拒否する
+    EXPECT_EQ(table.RegisterGroup("G3"), -1);
+    EXPECT_FALSE(table.Join("G3", kChildA));
+    EXPECT_EQ(table.GroupCount(), 2u);
+}
+
+TEST(SubscriptionTableTest, JoinPublishesNewSnapshotWithoutTouchingOldOne) {
+    SubscriptionTable table;
+    ASSERT_TRUE(table.Join("G1", kChildB));
+    const int slot = table.FindGroup("G1");
+    const GroupSubscribers* before = table.Subscribers(slot);
+    ASSERT_NE(before, nullptr);
+
+    ASSERT_TRUE(table.Join("G1", kChildA));
+    const GroupSubscribers* after = table.Subscribers(slot);
+    ASSERT_NE(after, before);
+    // 読み手が保持していた古いスナップショットは変わらず、猶予の間は参照できる
+    ASSERT_EQ(before->children.size(), 1u);
+    EXPECT_EQ(before->children[0].endpoint, kChildB);
+    // 新しいスナップショットは送信先で整列している
+    ASSERT_EQ(after->children.size(), 2u);
+    EXPECT_EQ(after->children[0].endpoint, kChildA);
+    EXPECT_EQ(after->children[1].endpoint, kChildB);
+    EXPECT_EQ(table.RetiredCount(), 1u);
+}
+
+TEST(SubscriptionTableTest, RepeatedJoinOnlyRepublishesOnLayerChange) {
+    SubscriptionTable table;
+    ASSERT_TRUE(table.Join("G1", kChildA, 0x1));
+    const int slot = table.FindGroup("G1");
+    const GroupSubscribers* first = table.Subscribers(slot);
+
+    ASSERT_TRUE(table.Join("G1", kChildA, 0x1));
+    EXPECT_EQ(table.Subscribers(slot), first);
+    EXPECT_EQ(table.RetiredCount(), 0u);
+
+    ASSERT_TRUE(table.Join("G1", kChildA, 0x2));
+    const GroupSubscribers* updated = table.Subscribers(slot);
+    ASSERT_NE(updated, first);
+    ASSERT_EQ(updated->children.size(), 1u);
+    EXPECT_FALSE(updated->children[0].WantsLayer(0));
+    EXPECT_TRUE(updated->children[0].WantsLayer(1));
+    EXPECT_FALSE(updated->children[0].WantsLayer(40));
+}
+
+TEST(SubscriptionTableTest, JoinRecordsControlPort) {
+    SubscriptionTable table;
+    ASSERT_TRUE(table.Join("G1", kChildA, ALL_LAYERS, 6001));
+    const int slot = table.FindGroup("G1");
+    const GroupSubscribers* first = table.Subscribers(slot);
+    EXPECT_EQ(first->children[0].ControlEndpoint(), kChildA.WithPort(6001));
+
+    // JOIN の送信元ポートが変わった場合も新しいスナップショットを公開する
+    ASSERT_TRUE(table.Join("G1", kChildA, ALL_LAYERS, 6002));
+    const GroupSubscribers* updated = table.Subscribers(slot);
+    ASSERT_NE(updated, first);
+    EXPECT_EQ(updated->children[0].ControlEndpoint(), kChildA.WithPort(6002));
+}
+
+TEST(SubscriptionTableTest, LastLeaveClearsSlot) {
+    SubscriptionTable table;
+    ASSERT_TRUE(table.Join("G1", kChildA));
+    ASSERT_TRUE(table.Join("G1", kChildB));
+    const int slot = table.FindGroup("G1");
+
+    EXPECT_TRUE(table.Leave("G1", kChildA));
+    EXPECT_FALSE(table.Leave("G1", kChildA));
+    EXPECT_FALSE(table.Leave("G2", kChildB));
+    ASSERT_NE(table.Subscribers(slot), nullptr);
+    EXPECT_EQ(table.ActiveGroups().size(), 1u);
+
+    EXPECT_TRUE(table.Leave("G1", kChildB));
+    EXPECT_EQ(table.Subscribers(slot), nullptr);
+    EXPECT_TRUE(table.ActiveGroups().empty());
+    // スロットは解放せず、再度の JOIN でも同じ番号を使う
+    ASSERT_TRUE(table.Join("G1", kChildA));
+    EXPECT_EQ(table.FindGroup("G1"), slot);
+}
+
+TEST(SubscriptionTableTest, RemoveChildLeavesEveryGroup) {
+    SubscriptionTable table;
+    ASSERT_TRUE(table.Join("G1", kChildA));
+    ASSERT_TRUE(table.Join("G2", kChildA));
+    ASSERT_TRUE(table.Join("G2", kChildB, ALL_LAYERS));
+    EXPECT_EQ(table.RemoveChild(kChildA), 2u);
+    const auto active = table.ActiveGroups();
+    ASSERT_EQ(active.size(), 1u);
+    EXPECT_EQ(active[0].first, "G2");
+    ASSERT_EQ(active[0].second.size(), 1u);
+    EXPECT_EQ(active[0].second[0].endpoint, kChildB);
+}
+
+TEST(SubscriptionTableTest, RetiredSnapshotsAreReclaimedAfterGrace) {
+    SubscriptionTable table;
+    ASSERT_TRUE(table.Join("G1", kChildA));
+    ASSERT_TRUE(table.Join("G1", kChildB));
+    ASSERT_TRUE(table.Leave("G1", kChildA));
+    EXPECT_EQ(table.RetiredCount(), 2u);
+
+    // 猶予の間は読み手がまだ参照している可能性があるため解放しない
+    table.ReclaimRetired();
+    EXPECT_EQ(table.RetiredCount(), 2u);
+
+    std::this_thread::sleep_for(hcs_control::SUBSCRIPTION_RECLAIM_GRACE + std::chrono::milliseconds(50));
+    table.ReclaimRetired();
+    EXPECT_EQ(table.RetiredCount(), 0u);
+    ASSERT_NE(table.Subscribers(table.FindGroup("G1")), nullptr);
+}
+
+} // namespace
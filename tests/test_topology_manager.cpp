@@ -0,0 +1,221 @@
+// TopologyManager の親選定 (パスベクトルのループ拒否・深さ優先・シーケンス停滞) と、障害時・計画停止時の切り替えのテスト。
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include "hcs_control/TopologyManager.h"
+
+namespace {
+
+using hcs_control::AdvertiseMessage;
+using hcs_control::GroupRoute;
+using hcs_control::NodeMetrics;
+using hcs_control::TopologyManager;
+using hcs_control::TopologyMetrics;
+using Clock = std::chrono::steady_clock;
+
+const std::string kGroup = "G1";
+const std::string kSelf = "10.0.0.1";
+
+/**
+ * @brief 送信元までの経路 path を持つピア ip の ADVERTISE を作る。
+ */
+AdvertiseMessage MakeAdvertise(const std::string& ip, const std::vector<std::string>& path, uint32_t seq,
+                               int bandwidth = 50) {
+    AdvertiseMessage msg;
+    msg.ip = ip;
+    msg.metrics.bandwidth_score = bandwidth;
+    msg.metrics.stability_score = 50;
+    msg.metrics.rtt_ms = 10;
+    GroupRoute route;
+    route.hops_to_source = static_cast<int>(path.size()) - 1;
+    route.source_seq = seq;
+    route.path = path;
+    msg.groups.insert(kGroup);
+    msg.routes[kGroup] = route;
+    return msg;
+}
+
+TEST(TopologyManagerTest, SelectsAdvertisedParent) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.2");
+}
+
+TEST(TopologyManagerTest, RejectsRouteContainingSelf) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", {"10.0.0.2", kSelf, "10.0.0.3"}, 1));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "");
+}
+
+TEST(TopologyManagerTest, DropsParentWhoseRouteStartsLooping) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", {"10.0.0.2", "10.0.0.3"}, 1));
+    ASSERT_EQ(topology.SelectBestParent(kGroup), "10.0.0.3");
+    // 親が自ノードの下に付け替わった経路を通知したら、選定から外す
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", {"10.0.0.2", kSelf, "10.0.0.3"}, 2));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "");
+}
+
+TEST(TopologyManagerTest, RejectsRouteBeyondMaxDepth) {
+    TopologyManager topology(kSelf);
+    topology.SetMaxTreeDepth(2);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.4", {"10.0.0.2", "10.0.0.3", "10.0.0.4"}, 1));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "");
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", {"10.0.0.2", "10.0.0.3"}, 1));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.3");
+}
+
+TEST(TopologyManagerTest, ShallowerRouteWinsOverHigherQuality) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.4", {"10.0.0.2", "10.0.0.3", "10.0.0.4"}, 1, 1000));
+    ASSERT_EQ(topology.SelectBestParent(kGroup), "10.0.0.4");
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1, 0));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.2");
+}
+
+TEST(TopologyManagerTest, SameDepthSwitchRequiresMargin) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1, 50));
+    // 帯域スコア +5 (スコア +25) は切り替えの差に満たない
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", {"10.0.0.3"}, 1, 55));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.2");
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", {"10.0.0.3"}, 2, 80));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.3");
+}
+
+TEST(TopologyManagerTest, DropsParentWhoseSourceSeqStalls) {
+    TopologyManager topology(kSelf);
+    const std::vector<std::string> path = {"10.0.0.2", "10.0.0.3"};
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", path, 7));
+    ASSERT_EQ(topology.SelectBestParent(kGroup), "10.0.0.3");
+    // 送信元シーケンス番号が進まない ADVERTISE が3回続くと、送信元から切り離されたとみなす
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", path, 7));
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", path, 7));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.3");
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", path, 7));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "");
+    // 進めば再び候補になる
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", path, 8));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.3");
+}
+
+TEST(TopologyManagerTest, SourceSeqWrapCountsAsAdvance) {
+    TopologyManager topology(kSelf);
+    const std::vector<std::string> path = {"10.0.0.2"};
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", path, UINT32_MAX));
+    for (uint32_t seq = 0; seq < 5; ++seq) topology.HandleAdvertise(MakeAdvertise("10.0.0.2", path, seq));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.2");
+}
+
+TEST(TopologyManagerTest, ChildAdvertisesParentPathPlusSelf) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 9));
+    const AdvertiseMessage own = topology.BuildAdvertise(NodeMetrics{});
+    ASSERT_EQ(own.routes.count(kGroup), 1u);
+    const GroupRoute& route = own.routes.at(kGroup);
+    EXPECT_EQ(route.hops_to_source, 1);
+    EXPECT_EQ(route.source_seq, 9u);
+    EXPECT_EQ(route.path, (std::vector<std::string>{"10.0.0.2", kSelf}));
+}
+
+TEST(TopologyManagerTest, SourceGroupAdvancesSeqAndHasNoParent) {
+    TopologyManager topology(kSelf);
+    topology.AddSourceGroup(kGroup);
+    const AdvertiseMessage first = topology.BuildAdvertise(NodeMetrics{});
+    const AdvertiseMessage second = topology.BuildAdvertise(NodeMetrics{});
+    EXPECT_EQ(first.routes.at(kGroup).hops_to_source, 0);
+    EXPECT_EQ(second.routes.at(kGroup).source_seq, first.routes.at(kGroup).source_seq + 1);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "");
+}
+
+TEST(TopologyManagerTest, DepartureSwitchesToRecommendedParent) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.3", {"10.0.0.2", "10.0.0.3"}, 1));
+    ASSERT_EQ(topology.SelectBestParent(kGroup), "10.0.0.3");
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1));
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.4", {"10.0.0.2", "10.0.0.4"}, 1));
+    ASSERT_EQ(topology.SelectBestParent(kGroup), "10.0.0.2");
+    // ADVERTISE を未受信の推奨候補は評価できないため読み飛ばす
+    const auto handoff = topology.HandleParentDeparture("10.0.0.2", kGroup, {"10.0.0.9", "10.0.0.4"});
+    EXPECT_EQ(handoff.new_parent, "10.0.0.4");
+    EXPECT_FALSE(handoff.receiving);
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.4");
+    // 予告の再送には切り替え後の親を受信中として返す
+    const auto resent = topology.HandleParentDeparture("10.0.0.2", kGroup, {"10.0.0.9"});
+    EXPECT_EQ(resent.new_parent, "10.0.0.4");
+    EXPECT_TRUE(resent.receiving);
+}
+
+TEST(TopologyManagerTest, DepartingPeerIsNotReselectedFromAdvertise) {
+    TopologyManager topology(kSelf);
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1));
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.4", {"10.0.0.2", "10.0.0.4"}, 1));
+    ASSERT_EQ(topology.HandleParentDeparture("10.0.0.2", kGroup, {"10.0.0.4"}).new_parent, "10.0.0.4");
+    // 停止を予告したピアは、浅い経路を広告し続けても親候補に戻らない (バッチ処理と同じ扱い)
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 2));
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.4");
+    topology.EnqueueAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 3));
+    topology.FlushAdvertiseBatch();
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.4");
+}
+
+/**
+ * @brief 親変更の通知を記録するハンドラ付きの TopologyManager を、手動で進める時計で動かす。
+ */
+struct FailoverFixture : ::testing::Test {
+    Clock::time_point now{};
+    TopologyManager topology{kSelf};
+    std::vector<std::pair<std::string, std::string>> switches; // (旧親, 新親)
+
+    void SetUp() override {
+        topology.SetClock([this] { return now; });
+        topology.SetParentChangeHandler(
+            [this](const std::string&, const std::string& old_parent, const std::string& new_parent) {
+                switches.emplace_back(old_parent, new_parent);
+            });
+    }
+
+    /**
+     * @brief 親候補 ip から一定間隔で HEARTBEAT を受信し、到着間隔を学習させる。
+     */
+    void TrainHeartbeats(const std::string& ip, int count) {
+        for (int i = 0; i < count; ++i) {
+            now += std::chrono::milliseconds(100);
+            topology.HandleHeartbeat(ip, kGroup);
+        }
+    }
+};
+
+TEST_F(FailoverFixture, FailedParentWithoutSecondaryNotifiesEmptyParent) {
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1));
+    ASSERT_EQ(topology.SelectBestParent(kGroup), "10.0.0.2");
+    TrainHeartbeats("10.0.0.2", 10);
+    switches.clear();
+    const uint64_t before = TopologyMetrics::Get().parent_switches.Value();
+
+    // 学習済みの間隔を大きく超えて途絶すると障害と判定される
+    now += std::chrono::seconds(10);
+    topology.CheckParentHealth(kGroup);
+
+    ASSERT_EQ(switches.size(), 1u);
+    EXPECT_EQ(switches[0].first, "10.0.0.2");
+    EXPECT_EQ(switches[0].second, "");
+    EXPECT_EQ(TopologyMetrics::Get().parent_switches.Value(), before + 1);
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "");
+
+    // 選定はリセット済みのため、再度の評価では通知しない
+    topology.CheckParentHealth(kGroup);
+    EXPECT_EQ(switches.size(), 1u);
+}
+
+TEST_F(FailoverFixture, HealthyParentIsKept) {
+    topology.HandleAdvertise(MakeAdvertise("10.0.0.2", {"10.0.0.2"}, 1));
+    TrainHeartbeats("10.0.0.2", 10);
+    switches.clear();
+    topology.CheckParentHealth(kGroup);
+    EXPECT_TRUE(switches.empty());
+    EXPECT_EQ(topology.SelectBestParent(kGroup), "10.0.0.2");
+}
+
+} // namespace